@@ -3,6 +3,7 @@
 #define INSTR_H
 
 #include "machine.h"
+#include "stats.h"
 
 //data structure representing each instruction
 typedef struct my_instruction
@@ -45,4 +46,10 @@ extern void put_instr(instruction_trace_t* trace, instruction_t* instr);
 //gets the instruction at the index, from the trace
 extern instruction_t* get_instr(instruction_trace_t* trace, int index);
 
+//simulates the trace with tomasulo's algorithm, returns the number of cycles
+extern counter_t runTomasulo(instruction_trace_t* trace);
+
+//registers the tomasulo stall-cause counters and CPI stack
+extern void tomasulo_reg_stats(struct stat_sdb_t *sdb);
+
 #endif
@@ -141,6 +141,7 @@ sim_reg_stats(struct stat_sdb_t *sdb)
   stat_reg_counter(sdb, "sim_num_tom_cycles",
 		   "total number of cycles with tomasulo",
 		   &sim_num_tom_cycles, 0, NULL);
+  tomasulo_reg_stats(sdb);
   /* ECE552 END */
 
   ld_reg_stats(sdb);
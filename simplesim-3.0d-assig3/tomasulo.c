@@ -99,6 +99,23 @@ static instruction_t* map_table[MD_TOTAL_REGS];
 //the index of the last instruction fetched
 static int fetch_index = 0;
 
+/* STALL ACCOUNTING */
+
+//every cycle is charged to exactly one of these, based on what the head of the IFQ did
+static counter_t tom_cycles_dispatch = 0;     //head of IFQ dispatched (or a branch left the IFQ)
+static counter_t tom_cycles_ifq_empty = 0;    //IFQ empty while the trace still has instructions
+static counter_t tom_cycles_rs_int_full = 0;  //head of IFQ stalled, all INT reservation stations busy
+static counter_t tom_cycles_rs_fp_full = 0;   //head of IFQ stalled, all FP reservation stations busy
+static counter_t tom_cycles_drain = 0;        //trace fully fetched, waiting for the pipeline to empty
+
+//structural hazards behind the reservation stations (not exclusive of the above)
+static counter_t tom_cycles_fu_int_busy = 0;  //cycles with a ready INT instruction but no free INT FU
+static counter_t tom_cycles_fu_fp_busy = 0;   //cycles with a ready FP instruction but no free FP FU
+static counter_t tom_insn_fu_int_busy = 0;    //instruction-cycles lost waiting for an INT FU
+static counter_t tom_insn_fu_fp_busy = 0;     //instruction-cycles lost waiting for an FP FU
+static counter_t tom_cycles_cdb_conflict = 0; //cycles with more than one instruction ready to broadcast
+static counter_t tom_insn_cdb_stall = 0;      //instruction-cycles lost waiting for the CDB
+
 /* FUNCTIONAL UNITS */
 
 
@@ -255,6 +272,7 @@ void execute_To_CDB(int current_cycle) {
 
   int i;
   int j;
+  int cdb_requests = 0;
   instruction_t *oldest_instruction = NULL;
 
   // INT Functional Unit
@@ -264,6 +282,7 @@ void execute_To_CDB(int current_cycle) {
         // indicates that the execution is done for the instruction
         if (WRITES_CDB(fuINT[i]->op)) {
           // instruction uses CDB
+          cdb_requests++;
           // check for the oldest instruction that is ready to be broadcast
           if (oldest_instruction == NULL) {
             oldest_instruction = fuINT[i];
@@ -295,6 +314,7 @@ void execute_To_CDB(int current_cycle) {
         // indicates that the execution is done for the instruction
         if (WRITES_CDB(fuFP[i]->op)) {
           // instruction uses CDB
+          cdb_requests++;
           // check for the oldest instruction that is ready to be broadcast
           if (oldest_instruction == NULL) {
             oldest_instruction = fuFP[i];
@@ -319,6 +339,12 @@ void execute_To_CDB(int current_cycle) {
     }
   }
 
+  // every finished instruction that lost arbitration waits another cycle for the CDB
+  if (cdb_requests > 1) {
+    tom_cycles_cdb_conflict++;
+    tom_insn_cdb_stall += cdb_requests - 1;
+  }
+
   // set CDB cycle count
   if (oldest_instruction != NULL) {
     oldest_instruction->tom_cdb_cycle = current_cycle;
@@ -382,6 +408,29 @@ void issue_To_execute(int current_cycle) {
       }
     }
   }
+
+  // Anything still ready in a RS at this point was denied a functional unit this cycle
+  int waiting = 0;
+  for (int j = 0; j < RESERV_INT_SIZE; j++) {
+    if ((reservINT[j] != NULL) && !reservINT[j]->tom_execute_cycle && !reservINT[j]->Q[0] && !reservINT[j]->Q[1] && !reservINT[j]->Q[2]) {
+      waiting++;
+    }
+  }
+  if (waiting) {
+    tom_cycles_fu_int_busy++;
+    tom_insn_fu_int_busy += waiting;
+  }
+
+  waiting = 0;
+  for (int j = 0; j < RESERV_FP_SIZE; j++) {
+    if ((reservFP[j] != NULL) && !reservFP[j]->tom_execute_cycle && !reservFP[j]->Q[0] && !reservFP[j]->Q[1] && !reservFP[j]->Q[2]) {
+      waiting++;
+    }
+  }
+  if (waiting) {
+    tom_cycles_fu_fp_busy++;
+    tom_insn_fu_fp_busy += waiting;
+  }
 }
 
 /* 
@@ -395,11 +444,18 @@ void issue_To_execute(int current_cycle) {
 void dispatch_To_issue(int current_cycle) {
 
   if (instr_queue_size == 0) {
-      return;  // Nothing in IFQ
+      // Nothing in IFQ, either the front end is behind or the trace is exhausted
+      if (fetch_index >= sim_num_insn) {
+        tom_cycles_drain++;
+      } else {
+        tom_cycles_ifq_empty++;
+      }
+      return;
   }
 
   instruction_t* instruction = instr_queue[0];
   if (instruction == NULL) {
+    tom_cycles_ifq_empty++;
     return;    // Invalid instruction
   }
 
@@ -411,6 +467,7 @@ void dispatch_To_issue(int current_cycle) {
       instr_queue[i] = instr_queue[i + 1];    // shift the entries 
     }
     instr_queue[INSTR_QUEUE_SIZE - 1] = NULL; // set the last entry to NULL
+    tom_cycles_dispatch++;
     return;
   }
 
@@ -440,8 +497,21 @@ void dispatch_To_issue(int current_cycle) {
     }
   }
 
+  // Charge the cycle to the structure that blocked the head of the IFQ
+  if (!dispatched) {
+    if (USES_INT_FU(instruction->op)) {
+      tom_cycles_rs_int_full++;
+    } else if (USES_FP_FU(instruction->op)) {
+      tom_cycles_rs_fp_full++;
+    } else {
+      // traps are skipped at fetch, so nothing else can reach the head of the IFQ
+      panic("instruction %d at the head of the IFQ uses no RS", instruction->index);
+    }
+  }
+
   // Update dependencies and instruction queue if dispatched
   if (dispatched) {
+    tom_cycles_dispatch++;
     instr_queue_size--;   // Remove instruction from issue queue
     for (int i = 0; i < INSTR_QUEUE_SIZE; i++) {
       instr_queue[i] = instr_queue[i + 1];  // shift the entries after the instruction is dispatched
@@ -524,6 +594,73 @@ void fetch_To_dispatch(instruction_trace_t* trace, int current_cycle) {
   }
 }
 
+/* 
+ * Description: 
+ * 	Registers the stall-cause counters and the CPI stack built from them.
+ *      The dispatch components (base, ifq_empty, rs_int_full, rs_fp_full, drain)
+ *      partition the simulated cycles, so they add up to the overall CPI.
+ * Inputs:
+ * 	sdb: the stats database of the simulator
+ * Returns:
+ * 	None
+ */
+void tomasulo_reg_stats(struct stat_sdb_t *sdb) {
+
+  stat_reg_counter(sdb, "tom_cycles_dispatch",
+		   "cycles the head of the IFQ dispatched",
+		   &tom_cycles_dispatch, 0, NULL);
+  stat_reg_counter(sdb, "tom_cycles_ifq_empty",
+		   "cycles with an empty IFQ (front end behind)",
+		   &tom_cycles_ifq_empty, 0, NULL);
+  stat_reg_counter(sdb, "tom_cycles_rs_int_full",
+		   "cycles the head of the IFQ stalled on full INT RS",
+		   &tom_cycles_rs_int_full, 0, NULL);
+  stat_reg_counter(sdb, "tom_cycles_rs_fp_full",
+		   "cycles the head of the IFQ stalled on full FP RS",
+		   &tom_cycles_rs_fp_full, 0, NULL);
+  stat_reg_counter(sdb, "tom_cycles_drain",
+		   "cycles spent draining the pipeline after the last fetch",
+		   &tom_cycles_drain, 0, NULL);
+
+  stat_reg_counter(sdb, "tom_cycles_fu_int_busy",
+		   "cycles a ready instruction found all INT FUs busy",
+		   &tom_cycles_fu_int_busy, 0, NULL);
+  stat_reg_counter(sdb, "tom_insn_fu_int_busy",
+		   "instruction-cycles spent waiting for an INT FU",
+		   &tom_insn_fu_int_busy, 0, NULL);
+  stat_reg_counter(sdb, "tom_cycles_fu_fp_busy",
+		   "cycles a ready instruction found all FP FUs busy",
+		   &tom_cycles_fu_fp_busy, 0, NULL);
+  stat_reg_counter(sdb, "tom_insn_fu_fp_busy",
+		   "instruction-cycles spent waiting for an FP FU",
+		   &tom_insn_fu_fp_busy, 0, NULL);
+  stat_reg_counter(sdb, "tom_cycles_cdb_conflict",
+		   "cycles with more than one instruction contending for the CDB",
+		   &tom_cycles_cdb_conflict, 0, NULL);
+  stat_reg_counter(sdb, "tom_insn_cdb_stall",
+		   "instruction-cycles lost to CDB arbitration",
+		   &tom_insn_cdb_stall, 0, NULL);
+
+  stat_reg_formula(sdb, "tom_cpi",
+		   "cycles per instruction with tomasulo",
+		   "sim_num_tom_cycles / sim_num_insn", NULL);
+  stat_reg_formula(sdb, "tom_cpi_base",
+		   "CPI stack: dispatching",
+		   "tom_cycles_dispatch / sim_num_insn", NULL);
+  stat_reg_formula(sdb, "tom_cpi_ifq_empty",
+		   "CPI stack: IFQ empty",
+		   "tom_cycles_ifq_empty / sim_num_insn", NULL);
+  stat_reg_formula(sdb, "tom_cpi_rs_int_full",
+		   "CPI stack: INT reservation stations full",
+		   "tom_cycles_rs_int_full / sim_num_insn", NULL);
+  stat_reg_formula(sdb, "tom_cpi_rs_fp_full",
+		   "CPI stack: FP reservation stations full",
+		   "tom_cycles_rs_fp_full / sim_num_insn", NULL);
+  stat_reg_formula(sdb, "tom_cpi_drain",
+		   "CPI stack: pipeline drain",
+		   "tom_cycles_drain / sim_num_insn", NULL);
+}
+
 /* 
  * Description: 
  * 	Performs a cycle-by-cycle simulation of the 4-stage pipeline
@@ -578,5 +715,8 @@ counter_t runTomasulo(instruction_trace_t* trace)
      if (is_simulation_done(sim_num_insn))
         break;
   }
+  // the returned count includes the final increment past the last simulated cycle,
+  // charge it to the drain so the dispatch components add up to sim_num_tom_cycles
+  tom_cycles_drain++;
   return cycle;
 }
@@ -120,6 +120,24 @@ typedef unsigned int *BITMAP_PTR_TYPE;
 #define BITMAP_CLEAR_P(BMAP, SZ, BIT)				\
   (!BMAP_SET_P((BMAP), (SZ), (BIT)))
 
+/* return the first bit set in bitmap BMAP at or after bit BIT and before bit
+   LIMIT, or -1 if there is none, scans a word at a time */
+#define BITMAP_NEXT_SET(BMAP, BIT, LIMIT)			\
+({								\
+  int ns_bit = (BIT), ns_res = -1;				\
+  while (ns_bit < (LIMIT))					\
+    {								\
+      unsigned int ns_word = (BMAP)[ns_bit/32] >> (ns_bit % 32);	\
+      if (ns_word)						\
+	{							\
+	  ns_res = ns_bit + __builtin_ctz(ns_word);		\
+	  break;						\
+	}							\
+      ns_bit = (ns_bit/32 + 1) * 32;				\
+    }								\
+  (ns_res < (LIMIT)) ? ns_res : -1;				\
+})
+
 /* count the number of bits set in BMAP */
 #define BITMAP_COUNT_ONES(BMAP, SZ)				\
 ({								\
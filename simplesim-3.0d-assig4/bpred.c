@@ -51,13 +51,18 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
 #include <assert.h>
 
 #include "host.h"
 #include "misc.h"
 #include "machine.h"
+#include "regs.h"
+#include "memory.h"
 #include "bpred.h"
+#include "libexo/libexo.h"
+#include "eio.h"
 
 /* turn this on to enable the SimpleScalar 2.0 RAS bug */
 /* #define RAS_BUG_COMPATIBLE */
@@ -483,6 +488,191 @@ bpred_after_priming(struct bpred_t *bpred)
   bpred->ras_hits = 0;
 }
 
+/* a BTB entry in a checkpoint, the entries of each set are saved in LRU
+   chain order, most recently used first */
+struct bpred_chkpt_btb_t {
+  md_addr_t addr;		/* address of branch being tracked */
+  md_addr_t target;		/* last destination of branch when taken */
+  int op;			/* opcode of branch corresp. to addr */
+};
+
+/* append the tables of direction predictor PRED_DIR to checkpoint list EXO,
+   or read them from checkpoint list position *ELT if EXO is NULL */
+static void
+bpred_dir_chkpt(struct bpred_dir_t *pred_dir,	/* branch dir predictor inst */
+		struct exo_term_t *exo,		/* checkpoint list to write */
+		struct exo_term_t **elt)	/* checkpoint list to read */
+{
+  int size;
+
+  if (!pred_dir)
+    return;
+
+  switch (pred_dir->class) {
+  case BPred2Level:
+    size = pred_dir->config.two.l1size * sizeof(int);
+    if (exo)
+      eio_chkpt_add_blob(exo, size, pred_dir->config.two.shiftregs);
+    else
+      eio_chkpt_blob(elt, pred_dir->config.two.shiftregs, size,
+		     "the branch predictor");
+    size = pred_dir->config.two.l2size;
+    if (exo)
+      eio_chkpt_add_blob(exo, size, pred_dir->config.two.l2table);
+    else
+      eio_chkpt_blob(elt, pred_dir->config.two.l2table, size,
+		     "the branch predictor");
+    break;
+
+  case BPred2bit:
+    size = pred_dir->config.bimod.size;
+    if (exo)
+      eio_chkpt_add_blob(exo, size, pred_dir->config.bimod.table);
+    else
+      eio_chkpt_blob(elt, pred_dir->config.bimod.table, size,
+		     "the branch predictor");
+    break;
+
+  default:
+    panic("bogus branch direction predictor class");
+  }
+}
+
+/* write the state of branch predictor PRED to checkpoint stream FD: its
+   direction predictor tables, BTB and return address stack */
+void
+bpred_write_chkpt(struct bpred_t *pred,	/* branch predictor instance */
+		  FILE *fd)		/* stream to write to */
+{
+  int i, j, n = pred->btb.sets * pred->btb.assoc;
+  struct bpred_btb_ent_t *ent;
+  struct bpred_chkpt_btb_t *btb = NULL;
+  md_addr_t *ras = NULL;
+  struct exo_term_t *exo;
+
+  exo = exo_new(ec_list,
+		exo_new(ec_integer, (exo_integer_t)pred->class),
+		exo_new(ec_integer, (exo_integer_t)pred->btb.sets),
+		exo_new(ec_integer, (exo_integer_t)pred->btb.assoc),
+		exo_new(ec_integer, (exo_integer_t)pred->retstack.size),
+		exo_new(ec_integer, (exo_integer_t)pred->retstack.tos),
+		NULL);
+  bpred_dir_chkpt(pred->dirpred.bimod, exo, NULL);
+  bpred_dir_chkpt(pred->dirpred.twolev, exo, NULL);
+  bpred_dir_chkpt(pred->dirpred.meta, exo, NULL);
+
+  if (n)
+    {
+      if (!(btb = calloc(n, sizeof(struct bpred_chkpt_btb_t))))
+	fatal("out of virtual memory");
+      for (i=0; i < pred->btb.sets; i++)
+	{
+	  /* walk the LRU chain from its head, the entry with no PREV */
+	  for (j=0; j < pred->btb.assoc - 1; j++)
+	    if (pred->btb.btb_data[i * pred->btb.assoc + j].prev == NULL)
+	      break;
+	  ent = &pred->btb.btb_data[i * pred->btb.assoc + j];
+	  for (j=0; j < pred->btb.assoc; j++, ent = ent->next)
+	    {
+	      btb[i * pred->btb.assoc + j].addr = ent->addr;
+	      btb[i * pred->btb.assoc + j].target = ent->target;
+	      btb[i * pred->btb.assoc + j].op = ent->op;
+	    }
+	}
+      eio_chkpt_add_blob(exo, n * sizeof(struct bpred_chkpt_btb_t), btb);
+    }
+  if (pred->retstack.size)
+    {
+      if (!(ras = calloc(pred->retstack.size, sizeof(md_addr_t))))
+	fatal("out of virtual memory");
+      for (i=0; i < pred->retstack.size; i++)
+	ras[i] = pred->retstack.stack[i].target;
+      eio_chkpt_add_blob(exo, pred->retstack.size * sizeof(md_addr_t), ras);
+    }
+
+  fprintf(fd, "/* branch predictor state */\n");
+  exo_print(exo, fd);
+  fprintf(fd, "\n\n");
+  exo_delete(exo);
+  if (btb)
+    free(btb);
+  if (ras)
+    free(ras);
+}
+
+/* restore the state of branch predictor PRED from checkpoint stream FD, as
+   written by bpred_write_chkpt() for a predictor of the same configuration,
+   returns FALSE if the stream holds no more checkpoint terms */
+int					/* predictor state restored? */
+bpred_read_chkpt(struct bpred_t *pred,	/* branch predictor instance */
+		 FILE *fd)		/* stream to read */
+{
+  int i, j, n = pred->btb.sets * pred->btb.assoc;
+  struct bpred_btb_ent_t *ent;
+  struct bpred_chkpt_btb_t *btb;
+  md_addr_t *ras;
+  struct exo_term_t *exo, *elt;
+
+  if (!(exo = exo_read(fd)))
+    return FALSE;
+  if (exo->ec != ec_list)
+    fatal("could not read the branch predictor checkpoint");
+  for (i=0, elt=exo->as_list.head; i < 5; i++, elt=elt->next)
+    if (!elt || elt->ec != ec_integer)
+      fatal("could not read the branch predictor checkpoint");
+  elt = exo->as_list.head;
+  if (elt->as_integer.val != pred->class
+      || elt->next->as_integer.val != pred->btb.sets
+      || elt->next->next->as_integer.val != pred->btb.assoc
+      || elt->next->next->next->as_integer.val != pred->retstack.size)
+    fatal("branch predictor checkpoint does not match its configuration");
+  pred->retstack.tos = elt->next->next->next->next->as_integer.val;
+  elt = elt->next->next->next->next->next;
+
+  bpred_dir_chkpt(pred->dirpred.bimod, NULL, &elt);
+  bpred_dir_chkpt(pred->dirpred.twolev, NULL, &elt);
+  bpred_dir_chkpt(pred->dirpred.meta, NULL, &elt);
+
+  if (n)
+    {
+      if (!(btb = calloc(n, sizeof(struct bpred_chkpt_btb_t))))
+	fatal("out of virtual memory");
+      eio_chkpt_blob(&elt, btb, n * sizeof(struct bpred_chkpt_btb_t),
+		     "the branch predictor");
+
+      /* each set is relinked in the saved LRU order */
+      for (i=0; i < pred->btb.sets; i++)
+	for (j=0; j < pred->btb.assoc; j++)
+	  {
+	    ent = &pred->btb.btb_data[i * pred->btb.assoc + j];
+	    ent->addr = btb[i * pred->btb.assoc + j].addr;
+	    ent->target = btb[i * pred->btb.assoc + j].target;
+	    ent->op = (enum md_opcode)btb[i * pred->btb.assoc + j].op;
+	    if (pred->btb.assoc > 1)
+	      {
+		ent->prev = j != 0 ? ent - 1 : NULL;
+		ent->next = j != pred->btb.assoc - 1 ? ent + 1 : NULL;
+	      }
+	  }
+      free(btb);
+    }
+  if (pred->retstack.size)
+    {
+      if (!(ras = calloc(pred->retstack.size, sizeof(md_addr_t))))
+	fatal("out of virtual memory");
+      eio_chkpt_blob(&elt, ras, pred->retstack.size * sizeof(md_addr_t),
+		     "the branch predictor");
+      for (i=0; i < pred->retstack.size; i++)
+	pred->retstack.stack[i].target = ras[i];
+      free(ras);
+    }
+  if (elt != NULL)
+    fatal("could not read the branch predictor checkpoint (too many terms)");
+  exo_delete(exo);
+
+  return TRUE;
+}
+
 #define BIMOD_HASH(PRED, ADDR)						\
   ((((ADDR) >> 19) ^ ((ADDR) >> MD_BR_SHIFT)) & ((PRED)->config.bimod.size-1))
     /* was: ((baddr >> 16) ^ baddr) & (pred->dirpred.bimod.size-1) */
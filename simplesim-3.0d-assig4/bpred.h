@@ -226,6 +226,19 @@ bpred_reg_stats(struct bpred_t *pred,	/* branch predictor instance */
 /* reset stats after priming, if appropriate */
 void bpred_after_priming(struct bpred_t *bpred);
 
+/* write the state of branch predictor PRED to checkpoint stream FD: its
+   direction predictor tables, BTB and return address stack */
+void
+bpred_write_chkpt(struct bpred_t *pred,	/* branch predictor instance */
+		  FILE *fd);		/* stream to write to */
+
+/* restore the state of branch predictor PRED from checkpoint stream FD, as
+   written by bpred_write_chkpt() for a predictor of the same configuration,
+   returns FALSE if the stream holds no more checkpoint terms */
+int					/* predictor state restored? */
+bpred_read_chkpt(struct bpred_t *pred,	/* branch predictor instance */
+		 FILE *fd);		/* stream to read */
+
 /* probe a predictor for a next fetch address, the predictor is probed
    with branch address BADDR, the branch target is BTARGET (used for
    static predictors), and OP is the instruction opcode (used to simulate
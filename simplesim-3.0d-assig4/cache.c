@@ -51,23 +51,46 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <assert.h>
 
 #include "host.h"
 #include "misc.h"
 #include "machine.h"
 #include "cache.h"
+#include "libexo/libexo.h"
+#include "eio.h"
+
+/* search tag arrays eight tags at a time on hosts built with -mavx2, only
+   for 32-bit target addresses */
+#if defined(__AVX2__) && defined(TARGET_PISA)
+#define CACHE_AVX2_TAGS
+#include <immintrin.h>
+#endif
 
 /* cache access macros */
 #define CACHE_TAG(cp, addr)	((addr) >> (cp)->tag_shift)
-#define CACHE_SET(cp, addr)	(((addr) >> (cp)->set_shift) & (cp)->set_mask)
+#define CACHE_SET(cp, addr)						\
+  ((cp)->index == BitSelect						\
+   ? (((addr) >> (cp)->set_shift) & (cp)->set_mask)			\
+   : hash_set((cp), (addr), /* way */0))
 #define CACHE_BLK(cp, addr)	((addr) & (cp)->blk_mask)
 #define CACHE_TAGSET(cp, addr)	((addr) & (cp)->tagset_mask)
 
 /* extract/reconstruct a block address */
 #define CACHE_BADDR(cp, addr)	((addr) & ~(cp)->blk_mask)
 #define CACHE_MK_BADDR(cp, tag, set)					\
-  (((tag) << (cp)->tag_shift)|((set) << (cp)->set_shift))
+  ((cp)->index == BitSelect						\
+   ? (((tag) << (cp)->tag_shift)|((set) << (cp)->set_shift))		\
+   : ((tag) << (cp)->tag_shift))
+
+/* mask of the sectors of the NBYTES at block offset BOFS */
+#define CACHE_SECT_MASK(cp, bofs, nbytes)				\
+  ((((unsigned int)2 << (((bofs) + (nbytes) - 1) >> (cp)->sect_shift)) - 1)\
+   & ~((1u << ((bofs) >> (cp)->sect_shift)) - 1))
+
+/* time stamp of WAY of set SET of a skewed cache */
+#define CACHE_STAMP(cp, set, way)	((cp)->stamps[(set)*(cp)->assoc + (way)])
 
 /* index an array of cache blocks, non-trivial due to variable length blocks */
 #define CACHE_BINDEX(cp, blks, i)					\
@@ -87,12 +110,6 @@
 #define CACHE_HALF(data, bofs)	  __CACHE_ACCESS(unsigned short, data, bofs)
 #define CACHE_BYTE(data, bofs)	  __CACHE_ACCESS(unsigned char, data, bofs)
 
-/* cache block hashing macros, this macro is used to index into a cache
-   set hash table (to find the correct block on N in an N-way cache), the
-   cache set index function is CACHE_SET, defined above */
-#define CACHE_HASH(cp, key)						\
-  (((key >> 24) ^ (key >> 16) ^ (key >> 8) ^ key) & ((cp)->hsize-1))
-
 /* copy data out of a cache block to buffer indicated by argument pointer p */
 #define CACHE_BCOPY(cmd, blk, bofs, p, nbytes)	\
   if (cmd == Read)							\
@@ -139,121 +156,616 @@
 /* bound sqword_t/dfloat_t to positive int */
 #define BOUND_POS(N)		((int)(MIN(MAX(0, (N)), 2147483647)))
 
-/* unlink BLK from the hash table bucket chain in SET */
+/* fold the bits of block number BNUM onto the low INDEX_BITS bits */
+static md_addr_t
+fold_bits(struct cache_t *cp,			/* cache instance */
+	  md_addr_t bnum)			/* block number bits */
+{
+  md_addr_t fold = 0;
+
+  if (cp->index_bits == 0)
+    return 0;
+  for (; bnum; bnum >>= cp->index_bits)
+    fold ^= bnum & cp->set_mask;
+  return fold;
+}
+
+/* set of the block containing ADDR in way WAY of hashed cache CP, only the
+   ways of a skewed cache differ */
+static md_addr_t
+hash_set(struct cache_t *cp,			/* cache instance */
+	 md_addr_t addr,			/* address of block */
+	 int way)				/* way of the set */
+{
+  md_addr_t bnum = addr >> cp->set_shift, hi;
+  int n = cp->index_bits, r;
+
+  switch (cp->index) {
+  case BitSelect:
+    return bnum & cp->set_mask;
+  case XORIndex:
+    return (bnum ^ fold_bits(cp, bnum >> n)) & cp->set_mask;
+  case PrimeMod:
+    return bnum % (md_addr_t)cp->index_prime;
+  case Skewed:
+    /* way W rotates the folded bits by W, ways past INDEX_BITS reuse the
+       functions of the lower ways */
+    hi = fold_bits(cp, bnum >> n);
+    r = n ? way % n : 0;
+    if (r)
+      hi = ((hi << r) | (hi >> (n - r))) & cp->set_mask;
+    return (bnum ^ hi) & cp->set_mask;
+  default:
+    panic("bogus set index function");
+  }
+}
+
+/* search the tag array of SET for TAG, returns the matching way or -1, tags
+   of invalid ways hold CACHE_TAG_INVALID so they never match */
+static int
+find_way(struct cache_t *cp,			/* cache to search */
+	 struct cache_set_t *set,		/* set to search */
+	 md_addr_t tag)				/* tag to look for */
+{
+  int way = 0;
+
+#ifdef CACHE_AVX2_TAGS
+  /* compare eight tags per step */
+  __m256i key = _mm256_set1_epi32((int)tag);
+
+  for (; way + 8 <= cp->assoc; way += 8)
+    {
+      __m256i tags = _mm256_loadu_si256((__m256i *)&set->tags[way]);
+      int mask =
+	_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(tags, key)));
+
+      if (mask)
+	return way + __builtin_ctz(mask);
+    }
+#endif /* CACHE_AVX2_TAGS */
+
+  for (; way < cp->assoc; way++)
+    {
+      if (set->tags[way] == tag)
+	return way;
+    }
+  return -1;
+}
+
+/* find the way of cache CP holding the block containing ADDR, returns it
+   or -1, and sets *SET to the set of that way, in which each way of a
+   skewed cache has its own */
+static int
+lookup_way(struct cache_t *cp,			/* cache to search */
+	   md_addr_t addr,			/* address to look for */
+	   md_addr_t *set)			/* set of the way found */
+{
+  md_addr_t tag = CACHE_TAG(cp, addr);
+  int way;
+
+  if (cp->index != Skewed)
+    {
+      *set = CACHE_SET(cp, addr);
+      return find_way(cp, &cp->sets[*set], tag);
+    }
+
+  for (way=0; way<cp->assoc; way++)
+    {
+      *set = hash_set(cp, addr, way);
+      if (cp->sets[*set].tags[way] == tag)
+	return way;
+    }
+  *set = CACHE_SET(cp, addr);
+  return -1;
+}
+
+/* where to move a way in the recency order of its set */
+enum list_loc_t { Head, Tail };
+
+/* move WAY of SET to location WHERE of the recency order, Head makes it the
+   youngest (age 0) way and Tail the oldest (age assoc-1) way, the ways in
+   between age by one, just as if WAY were relinked in an ordered list; in a
+   skewed cache, Head stamps WAY with the current time and Tail with zero */
 static void
-unlink_htab_ent(struct cache_t *cp,		/* cache to update */
-		struct cache_set_t *set,	/* set containing bkt chain */
-		struct cache_blk_t *blk)	/* block to unlink */
+update_way_age(struct cache_t *cp,		/* cache to update */
+	       struct cache_set_t *set,		/* set containing WAY */
+	       int way,				/* way to move */
+	       enum list_loc_t where)		/* new location */
 {
-  struct cache_blk_t *prev, *ent;
-  int index = CACHE_HASH(cp, blk->tag);
+  int i, age = set->ages[way];
 
-  /* locate the block in the hash table bucket chain */
-  for (prev=NULL,ent=set->hash[index];
-       ent;
-       prev=ent,ent=ent->hash_next)
+  /* skewed caches order blocks across sets by their time stamps */
+  if (cp->stamps)
     {
-      if (ent == blk)
-	break;
+      CACHE_STAMP(cp, set - cp->sets, way) =
+	where == Head ? ++cp->stamp_clock : 0;
+      return;
     }
-  assert(ent);
 
-  /* unlink the block from the hash table bucket chain */
-  if (!prev)
+  if (where == Head)
+    {
+      if (age == 0)
+	return;
+      for (i=0; i<cp->assoc; i++)
+	{
+	  if (set->ages[i] < age)
+	    set->ages[i]++;
+	}
+      set->ages[way] = 0;
+    }
+  else if (where == Tail)
     {
-      /* head of hash bucket list */
-      set->hash[index] = ent->hash_next;
+      if (age == cp->assoc - 1)
+	return;
+      for (i=0; i<cp->assoc; i++)
+	{
+	  if (set->ages[i] > age)
+	    set->ages[i]--;
+	}
+      set->ages[way] = cp->assoc - 1;
     }
   else
+    panic("bogus WHERE designator");
+}
+
+/* return the way of SET with age AGE, Tail is age assoc-1 */
+static int
+way_of_age(struct cache_t *cp,			/* cache instance */
+	   struct cache_set_t *set,		/* set to search */
+	   int age)				/* age to look for */
+{
+  int i;
+
+  for (i=0; i<cp->assoc; i++)
     {
-      /* middle or end of hash bucket list */
-      prev->hash_next = ent->hash_next;
+      if (set->ages[i] == age)
+	return i;
     }
-  ent->hash_next = NULL;
+  panic("ages of set are not a permutation");
 }
 
-/* insert BLK onto the head of the hash table bucket chain in SET */
-static void
-link_htab_ent(struct cache_t *cp,		/* cache to update */
-	      struct cache_set_t *set,		/* set containing bkt chain */
-	      struct cache_blk_t *blk)		/* block to insert */
+/* find the MSHR holding an outstanding fill of block BADDR at time NOW */
+static struct cache_mshr_t *
+mshr_lookup(struct cache_t *cp,			/* cache instance */
+	    md_addr_t baddr,			/* block address */
+	    tick_t now)				/* time of access */
 {
-  int index = CACHE_HASH(cp, blk->tag);
+  int i;
 
-  /* insert block onto the head of the bucket chain */
-  blk->hash_next = set->hash[index];
-  set->hash[index] = blk;
+  for (i=0; i<cp->mshr_nentries; i++)
+    {
+      if (cp->mshrs[i].ready > now && cp->mshrs[i].baddr == baddr)
+	return &cp->mshrs[i];
+    }
+  return NULL;
 }
 
-/* where to insert a block onto the ordered way chain */
-enum list_loc_t { Head, Tail };
+/* pick the MSHR for a primary miss at time NOW, i.e., the one that is free
+   earliest, and return in *STALL the cycles until it is free */
+static struct cache_mshr_t *
+mshr_select(struct cache_t *cp,			/* cache instance */
+	    tick_t now,				/* time of access */
+	    int *stall)				/* cycles until the MSHR is free */
+{
+  struct cache_mshr_t *mshr = &cp->mshrs[0];
+  int i;
 
-/* insert BLK into the order way chain in SET at location WHERE */
-static void
-update_way_list(struct cache_set_t *set,	/* set contained way chain */
-		struct cache_blk_t *blk,	/* block to insert */
-		enum list_loc_t where)		/* insert location */
+  for (i=1; i<cp->mshr_nentries; i++)
+    {
+      if (cp->mshrs[i].ready < mshr->ready)
+	mshr = &cp->mshrs[i];
+    }
+  *stall = BOUND_POS(mshr->ready - now);
+  return mshr;
+}
+
+/* latency of a hit at NOW to block BLK containing ADDR, a demand access to a
+   block that is still being filled is a secondary miss, it merges onto the
+   block's MSHR or, if all its targets are taken, waits for the fill and
+   accesses the cache again */
+static unsigned int
+hit_latency(struct cache_t *cp,			/* cache instance */
+	    struct cache_blk_t *blk,		/* block that hit */
+	    md_addr_t addr,			/* address of access */
+	    tick_t now,				/* time of access */
+	    int prefetch)			/* non-zero for a prefetch */
 {
-  /* unlink entry from the way list */
-  if (!blk->way_prev && !blk->way_next)
+  struct cache_mshr_t *mshr;
+
+  if (cp->mshr_nentries && !prefetch && blk->ready > now
+      && (mshr = mshr_lookup(cp, CACHE_BADDR(cp, addr), now)) != NULL)
     {
-      /* only one entry in list (direct-mapped), no action */
-      assert(set->way_head == blk && set->way_tail == blk);
-      /* Head/Tail order already */
-      return;
+      if (mshr->targets < cp->mshr_ntargets)
+	{
+	  mshr->targets++;
+	  cp->mshr_merges++;
+	}
+      else
+	{
+	  cp->mshr_target_full++;
+	  cp->mshr_stall_cycles += (blk->ready - now) + cp->hit_latency;
+	  return (unsigned int)(blk->ready - now) + cp->hit_latency;
+	}
+    }
+
+  /* first cycle data is available to access */
+  return (int) MAX(cp->hit_latency, (blk->ready - now));
+}
+
+/* find the write buffer entry holding a writeback of block BADDR that has
+   not completed by time NOW */
+static struct cache_wbuf_t *
+wbuf_lookup(struct cache_t *cp,			/* cache instance */
+	    md_addr_t baddr,			/* block address */
+	    tick_t now)				/* time of access */
+{
+  int i;
+
+  for (i=0; i<cp->wbuf_nentries; i++)
+    {
+      if (cp->wbuf[i].ready > now && cp->wbuf[i].baddr == baddr)
+	return &cp->wbuf[i];
+    }
+  return NULL;
+}
+
+/* read the sectors MASK of block BLK at BADDR from the next level at NOW, the
+   whole block if CP is not sectored, returns the latency of the fill, the
+   sectors being read in parallel */
+static unsigned int
+fill_blk(struct cache_t *cp,			/* cache instance */
+	 md_addr_t baddr,			/* block address */
+	 struct cache_blk_t *blk,		/* block filled, NULL if none */
+	 unsigned int mask,			/* sectors to read */
+	 tick_t now,				/* time of fill */
+	 md_addr_t pc,				/* PC of the requesting access */
+	 int prefetch)				/* non-zero for a prefetch */
+{
+  unsigned int lat = 0;
+  int i;
+
+  if (!cp->sect_size)
+    {
+      cp->fill_bytes += cp->bsize;
+      return cp->blk_access_fn(Read, baddr, cp->bsize, blk, now, pc,
+			       prefetch);
     }
-  /* else, more than one element in the list */
-  else if (!blk->way_prev)
+
+  for (i=0; mask != 0; i++, mask >>= 1)
     {
-      assert(set->way_head == blk && set->way_tail != blk);
-      if (where == Head)
+      if (mask & 1)
 	{
-	  /* already there */
-	  return;
+	  cp->fill_bytes += cp->sect_size;
+	  lat = MAX(lat, cp->blk_access_fn(Read, baddr + (i << cp->sect_shift),
+					   cp->sect_size, blk, now, pc,
+					   prefetch));
 	}
-      /* else, move to tail */
-      set->way_head = blk->way_next;
-      blk->way_next->way_prev = NULL;
     }
-  else if (!blk->way_next)
+  return lat;
+}
+
+/* write block BLK at BADDR to the next level at NOW, only its dirty sectors
+   if CP is sectored, or all of its valid sectors if an upper level made it
+   dirty, returns the latency of the writes, made in parallel */
+static unsigned int
+write_blk(struct cache_t *cp,			/* cache instance */
+	  md_addr_t baddr,			/* block address */
+	  struct cache_blk_t *blk,		/* block written, NULL if none */
+	  tick_t now,				/* time of write */
+	  md_addr_t pc)				/* PC of the requesting access */
+{
+  unsigned int mask, lat = 0;
+  int i;
+
+  if (!cp->sect_size || !blk)
+    {
+      cp->wb_bytes += cp->bsize;
+      return cp->blk_access_fn(Write, baddr, cp->bsize, blk, now, pc,
+			       /* prefetch */0);
+    }
+
+  mask = blk->sect_dirty ? blk->sect_dirty : blk->sect_valid;
+  for (i=0; mask != 0; i++, mask >>= 1)
     {
-      /* end of list (and not front of list) */
-      assert(set->way_head != blk && set->way_tail == blk);
-      if (where == Tail)
+      if (mask & 1)
 	{
-	  /* already there */
-	  return;
+	  cp->wb_bytes += cp->sect_size;
+	  lat = MAX(lat, cp->blk_access_fn(Write, baddr + (i << cp->sect_shift),
+					   cp->sect_size, blk, now, pc,
+					   /* prefetch */0));
 	}
-      set->way_tail = blk->way_prev;
-      blk->way_prev->way_next = NULL;
     }
+  return lat;
+}
+
+/* write back block BLK at BADDR at time NOW, through the write buffer if the
+   cache has one, returns the latency the writeback adds to the access */
+static unsigned int
+writeback(struct cache_t *cp,			/* cache instance */
+	  md_addr_t baddr,			/* block address */
+	  struct cache_blk_t *blk,		/* block written back */
+	  tick_t now,				/* time of writeback */
+	  md_addr_t pc)				/* PC of the requesting access */
+{
+  struct cache_wbuf_t *wb;
+  unsigned int lat;
+  tick_t issue;
+  int i, stall;
+
+  if (!cp->wbuf_nentries)
+    return write_blk(cp, baddr, blk, now, pc);
+
+  /* coalesce with a buffered writeback of the block yet to drain */
+  wb = wbuf_lookup(cp, baddr, now);
+  if (wb && wb->issue > now)
+    {
+      cp->wbuf_coalesced++;
+      return 0;
+    }
+
+  /* take the entry free earliest, waiting for it if the buffer is full */
+  wb = &cp->wbuf[0];
+  for (i=1; i<cp->wbuf_nentries; i++)
+    {
+      if (cp->wbuf[i].ready < wb->ready)
+	wb = &cp->wbuf[i];
+    }
+  stall = BOUND_POS(wb->ready - now);
+  if (stall)
+    {
+      cp->wbuf_full++;
+      cp->wbuf_stall_cycles += stall;
+    }
+
+  /* the buffer drains one write at a time, behind the writes before it */
+  issue = MAX(now + stall, cp->wbuf_drain);
+  lat = write_blk(cp, baddr, blk, issue, pc);
+  cp->wbuf_writes++;
+  wb->baddr = baddr;
+  wb->issue = issue;
+  wb->ready = issue + MAX(lat, 1);
+  cp->wbuf_drain = wb->ready;
+
+  return stall;
+}
+
+/* SHiP signature of a program counter, an index into the SHCT */
+#define CACHE_SHIP_SIG(pc)						\
+  ((((pc) >> 3) ^ ((pc) >> (3 + CACHE_SHCT_BITS))) & (CACHE_SHCT_SIZE - 1))
+
+/* DRRIP set-dueling role of a set */
+enum duel_role_t { Follower, SRRIPLeader, BRRIPLeader };
+
+/* decide if SET is a leader set using complement-select, i.e., within every
+   group of CACHE_DUEL_MOD sets the set whose offset matches the group number
+   leads SRRIP and the set whose offset matches its complement leads BRRIP */
+static enum duel_role_t
+duel_role(struct cache_t *cp,			/* cache instance */
+	  md_addr_t set)			/* set index */
+{
+  int mod = MIN(CACHE_DUEL_MOD, cp->nsets);
+  md_addr_t group, offset;
+
+  if (mod < 2)
+    return Follower;
+
+  group = (set / mod) & (mod - 1);
+  offset = set & (mod - 1);
+  if (offset == group)
+    return SRRIPLeader;
+  else if (offset == (~group & (mod - 1)))
+    return BRRIPLeader;
   else
+    return Follower;
+}
+
+/* largest RRPV of the replacement policy of CP, i.e., a distant re-reference */
+#define RRPV_DISTANT(cp)						\
+  ((cp)->policy == NRU ? CACHE_NRU_MAX : CACHE_RRPV_MAX)
+
+/* select a victim way in SET under NRU/RRIP: the first invalid block, else
+   the first block predicted for a distant re-reference, aging the whole set
+   as many times as it takes for one to be found */
+static int
+rrip_select_victim(struct cache_t *cp,		/* cache instance */
+		   struct cache_set_t *set)	/* set to replace in */
+{
+  struct cache_blk_t *blk, *repl = NULL;
+  int i, way = 0, distant = RRPV_DISTANT(cp);
+
+  for (i=0; i<cp->assoc; i++)
     {
-      /* middle of list (and not front or end of list) */
-      assert(set->way_head != blk && set->way_tail != blk);
-      blk->way_prev->way_next = blk->way_next;
-      blk->way_next->way_prev = blk->way_prev;
+      if (set->tags[i] == CACHE_TAG_INVALID)
+	return i;
+      blk = CACHE_BINDEX(cp, set->blks, i);
+      if (!repl || blk->rrpv > repl->rrpv)
+	{
+	  repl = blk;
+	  way = i;
+	}
     }
 
-  /* link BLK back into the list */
-  if (where == Head)
+  /* age the set in one step, same as incrementing until REPL is distant */
+  if (repl->rrpv < distant)
     {
-      /* link to the head of the way list */
-      blk->way_next = set->way_head;
-      blk->way_prev = NULL;
-      set->way_head->way_prev = blk;
-      set->way_head = blk;
+      int age = distant - repl->rrpv;
+
+      for (i=0; i<cp->assoc; i++)
+	{
+	  blk = CACHE_BINDEX(cp, set->blks, i);
+	  blk->rrpv = MIN(blk->rrpv + age, distant);
+	}
     }
-  else if (where == Tail)
+  return way;
+}
+
+/* set the insertion RRPV of newly filled block BLK in set SET, PC is the
+   program counter of the access that caused the fill (SHiP only) */
+static void
+rrip_insert(struct cache_t *cp,			/* cache instance */
+	    md_addr_t set,			/* set index of BLK */
+	    struct cache_blk_t *blk,		/* block just filled */
+	    md_addr_t pc)			/* PC of the filling access */
+{
+  int brrip = FALSE;
+
+  switch (cp->policy) {
+  case NRU:
+    blk->rrpv = 0;
+    return;
+  case SRRIP:
+    break;
+  case DRRIP:
+    switch (duel_role(cp, set)) {
+    case SRRIPLeader: brrip = FALSE; break;
+    case BRRIPLeader: brrip = TRUE; break;
+    default: brrip = (cp->psel > CACHE_PSEL_MAX/2); break;
+    }
+    break;
+  case SHiP:
+    blk->sig = CACHE_SHIP_SIG(pc);
+    blk->reref = FALSE;
+    /* no hits recorded for this signature, predict a distant re-reference */
+    if (!cp->shct[blk->sig])
+      {
+	blk->rrpv = CACHE_RRPV_MAX;
+	return;
+      }
+    break;
+  default:
+    panic("bogus RRIP replacement policy");
+  }
+
+  /* BRRIP inserts at a distant RRPV with a rare long RRPV, SRRIP always
+     inserts with a long RRPV */
+  if (brrip && (myrand() % CACHE_BRRIP_EPSILON) != 0)
+    blk->rrpv = CACHE_RRPV_MAX;
+  else
+    blk->rrpv = CACHE_RRPV_MAX - 1;
+}
+
+/* update NRU/RRIP state for a hit to block BLK */
+static void
+rrip_hit(struct cache_t *cp,			/* cache instance */
+	 struct cache_blk_t *blk)		/* block that hit */
+{
+  blk->rrpv = 0;
+  if (cp->policy == SHiP)
+    {
+      blk->reref = TRUE;
+      if (cp->shct[blk->sig] < CACHE_SHCT_CTR_MAX)
+	cp->shct[blk->sig]++;
+    }
+}
+
+/* update NRU/RRIP state for a demand miss in SET that evicts block REPL */
+static void
+rrip_miss(struct cache_t *cp,			/* cache instance */
+	  md_addr_t set,			/* set index of the miss */
+	  struct cache_blk_t *repl)		/* block to be replaced */
+{
+  /* SHiP: train down signatures whose blocks die without a re-reference */
+  if (cp->policy == SHiP
+      && (repl->status & CACHE_BLK_VALID) && !repl->reref
+      && cp->shct[repl->sig] > 0)
+    cp->shct[repl->sig]--;
+
+  /* DRRIP: leader sets vote against the policy that missed */
+  if (cp->policy == DRRIP)
+    {
+      enum duel_role_t role = duel_role(cp, set);
+
+      if (role == SRRIPLeader && cp->psel < CACHE_PSEL_MAX)
+	cp->psel++;
+      else if (role == BRRIPLeader && cp->psel > 0)
+	cp->psel--;
+    }
+}
+
+/* storage of the prefetcher of cache CP as built, in bits, for comparing
+   prefetchers at equal budgets; every prefetcher is counted at the widths
+   its tables are declared with, not at minimal hardware widths */
+static int
+prefetch_bits(struct cache_t *cp)	/* cache instance */
+{
+  if (cp->prefetch_type == 0 || cp->prefetch_type == 1)
+    {
+      /* no prefetcher, or a stateless next line prefetcher */
+      return 0;
+    }
+  else if (cp->prefetch_type == 2)
+    {
+      /* DCPT: the delta table */
+      return TABLE_SIZE * sizeof(struct dcpt_entry) * 8;
+    }
+  else if (cp->prefetch_type > 2)
     {
-      /* link to the tail of the way list */
-      blk->way_prev = set->way_tail;
-      blk->way_next = NULL;
-      set->way_tail->way_next = blk;
-      set->way_tail = blk;
+      /* stride: the reference prediction table */
+      return cp->prefetch_type * sizeof(struct rpt) * 8;
     }
   else
-    panic("bogus WHERE designator");
+    {
+      /* GHB: the history buffer, the index table and the sequence number
+	 of the next entry */
+      return cp->ghb_size * (sizeof(struct cache_ghb_entry_t)
+			     + sizeof(struct cache_ghb_index_t)) * 8
+	+ sizeof(cp->ghb_seq) * 8;
+    }
+}
+
+/* allocate and invalidate the blocks, tags and ages of the NSETS sets of
+   ASSOC ways of cache CP */
+static void
+alloc_blks(struct cache_t *cp)		/* cache instance */
+{
+  struct cache_blk_t *blk;
+  int i, j, bindex;
+
+  cp->data = (byte_t *)calloc(cp->nsets * cp->assoc,
+			      sizeof(struct cache_blk_t) +
+			      (cp->balloc ? (cp->bsize*sizeof(byte_t)) : 0));
+  if (!cp->data)
+    fatal("out of virtual memory");
+
+  /* allocate the flat tag and age arrays, ASSOC entries per set */
+  cp->tags = (md_addr_t *)calloc(cp->nsets * cp->assoc, sizeof(md_addr_t));
+  cp->ages = (unsigned short *)
+    calloc(cp->nsets * cp->assoc, sizeof(unsigned short));
+  if (!cp->tags || !cp->ages)
+    fatal("out of virtual memory");
+
+  /* slice up the data blocks */
+  for (bindex=0,i=0; i<cp->nsets; i++)
+    {
+      /* NOTE: all the blocks in a set *must* be allocated contiguously,
+	 otherwise, block accesses through SET->BLKS will fail (used
+	 during lookup and replacement selection) */
+      cp->sets[i].blks = CACHE_BINDEX(cp, cp->data, bindex);
+      cp->sets[i].tags = &cp->tags[bindex];
+      cp->sets[i].ages = &cp->ages[bindex];
+
+      for (j=0; j<cp->assoc; j++)
+	{
+	  /* locate next cache block */
+	  blk = CACHE_BINDEX(cp, cp->data, bindex);
+	  bindex++;
+
+	  /* invalidate new cache block */
+	  blk->status = 0;		
+	  blk->tag = 0;
+	  blk->ready = 0;
+	  blk->rrpv = RRPV_DISTANT(cp);
+	  blk->reref = FALSE;
+	  blk->sig = 0;
+	  blk->user_data = (cp->usize != 0
+			    ? (byte_t *)calloc(cp->usize, sizeof(byte_t))
+			    : NULL);
+	  cp->sets[i].tags[j] = CACHE_TAG_INVALID;
+
+	  /* initial recency order is arbitrary, the last way is youngest */
+	  cp->sets[i].ages[j] = cp->assoc - 1 - j;
+	}
+    }
 }
 
 /* create and initialize a general cache structure */
@@ -269,13 +781,12 @@ cache_create(char *name,		/* name of the cache */
 	     unsigned int (*blk_access_fn)(enum mem_cmd cmd,
 					   md_addr_t baddr, int bsize,
 					   struct cache_blk_t *blk,
-					   tick_t now, int prefetch),
+					   tick_t now, md_addr_t pc,
+					   int prefetch),
 	     unsigned int hit_latency,	/* latency in cycles for a hit */
 	     int prefetch_type)		/* prefetcher type */
 {
   struct cache_t *cp;
-  struct cache_blk_t *blk;
-  int i, j, bindex;
 
   /* check all cache parameters */
   if (nsets <= 0)
@@ -295,8 +806,8 @@ cache_create(char *name,		/* name of the cache */
     fatal("cache associativity `%d' must be a power of two", assoc);
   if (!blk_access_fn)
     fatal("must specify miss/replacement functions");
-  if (prefetch_type < 0)
-    fatal("prefetcher type `%d'must be a positive number", prefetch_type);
+  if (prefetch_type < 0 && ((-prefetch_type) & (-prefetch_type - 1)) != 0)
+    fatal("GHB prefetcher size `%d' must be a power of two", -prefetch_type);
 
   /* allocate the cache structure */
   cp = (struct cache_t *)
@@ -319,7 +830,6 @@ cache_create(char *name,		/* name of the cache */
   cp->blk_access_fn = blk_access_fn;
 
   /* compute derived parameters */
-  cp->hsize = CACHE_HIGHLY_ASSOC(cp) ? (assoc >> 2) : 0;
   cp->blk_mask = bsize-1;
   cp->set_shift = log_base2(bsize);
   cp->set_mask = nsets-1;
@@ -328,8 +838,80 @@ cache_create(char *name,		/* name of the cache */
   cp->tagset_mask = ~cp->blk_mask;
   cp->bus_free = 0;
 
+  /* sets are a bit slice of the address until cache_set_index() says
+     otherwise */
+  cp->index = BitSelect;
+  cp->index_bits = log_base2(nsets);
+  cp->index_prime = nsets;
+  cp->stamps = NULL;
+  cp->stamp_clock = 0;
+
+  /* whole, uncompressed blocks until cache_set_sectors() and
+     cache_set_compress() say otherwise */
+  cp->sect_size = 0;
+  cp->sect_shift = 0;
+  cp->sect_all = 0;
+  cp->bdi = FALSE;
+  cp->data_ways = assoc;
+  cp->data_fn = NULL;
+  cp->bdi_buf = NULL;
+  cp->cap_clock = 0;
+
+  /* unlimited outstanding misses until cache_set_mshr() says otherwise */
+  cp->mshr_nentries = 0;
+  cp->mshr_ntargets = 0;
+  cp->mshrs = NULL;
+
+  /* no write buffer until cache_set_wbuf() says otherwise */
+  cp->wbuf_nentries = 0;
+  cp->wbuf = NULL;
+  cp->wbuf_drain = 0;
+
+  /* no victim cache and no other levels until cache_set_victim() and
+     cache_set_lower() say otherwise */
+  cp->vc_nentries = 0;
+  cp->vc = NULL;
+  cp->vc_stamp = 0;
+  cp->lower = NULL;
+  cp->incl = NINE;
+  cp->nuppers = 0;
+  cp->excl_dirty = FALSE;
+  cp->timed = FALSE;
+
+  /* prefetches are issued as soon as they are generated, at a fixed
+     aggressiveness, until cache_set_prefetch() says otherwise */
+  cp->pf_qsize = 0;
+  cp->pf_bandwidth = 0;
+  cp->pf_queue = NULL;
+  cp->pf_head = 0;
+  cp->pf_num = 0;
+  cp->pf_tick = 0;
+  cp->pf_degree = (prefetch_type == 2 ? MAX_PREFETCH
+		   : prefetch_type < 0 ? CACHE_GHB_DEGREE : 1);
+  cp->pf_distance = 1;
+  cp->pf_throttle = FALSE;
+  cp->pf_level = 0;
+  cp->pf_filter = NULL;
+  if (prefetch_type != 0)
+    {
+      cp->pf_filter = (unsigned char *)calloc(CACHE_PF_FILTER_BITS/8, 1);
+      if (!cp->pf_filter)
+	fatal("out of virtual memory");
+    }
+
+  /* replacement policy state */
+  cp->psel = CACHE_PSEL_MAX/2;
+  cp->shct = NULL;
+  if (policy == SHiP)
+    {
+      /* start every signature weakly re-referenced, i.e., as SRRIP */
+      cp->shct = (unsigned char *)malloc(CACHE_SHCT_SIZE);
+      if (!cp->shct)
+	fatal("out of virtual memory");
+      memset(cp->shct, 1, CACHE_SHCT_SIZE);
+    }
+
   /* print derived parameters during debug */
-  debug("%s: cp->hsize     = %d", cp->name, cp->hsize);
   debug("%s: cp->blk_mask  = 0x%08x", cp->name, cp->blk_mask);
   debug("%s: cp->set_shift = %d", cp->name, cp->set_shift);
   debug("%s: cp->set_mask  = 0x%08x", cp->name, cp->set_mask);
@@ -347,67 +929,48 @@ cache_create(char *name,		/* name of the cache */
   cp->read_misses = 0;
   cp->prefetch_hits = 0;
   cp->prefetch_misses = 0;
+  cp->prefetch_useful = 0;
+  cp->prefetch_unused = 0;
+  cp->prefetch_late = 0;
+  cp->prefetch_squashed = 0;
+  cp->prefetch_dropped = 0;
+  cp->prefetch_pollution = 0;
+
+  cp->fdp_evictions = 0;
+  cp->fdp_issued = 0;
+  cp->fdp_useful = 0;
+  cp->fdp_late = 0;
+  cp->fdp_pollution = 0;
+  cp->fdp_misses = 0;
+
+  cp->mshr_allocs = 0;
+  cp->mshr_merges = 0;
+  cp->mshr_full = 0;
+  cp->mshr_target_full = 0;
+  cp->mshr_stall_cycles = 0;
+
+  cp->wbuf_writes = 0;
+  cp->wbuf_coalesced = 0;
+  cp->wbuf_forwards = 0;
+  cp->wbuf_full = 0;
+  cp->wbuf_stall_cycles = 0;
+
+  cp->victim_hits = 0;
+
+  cp->fill_bytes = 0;
+  cp->wb_bytes = 0;
+  cp->sector_misses = 0;
+  cp->cap_samples = 0;
+  cp->cap_bytes = 0;
+  cp->cap_stored = 0;
 
   /* blow away the last block accessed */
   cp->last_tagset = 0;
   cp->last_blk = NULL;
 
   /* allocate data blocks */
-  cp->data = (byte_t *)calloc(nsets * assoc,
-			      sizeof(struct cache_blk_t) +
-			      (cp->balloc ? (bsize*sizeof(byte_t)) : 0));
-  if (!cp->data)
-    fatal("out of virtual memory");
-
-  /* slice up the data blocks */
-  for (bindex=0,i=0; i<nsets; i++)
-    {
-
-      cp->sets[i].way_head = NULL;
-      cp->sets[i].way_tail = NULL;
-      /* get a hash table, if needed */
-      if (cp->hsize)
-	{
-	  cp->sets[i].hash =
-	    (struct cache_blk_t **)calloc(cp->hsize,
-					  sizeof(struct cache_blk_t *));
-	  if (!cp->sets[i].hash)
-	    fatal("out of virtual memory");
-	}
-      /* NOTE: all the blocks in a set *must* be allocated contiguously,
-	 otherwise, block accesses through SET->BLKS will fail (used
-	 during random replacement selection) */
-      cp->sets[i].blks = CACHE_BINDEX(cp, cp->data, bindex);
-      
-      /* link the data blocks into ordered way chain and hash table bucket
-         chains, if hash table exists */
-      for (j=0; j<assoc; j++)
-	{
-	  /* locate next cache block */
-	  blk = CACHE_BINDEX(cp, cp->data, bindex);
-	  bindex++;
+  alloc_blks(cp);
 
-	  /* invalidate new cache block */
-	  blk->status = 0;		
-	  blk->tag = 0;
-	  blk->ready = 0;
-	  blk->user_data = (usize != 0
-			    ? (byte_t *)calloc(usize, sizeof(byte_t)) : NULL);
-
-	  /* insert cache block into set hash table */
-	  if (cp->hsize)
-	    link_htab_ent(cp, &cp->sets[i], blk);
-
-	  /* insert into head of way list, order is arbitrary at this point */
-	  blk->way_next = cp->sets[i].way_head;
-	  blk->way_prev = NULL;
-	  if (cp->sets[i].way_head)
-	    cp->sets[i].way_head->way_prev = blk;
-	  cp->sets[i].way_head = blk;
-	  if (!cp->sets[i].way_tail)
-	    cp->sets[i].way_tail = blk;
-	}
-    }
   /* ECE552 Assignment 4 - BEGIN CODE*/
   if (prefetch_type == 2) {
     // dcpt_entry = pc (4B) + last_addr (4B) + last_prefetch (4B) + delta (4B * 16 entries) + delta_ptr (4B) = 80 bytes
@@ -416,38 +979,697 @@ cache_create(char *name,		/* name of the cache */
     cp->dcpt = (struct dcpt_entry*)calloc(TABLE_SIZE, sizeof(struct dcpt_entry));
   }
   /* ECE552 Assignment 4 - END CODE */
+
+  /* the stride prefetcher's RPT has prefetch_type entries, one per cache */
+  cp->rpt_size = 0;
+  cp->rpt = NULL;
+  if (prefetch_type > 2)
+    {
+      cp->rpt_size = prefetch_type;
+      cp->rpt = rpt_create(prefetch_type);
+    }
+
+  /* the GHB prefetcher has a GHB and index table of -prefetch_type
+     entries, one per cache */
+  cp->ghb_size = 0;
+  cp->ghb = NULL;
+  cp->ghb_index = NULL;
+  cp->ghb_seq = 0;
+  if (prefetch_type < 0)
+    {
+      cp->ghb_size = -prefetch_type;
+      cp->ghb = (struct cache_ghb_entry_t *)
+	calloc(cp->ghb_size, sizeof(struct cache_ghb_entry_t));
+      cp->ghb_index = (struct cache_ghb_index_t *)
+	calloc(cp->ghb_size, sizeof(struct cache_ghb_index_t));
+      if (!cp->ghb || !cp->ghb_index)
+	fatal("out of virtual memory");
+    }
+
+  cp->pf_storage_bits = prefetch_bits(cp);
   return cp;
 }
 
-/* parse policy */
-enum cache_policy			/* replacement policy enum */
-cache_char2policy(char c)		/* replacement policy as a char */
+/* give cache CP NENTRIES miss status holding registers, each of which may
+   hold NTARGETS accesses, zero NENTRIES leaves the cache with unlimited
+   outstanding misses */
+void
+cache_set_mshr(struct cache_t *cp,	/* cache instance */
+	       int nentries,		/* number of MSHRs, 0 for unlimited */
+	       int ntargets)		/* targets per MSHR */
 {
-  switch (c) {
-  case 'l': return LRU;
-  case 'r': return Random;
-  case 'f': return FIFO;
-  default: fatal("bogus replacement policy, `%c'", c);
-  }
+  if (nentries < 0)
+    fatal("number of MSHRs `%d' must be zero or positive", nentries);
+  if (nentries > 0 && ntargets < 1)
+    fatal("MSHR targets `%d' must be one or more", ntargets);
+
+  if (cp->mshrs)
+    free(cp->mshrs);
+  cp->mshrs = NULL;
+  cp->mshr_nentries = nentries;
+  cp->mshr_ntargets = ntargets;
+  if (nentries)
+    {
+      cp->mshrs = (struct cache_mshr_t *)
+	calloc(nentries, sizeof(struct cache_mshr_t));
+      if (!cp->mshrs)
+	fatal("out of virtual memory");
+    }
 }
 
-/* print cache configuration */
+/* give cache CP a write buffer of NENTRIES writebacks, zero NENTRIES
+   writes blocks back to the next level as they are replaced */
 void
-cache_config(struct cache_t *cp,	/* cache instance */
-	     FILE *stream)		/* output stream */
+cache_set_wbuf(struct cache_t *cp,	/* cache instance */
+	       int nentries)		/* write buffer entries, 0 for none */
 {
-  fprintf(stream,
-	  "cache: %s: %d sets, %d byte blocks, %d bytes user data/block\n",
-	  cp->name, cp->nsets, cp->bsize, cp->usize);
-  fprintf(stream,
-	  "cache: %s: %d-way, `%s' replacement policy, write-back, %d prefetcher type\n",
-	  cp->name, cp->assoc,
-	  cp->policy == LRU ? "LRU"
-	  : cp->policy == Random ? "Random"
-	  : cp->policy == FIFO ? "FIFO"
-	  : (abort(), ""),
-	  cp->prefetch_type);
-}
+  if (nentries < 0)
+    fatal("write buffer entries `%d' must be zero or positive", nentries);
+
+  if (cp->wbuf)
+    free(cp->wbuf);
+  cp->wbuf = NULL;
+  cp->wbuf_nentries = nentries;
+  cp->wbuf_drain = 0;
+  if (nentries)
+    {
+      cp->wbuf = (struct cache_wbuf_t *)
+	calloc(nentries, sizeof(struct cache_wbuf_t));
+      if (!cp->wbuf)
+	fatal("out of virtual memory");
+    }
+}
+
+/* give cache CP a fully associative victim cache of NENTRIES blocks, zero
+   NENTRIES evicts replaced blocks at once */
+void
+cache_set_victim(struct cache_t *cp,	/* cache instance */
+		 int nentries)		/* victim cache entries, 0 for none */
+{
+  if (nentries < 0)
+    fatal("victim cache entries `%d' must be zero or positive", nentries);
+  if (nentries && (cp->balloc || cp->usize))
+    fatal("cache `%s' keeps block data, it cannot have a victim cache",
+	  cp->name);
+  if (nentries && cp->sect_size)
+    fatal("sectored cache `%s' cannot have a victim cache", cp->name);
+
+  if (cp->vc)
+    free(cp->vc);
+  cp->vc = NULL;
+  cp->vc_nentries = nentries;
+  cp->vc_stamp = 0;
+  if (nentries)
+    {
+      cp->vc = (struct cache_victim_t *)
+	calloc(nentries, sizeof(struct cache_victim_t));
+      if (!cp->vc)
+	fatal("out of virtual memory");
+    }
+}
+
+/* index the sets of cache CP with INDEX, before its first access */
+void
+cache_set_index(struct cache_t *cp,	/* cache instance */
+		enum cache_index index)	/* set index function */
+{
+  int p, d;
+
+  if (index == Skewed && cp->assoc > CACHE_MAX_SKEW_WAYS)
+    fatal("skewed cache `%s' may have at most %d ways",
+	  cp->name, CACHE_MAX_SKEW_WAYS);
+  if (index == Skewed && cp->bdi)
+    fatal("compressed cache `%s' cannot be skewed-associative", cp->name);
+
+  cp->index = index;
+
+  /* hashed caches keep the whole block number as the tag */
+  cp->tag_shift = (index == BitSelect
+		   ? cp->set_shift + cp->index_bits : cp->set_shift);
+  cp->tag_mask = (1 << (32 - cp->tag_shift))-1;
+
+  /* the largest prime number of sets, all of them if the cache has fewer
+     than three sets */
+  cp->index_prime = cp->nsets;
+  if (index == PrimeMod)
+    {
+      for (p = cp->nsets; p > 2; p--)
+	{
+	  for (d = 2; d * d <= p && p % d != 0; d++)
+	    /* nada */;
+	  if (d * d > p)
+	    break;
+	}
+      cp->index_prime = p;
+    }
+
+  /* skewed caches order LRU and FIFO blocks by time stamps */
+  if (cp->stamps)
+    free(cp->stamps);
+  cp->stamps = NULL;
+  cp->stamp_clock = 0;
+  if (index == Skewed)
+    {
+      cp->stamps = (counter_t *)calloc(cp->nsets * cp->assoc,
+				       sizeof(counter_t));
+      if (!cp->stamps)
+	fatal("out of virtual memory");
+    }
+}
+
+/* parse set index function, i.e., {bits|xor|prime|skew} */
+enum cache_index			/* set index function */
+cache_str2index(char *s)		/* set index function as a string */
+{
+  if (!mystricmp(s, "bits"))
+    return BitSelect;
+  else if (!mystricmp(s, "xor"))
+    return XORIndex;
+  else if (!mystricmp(s, "prime"))
+    return PrimeMod;
+  else if (!mystricmp(s, "skew"))
+    return Skewed;
+  fatal("bad set index function `%s', i.e., {bits|xor|prime|skew}", s);
+  return BitSelect;
+}
+
+/* split the blocks of cache CP into sectors of SECT_SIZE bytes, before its
+   first access, zero SECT_SIZE leaves whole blocks; a sector size equal to
+   the block size keeps whole blocks but counts the bytes transferred and
+   the effective capacity */
+void
+cache_set_sectors(struct cache_t *cp,	/* cache instance */
+		  int sect_size)	/* sector size in bytes, 0 for none */
+{
+  if (sect_size == 0)
+    {
+      cp->sect_size = 0;
+      return;
+    }
+  if (sect_size < 8 || (sect_size & (sect_size-1)) != 0)
+    fatal("sector size `%d' must be a power of two, 8 or greater",
+	  sect_size);
+  if (sect_size > cp->bsize || cp->bsize / sect_size > CACHE_MAX_SECTORS)
+    fatal("cache `%s' must have 1 to %d sectors per block",
+	  cp->name, CACHE_MAX_SECTORS);
+  if (cp->vc_nentries)
+    fatal("sectored cache `%s' cannot have a victim cache", cp->name);
+  if (cp->bdi)
+    fatal("compressed cache `%s' cannot be sectored", cp->name);
+
+  cp->sect_size = sect_size;
+  cp->sect_shift = log_base2(sect_size);
+  cp->sect_all = CACHE_SECT_MASK(cp, 0, cp->bsize);
+}
+
+/* compress the blocks of cache CP with BDI, before its first access, giving
+   it CACHE_BDI_TAGS times its ways of tags, blocks are read with DATA_FN
+   unless the cache allocates block data */
+void
+cache_set_compress(struct cache_t *cp,	/* cache instance */
+		   void (*data_fn)(md_addr_t baddr,
+				   byte_t *buf, int bsize))
+{
+  if (cp->bdi)
+    return;
+  if (!cp->balloc && !data_fn)
+    fatal("compressed cache `%s' needs the contents of its blocks",
+	  cp->name);
+  if (cp->usize)
+    fatal("cache `%s' keeps user data, it cannot be compressed", cp->name);
+  if (cp->index == Skewed)
+    fatal("compressed cache `%s' cannot be skewed-associative", cp->name);
+  if (cp->sect_size)
+    fatal("sectored cache `%s' cannot be compressed", cp->name);
+
+  /* the data array keeps its size, the tags grow */
+  free(cp->data);
+  free(cp->tags);
+  free(cp->ages);
+  cp->data_ways = cp->assoc;
+  cp->assoc *= CACHE_BDI_TAGS;
+  alloc_blks(cp);
+  cp->last_tagset = 0;
+  cp->last_blk = NULL;
+
+  cp->bdi = TRUE;
+  cp->data_fn = data_fn;
+  cp->bdi_buf = (byte_t *)malloc(cp->bsize);
+  if (!cp->bdi_buf)
+    fatal("out of virtual memory");
+}
+
+/* make cache LOWER the next level below cache UPPER, holding the blocks of
+   its upper levels as POLICY says, the block access function of UPPER must
+   access LOWER */
+void
+cache_set_lower(struct cache_t *upper,	/* upper level cache */
+		struct cache_t *lower,	/* next level cache */
+		enum cache_incl policy)	/* inclusion policy of LOWER */
+{
+  int i;
+
+  if (upper == lower)
+    fatal("cache `%s' cannot be its own next level", upper->name);
+  if (upper->lower && upper->lower != lower)
+    fatal("cache `%s' already has a next level", upper->name);
+  if (lower->nuppers && lower->incl != policy)
+    fatal("cache `%s' is given conflicting inclusion policies", lower->name);
+  if (policy == Exclusive && (lower->sect_size || lower->bdi))
+    fatal("sectored or compressed cache `%s' cannot be exclusive",
+	  lower->name);
+  if (policy == Exclusive && upper->sect_size)
+    fatal("sectored cache `%s' cannot have an exclusive next level",
+	  upper->name);
+  if (policy == Exclusive && upper->bsize != lower->bsize)
+    fatal("exclusive cache `%s' needs the block size of cache `%s'",
+	  lower->name, upper->name);
+
+  upper->lower = lower;
+  lower->incl = policy;
+  for (i=0; i<lower->nuppers; i++)
+    {
+      if (lower->uppers[i] == upper)
+	return;
+    }
+  if (lower->nuppers == CACHE_MAX_UPPERS)
+    fatal("cache `%s' has too many upper levels", lower->name);
+  lower->uppers[lower->nuppers++] = upper;
+}
+
+/* parse inclusion policy, i.e., {nine|incl|excl} */
+enum cache_incl				/* inclusion policy */
+cache_str2incl(char *s)			/* inclusion policy as a string */
+{
+  if (!mystricmp(s, "nine"))
+    return NINE;
+  else if (!mystricmp(s, "incl"))
+    return Inclusive;
+  else if (!mystricmp(s, "excl"))
+    return Exclusive;
+  fatal("bad inclusion policy `%s', i.e., {nine|incl|excl}", s);
+  return NINE;
+}
+
+/* FDP aggressiveness levels, from the least to the most aggressive */
+static const struct {
+  int distance;			/* predictions to look ahead */
+  int degree;			/* requests per prefetch trigger */
+} fdp_levels[CACHE_FDP_LEVELS] = {
+  { 1, 1 }, { 1, 2 }, { 2, 4 }, { 4, 4 }, { 8, 8 }
+};
+
+/* give cache CP a prefetch request queue of QSIZE entries, of which
+   BANDWIDTH are issued on each demand access, zero QSIZE issues prefetches
+   as soon as they are generated; a non-zero THROTTLE adjusts the prefetch
+   degree and distance with feedback-directed prefetching */
+void
+cache_set_prefetch(struct cache_t *cp,	/* cache instance */
+		   int qsize,		/* prefetch queue entries, 0 for none */
+		   int bandwidth,	/* requests issued per access or cycle */
+		   int degree,		/* requests per trigger, 0 for default */
+		   int throttle)	/* enable FDP throttling? */
+{
+  if (qsize < 0)
+    fatal("prefetch queue size `%d' must be zero or positive", qsize);
+  if (qsize > 0 && bandwidth < 1)
+    fatal("prefetch bandwidth `%d' must be one or more", bandwidth);
+  if (degree < 0)
+    fatal("prefetch degree `%d' must be zero or positive", degree);
+
+  if (degree)
+    cp->pf_degree = degree;
+
+  if (cp->pf_queue)
+    free(cp->pf_queue);
+  cp->pf_queue = NULL;
+  cp->pf_qsize = qsize;
+  cp->pf_bandwidth = bandwidth;
+  cp->pf_head = 0;
+  cp->pf_num = 0;
+  if (qsize)
+    {
+      cp->pf_queue = (struct cache_pf_req_t *)
+	calloc(qsize, sizeof(struct cache_pf_req_t));
+      if (!cp->pf_queue)
+	fatal("out of virtual memory");
+    }
+
+  /* FDP starts out moderately aggressive */
+  cp->pf_throttle = throttle;
+  if (throttle)
+    {
+      cp->pf_level = CACHE_FDP_START_LEVEL;
+      cp->pf_distance = fdp_levels[cp->pf_level - 1].distance;
+      cp->pf_degree = fdp_levels[cp->pf_level - 1].degree;
+    }
+}
+
+/* mark cache CP as accessed by a timing simulator */
+void
+cache_set_timed(struct cache_t *cp)	/* cache instance */
+{
+  cp->timed = TRUE;
+}
+
+/* create an empty cache of the same organization, policies, MSHRs, write
+   buffer and prefetch settings as CP, sharing its block access function */
+struct cache_t *			/* pointer to cache created */
+cache_clone(struct cache_t *cp)		/* cache instance to copy */
+{
+  struct cache_t *ncp;
+
+  ncp = cache_create(cp->name, cp->nsets, cp->bsize, cp->balloc, cp->usize,
+		     cp->data_ways, cp->policy, cp->blk_access_fn,
+		     cp->hit_latency, cp->prefetch_type);
+  if (cp->bdi)
+    cache_set_compress(ncp, cp->data_fn);
+  if (cp->sect_size)
+    cache_set_sectors(ncp, cp->sect_size);
+  if (cp->mshr_nentries)
+    cache_set_mshr(ncp, cp->mshr_nentries, cp->mshr_ntargets);
+  if (cp->wbuf_nentries)
+    cache_set_wbuf(ncp, cp->wbuf_nentries);
+  if (cp->vc_nentries)
+    cache_set_victim(ncp, cp->vc_nentries);
+  if (cp->index != BitSelect)
+    cache_set_index(ncp, cp->index);
+  cache_set_prefetch(ncp, cp->pf_qsize, cp->pf_bandwidth, cp->pf_degree,
+		     cp->pf_throttle);
+  if (cp->timed)
+    cache_set_timed(ncp);
+  return ncp;
+}
+
+/* add the stats of cache SRC into those of cache CP */
+void
+cache_merge_stats(struct cache_t *cp,	/* cache instance */
+		  struct cache_t *src)	/* cache whose stats are added */
+{
+  cp->hits += src->hits;
+  cp->misses += src->misses;
+  cp->replacements += src->replacements;
+  cp->writebacks += src->writebacks;
+  cp->invalidations += src->invalidations;
+  cp->read_hits += src->read_hits;
+  cp->read_misses += src->read_misses;
+  cp->prefetch_hits += src->prefetch_hits;
+  cp->prefetch_misses += src->prefetch_misses;
+  cp->prefetch_useful += src->prefetch_useful;
+  cp->prefetch_unused += src->prefetch_unused;
+  cp->prefetch_late += src->prefetch_late;
+  cp->prefetch_squashed += src->prefetch_squashed;
+  cp->prefetch_dropped += src->prefetch_dropped;
+  cp->prefetch_pollution += src->prefetch_pollution;
+  cp->mshr_allocs += src->mshr_allocs;
+  cp->mshr_merges += src->mshr_merges;
+  cp->mshr_full += src->mshr_full;
+  cp->mshr_target_full += src->mshr_target_full;
+  cp->mshr_stall_cycles += src->mshr_stall_cycles;
+  cp->wbuf_writes += src->wbuf_writes;
+  cp->wbuf_coalesced += src->wbuf_coalesced;
+  cp->wbuf_forwards += src->wbuf_forwards;
+  cp->wbuf_full += src->wbuf_full;
+  cp->wbuf_stall_cycles += src->wbuf_stall_cycles;
+  cp->victim_hits += src->victim_hits;
+  cp->fill_bytes += src->fill_bytes;
+  cp->wb_bytes += src->wb_bytes;
+  cp->sector_misses += src->sector_misses;
+  cp->cap_samples += src->cap_samples;
+  cp->cap_bytes += src->cap_bytes;
+  cp->cap_stored += src->cap_stored;
+}
+
+/* state of one cache block in a checkpoint, blocks are restored as not
+   busy and without block or user data */
+struct cache_chkpt_blk_t
+{
+  md_addr_t tag;		/* data block tag value */
+  unsigned int status;		/* block status */
+  unsigned int sect_valid;	/* sectored: valid sectors */
+  unsigned int sect_dirty;	/* sectored: dirty sectors */
+  unsigned short sig;		/* SHiP: signature of the filling PC */
+  unsigned short csize;		/* BDI: compressed size in bytes */
+  unsigned char rrpv;		/* re-reference prediction value */
+  unsigned char reref;		/* SHiP: re-referenced since fill? */
+};
+
+/* write the contents of cache CP to checkpoint stream FD: the tags, status
+   and replacement state of its blocks, its victim cache, and the tables of
+   its replacement policy and prefetcher */
+void
+cache_write_chkpt(struct cache_t *cp,	/* cache instance */
+		  FILE *fd)		/* stream to write to */
+{
+  int i, n = cp->nsets * cp->assoc;
+  struct cache_blk_t *blk;
+  struct cache_chkpt_blk_t *cblks;
+  struct exo_term_t *exo;
+
+  if (cp->balloc)
+    fatal("cannot checkpoint cache `%s', block data is not saved", cp->name);
+
+  if (!(cblks = calloc(n, sizeof(struct cache_chkpt_blk_t))))
+    fatal("out of virtual memory");
+  for (i=0; i<n; i++)
+    {
+      blk = CACHE_BINDEX(cp, cp->data, i);
+      cblks[i].tag = blk->tag;
+      cblks[i].status = blk->status;
+      cblks[i].sect_valid = blk->sect_valid;
+      cblks[i].sect_dirty = blk->sect_dirty;
+      cblks[i].sig = blk->sig;
+      cblks[i].csize = blk->csize;
+      cblks[i].rrpv = blk->rrpv;
+      cblks[i].reref = blk->reref;
+    }
+
+  /* organization, replacement and prefetcher state, then the tables */
+  exo = exo_new(ec_list,
+		 exo_new(ec_integer, (exo_integer_t)cp->nsets),
+		 exo_new(ec_integer, (exo_integer_t)cp->bsize),
+		 exo_new(ec_integer, (exo_integer_t)cp->assoc),
+		 exo_new(ec_integer, (exo_integer_t)cp->policy),
+		 exo_new(ec_integer, (exo_integer_t)cp->index),
+		 exo_new(ec_integer, (exo_integer_t)cp->sect_size),
+		 exo_new(ec_integer, (exo_integer_t)cp->bdi),
+		 exo_new(ec_integer, (exo_integer_t)cp->vc_nentries),
+		 exo_new(ec_integer, (exo_integer_t)cp->prefetch_type),
+		 exo_new(ec_integer, (exo_integer_t)cp->psel),
+		 exo_new(ec_integer, (exo_integer_t)cp->stamp_clock),
+		 exo_new(ec_integer, (exo_integer_t)cp->vc_stamp),
+		 exo_new(ec_integer, (exo_integer_t)cp->ghb_seq),
+		 exo_new(ec_blob, n * sizeof(md_addr_t), cp->tags),
+		 exo_new(ec_blob, n * sizeof(unsigned short), cp->ages),
+		 exo_new(ec_blob, n * sizeof(struct cache_chkpt_blk_t), cblks),
+		 NULL);
+  if (cp->stamps)
+    eio_chkpt_add_blob(exo, n * sizeof(counter_t), cp->stamps);
+  if (cp->shct)
+    eio_chkpt_add_blob(exo, CACHE_SHCT_SIZE, cp->shct);
+  if (cp->vc)
+    eio_chkpt_add_blob(exo, cp->vc_nentries * sizeof(struct cache_victim_t),
+		       cp->vc);
+  if (cp->rpt)
+    eio_chkpt_add_blob(exo, cp->rpt_size * sizeof(struct rpt), cp->rpt);
+  if (cp->dcpt)
+    eio_chkpt_add_blob(exo, cp->dcpt_size * sizeof(struct dcpt_entry),
+		       cp->dcpt);
+  if (cp->ghb)
+    {
+      eio_chkpt_add_blob(exo, cp->ghb_size * sizeof(struct cache_ghb_entry_t),
+			 cp->ghb);
+      eio_chkpt_add_blob(exo, cp->ghb_size * sizeof(struct cache_ghb_index_t),
+			 cp->ghb_index);
+    }
+
+  fprintf(fd, "/* cache `%s' contents */\n", cp->name);
+  exo_print(exo, fd);
+  fprintf(fd, "\n\n");
+  exo_delete(exo);
+  free(cblks);
+}
+
+/* restore the contents of cache CP from checkpoint stream FD, as written by
+   cache_write_chkpt() for a cache of the same organization, returns FALSE
+   if the stream holds no more checkpoint terms */
+int					/* cache contents restored? */
+cache_read_chkpt(struct cache_t *cp,	/* cache instance */
+		 FILE *fd)		/* stream to read */
+{
+  int i, n = cp->nsets * cp->assoc;
+  struct cache_blk_t *blk;
+  struct cache_chkpt_blk_t *cblks;
+  struct exo_term_t *exo, *elt;
+  char what[256];
+
+  sprintf(what, "cache `%.240s'", cp->name);
+  if (!(exo = exo_read(fd)))
+    return FALSE;
+  if (exo->ec != ec_list)
+    fatal("could not read the checkpoint of %s", what);
+  elt = exo->as_list.head;
+
+  if (eio_chkpt_integer(&elt, what) != cp->nsets
+      || eio_chkpt_integer(&elt, what) != cp->bsize
+      || eio_chkpt_integer(&elt, what) != cp->assoc
+      || eio_chkpt_integer(&elt, what) != cp->policy
+      || eio_chkpt_integer(&elt, what) != cp->index
+      || eio_chkpt_integer(&elt, what) != cp->sect_size
+      || eio_chkpt_integer(&elt, what) != cp->bdi
+      || eio_chkpt_integer(&elt, what) != cp->vc_nentries
+      || eio_chkpt_integer(&elt, what) != cp->prefetch_type)
+    fatal("checkpoint of cache `%s' does not match its organization",
+	  cp->name);
+  cp->psel = eio_chkpt_integer(&elt, what);
+  cp->stamp_clock = eio_chkpt_integer(&elt, what);
+  cp->vc_stamp = eio_chkpt_integer(&elt, what);
+  cp->ghb_seq = eio_chkpt_integer(&elt, what);
+
+  eio_chkpt_blob(&elt, cp->tags, n * sizeof(md_addr_t), what);
+  eio_chkpt_blob(&elt, cp->ages, n * sizeof(unsigned short), what);
+  if (!(cblks = calloc(n, sizeof(struct cache_chkpt_blk_t))))
+    fatal("out of virtual memory");
+  eio_chkpt_blob(&elt, cblks, n * sizeof(struct cache_chkpt_blk_t), what);
+  for (i=0; i<n; i++)
+    {
+      blk = CACHE_BINDEX(cp, cp->data, i);
+      blk->tag = cblks[i].tag;
+      blk->status = cblks[i].status;
+      blk->sect_valid = cblks[i].sect_valid;
+      blk->sect_dirty = cblks[i].sect_dirty;
+      blk->sig = cblks[i].sig;
+      blk->csize = cblks[i].csize;
+      blk->rrpv = cblks[i].rrpv;
+      blk->reref = cblks[i].reref;
+      blk->ready = 0;
+    }
+  free(cblks);
+
+  if (cp->stamps)
+    eio_chkpt_blob(&elt, cp->stamps, n * sizeof(counter_t), what);
+  if (cp->shct)
+    eio_chkpt_blob(&elt, cp->shct, CACHE_SHCT_SIZE, what);
+  if (cp->vc)
+    eio_chkpt_blob(&elt, cp->vc, cp->vc_nentries * sizeof(struct cache_victim_t),
+		   what);
+  if (cp->rpt)
+    eio_chkpt_blob(&elt, cp->rpt, cp->rpt_size * sizeof(struct rpt), what);
+  if (cp->dcpt)
+    eio_chkpt_blob(&elt, cp->dcpt, cp->dcpt_size * sizeof(struct dcpt_entry),
+		   what);
+  if (cp->ghb)
+    {
+      eio_chkpt_blob(&elt, cp->ghb,
+		     cp->ghb_size * sizeof(struct cache_ghb_entry_t), what);
+      eio_chkpt_blob(&elt, cp->ghb_index,
+		     cp->ghb_size * sizeof(struct cache_ghb_index_t), what);
+    }
+  if (elt != NULL)
+    fatal("could not read the checkpoint of cache `%s' (too many terms)",
+	  cp->name);
+  exo_delete(exo);
+
+  /* blow away the last block to hit */
+  cp->last_tagset = 0;
+  cp->last_blk = NULL;
+
+  return TRUE;
+}
+
+/* parse policy */
+enum cache_policy			/* replacement policy enum */
+cache_char2policy(char c)		/* replacement policy as a char */
+{
+  switch (c) {
+  case 'l': return LRU;
+  case 'r': return Random;
+  case 'f': return FIFO;
+  case 'n': return NRU;
+  case 's': return SRRIP;
+  case 'd': return DRRIP;
+  case 'h': return SHiP;
+  default: fatal("bogus replacement policy, `%c'", c);
+  }
+}
+
+/* print cache configuration */
+void
+cache_config(struct cache_t *cp,	/* cache instance */
+	     FILE *stream)		/* output stream */
+{
+  fprintf(stream,
+	  "cache: %s: %d sets, %d byte blocks, %d bytes user data/block\n",
+	  cp->name, cp->nsets, cp->bsize, cp->usize);
+  fprintf(stream,
+	  "cache: %s: %d-way, `%s' replacement policy, write-back, %d prefetcher type\n",
+	  cp->name, cp->assoc,
+	  cp->policy == LRU ? "LRU"
+	  : cp->policy == Random ? "Random"
+	  : cp->policy == FIFO ? "FIFO"
+	  : cp->policy == NRU ? "NRU"
+	  : cp->policy == SRRIP ? "SRRIP"
+	  : cp->policy == DRRIP ? "DRRIP"
+	  : cp->policy == SHiP ? "SHiP"
+	  : (abort(), ""),
+	  cp->prefetch_type);
+  if (cp->prefetch_type != 0)
+    {
+      if (cp->ghb_size)
+	fprintf(stream,
+		"cache: %s: GHB PC/DC prefetcher, %d GHB and index table "
+		"entries\n", cp->name, cp->ghb_size);
+      fprintf(stream,
+	      "cache: %s: prefetch degree %d, %d bits of prefetcher state\n",
+	      cp->name, cp->pf_degree, cp->pf_storage_bits);
+      if (cp->pf_qsize)
+	fprintf(stream,
+		"cache: %s: %d entry prefetch queue, %d requests per access\n",
+		cp->name, cp->pf_qsize, cp->pf_bandwidth);
+      if (cp->pf_throttle)
+	fprintf(stream,
+		"cache: %s: FDP throttling, start degree %d, distance %d\n",
+		cp->name, cp->pf_degree, cp->pf_distance);
+    }
+  if (cp->mshr_nentries)
+    fprintf(stream,
+	    "cache: %s: %d MSHRs, %d targets per MSHR\n",
+	    cp->name, cp->mshr_nentries, cp->mshr_ntargets);
+  else
+    fprintf(stream,
+	    "cache: %s: unlimited outstanding misses\n", cp->name);
+  if (cp->wbuf_nentries)
+    fprintf(stream,
+	    "cache: %s: %d entry write buffer\n", cp->name, cp->wbuf_nentries);
+  if (cp->vc_nentries)
+    fprintf(stream,
+	    "cache: %s: %d entry victim cache\n", cp->name, cp->vc_nentries);
+  if (cp->index == XORIndex)
+    fprintf(stream, "cache: %s: XOR hashed set index\n", cp->name);
+  else if (cp->index == PrimeMod)
+    fprintf(stream, "cache: %s: prime modulo set index, %d of %d sets used\n",
+	    cp->name, cp->index_prime, cp->nsets);
+  else if (cp->index == Skewed)
+    fprintf(stream, "cache: %s: skewed-associative, XOR hashed per way\n",
+	    cp->name);
+  if (cp->sect_size)
+    fprintf(stream, "cache: %s: %d byte sectors, %d per block\n",
+	    cp->name, cp->sect_size, cp->bsize / cp->sect_size);
+  if (cp->bdi)
+    fprintf(stream, "cache: %s: BDI compressed, %d tags and %d blocks of "
+	    "data per set\n", cp->name, cp->assoc, cp->data_ways);
+  if (cp->nuppers)
+    {
+      int i;
+
+      fprintf(stream, "cache: %s: %s of", cp->name,
+	      cp->incl == Inclusive ? "inclusive"
+	      : cp->incl == Exclusive ? "exclusive" : "non-inclusive");
+      for (i=0; i<cp->nuppers; i++)
+	fprintf(stream, " %s", cp->uppers[i]->name);
+      fprintf(stream, "\n");
+    }
+}
 
 /* register cache stats */
 void
@@ -510,19 +1732,338 @@ cache_reg_stats(struct cache_t *cp,	/* cache instance */
   sprintf(buf, "%s.prefetch_misses", name);
   stat_reg_counter(sdb, buf, "total number of prefetch misses", &cp->prefetch_misses, 0, NULL);
 
+  if (cp->prefetch_type != 0)
+    {
+      sprintf(buf, "%s.prefetch_useful", name);
+      stat_reg_counter(sdb, buf, "prefetched blocks used by a demand access",
+		       &cp->prefetch_useful, 0, NULL);
+      sprintf(buf, "%s.prefetch_unused", name);
+      stat_reg_counter(sdb, buf, "prefetched blocks evicted before any use",
+		       &cp->prefetch_unused, 0, NULL);
+      sprintf(buf, "%s.prefetch_late", name);
+      stat_reg_counter(sdb, buf,
+		       "demand hits on prefetched blocks still in flight",
+		       &cp->prefetch_late, 0, NULL);
+      sprintf(buf, "%s.prefetch_squashed", name);
+      stat_reg_counter(sdb, buf,
+		       "queued prefetches overtaken by a demand miss",
+		       &cp->prefetch_squashed, 0, NULL);
+      sprintf(buf, "%s.prefetch_pollution", name);
+      stat_reg_counter(sdb, buf,
+		       "demand misses to blocks evicted by a prefetch",
+		       &cp->prefetch_pollution, 0, NULL);
+      sprintf(buf, "%s.prefetch_accuracy", name);
+      sprintf(buf1, "%s.prefetch_useful / %s.prefetch_misses", name, name);
+      stat_reg_formula(sdb, buf, "prefetch accuracy (i.e., used/prefetched)",
+		       buf1, NULL);
+      sprintf(buf, "%s.prefetch_coverage", name);
+      sprintf(buf1, "%s.prefetch_useful / (%s.prefetch_useful + %s.misses)",
+	      name, name, name);
+      stat_reg_formula(sdb, buf,
+		       "prefetch coverage (i.e., misses removed/misses)",
+		       buf1, NULL);
+      sprintf(buf, "%s.prefetch_lateness", name);
+      sprintf(buf1, "(%s.prefetch_late + %s.prefetch_squashed)"
+	      " / (%s.prefetch_useful + %s.prefetch_squashed)",
+	      name, name, name, name);
+      stat_reg_formula(sdb, buf,
+		       "fraction of useful prefetches that were late",
+		       buf1, NULL);
+      sprintf(buf, "%s.prefetch_bits", name);
+      stat_reg_int(sdb, buf, "prefetcher storage, in bits",
+		   &cp->pf_storage_bits, cp->pf_storage_bits, NULL);
+      if (cp->pf_qsize)
+	{
+	  sprintf(buf, "%s.prefetch_dropped", name);
+	  stat_reg_counter(sdb, buf, "queued prefetches dropped, queue full",
+			   &cp->prefetch_dropped, 0, NULL);
+	}
+      if (cp->pf_throttle)
+	{
+	  sprintf(buf, "%s.pf_level", name);
+	  stat_reg_int(sdb, buf, "final FDP aggressiveness level",
+		       &cp->pf_level, CACHE_FDP_START_LEVEL, NULL);
+	}
+    }
+
+  if (cp->mshr_nentries)
+    {
+      sprintf(buf, "%s.mshr_allocs", name);
+      stat_reg_counter(sdb, buf, "primary misses allocated an MSHR",
+		       &cp->mshr_allocs, 0, NULL);
+      sprintf(buf, "%s.mshr_merges", name);
+      stat_reg_counter(sdb, buf, "secondary misses merged onto an MSHR",
+		       &cp->mshr_merges, 0, NULL);
+      sprintf(buf, "%s.mshr_full", name);
+      stat_reg_counter(sdb, buf, "primary misses stalled, all MSHRs busy",
+		       &cp->mshr_full, 0, NULL);
+      sprintf(buf, "%s.mshr_target_full", name);
+      stat_reg_counter(sdb, buf,
+		       "secondary misses stalled, all MSHR targets busy",
+		       &cp->mshr_target_full, 0, NULL);
+      sprintf(buf, "%s.mshr_stall_cycles", name);
+      stat_reg_counter(sdb, buf, "cycles lost to MSHR structural stalls",
+		       &cp->mshr_stall_cycles, 0, NULL);
+    }
+
+  if (cp->wbuf_nentries)
+    {
+      sprintf(buf, "%s.wbuf_writes", name);
+      stat_reg_counter(sdb, buf, "writebacks given a write buffer entry",
+		       &cp->wbuf_writes, 0, NULL);
+      sprintf(buf, "%s.wbuf_coalesced", name);
+      stat_reg_counter(sdb, buf,
+		       "writebacks coalesced with a buffered writeback",
+		       &cp->wbuf_coalesced, 0, NULL);
+      sprintf(buf, "%s.wbuf_forwards", name);
+      stat_reg_counter(sdb, buf, "block fills forwarded from the write buffer",
+		       &cp->wbuf_forwards, 0, NULL);
+      sprintf(buf, "%s.wbuf_full", name);
+      stat_reg_counter(sdb, buf, "writebacks stalled, write buffer full",
+		       &cp->wbuf_full, 0, NULL);
+      sprintf(buf, "%s.wbuf_stall_cycles", name);
+      stat_reg_counter(sdb, buf, "cycles lost to a full write buffer",
+		       &cp->wbuf_stall_cycles, 0, NULL);
+    }
+
+  if (cp->vc_nentries)
+    {
+      sprintf(buf, "%s.victim_hits", name);
+      stat_reg_counter(sdb, buf, "misses that hit in the victim cache",
+		       &cp->victim_hits, 0, NULL);
+      sprintf(buf, "%s.victim_hit_rate", name);
+      sprintf(buf1, "%s.victim_hits / %s.misses", name, name);
+      stat_reg_formula(sdb, buf, "victim cache hit rate (i.e., hits/misses)",
+		       buf1, NULL);
+    }
+
+  if (cp->sect_size || cp->bdi)
+    {
+      sprintf(buf, "%s.fill_bytes", name);
+      stat_reg_counter(sdb, buf, "bytes read from the next level",
+		       &cp->fill_bytes, 0, NULL);
+      sprintf(buf, "%s.wb_bytes", name);
+      stat_reg_counter(sdb, buf, "bytes written back to the next level",
+		       &cp->wb_bytes, 0, NULL);
+      sprintf(buf, "%s.bytes_per_access", name);
+      sprintf(buf1, "(%s.fill_bytes + %s.wb_bytes) / %s.accesses",
+	      name, name, name);
+      stat_reg_formula(sdb, buf, "bytes transferred per access", buf1, NULL);
+      sprintf(buf, "%s.cap_samples", name);
+      stat_reg_counter(sdb, buf, "effective capacity samples",
+		       &cp->cap_samples, 0, NULL);
+      sprintf(buf, "%s.cap_bytes", name);
+      stat_reg_counter(sdb, buf, "sum of the bytes of data held",
+		       &cp->cap_bytes, 0, NULL);
+      sprintf(buf, "%s.eff_capacity", name);
+      sprintf(buf1, "%s.cap_bytes / %s.cap_samples", name, name);
+      stat_reg_formula(sdb, buf, "bytes of data held, on average",
+		       buf1, "%12.0f");
+      sprintf(buf, "%s.eff_capacity_ratio", name);
+      sprintf(buf1, "%s.eff_capacity / %.0f", name,
+	      (double)cp->nsets * cp->data_ways * cp->bsize);
+      stat_reg_formula(sdb, buf,
+		       "effective capacity / data array size", buf1, NULL);
+    }
+  if (cp->sect_size)
+    {
+      sprintf(buf, "%s.sector_misses", name);
+      stat_reg_counter(sdb, buf, "misses on invalid sectors of a block",
+		       &cp->sector_misses, 0, NULL);
+    }
+  if (cp->bdi)
+    {
+      sprintf(buf, "%s.cap_stored", name);
+      stat_reg_counter(sdb, buf, "sum of the bytes the data takes up",
+		       &cp->cap_stored, 0, NULL);
+      sprintf(buf, "%s.compression_ratio", name);
+      sprintf(buf1, "%s.cap_bytes / %s.cap_stored", name, name);
+      stat_reg_formula(sdb, buf, "BDI compression ratio of the data held",
+		       buf1, NULL);
+    }
+
+  if (cp->policy == DRRIP)
+    {
+      sprintf(buf, "%s.psel", name);
+      stat_reg_int(sdb, buf, "DRRIP policy selector (high favors BRRIP)",
+		   &cp->psel, CACHE_PSEL_MAX/2, NULL);
+    }
 
 }
-/* ECE552 Assignment 4 - BEGIN CODE*/
-md_addr_t get_PC();
-/* ECE552 Assignment 4 - END CODE */
+/* pollution filter bit of block address BADDR */
+#define PF_FILTER_BIT(cp, baddr)					\
+  ((((baddr) >> (cp)->set_shift) ^ ((baddr) >> ((cp)->set_shift + 12)))	\
+   & (CACHE_PF_FILTER_BITS - 1))
+#define PF_FILTER_TEST(cp, baddr)					\
+  ((cp)->pf_filter[PF_FILTER_BIT(cp, baddr) >> 3]			\
+   & (1 << (PF_FILTER_BIT(cp, baddr) & 7)))
+#define PF_FILTER_SET(cp, baddr)					\
+  ((cp)->pf_filter[PF_FILTER_BIT(cp, baddr) >> 3]			\
+   |= (1 << (PF_FILTER_BIT(cp, baddr) & 7)))
+#define PF_FILTER_CLEAR(cp, baddr)					\
+  ((cp)->pf_filter[PF_FILTER_BIT(cp, baddr) >> 3]			\
+   &= ~(1 << (PF_FILTER_BIT(cp, baddr) & 7)))
+
+/* request a prefetch of block BADDR at NOW, the request goes straight to
+   the cache if CP has no prefetch queue */
+static void
+pf_request(struct cache_t *cp,			/* cache instance */
+	   md_addr_t baddr,			/* block to prefetch */
+	   md_addr_t pc,			/* PC of the triggering access */
+	   tick_t now)				/* time of request */
+{
+  int i;
+
+  /* nothing to do if the block is already cached */
+  if (cache_probe(cp, baddr))
+    return;
+
+  if (!cp->pf_qsize)
+    {
+      cache_access(cp, Read, baddr, NULL, cp->bsize, now, NULL, NULL, pc, 1);
+      return;
+    }
+
+  /* merge with a queued request for the same block */
+  for (i=0; i < cp->pf_num; i++)
+    if (cp->pf_queue[(cp->pf_head + i) % cp->pf_qsize].baddr == baddr)
+      return;
+
+  /* a full queue drops its oldest, most likely stale, request */
+  if (cp->pf_num == cp->pf_qsize)
+    {
+      cp->prefetch_dropped++;
+      cp->pf_head = (cp->pf_head + 1) % cp->pf_qsize;
+      cp->pf_num--;
+    }
+  cp->pf_queue[(cp->pf_head + cp->pf_num) % cp->pf_qsize].baddr = baddr;
+  cp->pf_queue[(cp->pf_head + cp->pf_num) % cp->pf_qsize].pc = pc;
+  cp->pf_num++;
+}
+
+/* issue up to the prefetch bandwidth of queued requests at NOW, requests
+   for blocks that have since been cached are discarded for free */
+static void
+pf_drain(struct cache_t *cp,			/* cache instance */
+	 tick_t now)				/* time of issue */
+{
+  int issued = 0;
+
+  while (issued < cp->pf_bandwidth && cp->pf_num > 0)
+    {
+      struct cache_pf_req_t *req = &cp->pf_queue[cp->pf_head];
+
+      cp->pf_head = (cp->pf_head + 1) % cp->pf_qsize;
+      cp->pf_num--;
+      if (!cache_probe(cp, req->baddr))
+	{
+	  cache_access(cp, Read, req->baddr, NULL, cp->bsize, now,
+		       NULL, NULL, req->pc, 1);
+	  issued++;
+	}
+    }
+}
+
+/* issue the queued prefetches of timed cache CP for every cycle up to NOW
+   since the last call, the queue stops draining once it is empty */
+void
+cache_prefetch_tick(struct cache_t *cp,		/* cache instance */
+		    tick_t now)			/* time of access */
+{
+  tick_t when;
+
+  for (when = cp->pf_tick + 1; cp->pf_num > 0 && when <= now; when++)
+    pf_drain(cp, when);
+  cp->pf_tick = MAX(cp->pf_tick, now);
+}
+
+/* remove a queued prefetch of block BADDR, which a demand miss is about to
+   fetch, returns non-zero if one was queued */
+static int
+pf_squash(struct cache_t *cp,			/* cache instance */
+	  md_addr_t baddr)			/* block missed on */
+{
+  int i;
+
+  for (i=0; i < cp->pf_num; i++)
+    if (cp->pf_queue[(cp->pf_head + i) % cp->pf_qsize].baddr == baddr)
+      {
+	/* close the gap, keeping the remaining requests in order */
+	for (; i < cp->pf_num - 1; i++)
+	  cp->pf_queue[(cp->pf_head + i) % cp->pf_qsize] =
+	    cp->pf_queue[(cp->pf_head + i + 1) % cp->pf_qsize];
+	cp->pf_num--;
+	return TRUE;
+      }
+  return FALSE;
+}
+
+/* end of an FDP interval, move one aggressiveness level up or down as
+   decided by the prefetch accuracy, lateness and cache pollution of the
+   interval (Srinath et al., HPCA 2007), then age the interval counters */
+static void
+fdp_update(struct cache_t *cp)			/* cache instance */
+{
+  double accuracy, lateness, pollution;
+  int late, polluting, delta;
+
+  accuracy = (cp->fdp_issued
+	      ? (double)cp->fdp_useful / (double)cp->fdp_issued : 0.0);
+  lateness = (cp->fdp_useful + cp->fdp_late
+	      ? ((double)cp->fdp_late
+		 / (double)(cp->fdp_useful + cp->fdp_late)) : 0.0);
+  pollution = (cp->fdp_misses
+	       ? (double)cp->fdp_pollution / (double)cp->fdp_misses : 0.0);
+  late = lateness > CACHE_FDP_LATE;
+  polluting = pollution > CACHE_FDP_POLLUTION;
+
+  if (accuracy >= CACHE_FDP_ACC_HIGH)
+    delta = late ? 1 : (polluting ? -1 : 0);
+  else if (accuracy >= CACHE_FDP_ACC_LOW)
+    delta = polluting ? -1 : (late ? 1 : 0);
+  else
+    delta = (late || polluting) ? -1 : 0;
+
+  cp->pf_level = MIN(MAX(cp->pf_level + delta, 1), CACHE_FDP_LEVELS);
+  cp->pf_distance = fdp_levels[cp->pf_level - 1].distance;
+  cp->pf_degree = fdp_levels[cp->pf_level - 1].degree;
+
+  /* weigh each interval as much as all of the earlier ones together */
+  cp->fdp_evictions = 0;
+  cp->fdp_issued /= 2;
+  cp->fdp_useful /= 2;
+  cp->fdp_late /= 2;
+  cp->fdp_pollution /= 2;
+  cp->fdp_misses /= 2;
+}
+
+/* account a demand reference to block BLK at NOW, the first one to a
+   prefetched block makes the prefetch useful */
+static void
+pf_demand_hit(struct cache_t *cp,		/* cache instance */
+	      struct cache_blk_t *blk,		/* block referenced */
+	      tick_t now)			/* time of access */
+{
+  blk->status &= ~CACHE_BLK_PREFETCHED;
+  cp->prefetch_useful++;
+  cp->fdp_useful++;
+
+  /* the prefetch only hid part of the miss, only timed caches can see a
+     prefetch in flight, functional simulators access everything at once */
+  if (cp->timed && blk->ready > now)
+    {
+      cp->prefetch_late++;
+      cp->fdp_late++;
+    }
+}
 
 /* Next Line Prefetcher */
-void next_line_prefetcher(struct cache_t *cp, md_addr_t addr) {
+void next_line_prefetcher(struct cache_t *cp, md_addr_t addr, md_addr_t pc, tick_t now) {
   /* ECE552 Assignment 4 - BEGIN CODE*/
-  // Just add an entry into the cache
-  md_addr_t next_addr = addr + cp->bsize;
-  if (!cache_probe(cp, CACHE_BADDR(cp, next_addr))) {
-    cache_access(cp, Read, CACHE_BADDR(cp, next_addr), NULL, cp->bsize, 0, NULL, NULL, 1);
+  // Just add an entry into the cache, pf_degree lines starting pf_distance lines ahead
+  for (int k = 0; k < cp->pf_degree; k++) {
+    md_addr_t next_addr = addr + cp->bsize * (cp->pf_distance + k);
+    pf_request(cp, CACHE_BADDR(cp, next_addr), pc, now);
   }
   /* ECE552 Assignment 4 - END CODE*/
 }
@@ -530,9 +2071,9 @@ void next_line_prefetcher(struct cache_t *cp, md_addr_t addr) {
 /* Open Ended Prefetcher */
 /* Delta-Correlation Data Prefetcher based on paper: https://jilp.org/vol13/v13paper2.pdf */
 /* Specifically pages 4-6 detail the design methodology that was implemented */
-void open_ended_prefetcher(struct cache_t *cp, md_addr_t addr) {
+void open_ended_prefetcher(struct cache_t *cp, md_addr_t addr, md_addr_t pc, tick_t now) {
   /* ECE552 Assignment 4 - BEGIN CODE*/
-  md_addr_t pc = get_PC();                        // Fetch the program counter (PC) for indexing the delta-correlation table (DCPT)
+  // The PC of the requesting instruction indexes the delta-correlation table (DCPT)
   int index = (pc >> 3) & (cp->dcpt_size - 1);    // PC acts as index into the DCPT
   struct dcpt_entry *entry = &(cp->dcpt[index]);  // Retrieve corresponding DCPT entry
 
@@ -583,153 +2124,820 @@ void open_ended_prefetcher(struct cache_t *cp, md_addr_t addr) {
     }
 
     // Filter and issue prefetch requests for the predicted addresses also from page 6 of paper
-    int batch_count = 0;  // Limit the number of prefetches in this call
-    for (int i = 0; i < num_candidates && batch_count < MAX_PREFETCH; i++) {
+    int batch_count = 0;  // Limit the number of prefetches in this call to pf_degree, skipping the first pf_distance - 1
+    for (int i = cp->pf_distance - 1; i < num_candidates && batch_count < cp->pf_degree; i++) {
       // Check if candidate is valid (not recently prefetched or already in cache)
       if (candidates[i] != entry->last_prefetch && cache_probe(cp, candidates[i]) == 0) {
         entry->last_prefetch = candidates[i];                                                       // Update the last prefetched address
-        cache_access(cp, Read, CACHE_BADDR(cp, candidates[i]), NULL, cp->bsize, 0, NULL, NULL, 1);  // Issue the prefetch request
+        pf_request(cp, CACHE_BADDR(cp, candidates[i]), pc, now);                                       // Issue the prefetch request
         batch_count++;                                                                              // Increment prefetch batch_count
       }
     }
-  }
-  /* ECE552 Assignment 4 - END CODE*/
+  }
+  /* ECE552 Assignment 4 - END CODE*/
+}
+
+/* ECE552 Assignment 4 - BEGIN CODE*/
+struct rpt* rpt_create(int size) {
+  struct rpt* stride_rpt = (struct rpt*)malloc(size * sizeof(struct rpt));
+  if (!stride_rpt)
+    fatal("out of virtual memory");
+
+  for(int i = 0; i < size; i++){
+    stride_rpt[i].tag = 0;
+    stride_rpt[i].prev_addr = 0;
+    stride_rpt[i].stride = 0;
+    stride_rpt[i].state = initial;
+  }
+  return stride_rpt;
+}
+/* ECE552 Assignment 4 - END CODE*/
+
+/* Stride Prefetcher */
+void stride_prefetcher(struct cache_t *cp, md_addr_t addr, md_addr_t req_pc, tick_t now) {
+  /* ECE552 Assignment 4 - BEGIN CODE*/
+  int table_size = cp->rpt_size;
+  struct rpt *stride_rpt = cp->rpt;  // this cache's own RPT, allocated by cache_create()
+
+  md_addr_t pc = (req_pc >> 2) % table_size; // discard lowest two zero bits
+  md_addr_t stride = addr - stride_rpt[pc].prev_addr;
+  int stride_condition = (stride_rpt[pc].stride == stride);
+
+  // check if entry has already been accessed / matches
+  if (stride_rpt[pc].tag == pc) {
+    if (stride_rpt[pc].state == initial) {
+      if (stride_condition) {
+        stride_rpt[pc].state = steady;
+      }
+      else {
+        stride_rpt[pc].state = transient;
+        stride_rpt[pc].stride = stride;
+      }
+    }
+    else if (stride_rpt[pc].state == transient) {
+      if (stride_condition) {
+        stride_rpt[pc].state = steady;
+      }
+      else {
+        stride_rpt[pc].state = no_prediction;
+        stride_rpt[pc].stride = stride;
+      }
+    }
+    else if (stride_rpt[pc].state == steady) {
+      if (stride_condition) {
+        stride_rpt[pc].state = steady;
+      }
+      else {
+        stride_rpt[pc].state = initial;
+      }
+    }
+    else if (stride_rpt[pc].state == no_prediction) {
+      if (stride_condition) {
+        stride_rpt[pc].state = transient;
+      }
+      else {
+        stride_rpt[pc].state = no_prediction;
+        stride_rpt[pc].stride = stride;
+      }
+    }
+    stride_rpt[pc].prev_addr = addr; //
+  }
+  else {
+    stride_rpt[pc].tag = pc;
+    stride_rpt[pc].prev_addr = addr; //
+    stride_rpt[pc].stride = 0;
+    stride_rpt[pc].state = initial;
+  }
+
+  if (stride_rpt[pc].state != no_prediction) {
+    for (int k = 0; k < cp->pf_degree; k++) {
+      md_addr_t next_addr = addr + stride_rpt[pc].stride * (cp->pf_distance + k);
+      pf_request(cp, CACHE_BADDR(cp, next_addr), req_pc, now);
+    }
+  }
+  return;
+  /* ECE552 Assignment 4 - END CODE*/
+}
+
+
+/* GHB PC/DC prefetcher: the block numbers referenced by the PC are read
+   back from the GHB, most recent first, and the deltas between them are
+   searched for the latest earlier occurrence of the last two deltas; the
+   deltas that followed that occurrence are predicted to follow again */
+void
+ghb_prefetcher(struct cache_t *cp,	/* cache instance */
+	       md_addr_t addr,		/* address accessed */
+	       md_addr_t pc,		/* PC of the accessing instruction */
+	       tick_t now)		/* time of access */
+{
+  struct cache_ghb_index_t *it;
+  struct cache_ghb_entry_t *ent;
+  md_addr_t hist[CACHE_GHB_DEPTH], bnum = addr >> cp->set_shift, pred;
+  int delta[CACHE_GHB_DEPTH-1], nhist, k, i, n, last, has_link;
+  unsigned int seq, age;
+
+/* non-zero if GHB entry SEQ has not been overwritten yet */
+#define GHB_LIVE(SEQ)	((unsigned int)(cp->ghb_seq - (SEQ)) <= (unsigned int)cp->ghb_size)
+#define GHB_ENTRY(SEQ)	(&cp->ghb[(SEQ) & (cp->ghb_size - 1)])
+
+  it = &cp->ghb_index[(pc >> log_base2(sizeof(md_inst_t)))
+		      & (cp->ghb_size - 1)];
+  has_link = (it->valid && it->pc == pc && GHB_LIVE(it->head));
+
+  /* same block as the last reference of this PC, a zero delta */
+  if (has_link && GHB_ENTRY(it->head)->bnum == bnum)
+    return;
+
+  /* push this reference, linked to the previous one of the PC */
+  seq = cp->ghb_seq++;
+  ent = GHB_ENTRY(seq);
+  ent->bnum = bnum;
+  ent->has_link = has_link;
+  ent->link = it->head;
+  it->valid = TRUE;
+  it->pc = pc;
+  it->head = seq;
+
+  /* walk the history of the PC, the links always point further back */
+  hist[0] = bnum;
+  nhist = 1;
+  age = 0;
+  while (nhist < CACHE_GHB_DEPTH && ent->has_link
+	 && GHB_LIVE(ent->link) && cp->ghb_seq - ent->link > age)
+    {
+      age = cp->ghb_seq - ent->link;
+      ent = GHB_ENTRY(ent->link);
+      hist[nhist++] = ent->bnum;
+    }
+
+  /* deltas, most recent first, and the latest earlier occurrence of the
+     last two of them */
+  if (nhist < 4)
+    return;
+  for (i=0; i < nhist-1; i++)
+    delta[i] = (int)(hist[i] - hist[i+1]);
+  for (k=1; k+1 < nhist-1; k++)
+    if (delta[k] == delta[0] && delta[k+1] == delta[1])
+      break;
+  if (k+1 >= nhist-1)
+    return;
+
+  /* replay the K deltas that followed, from the oldest, as often as needed
+     to issue pf_degree requests starting pf_distance predictions ahead */
+  pred = bnum;
+  last = cp->pf_distance - 1 + cp->pf_degree;
+  for (n=0, i=k-1; n < last; n++, i = (i == 0 ? k-1 : i-1))
+    {
+      pred += delta[i];
+      if (n >= cp->pf_distance - 1)
+	pf_request(cp, pred << cp->set_shift, pc, now);
+    }
+
+#undef GHB_LIVE
+#undef GHB_ENTRY
+}
+
+/* cache x might generate a prefetch after a regular cache access to address addr */
+void generate_prefetch(struct cache_t *cp, md_addr_t addr, md_addr_t pc, tick_t now) {
+
+	switch(cp->prefetch_type) {
+		case 0:
+		   // prefetching is not enabled;
+		   // do nothing
+		   break;
+		case 1:
+		   // Next Line Prefetcher
+		   next_line_prefetcher(cp, addr, pc, now);
+		   break;
+		case 2:
+		   // Open Ended Prefetcher
+		   open_ended_prefetcher(cp, addr, pc, now);
+		   break;
+		default:
+		   if (cp->prefetch_type < 0)
+		     {
+		       /* GHB PC/DC prefetcher of -prefetch_type entries */
+		       ghb_prefetcher(cp, addr, pc, now);
+		       break;
+		     }
+		   // Stride Prefetcher with cp->prefetch_type number of entries in the Reference Prediction Table (RPT)
+		   stride_prefetcher(cp, addr, pc, now);
+	}
+
+}
+
+/* print cache stats */
+void
+cache_stats(struct cache_t *cp,		/* cache instance */
+	    FILE *stream)		/* output stream */
+{
+  double sum = (double)(cp->hits + cp->misses);
+
+  fprintf(stream,
+	  "cache: %s: %.0f hits %.0f misses %.0f repls %.0f invalidations\n",
+	  cp->name, (double)cp->hits, (double)cp->misses,
+	  (double)cp->replacements, (double)cp->invalidations);
+  fprintf(stream,
+	  "cache: %s: miss rate=%f  repl rate=%f  invalidation rate=%f\n",
+	  cp->name,
+	  (double)cp->misses/sum, (double)(double)cp->replacements/sum,
+	  (double)cp->invalidations/sum);
+}
+
+/* select the way of skewed cache CP to replace for a miss on ADDR, out of
+   the blocks the missing block may go to, one per way: an invalid one,
+   else the oldest for LRU and FIFO or the most distant re-reference for
+   NRU/RRIP, aging all of them as in rrip_select_victim(); sets *SET to the
+   set of the way */
+static int
+skew_replace_way(struct cache_t *cp,		/* cache instance */
+		 md_addr_t addr,		/* address of the miss */
+		 md_addr_t *set,		/* set of the way selected */
+		 int prefetch)			/* non-zero for a prefetch */
+{
+  md_addr_t sets[CACHE_MAX_SKEW_WAYS];
+  struct cache_blk_t *blk, *repl = NULL;
+  int i, way = -1, distant = RRPV_DISTANT(cp);
+
+  for (i=0; i<cp->assoc; i++)
+    {
+      sets[i] = hash_set(cp, addr, i);
+      if (way < 0 && cp->sets[sets[i]].tags[i] == CACHE_TAG_INVALID)
+	way = i;
+    }
+
+  switch (cp->policy) {
+  case LRU:
+  case FIFO:
+    if (way < 0)
+      {
+	way = 0;
+	for (i=1; i<cp->assoc; i++)
+	  {
+	    if (CACHE_STAMP(cp, sets[i], i) < CACHE_STAMP(cp, sets[way], way))
+	      way = i;
+	  }
+      }
+    update_way_age(cp, &cp->sets[sets[way]], way, Head);
+    break;
+  case Random:
+    if (way < 0)
+      way = myrand() & (cp->assoc - 1);
+    break;
+  case NRU:
+  case SRRIP:
+  case DRRIP:
+  case SHiP:
+    if (way < 0)
+      {
+	for (i=0; i<cp->assoc; i++)
+	  {
+	    blk = CACHE_BINDEX(cp, cp->sets[sets[i]].blks, i);
+	    if (!repl || blk->rrpv > repl->rrpv)
+	      {
+		repl = blk;
+		way = i;
+	      }
+	  }
+	if (repl->rrpv < distant)
+	  {
+	    int age = distant - repl->rrpv;
+
+	    for (i=0; i<cp->assoc; i++)
+	      {
+		blk = CACHE_BINDEX(cp, cp->sets[sets[i]].blks, i);
+		blk->rrpv = MIN(blk->rrpv + age, distant);
+	      }
+	  }
+      }
+    if (prefetch == 0)
+      rrip_miss(cp, sets[way],
+		CACHE_BINDEX(cp, cp->sets[sets[way]].blks, way));
+    break;
+  default:
+    panic("bogus replacement policy");
+  }
+
+  *set = sets[way];
+  return way;
+}
+
+/* select the way of cache CP to replace for a miss on ADDR, making it the
+   youngest way of its set, and set *SET to that set */
+static int
+replace_way(struct cache_t *cp,			/* cache instance */
+	    md_addr_t addr,			/* address of the miss */
+	    md_addr_t *setp,			/* set of the way selected */
+	    int prefetch)			/* non-zero for a prefetch */
+{
+  md_addr_t set;
+  int way;
+
+  if (cp->index == Skewed)
+    return skew_replace_way(cp, addr, setp, prefetch);
+
+  set = *setp = CACHE_SET(cp, addr);
+  switch (cp->policy) {
+  case LRU:
+  case FIFO:
+    way = way_of_age(cp, &cp->sets[set], cp->assoc - 1);
+    update_way_age(cp, &cp->sets[set], way, Head);
+    break;
+  case Random:
+    way = myrand() & (cp->assoc - 1);
+    break;
+  case NRU:
+  case SRRIP:
+  case DRRIP:
+  case SHiP:
+    way = rrip_select_victim(cp, &cp->sets[set]);
+    if (prefetch == 0)
+      rrip_miss(cp, set, CACHE_BINDEX(cp, cp->sets[set].blks, way));
+    break;
+  default:
+    panic("bogus replacement policy");
+  }
+  return way;
+}
+
+/* find the victim cache entry of cache CP holding block BADDR */
+static struct cache_victim_t *
+victim_lookup(struct cache_t *cp,		/* cache instance */
+	      md_addr_t baddr)			/* block address */
+{
+  int i;
+
+  for (i=0; i<cp->vc_nentries; i++)
+    {
+      if ((cp->vc[i].status & CACHE_BLK_VALID) && cp->vc[i].baddr == baddr)
+	return &cp->vc[i];
+    }
+  return NULL;
+}
+
+/* invalidate the block containing ADDR in cache CP and its victim cache,
+   without writing it back, returns its CACHE_BLK_VALID and CACHE_BLK_DIRTY
+   status, zero if the cache did not hold it */
+static unsigned int
+invalidate_blk(struct cache_t *cp,		/* cache instance */
+	       md_addr_t addr)			/* address of block */
+{
+  md_addr_t set;
+  struct cache_victim_t *vc;
+  struct cache_blk_t *blk;
+  unsigned int status = 0;
+  int way;
+
+  way = lookup_way(cp, addr, &set);
+  if (way >= 0)
+    {
+      blk = CACHE_BINDEX(cp, cp->sets[set].blks, way);
+      status = blk->status & (CACHE_BLK_VALID | CACHE_BLK_DIRTY);
+      blk->status &= ~CACHE_BLK_VALID;
+      cp->sets[set].tags[way] = CACHE_TAG_INVALID;
+
+      /* blow away the last block to hit */
+      cp->last_tagset = 0;
+      cp->last_blk = NULL;
+
+      /* make this block the oldest (LRU) way */
+      update_way_age(cp, &cp->sets[set], way, Tail);
+      blk->rrpv = RRPV_DISTANT(cp);
+    }
+  if (cp->vc_nentries
+      && (vc = victim_lookup(cp, CACHE_BADDR(cp, addr))) != NULL)
+    {
+      status |= vc->status & (CACHE_BLK_VALID | CACHE_BLK_DIRTY);
+      vc->status = 0;
+    }
+  return status;
+}
+
+/* inclusive cache CP gives up block BADDR, invalidate it in the upper
+   levels, returns non-zero if any of them held it dirty */
+static int
+back_invalidate(struct cache_t *cp,		/* cache instance */
+		md_addr_t baddr)		/* block address */
+{
+  struct cache_t *up;
+  unsigned int status;
+  int i, j, dirty = FALSE;
+
+  for (i=0; i<cp->nuppers; i++)
+    {
+      up = cp->uppers[i];
+      for (j=0; j < MAX(cp->bsize / up->bsize, 1); j++)
+	{
+	  status = invalidate_blk(up, baddr + j * up->bsize);
+	  if (status)
+	    up->invalidations++;
+	  if (status & CACHE_BLK_DIRTY)
+	    dirty = TRUE;
+	}
+    }
+  return dirty;
+}
+
+static void victim_fill(struct cache_t *cp, md_addr_t baddr, int dirty,
+			tick_t now);
+
+/* block BADDR leaves cache CP for good: an inclusive cache takes it out of
+   its upper levels, an exclusive next level takes it clean or dirty, and
+   otherwise it is written back if dirty; returns the latency this adds to
+   the access */
+static unsigned int
+evict(struct cache_t *cp,			/* cache instance */
+      md_addr_t baddr,				/* block address */
+      struct cache_blk_t *blk,			/* block, NULL if none */
+      int dirty,				/* is the block dirty? */
+      tick_t now,				/* time of eviction */
+      md_addr_t pc)				/* PC of the requesting access */
+{
+  if (cp->incl == Inclusive && back_invalidate(cp, baddr))
+    dirty = TRUE;
+
+  if (cp->lower && cp->lower->incl == Exclusive)
+    {
+      /* victim fills are off the critical path, like unlimited writes */
+      if (dirty)
+	cp->writebacks++;
+      victim_fill(cp->lower, baddr, dirty, now);
+      return 0;
+    }
+
+  if (dirty)
+    {
+      /* write back the cache block */
+      cp->writebacks++;
+      return writeback(cp, baddr, blk, now, pc);
+    }
+  return 0;
+}
+
+/* put block BADDR, replaced from cache CP, in its victim cache, the oldest
+   entry leaving the cache if it is full; returns the latency this adds to
+   the access */
+static unsigned int
+victim_insert(struct cache_t *cp,		/* cache instance */
+	      md_addr_t baddr,			/* block address */
+	      unsigned int status,		/* status of the replaced block */
+	      tick_t now,			/* time of replacement */
+	      md_addr_t pc)			/* PC of the requesting access */
+{
+  struct cache_victim_t *vc = &cp->vc[0];
+  unsigned int lat = 0;
+  int i;
+
+  for (i=0; i<cp->vc_nentries; i++)
+    {
+      if (!(cp->vc[i].status & CACHE_BLK_VALID))
+	{
+	  vc = &cp->vc[i];
+	  break;
+	}
+      if (cp->vc[i].stamp < vc->stamp)
+	vc = &cp->vc[i];
+    }
+
+  if (vc->status & CACHE_BLK_VALID)
+    {
+      if (vc->status & CACHE_BLK_PREFETCHED)
+	cp->prefetch_unused++;
+      lat = evict(cp, vc->baddr, NULL, (vc->status & CACHE_BLK_DIRTY) != 0,
+		  now, pc);
+    }
+
+  vc->baddr = baddr;
+  vc->status = CACHE_BLK_VALID
+    | (status & (CACHE_BLK_DIRTY | CACHE_BLK_PREFETCHED));
+  vc->stamp = ++cp->vc_stamp;
+
+  return lat;
+}
+
+/* replaced block BLK at BADDR of cache CP goes to the victim cache, if
+   there is one, or leaves the cache, a prefetched block leaving unreferenced
+   is a wasted prefetch; returns the latency this adds to the access */
+static unsigned int
+retire_blk(struct cache_t *cp,			/* cache instance */
+	   md_addr_t baddr,			/* block address */
+	   struct cache_blk_t *blk,		/* block replaced */
+	   tick_t now,				/* time of replacement */
+	   md_addr_t pc)			/* PC of the requesting access */
+{
+  if (cp->vc_nentries)
+    return victim_insert(cp, baddr, blk->status, now, pc);
+
+  if (blk->status & CACHE_BLK_PREFETCHED)
+    cp->prefetch_unused++;
+  return evict(cp, baddr, blk, (blk->status & CACHE_BLK_DIRTY) != 0, now, pc);
+}
+
+/* exclusive cache CP takes block BADDR, replaced from an upper level at
+   time NOW, without reading it from the next level */
+static void
+victim_fill(struct cache_t *cp,			/* cache instance */
+	    md_addr_t baddr,			/* block address */
+	    int dirty,				/* is the block dirty? */
+	    tick_t now)				/* time of fill */
+{
+  md_addr_t tag = CACHE_TAG(cp, baddr);
+  md_addr_t set;
+  struct cache_blk_t *repl;
+  int way;
+
+  /* a prefetch may have left a copy here */
+  way = lookup_way(cp, baddr, &set);
+  if (way >= 0)
+    {
+      if (dirty)
+	CACHE_BINDEX(cp, cp->sets[set].blks, way)->status |= CACHE_BLK_DIRTY;
+      return;
+    }
+
+  way = replace_way(cp, baddr, &set, /* prefetch */1);
+  repl = CACHE_BINDEX(cp, cp->sets[set].blks, way);
+
+  /* blow away the last block to hit */
+  cp->last_tagset = 0;
+  cp->last_blk = NULL;
+
+  if (repl->status & CACHE_BLK_VALID)
+    {
+      cp->replacements++;
+      retire_blk(cp, CACHE_MK_BADDR(cp, repl->tag, set), repl, now,
+		 /* no requesting PC */0);
+    }
+
+  repl->tag = tag;
+  repl->status = CACHE_BLK_VALID | (dirty ? CACHE_BLK_DIRTY : 0);
+  repl->ready = now;
+  cp->sets[set].tags[way] = tag;
+  if (CACHE_RRIP_POLICY(cp))
+    rrip_insert(cp, set, repl, /* no requesting PC */0);
 }
 
-/* ECE552 Assignment 4 - BEGIN CODE*/
-struct rpt* stride_rpt;
-int rpt_init = 0;
+/* a tag hit on block BLK of sectored cache CP is a sector miss if the NBYTES
+   at ADDR are in sectors the block does not hold, which are then read from
+   the next level, none of them for a write of whole sectors; returns
+   non-zero if the access is a sector miss, counted as a miss */
+static int
+sector_miss(struct cache_t *cp,			/* cache instance */
+	    enum mem_cmd cmd,			/* access type, Read or Write */
+	    struct cache_blk_t *blk,		/* block that hit */
+	    md_addr_t addr,			/* address of access */
+	    int nbytes,				/* number of bytes to access */
+	    tick_t now,				/* time of access */
+	    md_addr_t pc,			/* PC of the requesting access */
+	    int prefetch)			/* non-zero for a prefetch */
+{
+  unsigned int need = CACHE_SECT_MASK(cp, CACHE_BLK(cp, addr), nbytes);
+  unsigned int lat = 0;
 
-struct rpt* rpt_create(int size) {
-  //struct rpt* stride_rpt = (struct rpt*)malloc(size * sizeof(struct rpt));
-  stride_rpt = (struct rpt*)malloc(size * sizeof(struct rpt));
-  
-  for(int i = 0; i < size; i++){
-    stride_rpt[i].tag = 0;
-    stride_rpt[i].prev_addr = 0;
-    stride_rpt[i].stride = 0;
-    stride_rpt[i].state = initial;
-  }
-  return stride_rpt;
+  if (!(need & ~blk->sect_valid))
+    return FALSE;
+
+  if (prefetch == 0)
+    {
+      cp->misses++;
+      if (cmd == Read)
+	cp->read_misses++;
+      cp->sector_misses++;
+    }
+  else
+    cp->prefetch_misses++;
+
+  if (cmd == Read || nbytes < cp->sect_size)
+    lat = fill_blk(cp, CACHE_BADDR(cp, addr), blk, need & ~blk->sect_valid,
+		   now, pc, prefetch);
+  blk->sect_valid |= need;
+  blk->ready = MAX(blk->ready, now + lat);
+  return TRUE;
 }
-/* ECE552 Assignment 4 - END CODE*/
 
-/* Stride Prefetcher */
-void stride_prefetcher(struct cache_t *cp, md_addr_t addr) {
-  /* ECE552 Assignment 4 - BEGIN CODE*/
-  int table_size = cp->prefetch_type; 
-  if (!rpt_init) {
-    stride_rpt = rpt_create(table_size);
-    rpt_init = 1;
-  }
+/* base and delta sizes of the BDI encodings, in bytes, tried in order */
+static struct {
+  int base, delta;
+} bdi_encodings[] = {
+  { 8, 1 }, { 8, 2 }, { 8, 4 }, { 4, 1 }, { 4, 2 }, { 2, 1 }
+};
+
+/* X sign extended from its low BYTES bytes */
+static sqword_t
+bdi_sext(qword_t x,				/* value */
+	 int bytes)				/* bytes of X that are valid */
+{
+  int shift = 64 - 8 * bytes;
 
-  md_addr_t pc = (get_PC() >> 2) % table_size; // discard lowest two zero bits
-  md_addr_t stride = addr - stride_rpt[pc].prev_addr;
-  int stride_condition = (stride_rpt[pc].stride == stride);
+  return ((sqword_t)(x << shift)) >> shift;
+}
 
-  // check if entry has already been accessed / matches
-  if (stride_rpt[pc].tag == pc) {
-    if (stride_rpt[pc].state == initial) {
-      if (stride_condition) {
-        stride_rpt[pc].state = steady;
-      }
-      else {
-        stride_rpt[pc].state = transient;
-        stride_rpt[pc].stride = stride;
-      }
+/* element I of BYTES bytes of block DATA, in host byte order */
+static qword_t
+bdi_elem(byte_t *data,				/* block data */
+	 int i,					/* element index */
+	 int bytes)				/* element size */
+{
+  qword_t q;
+  word_t w;
+  half_t h;
+
+  switch (bytes)
+    {
+    case 8: memcpy(&q, data + 8*i, 8); return q;
+    case 4: memcpy(&w, data + 4*i, 4); return w;
+    case 2: memcpy(&h, data + 2*i, 2); return h;
+    default: panic("bogus BDI element size");
     }
-    else if (stride_rpt[pc].state == transient) {
-      if (stride_condition) {
-        stride_rpt[pc].state = steady;
-      }
-      else {
-        stride_rpt[pc].state = no_prediction;
-        stride_rpt[pc].stride = stride;
-      }
+}
+
+/* non-zero if every element of BASE bytes of the BSIZE bytes at DATA is
+   within a signed DELTA bytes of zero (an immediate) or of the first
+   element that is not (the base) */
+static int
+bdi_fits(byte_t *data,				/* block data */
+	 int bsize,				/* block size */
+	 int base,				/* element size */
+	 int delta)				/* delta size */
+{
+  sqword_t lim = (sqword_t)1 << (8 * delta - 1), d;
+  qword_t b = 0, v;
+  int i, have_base = FALSE;
+
+  for (i=0; i < bsize / base; i++)
+    {
+      v = bdi_elem(data, i, base);
+      d = bdi_sext(v, base);
+      if (d >= -lim && d < lim)
+	continue;
+      if (!have_base)
+	{
+	  b = v;
+	  have_base = TRUE;
+	  continue;
+	}
+      d = bdi_sext(v - b, base);
+      if (d < -lim || d >= lim)
+	return FALSE;
     }
-    else if (stride_rpt[pc].state == steady) {
-      if (stride_condition) {
-        stride_rpt[pc].state = steady;
-      }
-      else {
-        stride_rpt[pc].state = initial;
-      }
+  return TRUE;
+}
+
+/* BDI compressed size of the BSIZE bytes at DATA, in whole segments, the
+   encoding itself is kept with the tag */
+static int
+bdi_size(byte_t *data,				/* block data */
+	 int bsize)				/* block size */
+{
+  int i, size = bsize;
+
+  /* all zeros, or one repeated 8 byte value */
+  for (i=0; i < bsize && !data[i]; i++)
+    /* nada */;
+  if (i == bsize)
+    size = 1;
+  else
+    {
+      for (i=8; i < bsize && !memcmp(data, data + i, 8); i += 8)
+	/* nada */;
+      if (i >= bsize)
+	size = 8;
     }
-    else if (stride_rpt[pc].state == no_prediction) {
-      if (stride_condition) {
-        stride_rpt[pc].state = transient;
-      }
-      else {
-        stride_rpt[pc].state = no_prediction;
-        stride_rpt[pc].stride = stride;
-      }
+
+  for (i=0; i < N_ELT(bdi_encodings); i++)
+    {
+      int enc = bdi_encodings[i].base
+	+ (bsize / bdi_encodings[i].base) * bdi_encodings[i].delta;
+
+      if (enc < size
+	  && bdi_fits(data, bsize, bdi_encodings[i].base,
+		      bdi_encodings[i].delta))
+	size = enc;
     }
-    stride_rpt[pc].prev_addr = addr; //
-  }
-  else {
-    stride_rpt[pc].tag = pc;
-    stride_rpt[pc].prev_addr = addr; //
-    stride_rpt[pc].stride = 0;
-    stride_rpt[pc].state = initial;
-  }
 
-  md_addr_t next_addr = CACHE_BADDR(cp, addr + stride_rpt[pc].stride);
-  if ((!cache_probe(cp, CACHE_BADDR(cp, next_addr)) && (stride_rpt[pc].state != no_prediction))) {
-      cache_access(cp, Read, CACHE_BADDR(cp, next_addr), NULL, cp->bsize, 0, NULL, NULL, 1);
-  }
-  return;
-  /* ECE552 Assignment 4 - END CODE*/
+  size = ((size + CACHE_BDI_SEGMENT - 1) / CACHE_BDI_SEGMENT)
+    * CACHE_BDI_SEGMENT;
+  return MIN(size, bsize);
 }
 
+/* recompress WAY of SET of compressed cache CP, holding block BADDR, and
+   evict the oldest other blocks of the set until its data fits, returns
+   the latency the evictions add to the access */
+static unsigned int
+bdi_fit(struct cache_t *cp,			/* cache instance */
+	md_addr_t set,				/* set of the block */
+	int way,				/* way of the block */
+	md_addr_t baddr,			/* block address */
+	tick_t now,				/* time of access */
+	md_addr_t pc)				/* PC of the requesting access */
+{
+  struct cache_set_t *sp = &cp->sets[set];
+  struct cache_blk_t *blk = CACHE_BINDEX(cp, sp->blks, way), *vblk;
+  int i, victim, used = 0, budget = cp->data_ways * cp->bsize;
+  unsigned int lat = 0;
 
-/* cache x might generate a prefetch after a regular cache access to address addr */
-void generate_prefetch(struct cache_t *cp, md_addr_t addr) {
+  if (cp->balloc)
+    blk->csize = bdi_size(blk->data, cp->bsize);
+  else
+    {
+      cp->data_fn(baddr, cp->bdi_buf, cp->bsize);
+      blk->csize = bdi_size(cp->bdi_buf, cp->bsize);
+    }
 
-	switch(cp->prefetch_type) {
-		case 0:
-		   // prefetching is not enabled;
-		   // do nothing
-		   break;
-		case 1:
-		   // Next Line Prefetcher
-		   next_line_prefetcher(cp, addr);
-		   break;
-		case 2:
-		   // Open Ended Prefetcher
-		   open_ended_prefetcher(cp, addr);
-		   break;
-		default:
-		   // Stride Prefetcher with cp->prefetch_type number of entries in the Reference Prediction Table (RPT)
-		   stride_prefetcher(cp, addr);
+  for (i=0; i < cp->assoc; i++)
+    {
+      vblk = CACHE_BINDEX(cp, sp->blks, i);
+      if (vblk->status & CACHE_BLK_VALID)
+	used += vblk->csize;
+    }
+
+  while (used > budget)
+    {
+      /* the oldest block, or the most distant re-reference */
+      victim = -1;
+      for (i=0; i < cp->assoc; i++)
+	{
+	  vblk = CACHE_BINDEX(cp, sp->blks, i);
+	  if (i == way || !(vblk->status & CACHE_BLK_VALID))
+	    continue;
+	  if (victim < 0
+	      || (CACHE_RRIP_POLICY(cp)
+		  ? vblk->rrpv > CACHE_BINDEX(cp, sp->blks, victim)->rrpv
+		  : sp->ages[i] > sp->ages[victim]))
+	    victim = i;
 	}
+      if (victim < 0)
+	panic("compressed block does not fit in its set");
 
+      vblk = CACHE_BINDEX(cp, sp->blks, victim);
+      cp->replacements++;
+      lat += retire_blk(cp, CACHE_MK_BADDR(cp, vblk->tag, set), vblk,
+			now+lat, pc);
+      used -= vblk->csize;
+      vblk->status = 0;
+      sp->tags[victim] = CACHE_TAG_INVALID;
+      update_way_age(cp, sp, victim, Tail);
+      vblk->rrpv = RRPV_DISTANT(cp);
+      if (cp->last_blk == vblk)
+	{
+	  cp->last_tagset = 0;
+	  cp->last_blk = NULL;
+	}
+    }
+  return lat;
 }
 
-//md_addr_t get_PC();
+/* a write to compressed cache CP changed the data of the block at ADDR,
+   recompress it, its evictions are off the critical path */
+static void
+bdi_refit(struct cache_t *cp,			/* cache instance */
+	  md_addr_t addr,			/* address of access */
+	  tick_t now,				/* time of access */
+	  md_addr_t pc)				/* PC of the requesting access */
+{
+  md_addr_t set;
+  int way = lookup_way(cp, addr, &set);
 
-/* print cache stats */
-void
-cache_stats(struct cache_t *cp,		/* cache instance */
-	    FILE *stream)		/* output stream */
+  if (way >= 0)
+    bdi_fit(cp, set, way, CACHE_BADDR(cp, addr), now, pc);
+}
+
+/* sample the bytes of data sectored or compressed cache CP holds, and the
+   bytes they take up */
+static void
+sample_capacity(struct cache_t *cp)		/* cache instance */
 {
-  double sum = (double)(cp->hits + cp->misses);
+  struct cache_blk_t *blk;
+  int i, j, bytes;
+  unsigned int mask;
 
-  fprintf(stream,
-	  "cache: %s: %.0f hits %.0f misses %.0f repls %.0f invalidations\n",
-	  cp->name, (double)cp->hits, (double)cp->misses,
-	  (double)cp->replacements, (double)cp->invalidations);
-  fprintf(stream,
-	  "cache: %s: miss rate=%f  repl rate=%f  invalidation rate=%f\n",
-	  cp->name,
-	  (double)cp->misses/sum, (double)(double)cp->replacements/sum,
-	  (double)cp->invalidations/sum);
+  for (i=0; i < cp->nsets; i++)
+    {
+      for (j=0; j < cp->assoc; j++)
+	{
+	  blk = CACHE_BINDEX(cp, cp->sets[i].blks, j);
+	  if (!(blk->status & CACHE_BLK_VALID))
+	    continue;
+	  bytes = cp->bsize;
+	  if (cp->sect_size)
+	    {
+	      for (bytes=0, mask=blk->sect_valid; mask != 0; mask >>= 1)
+		bytes += (mask & 1) ? cp->sect_size : 0;
+	    }
+	  cp->cap_bytes += bytes;
+	  cp->cap_stored += cp->bdi ? blk->csize : bytes;
+	}
+    }
+  cp->cap_samples++;
+  cp->cap_clock = 0;
 }
 
 /* access a cache, perform a CMD operation on cache CP at address ADDR,
    places NBYTES of data at *P, returns latency of operation if initiated
    at NOW, places pointer to block user data in *UDATA, *P is untouched if
    cache blocks are not allocated (!CP->BALLOC), UDATA should be NULL if no
-   user data is attached to blocks */
+   user data is attached to blocks; PC, the PC of the instruction making the
+   access or zero if unknown, trains PC-indexed prefetchers and policies */
 unsigned int				/* latency of access in cycles */
 cache_access(struct cache_t *cp,	/* cache to access */
 	     enum mem_cmd cmd,		/* access type, Read or Write */
@@ -739,14 +2947,17 @@ cache_access(struct cache_t *cp,	/* cache to access */
 	     tick_t now,		/* time of access */
 	     byte_t **udata,		/* for return of user data ptr */
 	     md_addr_t *repl_addr,	/* for address of replaced block */
+	     md_addr_t pc,		/* PC of the requesting instruction */
 	     int prefetch)		/* 1 if the access is a prefetch, 0 if it is not */
 {
   byte_t *p = vp;
   md_addr_t tag = CACHE_TAG(cp, addr);
-  md_addr_t set = CACHE_SET(cp, addr);
+  md_addr_t set;
   md_addr_t bofs = CACHE_BLK(cp, addr);
   struct cache_blk_t *blk, *repl;
-  int lat = 0;
+  struct cache_mshr_t *mshr = NULL;
+  struct cache_victim_t *vc = NULL;
+  int way, lat = 0, fill_dirty = FALSE;
 
   /* default replacement address */
   if (repl_addr)
@@ -764,6 +2975,17 @@ cache_access(struct cache_t *cp,	/* cache to access */
 
   /* permissions are checked on cache misses */
 
+  /* demand accesses give queued prefetches their turn to issue, timed
+     caches drain their queue every cycle in cache_prefetch_tick() */
+  if (prefetch == 0 && cp->pf_num && !cp->timed)
+    pf_drain(cp, now);
+
+  /* sample the effective capacity of sectored and compressed caches once
+     every NSETS * ASSOC accesses, about one block per access */
+  if ((cp->sect_size || cp->bdi)
+      && ++cp->cap_clock >= (counter_t)cp->nsets * cp->assoc)
+    sample_capacity(cp);
+
   /* check for a fast hit: access to same block */
   if (CACHE_TAGSET(cp, addr) == cp->last_tagset)
     {
@@ -772,29 +2994,12 @@ cache_access(struct cache_t *cp,	/* cache to access */
       goto cache_fast_hit;
     }
     
-  if (cp->hsize)
-    {
-      /* higly-associativity cache, access through the per-set hash tables */
-      int hindex = CACHE_HASH(cp, tag);
-
-      for (blk=cp->sets[set].hash[hindex];
-	   blk;
-	   blk=blk->hash_next)
-	{
-	  if (blk->tag == tag && (blk->status & CACHE_BLK_VALID))
-	    goto cache_hit;
-	}
-    }
-  else
+  /* search the tag array of the set */
+  way = lookup_way(cp, addr, &set);
+  if (way >= 0)
     {
-      /* low-associativity cache, linear search the way list */
-      for (blk=cp->sets[set].way_head;
-	   blk;
-	   blk=blk->way_next)
-	{
-	  if (blk->tag == tag && (blk->status & CACHE_BLK_VALID))
-	    goto cache_hit;
-	}
+      blk = CACHE_BINDEX(cp, cp->sets[set].blks, way);
+      goto cache_hit;
     }
 
   /* cache block not found */
@@ -807,33 +3012,83 @@ cache_access(struct cache_t *cp,	/* cache to access */
      if (cmd == Read) {	
 	cp->read_misses++;
      }
+
+     /* prefetch feedback: a queued prefetch for this block was too late,
+	or an earlier prefetch evicted it */
+     cp->fdp_misses++;
+     if (cp->pf_num && pf_squash(cp, CACHE_BADDR(cp, addr)))
+       {
+	 cp->prefetch_squashed++;
+	 cp->fdp_late++;
+       }
+     if (cp->pf_filter && PF_FILTER_TEST(cp, CACHE_BADDR(cp, addr)))
+       {
+	 PF_FILTER_CLEAR(cp, CACHE_BADDR(cp, addr));
+	 cp->prefetch_pollution++;
+	 cp->fdp_pollution++;
+       }
   }
   else {
      cp->prefetch_misses++;
   }
 
+  /* look for the block in the victim cache, it needs no MSHR if there */
+  if (cp->vc_nentries && (vc = victim_lookup(cp, CACHE_BADDR(cp, addr))))
+    {
+      cp->victim_hits++;
+      fill_dirty = (vc->status & CACHE_BLK_DIRTY) != 0;
+
+      /* a prefetched block keeps its mark in the victim cache, so the
+	 first demand reference makes the prefetch useful, a prefetch marks
+	 the block again below */
+      if (prefetch == 0 && (vc->status & CACHE_BLK_PREFETCHED))
+	{
+	  cp->prefetch_useful++;
+	  cp->fdp_useful++;
+	}
+      vc->status = 0;
+    }
 
-  /* select the appropriate block to replace, and re-link this entry to
-     the appropriate place in the way list */
-  switch (cp->policy) {
-  case LRU:
-  case FIFO:
-    repl = cp->sets[set].way_tail;
-    update_way_list(&cp->sets[set], repl, Head);
-    break;
-  case Random:
+  /* a primary miss needs an MSHR, wait for the earliest one to free up */
+  if (cp->mshr_nentries && !vc)
     {
-      int bindex = myrand() & (cp->assoc - 1);
-      repl = CACHE_BINDEX(cp, cp->sets[set].blks, bindex);
+      int stall;
+
+      mshr = mshr_select(cp, now, &stall);
+      if (stall)
+	{
+	  cp->mshr_full++;
+	  cp->mshr_stall_cycles += stall;
+	  lat += stall;
+	}
     }
-    break;
-  default:
-    panic("bogus replacement policy");
-  }
 
-  /* remove this block from the hash bucket chain, if hash exists */
-  if (cp->hsize)
-    unlink_htab_ent(cp, &cp->sets[set], repl);
+  /* an exclusive cache gives the block to the upper level that missed on
+     it rather than keeping a copy */
+  if (cp->incl == Exclusive && cmd == Read && prefetch == 0)
+    {
+      if (vc)
+	lat += cp->hit_latency + 1;
+      else
+	lat += fill_blk(cp, CACHE_BADDR(cp, addr), /* no block */NULL,
+			cp->sect_all, now+lat, pc, prefetch);
+      cp->excl_dirty = fill_dirty;
+
+      if (mshr)
+	{
+	  cp->mshr_allocs++;
+	  mshr->baddr = CACHE_BADDR(cp, addr);
+	  mshr->ready = now+lat;
+	  mshr->targets = 1;
+	}
+      generate_prefetch(cp, addr, pc, now);
+      return lat;
+    }
+
+  /* select the appropriate way to replace, and make it the youngest way of
+     the set */
+  way = replace_way(cp, addr, &set, prefetch);
+  repl = CACHE_BINDEX(cp, cp->sets[set].blks, way);
 
   /* blow away the last block to hit */
   cp->last_tagset = 0;
@@ -846,9 +3101,17 @@ cache_access(struct cache_t *cp,	/* cache to access */
 
       if (repl_addr)
 	*repl_addr = CACHE_MK_BADDR(cp, repl->tag, set);
+
+      /* prefetch feedback: blocks displaced by prefetches, and the end of
+	 the FDP interval, wasted prefetches are counted by retire_blk() */
+      if (prefetch && cp->pf_filter)
+	PF_FILTER_SET(cp, CACHE_MK_BADDR(cp, repl->tag, set));
+      if (cp->pf_throttle
+	  && ++cp->fdp_evictions >= MAX((cp->nsets * cp->assoc) / 2, 1))
+	fdp_update(cp);
  
       /* don't replace the block until outstanding misses are satisfied */
-      lat += BOUND_POS(repl->ready - now);
+      lat += BOUND_POS(repl->ready - (now + lat));
  
       /* stall until the bus to next level of memory is available */
       lat += BOUND_POS(cp->bus_free - (now + lat));
@@ -856,23 +3119,61 @@ cache_access(struct cache_t *cp,	/* cache to access */
       /* track bus resource usage */
       cp->bus_free = MAX(cp->bus_free, (now + lat)) + 1;
 
-      if (repl->status & CACHE_BLK_DIRTY)
-	{
-	  /* write back the cache block */
-	  cp->writebacks++;
-	  lat += cp->blk_access_fn(Write,
-				   CACHE_MK_BADDR(cp, repl->tag, set),
-				   cp->bsize, repl, now+lat, 0);
-	}
+      /* the replaced block goes to the victim cache or leaves the cache */
+      lat += retire_blk(cp, CACHE_MK_BADDR(cp, repl->tag, set), repl,
+			now+lat, pc);
     }
 
   /* update block tags */
   repl->tag = tag;
   repl->status = CACHE_BLK_VALID;	/* dirty bit set on update */
+  cp->sets[set].tags[way] = tag;
+
+  /* a sectored block holds only the sectors of the access */
+  if (cp->sect_size)
+    {
+      repl->sect_valid = CACHE_SECT_MASK(cp, bofs, nbytes);
+      repl->sect_dirty = 0;
+    }
+
+  /* mark prefetched blocks until their first demand reference */
+  if (prefetch)
+    {
+      repl->status |= CACHE_BLK_PREFETCHED;
+      cp->fdp_issued++;
+      if (cp->pf_filter)
+	PF_FILTER_CLEAR(cp, CACHE_BADDR(cp, addr));
+    }
+
+  /* set the re-reference prediction of the new block */
+  if (CACHE_RRIP_POLICY(cp))
+    rrip_insert(cp, set, repl, pc);
+
+  /* read data block, swapped in from the victim cache one cycle after a
+     hit, or forwarded from the write buffer if it still holds a writeback
+     of the block */
+  if (vc)
+    lat += cp->hit_latency + 1;
+  else if (cp->wbuf_nentries
+	   && wbuf_lookup(cp, CACHE_BADDR(cp, addr), now+lat))
+    {
+      cp->wbuf_forwards++;
+      lat += cp->hit_latency;
+    }
+  else
+    {
+      /* a write of whole sectors needs nothing from the next level */
+      if (!cp->sect_size || cmd == Read || nbytes < cp->sect_size)
+	lat += fill_blk(cp, CACHE_BADDR(cp, addr), repl, repl->sect_valid,
+			now+lat, pc, prefetch);
 
-  /* read data block */
-  lat += cp->blk_access_fn(Read, CACHE_BADDR(cp, addr), cp->bsize,
-			   repl, now+lat, prefetch);
+      /* a dirty block handed up by an exclusive next level stays dirty */
+      if (cp->lower && cp->lower->incl == Exclusive && cp->lower->excl_dirty)
+	{
+	  fill_dirty = TRUE;
+	  cp->lower->excl_dirty = FALSE;
+	}
+    }
 
   /* copy data out of cache block */
   if (cp->balloc)
@@ -881,8 +3182,15 @@ cache_access(struct cache_t *cp,	/* cache to access */
     }
 
   /* update dirty status */
-  if (cmd == Write)
+  if (cmd == Write || fill_dirty)
     repl->status |= CACHE_BLK_DIRTY;
+  if (cp->sect_size)
+    repl->sect_dirty = (fill_dirty ? repl->sect_valid
+			: cmd == Write ? CACHE_SECT_MASK(cp, bofs, nbytes) : 0);
+
+  /* a compressed set may have to give up more blocks to fit this one */
+  if (cp->bdi)
+    lat += bdi_fit(cp, set, way, CACHE_BADDR(cp, addr), now+lat, pc);
 
   /* get user block data, if requested and it exists */
   if (udata)
@@ -891,12 +3199,17 @@ cache_access(struct cache_t *cp,	/* cache to access */
   /* update block status */
   repl->ready = now+lat;
 
-  /* link this entry back into the hash table */
-  if (cp->hsize)
-    link_htab_ent(cp, &cp->sets[set], repl);
+  /* the MSHR is busy until the fill completes */
+  if (mshr)
+    {
+      cp->mshr_allocs++;
+      mshr->baddr = CACHE_BADDR(cp, addr);
+      mshr->ready = repl->ready;
+      mshr->targets = 1;
+    }
 
   if (prefetch == 0) {	/* only regular cache accesses can generate a prefetch */
-  	generate_prefetch(cp, addr);
+  	generate_prefetch(cp, addr, pc, now);
   }
 
   /* return latency of the operation */
@@ -906,7 +3219,12 @@ cache_access(struct cache_t *cp,	/* cache to access */
  cache_hit: /* slow hit handler */
   
   /* **HIT** */
-  if (prefetch == 0) {
+  if (cp->sect_size
+      && sector_miss(cp, cmd, blk, addr, nbytes, now, pc, prefetch))
+    {
+      /* counted as a miss */
+    }
+  else if (prefetch == 0) {
 
      cp->hits++;
 
@@ -919,6 +3237,10 @@ cache_access(struct cache_t *cp,	/* cache to access */
   }
 
 
+  /* first demand reference to a prefetched block */
+  if (prefetch == 0 && (blk->status & CACHE_BLK_PREFETCHED))
+    pf_demand_hit(cp, blk, now);
+
   /* copy data out of cache block, if block exists */
   if (cp->balloc)
     {
@@ -927,16 +3249,24 @@ cache_access(struct cache_t *cp,	/* cache to access */
 
   /* update dirty status */
   if (cmd == Write)
-    blk->status |= CACHE_BLK_DIRTY;
+    {
+      blk->status |= CACHE_BLK_DIRTY;
+      if (cp->sect_size)
+	blk->sect_dirty |= CACHE_SECT_MASK(cp, bofs, nbytes);
+      if (cp->bdi)
+	bdi_refit(cp, addr, now, pc);
+    }
 
-  /* if LRU replacement and this is not the first element of list, reorder */
-  if (blk->way_prev && cp->policy == LRU)
+  /* if LRU replacement and this is not the youngest way, reorder */
+  if (cp->policy == LRU && (cp->stamps || cp->sets[set].ages[way] != 0))
     {
-      /* move this block to head of the way (MRU) list */
-      update_way_list(&cp->sets[set], blk, Head);
+      /* make this block the MRU way */
+      update_way_age(cp, &cp->sets[set], way, Head);
     }
+  else if (CACHE_RRIP_POLICY(cp))
+    rrip_hit(cp, blk);
 
-  /* tag is unchanged, so hash links (if they exist) are still valid */
+  /* tag is unchanged, so the tag array is still valid */
 
   /* record the last block to hit */
   cp->last_tagset = CACHE_TAGSET(cp, addr);
@@ -947,17 +3277,29 @@ cache_access(struct cache_t *cp,	/* cache to access */
     *udata = blk->user_data;
 
   if (prefetch == 0) {	/* only regular cache accesses can generate a prefetch */
-	generate_prefetch(cp, addr);
+	generate_prefetch(cp, addr, pc, now);
   }
 
+  /* an exclusive cache gives the block to the upper level that missed */
+  if (cp->incl == Exclusive && cmd == Read && prefetch == 0)
+    {
+      lat = hit_latency(cp, blk, addr, now, prefetch);
+      cp->excl_dirty = (invalidate_blk(cp, addr) & CACHE_BLK_DIRTY) != 0;
+      return lat;
+    }
 
   /* return first cycle data is available to access */
-  return (int) MAX(cp->hit_latency, (blk->ready - now));
+  return hit_latency(cp, blk, addr, now, prefetch);
 
  cache_fast_hit: /* fast hit handler */
   
   /* **FAST HIT** */
-  if (prefetch == 0) {
+  if (cp->sect_size
+      && sector_miss(cp, cmd, blk, addr, nbytes, now, pc, prefetch))
+    {
+      /* counted as a miss */
+    }
+  else if (prefetch == 0) {
      
      cp->hits++;
 
@@ -970,6 +3312,10 @@ cache_access(struct cache_t *cp,	/* cache to access */
   }
 
 
+  /* first demand reference to a prefetched block */
+  if (prefetch == 0 && (blk->status & CACHE_BLK_PREFETCHED))
+    pf_demand_hit(cp, blk, now);
+
   /* copy data out of cache block, if block exists */
   if (cp->balloc)
     {
@@ -978,11 +3324,19 @@ cache_access(struct cache_t *cp,	/* cache to access */
 
   /* update dirty status */
   if (cmd == Write)
-    blk->status |= CACHE_BLK_DIRTY;
+    {
+      blk->status |= CACHE_BLK_DIRTY;
+      if (cp->sect_size)
+	blk->sect_dirty |= CACHE_SECT_MASK(cp, bofs, nbytes);
+      if (cp->bdi)
+	bdi_refit(cp, addr, now, pc);
+    }
 
   /* this block hit last, no change in the way list */
+  if (CACHE_RRIP_POLICY(cp))
+    rrip_hit(cp, blk);
 
-  /* tag is unchanged, so hash links (if they exist) are still valid */
+  /* tag is unchanged, so the tag array is still valid */
 
   /* get user block data, if requested and it exists */
   if (udata)
@@ -993,11 +3347,19 @@ cache_access(struct cache_t *cp,	/* cache to access */
   cp->last_blk = blk;
 
   if (prefetch == 0) {	/* only regular cache accesses can generate a prefetch */
-     generate_prefetch(cp, addr);
+     generate_prefetch(cp, addr, pc, now);
   }
 
+  /* an exclusive cache gives the block to the upper level that missed */
+  if (cp->incl == Exclusive && cmd == Read && prefetch == 0)
+    {
+      lat = hit_latency(cp, blk, addr, now, prefetch);
+      cp->excl_dirty = (invalidate_blk(cp, addr) & CACHE_BLK_DIRTY) != 0;
+      return lat;
+    }
+
   /* return first cycle data is available to access */
-  return (int) MAX(cp->hit_latency, (blk->ready - now));
+  return hit_latency(cp, blk, addr, now, prefetch);
 }
 
 /* return non-zero if block containing address ADDR is contained in cache
@@ -1007,39 +3369,11 @@ int					/* non-zero if access would hit */
 cache_probe(struct cache_t *cp,		/* cache instance to probe */
 	    md_addr_t addr)		/* address of block to probe */
 {
-  md_addr_t tag = CACHE_TAG(cp, addr);
-  md_addr_t set = CACHE_SET(cp, addr);
-  struct cache_blk_t *blk;
+  md_addr_t set;
 
   /* permissions are checked on cache misses */
 
-  if (cp->hsize)
-  {
-    /* higly-associativity cache, access through the per-set hash tables */
-    int hindex = CACHE_HASH(cp, tag);
-    
-    for (blk=cp->sets[set].hash[hindex];
-	 blk;
-	 blk=blk->hash_next)
-    {	
-      if (blk->tag == tag && (blk->status & CACHE_BLK_VALID))
-	  return TRUE;
-    }
-  }
-  else
-  {
-    /* low-associativity cache, linear search the way list */
-    for (blk=cp->sets[set].way_head;
-	 blk;
-	 blk=blk->way_next)
-    {
-      if (blk->tag == tag && (blk->status & CACHE_BLK_VALID))
-	  return TRUE;
-    }
-  }
-  
-  /* cache block not found */
-  return FALSE;
+  return lookup_way(cp, addr, &set) >= 0;
 }
 
 /* flush the entire cache, returns latency of the operation */
@@ -1047,36 +3381,48 @@ unsigned int				/* latency of the flush operation */
 cache_flush(struct cache_t *cp,		/* cache instance to flush */
 	    tick_t now)			/* time of cache flush */
 {
-  int i, lat = cp->hit_latency; /* min latency to probe cache */
+  int i, age, way, lat = cp->hit_latency; /* min latency to probe cache */
   struct cache_blk_t *blk;
 
   /* blow away the last block to hit */
   cp->last_tagset = 0;
   cp->last_blk = NULL;
 
-  /* no way list updates required because all blocks are being invalidated */
+  /* no age updates required because all blocks are being invalidated,
+     blocks are written back youngest first */
   for (i=0; i<cp->nsets; i++)
     {
-
-      for (blk=cp->sets[i].way_head; blk; blk=blk->way_next)
+      for (age=0; age<cp->assoc; age++)
 	{
+	  way = way_of_age(cp, &cp->sets[i], age);
+	  blk = CACHE_BINDEX(cp, cp->sets[i].blks, way);
 	  if (blk->status & CACHE_BLK_VALID)
 	    {
 	      cp->invalidations++;
 	      blk->status &= ~CACHE_BLK_VALID;
+	      cp->sets[i].tags[way] = CACHE_TAG_INVALID;
 
-	      if (blk->status & CACHE_BLK_DIRTY)
-		{
-		  /* write back the invalidated block */
-          	  cp->writebacks++;
-		  lat += cp->blk_access_fn(Write,
-					   CACHE_MK_BADDR(cp, blk->tag, i),
-					   cp->bsize, blk, now+lat, 0);
-		}
+	      /* the invalidated block leaves the cache like a replaced one */
+	      lat += evict(cp, CACHE_MK_BADDR(cp, blk->tag, i), blk,
+			   (blk->status & CACHE_BLK_DIRTY) != 0, now+lat,
+			   /* no requesting PC */0);
 	    }
 	}
     }
 
+  /* the victim cache is flushed too */
+  for (i=0; i<cp->vc_nentries; i++)
+    {
+      if (cp->vc[i].status & CACHE_BLK_VALID)
+	{
+	  cp->invalidations++;
+	  lat += evict(cp, cp->vc[i].baddr, /* no block */NULL,
+		       (cp->vc[i].status & CACHE_BLK_DIRTY) != 0, now+lat,
+		       /* no requesting PC */0);
+	  cp->vc[i].status = 0;
+	}
+    }
+
   /* return latency of the flush operation */
   return lat;
 }
@@ -1088,55 +3434,42 @@ cache_flush_addr(struct cache_t *cp,	/* cache instance to flush */
 		 md_addr_t addr,	/* address of block to flush */
 		 tick_t now)		/* time of cache flush */
 {
-  md_addr_t tag = CACHE_TAG(cp, addr);
-  md_addr_t set = CACHE_SET(cp, addr);
+  md_addr_t set;
   struct cache_blk_t *blk;
-  int lat = cp->hit_latency; /* min latency to probe cache */
-
-  if (cp->hsize)
-    {
-      /* higly-associativity cache, access through the per-set hash tables */
-      int hindex = CACHE_HASH(cp, tag);
+  struct cache_victim_t *vc;
+  int way, lat = cp->hit_latency; /* min latency to probe cache */
 
-      for (blk=cp->sets[set].hash[hindex];
-	   blk;
-	   blk=blk->hash_next)
-	{
-	  if (blk->tag == tag && (blk->status & CACHE_BLK_VALID))
-	    break;
-	}
-    }
-  else
-    {
-      /* low-associativity cache, linear search the way list */
-      for (blk=cp->sets[set].way_head;
-	   blk;
-	   blk=blk->way_next)
-	{
-	  if (blk->tag == tag && (blk->status & CACHE_BLK_VALID))
-	    break;
-	}
-    }
+  way = lookup_way(cp, addr, &set);
+  blk = way >= 0 ? CACHE_BINDEX(cp, cp->sets[set].blks, way) : NULL;
 
   if (blk)
     {
       cp->invalidations++;
       blk->status &= ~CACHE_BLK_VALID;
+      cp->sets[set].tags[way] = CACHE_TAG_INVALID;
 
       /* blow away the last block to hit */
       cp->last_tagset = 0;
       cp->last_blk = NULL;
 
-      if (blk->status & CACHE_BLK_DIRTY)
-	{
-	  /* write back the invalidated block */
-          cp->writebacks++;
-	  lat += cp->blk_access_fn(Write,
-				   CACHE_MK_BADDR(cp, blk->tag, set),
-				   cp->bsize, blk, now+lat, 0);
-	}
-      /* move this block to tail of the way (LRU) list */
-      update_way_list(&cp->sets[set], blk, Tail);
+      /* the invalidated block leaves the cache like a replaced one */
+      lat += evict(cp, CACHE_MK_BADDR(cp, blk->tag, set), blk,
+		   (blk->status & CACHE_BLK_DIRTY) != 0, now+lat,
+		   /* no requesting PC */0);
+
+      /* make this block the oldest (LRU) way */
+      update_way_age(cp, &cp->sets[set], way, Tail);
+      blk->rrpv = RRPV_DISTANT(cp);
+    }
+  else if (cp->vc_nentries
+	   && (vc = victim_lookup(cp, CACHE_BADDR(cp, addr))) != NULL)
+    {
+      /* the block is in the victim cache */
+      cp->invalidations++;
+      lat += evict(cp, vc->baddr, /* no block */NULL,
+		   (vc->status & CACHE_BLK_DIRTY) != 0, now+lat,
+		   /* no requesting PC */0);
+      vc->status = 0;
     }
 
   /* return latency of the operation */
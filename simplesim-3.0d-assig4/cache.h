@@ -78,37 +78,206 @@
  * physical page address information, etc...
  *
  * The caches implemented by this module provide efficient storage management
- * and fast access for all cache geometries.  When sets become highly
- * associative, a hash table (indexed by address) is allocated for each set
- * in the cache.
+ * and fast access for all cache geometries.  The tags of each set are kept
+ * in a contiguous array that is searched in a single pass (eight tags at a
+ * time when built with -mavx2), and recency is kept as a small age counter
+ * per way rather than as a linked list of blocks.
  *
  * This module also tracks latency of accessing the data cache, each cache has
  * a hit latency defined when instantiated, miss latency is returned by the
- * cache's block access function, the caches may service any number of hits
- * under any number of misses, the calling simulator should limit the number
- * of outstanding misses or the number of hits under misses as per the
- * limitations of the particular microarchitecture being simulated.
+ * cache's block access function.  By default the caches may service any
+ * number of hits under any number of misses.  A cache may instead be given a
+ * bounded set of miss status holding registers (MSHRs) with cache_set_mshr():
+ * a primary miss then needs a free MSHR, stalling until the earliest
+ * outstanding miss completes if none is free, and later accesses to a block
+ * still being filled merge onto its MSHR as secondary misses, stalling until
+ * the fill completes if the MSHR has no free target.  Misses to different
+ * blocks thus complete in the order their fills finish, not the order in
+ * which they were issued.
+ *
+ * Writebacks of dirty blocks are passed to the next level as they happen,
+ * unless the cache is given a bounded write buffer with cache_set_wbuf().
+ * Writebacks then wait in the buffer, which drains them to the next level
+ * one at a time, and cost the cache nothing unless the buffer is full, in
+ * which case the miss stalls until the oldest write completes.  A writeback
+ * of a block still waiting in the buffer is coalesced with it, and block
+ * fills bypass the buffered writes, except that a fill of a block in the
+ * buffer is forwarded from it.
+ *
+ * A cache may keep a small fully associative victim cache of the blocks it
+ * replaces, set up with cache_set_victim().  A miss that finds its block
+ * there swaps it with the block being replaced, one cycle after a hit, and
+ * is counted both as a miss and as a victim hit; blocks leave the cache
+ * only when they leave its victim cache.  cache_set_lower() makes one cache
+ * the next level of another and sets how the lower level holds the blocks
+ * of its upper levels: non-inclusive non-exclusive (the default, each level
+ * is managed on its own), inclusive (a block the lower level gives up is
+ * invalidated in the upper levels, its dirty data kept) or exclusive (the
+ * lower level holds the victims of its upper levels, clean or dirty, and
+ * gives up a block when a demand miss of an upper level finds it there;
+ * prefetches are exempt and may leave a copy in both).
+ *
+ * Sets are indexed by the low bits of the block address unless the cache
+ * is given another index function with cache_set_index(): the index bits
+ * XORed with all higher bits folded onto them, the block address modulo the
+ * largest prime number of sets (leaving the remaining sets unused), or a
+ * skewed-associative organization in which each way hashes the address
+ * with its own XOR function (rotating the folded bits by the way number),
+ * so that blocks that conflict in one way rarely conflict in the others.
+ * Hashed caches keep the whole block address as the tag.  Skewed caches
+ * replace one of the blocks the missing block may go to, one per way, and
+ * order them by a per-block time stamp for LRU and FIFO, since the ages of
+ * a set only order the ways of that set.
+ *
+ * A cache may be sectored with cache_set_sectors(): each block is split into
+ * sectors with their own valid and dirty bits, a miss fetches only the
+ * sectors the access needs (none for a write of whole sectors), a tag hit
+ * that finds a needed sector invalid is a sector miss, and only dirty
+ * sectors are written back.  A cache compressed with cache_set_compress()
+ * stores each block base-delta-immediate (BDI) compressed (Pekhimenko et
+ * al., 2012), in 8 byte segments, and has twice the tags of the blocks its
+ * data array holds uncompressed, so a set holds more blocks the better they
+ * compress; a fill or a write that overflows the data of a set evicts more
+ * blocks, oldest first.  Block contents are taken from the block data of
+ * caches that allocate it, or else from a function that reads the block
+ * from the simulated memory.  Both kinds of cache count the bytes read from
+ * and written to the next level, and sample the bytes of data they hold,
+ * their effective capacity.
+ *
+ * Prefetches generated after demand accesses are either issued at once or,
+ * after cache_set_prefetch(), held in a bounded request queue that is
+ * drained a few requests per demand access or, in a timing simulator that
+ * calls cache_prefetch_tick(), a few requests per cycle.  Prefetched blocks
+ * are marked
+ * until their first demand reference, which yields prefetch accuracy,
+ * coverage and lateness; feedback-directed prefetching (FDP) uses the same
+ * counters to raise or lower the prefetch degree and distance every
+ * interval.  The storage each prefetcher needs is reported in bits, so
+ * prefetchers can be compared at equal hardware budgets.
  *
  * Due to the organization of this cache implementation, the latency of a
  * request cannot be affected by a later request to this module.  As a result,
- * reordering of requests in the memory hierarchy is not possible.
+ * a later request may wait for the MSHRs, write buffer or bus taken by the
+ * requests before it, and with MSHRs may complete before them, but it can
+ * never delay one already accepted.
  */
 
-/* highly associative caches are implemented using a hash table lookup to
-   speed block access, this macro decides if a cache is "highly associative" */
-#define CACHE_HIGHLY_ASSOC(cp)	((cp)->assoc > 4)
+/* tag array value of an invalid way, never equal to a real tag as tags
+   are always shifted right by at least the block offset */
+#define CACHE_TAG_INVALID	((md_addr_t)-1)
 
 /* cache replacement policy */
 enum cache_policy {
   LRU,		/* replace least recently used block (perfect LRU) */
   Random,	/* replace a random block */
-  FIFO		/* replace the oldest block in the set */
+  FIFO,		/* replace the oldest block in the set */
+  NRU,		/* replace a block not recently used (one reference bit) */
+  SRRIP,	/* static re-reference interval prediction */
+  DRRIP,	/* dynamic RRIP, set-dueling between SRRIP and BRRIP */
+  SHiP		/* signature-based hit predictor (PC signatures) over SRRIP */
+};
+
+/* how a cache holds the blocks of the levels above it */
+enum cache_incl {
+  NINE,		/* non-inclusive non-exclusive, no enforcement */
+  Inclusive,	/* holds every block of its upper levels */
+  Exclusive	/* holds no block of its upper levels */
+};
+
+/* how a cache maps block addresses to sets */
+enum cache_index {
+  BitSelect,	/* the low bits of the block address (the default) */
+  XORIndex,	/* the low bits XORed with the folded higher bits */
+  PrimeMod,	/* the block address modulo a prime number of sets */
+  Skewed	/* skewed-associative, a different XOR hash per way */
 };
 
+/* most ways of a skewed cache */
+#define CACHE_MAX_SKEW_WAYS	32
+
+/* sectors per block of a sectored cache, one valid and one dirty bit each */
+#define CACHE_MAX_SECTORS	32
+
+/* BDI compressed caches have CACHE_BDI_TAGS tags per block of data, and
+   allocate data in CACHE_BDI_SEGMENT byte segments */
+#define CACHE_BDI_TAGS		2
+#define CACHE_BDI_SEGMENT	8
+
+/* upper levels one cache may be the next level of, e.g., il1 and dl1 */
+#define CACHE_MAX_UPPERS	4
+
+/* re-reference prediction values (RRPV) used by the RRIP family, NRU is
+   RRIP with a single bit */
+#define CACHE_RRPV_BITS		2
+#define CACHE_RRPV_MAX		((1 << CACHE_RRPV_BITS) - 1)
+#define CACHE_NRU_MAX		1
+
+/* DRRIP set-dueling: one SRRIP and one BRRIP leader set out of every
+   CACHE_DUEL_MOD sets, a CACHE_PSEL_BITS saturating counter picks the
+   policy for the followers, BRRIP inserts at RRPV_MAX-1 once every
+   CACHE_BRRIP_EPSILON fills */
+#define CACHE_DUEL_MOD		32
+#define CACHE_PSEL_BITS		10
+#define CACHE_PSEL_MAX		((1 << CACHE_PSEL_BITS) - 1)
+#define CACHE_BRRIP_EPSILON	32
+
+/* SHiP signature history counter table: 2^CACHE_SHCT_BITS entries of
+   CACHE_SHCT_CTR_MAX-saturating counters indexed by a hashed PC */
+#define CACHE_SHCT_BITS		14
+#define CACHE_SHCT_SIZE		(1 << CACHE_SHCT_BITS)
+#define CACHE_SHCT_CTR_MAX	7
+
+/* non-zero if the replacement policy CP uses the RRPV block state rather
+   than the ordered way chain */
+#define CACHE_RRIP_POLICY(cp)						\
+  ((cp)->policy == NRU || (cp)->policy == SRRIP				\
+   || (cp)->policy == DRRIP || (cp)->policy == SHiP)
+
 
 /* block status values */
 #define CACHE_BLK_VALID		0x00000001	/* block in valid, in use */
 #define CACHE_BLK_DIRTY		0x00000002	/* dirty block */
+#define CACHE_BLK_PREFETCHED	0x00000004	/* filled by a prefetch and not
+						   yet referenced by a demand
+						   access */
+
+/* feedback-directed prefetching (FDP): aggressiveness levels, interval
+   thresholds for prefetch accuracy, lateness and cache pollution, and the
+   size of the filter of blocks evicted by prefetches, in bits */
+#define CACHE_FDP_LEVELS	5
+#define CACHE_FDP_START_LEVEL	3
+#define CACHE_FDP_ACC_HIGH	0.75
+#define CACHE_FDP_ACC_LOW	0.40
+#define CACHE_FDP_LATE		0.01
+#define CACHE_FDP_POLLUTION	0.005
+#define CACHE_PF_FILTER_BITS	4096
+
+/* global history buffer (GHB) PC/DC prefetcher (Nesbit and Smith, 2004):
+   a FIFO of the block addresses referenced, each linked to the previous
+   entry of the same PC, and an index table holding the latest entry of
+   each PC; a prefetch type of -N selects a GHB of N entries with an index
+   table of N entries, the history of a PC is walked at most
+   CACHE_GHB_DEPTH entries deep, and CACHE_GHB_DEGREE prefetches are issued
+   per access unless told otherwise */
+#define CACHE_GHB_DEPTH		16
+#define CACHE_GHB_DEGREE	4
+
+/* GHB entry */
+struct cache_ghb_entry_t
+{
+  md_addr_t bnum;		/* block number referenced, address/bsize */
+  unsigned int link;		/* sequence number of the previous entry of
+				   the same PC */
+  int has_link;			/* is LINK valid? */
+};
+
+/* GHB index table entry */
+struct cache_ghb_index_t
+{
+  md_addr_t pc;			/* PC of the entry, the tag */
+  unsigned int head;		/* sequence number of its latest GHB entry */
+  int valid;			/* is the entry in use? */
+};
 
 /* ECE552 Assignment 4 - BEGIN CODE*/
 /* stride prefetcher */
@@ -146,18 +315,54 @@ struct dcpt_entry {
 };
 /* ECE552 Assignment 4 - END CODE*/
 
+/* miss status holding register, tracks one outstanding block fill */
+struct cache_mshr_t
+{
+  md_addr_t baddr;		/* block address being filled */
+  tick_t ready;			/* time when the fill completes, the MSHR is
+				   free from then on */
+  int targets;			/* accesses waiting on this fill */
+};
+
+/* write buffer entry, holds one writeback until it has drained */
+struct cache_wbuf_t
+{
+  md_addr_t baddr;		/* block address written back */
+  tick_t issue;			/* time when the write leaves for the next
+				   level, it may coalesce until then */
+  tick_t ready;			/* time when the write completes, the entry
+				   is free from then on */
+};
+
+/* victim cache entry, a block replaced from the cache */
+struct cache_victim_t
+{
+  md_addr_t baddr;		/* block address */
+  unsigned int status;		/* CACHE_BLK_VALID, CACHE_BLK_DIRTY and
+				   CACHE_BLK_PREFETCHED */
+  counter_t stamp;		/* time of insertion, the oldest entry is
+				   replaced first */
+};
+
+/* queued prefetch request */
+struct cache_pf_req_t
+{
+  md_addr_t baddr;		/* block to prefetch */
+  md_addr_t pc;			/* PC of the access that triggered it */
+};
+
 /* cache block (or line) definition */
 struct cache_blk_t
 {
-  struct cache_blk_t *way_next;	/* next block in the ordered way chain, used
-				   to order blocks for replacement */
-  struct cache_blk_t *way_prev;	/* previous block in the order way chain */
-  struct cache_blk_t *hash_next;/* next block in the hash bucket chain, only
-				   used in highly-associative caches */
-  /* since hash table lists are typically small, there is no previous
-     pointer, deletion requires a trip through the hash table bucket list */
   md_addr_t tag;		/* data block tag value */
   unsigned int status;		/* block status, see CACHE_BLK_* defs above */
+  unsigned char rrpv;		/* re-reference prediction value, NRU/RRIP */
+  unsigned char reref;		/* SHiP: block was re-referenced since fill */
+  unsigned short sig;		/* SHiP: signature of the filling PC */
+  unsigned short csize;		/* BDI: compressed size in bytes */
+  unsigned int sect_valid;	/* sectored: valid sectors, bit I for
+				   sector I */
+  unsigned int sect_dirty;	/* sectored: dirty sectors */
   tick_t ready;		/* time when block will be accessible, field
 				   is set when a miss fetch is initiated */
   byte_t *user_data;		/* pointer to user defined data, e.g.,
@@ -172,14 +377,13 @@ struct cache_blk_t
 /* cache set definition (one or more blocks sharing the same set index) */
 struct cache_set_t
 {
-
-  struct cache_blk_t **hash;	/* hash table: for fast access w/assoc, NULL
-				   for low-assoc caches */
-  struct cache_blk_t *way_head;	/* head of way list */
-  struct cache_blk_t *way_tail;	/* tail pf way list */
+  md_addr_t *tags;		/* tag of each way, contiguous for a fast
+				   search, CACHE_TAG_INVALID if not valid */
+  unsigned short *ages;		/* recency (LRU) or insertion (FIFO) age of
+				   each way, 0 is the youngest way and
+				   assoc-1 the next victim */
   struct cache_blk_t *blks;	/* cache blocks, allocated sequentially, so
-				   this pointer can also be used for random
-				   access to cache blocks */
+				   way I is block I of this array */
 };
 
 /* cache definition */
@@ -211,10 +415,10 @@ struct cache_t
 		     int bsize,			/* size of the cache block */
 		     struct cache_blk_t *blk,	/* ptr to cache block struct */
 		     tick_t now,		/* when fetch was initiated */
+		     md_addr_t pc,		/* PC of the requesting instruction */
 		     int prefetch);		/* 1 if the access is a prefetch, 0 if it is not */
 
   /* derived data, for fast decoding */
-  int hsize;			/* cache set hash table size */
   md_addr_t blk_mask;
   int set_shift;
   md_addr_t set_mask;		/* use *after* shift */
@@ -222,11 +426,109 @@ struct cache_t
   md_addr_t tag_mask;		/* use *after* shift */
   md_addr_t tagset_mask;	/* used for fast hit detection */
 
+  /* set index function, see cache_set_index() */
+  enum cache_index index;	/* set index function */
+  int index_bits;		/* log2 of the number of sets */
+  int index_prime;		/* sets used by PrimeMod indexing */
+  counter_t *stamps;		/* Skewed: last use (LRU) or fill (FIFO)
+				   of each way of each set */
+  counter_t stamp_clock;	/* Skewed: stamps handed out so far */
+
+  /* sectored blocks, see cache_set_sectors(), not sectored if SECT_SIZE
+     is zero */
+  int sect_size;		/* sector size in bytes */
+  int sect_shift;		/* log2 of SECT_SIZE */
+  unsigned int sect_all;	/* mask of all the sectors of a block */
+
+  /* BDI compression, see cache_set_compress() */
+  int bdi;			/* compressed? */
+  int data_ways;		/* blocks of uncompressed data per set */
+  void (*data_fn)(md_addr_t baddr,	/* block address */
+		  byte_t *buf,		/* buffer for the block */
+		  int bsize);		/* block size */
+  byte_t *bdi_buf;		/* block read with DATA_FN */
+
+  /* effective capacity sampling, every NSETS * ASSOC accesses */
+  counter_t cap_clock;		/* accesses since the last sample */
+
   /* ECE552 Assignment 4 - BEGIN CODE*/
   int dcpt_size;            // delta table size
 	struct dcpt_entry *dcpt;  // delta table instantiation
   /* ECE552 Assignment 4 - END CODE*/
 
+  /* stride prefetcher reference prediction table */
+  int rpt_size;			/* number of RPT entries */
+  struct rpt *rpt;		/* RPT of this cache */
+
+  /* GHB PC/DC prefetcher, entry SEQ of the history is at SEQ % GHB_SIZE */
+  int ghb_size;			/* GHB and index table entries */
+  struct cache_ghb_entry_t *ghb;/* global history buffer */
+  struct cache_ghb_index_t *ghb_index; /* index table */
+  unsigned int ghb_seq;		/* sequence number of the next GHB entry */
+
+  /* prefetcher state, in bits */
+  int pf_storage_bits;
+
+  /* replacement policy state */
+  int psel;			/* DRRIP policy selector, high means BRRIP */
+  unsigned char *shct;		/* SHiP signature history counter table */
+
+  /* miss status holding registers, unlimited if MSHR_NENTRIES is zero */
+  int mshr_nentries;		/* number of MSHRs */
+  int mshr_ntargets;		/* accesses that may wait on one MSHR */
+  struct cache_mshr_t *mshrs;	/* MSHR file */
+
+  /* write buffer, writebacks go straight to the next level if
+     WBUF_NENTRIES is zero */
+  int wbuf_nentries;		/* number of write buffer entries */
+  struct cache_wbuf_t *wbuf;	/* write buffer */
+  tick_t wbuf_drain;		/* time when the buffer may issue its next
+				   write to the next level */
+
+  /* victim cache, none if VC_NENTRIES is zero */
+  int vc_nentries;		/* number of victim cache entries */
+  struct cache_victim_t *vc;	/* victim cache */
+  counter_t vc_stamp;		/* insertions so far */
+
+  /* multi-level hierarchy, see cache_set_lower() */
+  struct cache_t *lower;	/* next level, if linked */
+  enum cache_incl incl;		/* how this cache holds upper level blocks */
+  int nuppers;			/* number of upper levels */
+  struct cache_t *uppers[CACHE_MAX_UPPERS]; /* upper levels */
+  int excl_dirty;		/* was the block an exclusive cache last gave
+				   to an upper level dirty? */
+
+  /* accesses carry the cycle of a timing simulator, see cache_set_timed() */
+  int timed;			/* accessed by a timing simulator? */
+
+  /* prefetch request queue, prefetchers issue their requests directly to
+     the cache if PF_QSIZE is zero */
+  int pf_qsize;			/* capacity of the prefetch queue */
+  int pf_bandwidth;		/* queued requests issued per demand access,
+				   or per cycle if timed */
+  struct cache_pf_req_t *pf_queue; /* circular queue of requests */
+  int pf_head;			/* oldest queued request */
+  int pf_num;			/* number of queued requests */
+  tick_t pf_tick;		/* last cycle the queue was drained, if timed */
+
+  /* prefetch aggressiveness, prefetchers issue PF_DEGREE requests starting
+     PF_DISTANCE predictions ahead of the access, adjusted every interval
+     when PF_THROTTLE is set */
+  int pf_degree;		/* requests per prefetch trigger */
+  int pf_distance;		/* predictions to look ahead */
+  int pf_throttle;		/* adjust aggressiveness with FDP? */
+  int pf_level;			/* FDP aggressiveness level, 1 to
+				   CACHE_FDP_LEVELS */
+  unsigned char *pf_filter;	/* bit vector of blocks evicted by prefetches */
+
+  /* FDP interval counters, halved at the end of each interval */
+  counter_t fdp_evictions;	/* evictions in this interval */
+  counter_t fdp_issued;		/* prefetch fills */
+  counter_t fdp_useful;		/* prefetched blocks used by demand accesses */
+  counter_t fdp_late;		/* prefetches that did not hide the miss */
+  counter_t fdp_pollution;	/* demand misses caused by prefetches */
+  counter_t fdp_misses;		/* demand misses */
+
   /* bus resource */
   tick_t bus_free;		/* time when bus to next level of cache is
 				   free, NOTE: the bus model assumes only a
@@ -250,6 +552,34 @@ struct cache_t
 
   counter_t prefetch_hits;	/* total number of prefetch accesses that are hits */ 
   counter_t prefetch_misses;	/* total number of prefetch accesses that miss in this cache */
+  counter_t prefetch_useful;	/* prefetched blocks referenced by a demand access */
+  counter_t prefetch_unused;	/* prefetched blocks evicted before any use */
+  counter_t prefetch_late;	/* demand hits on prefetched blocks still in flight */
+  counter_t prefetch_squashed;	/* queued prefetches overtaken by a demand miss */
+  counter_t prefetch_dropped;	/* queued prefetches dropped, queue full */
+  counter_t prefetch_pollution;	/* demand misses to blocks evicted by a prefetch */
+
+  counter_t mshr_allocs;	/* primary misses given an MSHR */
+  counter_t mshr_merges;	/* secondary misses merged onto an MSHR */
+  counter_t mshr_full;		/* primary misses stalled, no free MSHR */
+  counter_t mshr_target_full;	/* secondary misses stalled, no free target */
+  counter_t mshr_stall_cycles;	/* cycles lost to MSHR structural stalls */
+
+  counter_t wbuf_writes;	/* writebacks given a write buffer entry */
+  counter_t wbuf_coalesced;	/* writebacks coalesced with a buffered one */
+  counter_t wbuf_forwards;	/* fills forwarded from the write buffer */
+  counter_t wbuf_full;		/* writebacks stalled, write buffer full */
+  counter_t wbuf_stall_cycles;	/* cycles lost to a full write buffer */
+
+  counter_t victim_hits;	/* misses that found their block in the
+				   victim cache */
+
+  counter_t fill_bytes;		/* bytes read from the next level */
+  counter_t wb_bytes;		/* bytes written back to the next level */
+  counter_t sector_misses;	/* tag hits on invalid sectors */
+  counter_t cap_samples;	/* effective capacity samples */
+  counter_t cap_bytes;		/* sum of the bytes of data held */
+  counter_t cap_stored;		/* sum of the bytes the data takes up */
 
 
 
@@ -259,6 +589,8 @@ struct cache_t
 
   /* data blocks */
   byte_t *data;			/* pointer to data blocks allocation */
+  md_addr_t *tags;		/* pointer to tag array allocation */
+  unsigned short *ages;		/* pointer to age array allocation */
 
   /* NOTE: this is a variable-size tail array, this must be the LAST field
      defined in this structure! */
@@ -278,10 +610,120 @@ cache_create(char *name,		/* name of the cache */
 	     unsigned int (*blk_access_fn)(enum mem_cmd cmd,
 					   md_addr_t baddr, int bsize,
 					   struct cache_blk_t *blk,
-					   tick_t now, int prefetch),
+					   tick_t now, md_addr_t pc,
+					   int prefetch),
 	     unsigned int hit_latency,/* latency in cycles for a hit */
 	     int prefetch_type);      /* the type of the prefetcher for this cache */	
 
+/* give cache CP NENTRIES miss status holding registers, each of which may
+   hold NTARGETS accesses, zero NENTRIES leaves the cache with unlimited
+   outstanding misses */
+void
+cache_set_mshr(struct cache_t *cp,	/* cache instance */
+	       int nentries,		/* number of MSHRs, 0 for unlimited */
+	       int ntargets);		/* targets per MSHR */
+
+/* give cache CP a write buffer of NENTRIES writebacks, zero NENTRIES
+   writes blocks back to the next level as they are replaced */
+void
+cache_set_wbuf(struct cache_t *cp,	/* cache instance */
+	       int nentries);		/* write buffer entries, 0 for none */
+
+/* give cache CP a fully associative victim cache of NENTRIES blocks, zero
+   NENTRIES evicts replaced blocks at once */
+void
+cache_set_victim(struct cache_t *cp,	/* cache instance */
+		 int nentries);		/* victim cache entries, 0 for none */
+
+/* index the sets of cache CP with INDEX, before its first access */
+void
+cache_set_index(struct cache_t *cp,	/* cache instance */
+		enum cache_index index);/* set index function */
+
+/* parse set index function, i.e., {bits|xor|prime|skew} */
+enum cache_index			/* set index function */
+cache_str2index(char *s);		/* set index function as a string */
+
+/* split the blocks of cache CP into sectors of SECT_SIZE bytes, before its
+   first access, zero SECT_SIZE leaves whole blocks; a sector size equal to
+   the block size keeps whole blocks but counts the bytes transferred and
+   the effective capacity */
+void
+cache_set_sectors(struct cache_t *cp,	/* cache instance */
+		  int sect_size);	/* sector size in bytes, 0 for none */
+
+/* compress the blocks of cache CP with BDI, before its first access, giving
+   it CACHE_BDI_TAGS times its ways of tags, blocks are read with DATA_FN
+   unless the cache allocates block data */
+void
+cache_set_compress(struct cache_t *cp,	/* cache instance */
+		   void (*data_fn)(md_addr_t baddr,
+				   byte_t *buf, int bsize));
+
+/* make cache LOWER the next level below cache UPPER, holding the blocks of
+   its upper levels as POLICY says, the block access function of UPPER must
+   access LOWER */
+void
+cache_set_lower(struct cache_t *upper,	/* upper level cache */
+		struct cache_t *lower,	/* next level cache */
+		enum cache_incl policy);/* inclusion policy of LOWER */
+
+/* parse inclusion policy, i.e., {nine|incl|excl} */
+enum cache_incl				/* inclusion policy */
+cache_str2incl(char *s);		/* inclusion policy as a string */
+
+/* give cache CP a prefetch request queue of QSIZE entries, of which
+   BANDWIDTH are issued on each demand access, or on each cycle once
+   cache_set_timed() is called, zero QSIZE issues prefetches
+   as soon as they are generated; a non-zero DEGREE sets the requests per
+   prefetch trigger, zero keeps the prefetcher's own; a non-zero THROTTLE
+   adjusts the prefetch degree and distance with feedback-directed
+   prefetching */
+void
+cache_set_prefetch(struct cache_t *cp,	/* cache instance */
+		   int qsize,		/* prefetch queue entries, 0 for none */
+		   int bandwidth,	/* requests issued per access or cycle */
+		   int degree,		/* requests per trigger, 0 for default */
+		   int throttle);	/* enable FDP throttling? */
+
+/* mark cache CP as accessed by a timing simulator: accesses carry the cycle
+   they are made in, so a demand hit may find a prefetch still in flight,
+   and the prefetch queue is drained by cache_prefetch_tick() rather than on
+   demand accesses; functional simulators access everything at time zero */
+void
+cache_set_timed(struct cache_t *cp);	/* cache instance */
+
+/* issue the queued prefetches of timed cache CP for every cycle up to NOW
+   since the last call, including cycles the simulator skipped */
+void
+cache_prefetch_tick(struct cache_t *cp,	/* cache instance */
+		    tick_t now);	/* time of access */
+
+/* create an empty cache of the same organization, policies, MSHRs, write
+   buffer, victim cache and prefetch settings as CP, not linked to any other
+   level, sharing its block access function */
+struct cache_t *			/* pointer to cache created */
+cache_clone(struct cache_t *cp);	/* cache instance to copy */
+
+/* add the stats of cache SRC into those of cache CP */
+void
+cache_merge_stats(struct cache_t *cp,	/* cache instance */
+		  struct cache_t *src);	/* cache whose stats are added */
+
+/* write the contents of cache CP to checkpoint stream FD: the tags, status
+   and replacement state of its blocks, its victim cache, and the tables of
+   its replacement policy and prefetcher */
+void
+cache_write_chkpt(struct cache_t *cp,	/* cache instance */
+		  FILE *fd);		/* stream to write to */
+
+/* restore the contents of cache CP from checkpoint stream FD, as written by
+   cache_write_chkpt() for a cache of the same organization, returns FALSE
+   if the stream holds no more checkpoint terms */
+int					/* cache contents restored? */
+cache_read_chkpt(struct cache_t *cp,	/* cache instance */
+		 FILE *fd);		/* stream to read */
+
 /* parse policy */
 enum cache_policy			/* replacement policy enum */
 cache_char2policy(char c);		/* replacement policy as a char */
@@ -305,24 +747,33 @@ cache_stats(struct cache_t *cp,		/* cache instance */
 void cache_stats(struct cache_t *cp, FILE *stream);
 
 /* figure out what type of prefetcher is used by this cache and
-   call the appropriate function to generate the prefetch (e.g., next_line_prefetcher) */
+   call the appropriate function to generate the prefetch (e.g., next_line_prefetcher),
+   PC is that of the instruction whose access to ADDR triggers the prefetch */
 
-void generate_prefetch(struct cache_t *cp, md_addr_t addr);
+void generate_prefetch(struct cache_t *cp, md_addr_t addr, md_addr_t pc, tick_t now);
 
 /* Next Line Prefetcher */
-void next_line_prefetcher(struct cache_t *cp, md_addr_t addr);
+void next_line_prefetcher(struct cache_t *cp, md_addr_t addr, md_addr_t pc, tick_t now);
 
 /* Stride Prefetcher */
-void stride_prefetcher(struct cache_t *cp, md_addr_t addr);
+void stride_prefetcher(struct cache_t *cp, md_addr_t addr, md_addr_t pc, tick_t now);
 
 /* Opend Ended Prefetcher */
-void open_ended_prefetcher(struct cache_t *cp, md_addr_t addr);
+void open_ended_prefetcher(struct cache_t *cp, md_addr_t addr, md_addr_t pc, tick_t now);
+
+/* GHB PC/DC prefetcher, PC is that of the instruction accessing ADDR */
+void
+ghb_prefetcher(struct cache_t *cp,	/* cache instance */
+	       md_addr_t addr,		/* address accessed */
+	       md_addr_t pc,		/* PC of the accessing instruction */
+	       tick_t now);		/* time of access */
 
 /* access a cache, perform a CMD operation on cache CP at address ADDR,
    places NBYTES of data at *P, returns latency of operation if initiated
    at NOW, places pointer to block user data in *UDATA, *P is untouched if
    cache blocks are not allocated (!CP->BALLOC), UDATA should be NULL if no
-   user data is attached to blocks */
+   user data is attached to blocks; PC, the PC of the instruction making the
+   access or zero if unknown, trains PC-indexed prefetchers and policies */
 unsigned int				/* latency of access in cycles */
 cache_access(struct cache_t *cp,	/* cache to access */
 	     enum mem_cmd cmd,		/* access type, Read or Write */
@@ -332,22 +783,23 @@ cache_access(struct cache_t *cp,	/* cache to access */
 	     tick_t now,		/* time of access */
 	     byte_t **udata,		/* for return of user data ptr */
 	     md_addr_t *repl_addr,	/* for address of replaced block */
+	     md_addr_t pc,		/* PC of the requesting instruction */
 	     int prefetch);		/* if 1 the access is a prefetch, if 0 it is a regular cache access */
 
 /* cache access functions, these are safe, they check alignment and
    permissions */
-#define cache_double(cp, cmd, addr, p, now, udata, prefetch)	\
-  cache_access(cp, cmd, addr, p, sizeof(double), now, udata, prefetch)
-#define cache_float(cp, cmd, addr, p, now, udata, prefetch)	\
-  cache_access(cp, cmd, addr, p, sizeof(float), now, udata, prefetch)
-#define cache_dword(cp, cmd, addr, p, now, udata, prefetch)	\
-  cache_access(cp, cmd, addr, p, sizeof(long long), now, udata, prefetch)
-#define cache_word(cp, cmd, addr, p, now, udata, prefetch)	\
-  cache_access(cp, cmd, addr, p, sizeof(int), now, udata, prefetch)
-#define cache_half(cp, cmd, addr, p, now, udata, prefetch)	\
-  cache_access(cp, cmd, addr, p, sizeof(short), now, udata, prefetch)
-#define cache_byte(cp, cmd, addr, p, now, udata, prefetch)	\
-  cache_access(cp, cmd, addr, p, sizeof(char), now, udata, prefetch)
+#define cache_double(cp, cmd, addr, p, now, udata, pc, prefetch)	\
+  cache_access(cp, cmd, addr, p, sizeof(double), now, udata, NULL, pc, prefetch)
+#define cache_float(cp, cmd, addr, p, now, udata, pc, prefetch)	\
+  cache_access(cp, cmd, addr, p, sizeof(float), now, udata, NULL, pc, prefetch)
+#define cache_dword(cp, cmd, addr, p, now, udata, pc, prefetch)	\
+  cache_access(cp, cmd, addr, p, sizeof(long long), now, udata, NULL, pc, prefetch)
+#define cache_word(cp, cmd, addr, p, now, udata, pc, prefetch)	\
+  cache_access(cp, cmd, addr, p, sizeof(int), now, udata, NULL, pc, prefetch)
+#define cache_half(cp, cmd, addr, p, now, udata, pc, prefetch)	\
+  cache_access(cp, cmd, addr, p, sizeof(short), now, udata, NULL, pc, prefetch)
+#define cache_byte(cp, cmd, addr, p, now, udata, pc, prefetch)	\
+  cache_access(cp, cmd, addr, p, sizeof(char), now, udata, NULL, pc, prefetch)
 
 /* return non-zero if block containing address ADDR is contained in cache
    CP, this interface is used primarily for debugging and asserting cache
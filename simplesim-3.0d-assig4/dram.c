@@ -0,0 +1,368 @@
+/* dram.c - DRAM controller and device timing model routines */
+
+/* SimpleScalar(TM) Tool Suite
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ * All Rights Reserved. 
+ * 
+ * THIS IS A LEGAL DOCUMENT, BY USING SIMPLESCALAR,
+ * YOU ARE AGREEING TO THESE TERMS AND CONDITIONS.
+ * 
+ * No portion of this work may be used by any commercial entity, or for any
+ * commercial purpose, without the prior, written permission of SimpleScalar,
+ * LLC (info@simplescalar.com). Nonprofit and noncommercial use is permitted
+ * as described below.
+ * 
+ * 1. SimpleScalar is provided AS IS, with no warranty of any kind, express
+ * or implied. The user of the program accepts full responsibility for the
+ * application of the program and the use of any results.
+ * 
+ * 2. Nonprofit and noncommercial use is encouraged. SimpleScalar may be
+ * downloaded, compiled, executed, copied, and modified solely for nonprofit,
+ * educational, noncommercial research, and noncommercial scholarship
+ * purposes provided that this notice in its entirety accompanies all copies.
+ * Copies of the modified software can be delivered to persons who use it
+ * solely for nonprofit, educational, noncommercial research, and
+ * noncommercial scholarship purposes provided that this notice in its
+ * entirety accompanies all copies.
+ * 
+ * 3. ALL COMMERCIAL USE, AND ALL USE BY FOR PROFIT ENTITIES, IS EXPRESSLY
+ * PROHIBITED WITHOUT A LICENSE FROM SIMPLESCALAR, LLC (info@simplescalar.com).
+ * 
+ * 4. No nonprofit user may place any restrictions on the use of this software,
+ * including as modified by the user, by any other authorized user.
+ * 
+ * 5. Noncommercial and nonprofit users may distribute copies of SimpleScalar
+ * in compiled or executable form as set forth in Section 2, provided that
+ * either: (A) it is accompanied by the corresponding machine-readable source
+ * code, or (B) it is accompanied by a written offer, with no time limit, to
+ * give anyone a machine-readable copy of the corresponding source code in
+ * return for reimbursement of the cost of distribution. This written offer
+ * must permit verbatim duplication by anyone, or (C) it is distributed by
+ * someone who received only the executable form, and is accompanied by a
+ * copy of the written offer of source code.
+ * 
+ * 6. SimpleScalar was developed by Todd M. Austin, Ph.D. The tool suite is
+ * currently maintained by SimpleScalar LLC (info@simplescalar.com). US Mail:
+ * 2395 Timbercrest Court, Ann Arbor, MI 48105.
+ * 
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "host.h"
+#include "misc.h"
+#include "machine.h"
+#include "memory.h"
+#include "stats.h"
+#include "dram.h"
+
+/* create a DRAM of NCHANNELS channels of NRANKS ranks of NBANKS banks with
+   ROW_SIZE byte rows, all powers of two, the given timings, QSIZE request
+   queue entries per channel, and BUS_WIDTH byte buses that take
+   TRANSFER_LAT cycles per transfer */
+struct dram_t *				/* DRAM */
+dram_create(char *name,			/* name of the DRAM */
+	    int nchannels,		/* number of channels */
+	    int nranks,			/* ranks per channel */
+	    int nbanks,			/* banks per rank */
+	    int row_size,		/* row buffer size in bytes */
+	    int t_rcd,			/* activate to column access */
+	    int t_cas,			/* column access to data */
+	    int t_rp,			/* precharge to activate */
+	    int qsize,			/* request queue entries per channel */
+	    int bus_width,		/* data bus width in bytes */
+	    int transfer_lat)		/* cycles per bus transfer */
+{
+  struct dram_t *dram;
+  int i;
+
+  /* check all DRAM parameters */
+  if (nchannels <= 0 || (nchannels & (nchannels-1)) != 0)
+    fatal("number of DRAM channels `%d' must be a positive power of two",
+	  nchannels);
+  if (nranks <= 0 || (nranks & (nranks-1)) != 0)
+    fatal("number of DRAM ranks `%d' must be a positive power of two",
+	  nranks);
+  if (nbanks <= 0 || (nbanks & (nbanks-1)) != 0)
+    fatal("number of DRAM banks `%d' must be a positive power of two",
+	  nbanks);
+  if (row_size < 64 || (row_size & (row_size-1)) != 0)
+    fatal("DRAM row size `%d' must be a power of two of at least 64 bytes",
+	  row_size);
+  if (t_rcd < 0 || t_cas < 0 || t_rp < 0)
+    fatal("DRAM timings must be non-negative");
+  if (qsize < 1)
+    fatal("DRAM request queue size `%d' must be at least one", qsize);
+  if (bus_width < 1 || (bus_width & (bus_width-1)) != 0)
+    fatal("DRAM bus width `%d' must be a positive power of two", bus_width);
+  if (transfer_lat < 1)
+    fatal("DRAM transfer latency `%d' must be at least one cycle",
+	  transfer_lat);
+
+  dram = (struct dram_t *)calloc(1, sizeof(struct dram_t));
+  if (!dram)
+    fatal("out of virtual memory");
+
+  dram->name = mystrdup(name);
+  dram->nchannels = nchannels;
+  dram->nranks = nranks;
+  dram->nbanks = nbanks;
+  dram->row_size = row_size;
+  dram->t_rcd = t_rcd;
+  dram->t_cas = t_cas;
+  dram->t_rp = t_rp;
+  dram->qsize = qsize;
+  dram->bus_width = bus_width;
+  dram->transfer_lat = transfer_lat;
+
+  dram->col_shift = log_base2(row_size);
+  dram->chan_shift = log_base2(nchannels);
+  dram->bank_shift = log_base2(nbanks);
+  dram->rank_shift = log_base2(nranks);
+
+  dram->channels = (struct dram_channel_t *)
+    calloc(nchannels, sizeof(struct dram_channel_t));
+  dram->banks = (struct dram_bank_t *)
+    calloc(nchannels * nranks * nbanks, sizeof(struct dram_bank_t));
+  if (!dram->channels || !dram->banks)
+    fatal("out of virtual memory");
+  for (i=0; i < nchannels; i++)
+    {
+      dram->channels[i].queue = (struct dram_req_t *)
+	calloc(qsize, sizeof(struct dram_req_t));
+      if (!dram->channels[i].queue)
+	fatal("out of virtual memory");
+    }
+
+  return dram;
+}
+
+/* retire the requests of channel CH that have completed by time NOW */
+static void
+retire_reqs(struct dram_channel_t *ch,	/* DRAM channel */
+	    tick_t now)			/* current time */
+{
+  int i;
+
+  for (i=0; i < ch->nreqs; )
+    {
+      if (ch->queue[i].finish <= now)
+	ch->queue[i] = ch->queue[--ch->nreqs];
+      else
+	i++;
+    }
+}
+
+/* find the earliest time no earlier than EARLIEST that channel CH's data bus
+   is free for BURST cycles */
+static tick_t
+bus_slot(struct dram_channel_t *ch,	/* DRAM channel */
+	 tick_t earliest,		/* earliest start of transfer */
+	 int burst)			/* cycles of transfer */
+{
+  tick_t start = earliest;
+  int i, moved;
+
+  do {
+    moved = FALSE;
+    for (i=0; i < ch->nreqs; i++)
+      {
+	if (start < ch->queue[i].finish
+	    && ch->queue[i].data_start < start + burst)
+	  {
+	    /* overlaps this transfer, try just after it */
+	    start = ch->queue[i].finish;
+	    moved = TRUE;
+	  }
+      }
+  } while (moved);
+
+  return start;
+}
+
+/* access NBYTES of DRAM at ADDR at time NOW, returns the latency until the
+   last byte has been transferred */
+unsigned int				/* latency of access in cycles */
+dram_access(struct dram_t *dram,	/* DRAM */
+	    enum mem_cmd cmd,		/* Read or Write */
+	    md_addr_t addr,		/* address of access */
+	    int nbytes,			/* number of bytes to access */
+	    tick_t now)			/* time of access */
+{
+  struct dram_channel_t *ch;
+  struct dram_bank_t *bank;
+  md_addr_t x = addr >> dram->col_shift;
+  int chan, bnum, rank, burst, i;
+  tick_t t = now, cas, data_start, finish;
+
+  /* decode the address, from the least significant bits up: column,
+     channel, bank, rank, row */
+  chan = x & (dram->nchannels - 1);
+  x >>= dram->chan_shift;
+  bnum = x & (dram->nbanks - 1);
+  x >>= dram->bank_shift;
+  rank = x & (dram->nranks - 1);
+  x >>= dram->rank_shift;
+
+  ch = &dram->channels[chan];
+  bank = &dram->banks[(chan * dram->nranks + rank) * dram->nbanks + bnum];
+
+  /* wait for a free request queue entry */
+  retire_reqs(ch, t);
+  if (ch->nreqs >= dram->qsize)
+    {
+      tick_t first = ch->queue[0].finish;
+
+      for (i=1; i < ch->nreqs; i++)
+	first = MIN(first, ch->queue[i].finish);
+      dram->queue_full++;
+      dram->queue_cycles += first - t;
+      t = first;
+      retire_reqs(ch, t);
+    }
+
+  burst = ((nbytes + dram->bus_width - 1) / dram->bus_width)
+    * dram->transfer_lat;
+
+  if (bank->row_valid && bank->row == x)
+    {
+      /* row hit, column access once the row is open */
+      dram->row_hits++;
+      cas = MAX(t, bank->ready);
+      bank->last_cas = MAX(bank->last_cas, cas);
+    }
+  else if (bank->prev_valid && bank->prev_row == x
+	   && MAX(t, bank->prev_ready) < bank->prev_until)
+    {
+      /* hit on the row that an older request is about to close, serve it
+	 first, it fits before the precharge */
+      dram->row_hits++;
+      dram->row_hits_first++;
+      cas = MAX(t, bank->prev_ready);
+    }
+  else if (!bank->row_valid)
+    {
+      /* closed bank, activate the row */
+      dram->row_misses++;
+      bank->row_valid = TRUE;
+      bank->row = x;
+      bank->ready = t + dram->t_rcd;
+      bank->last_cas = cas = bank->ready;
+    }
+  else
+    {
+      /* row conflict, precharge after the last column access to the open
+	 row, then activate the new one; the precharge is put off for as long
+	 as the data would wait for the bus anyway, leaving the open row to
+	 any row hits that arrive meanwhile */
+      tick_t pre = MAX(t, bank->last_cas);
+
+      data_start = bus_slot(ch, pre + dram->t_rp + dram->t_rcd + dram->t_cas,
+			    burst);
+      pre = data_start - (dram->t_rp + dram->t_rcd + dram->t_cas);
+
+      dram->row_conflicts++;
+      bank->prev_valid = TRUE;
+      bank->prev_row = bank->row;
+      bank->prev_ready = bank->ready;
+      bank->prev_until = pre;
+      bank->row = x;
+      bank->ready = pre + dram->t_rp + dram->t_rcd;
+      bank->last_cas = cas = bank->ready;
+    }
+
+  /* transfer the data on the channel bus, in the first free slot */
+  data_start = bus_slot(ch, cas + dram->t_cas, burst);
+  finish = data_start + burst;
+
+  ch->queue[ch->nreqs].data_start = data_start;
+  ch->queue[ch->nreqs].finish = finish;
+  ch->nreqs++;
+
+  if (cmd == Read)
+    dram->reads++;
+  else
+    dram->writes++;
+  dram->bus_cycles += burst;
+  dram->total_lat += finish - now;
+
+  return (unsigned int)(finish - now);
+}
+
+/* print the DRAM configuration */
+void
+dram_config(struct dram_t *dram,	/* DRAM */
+	    FILE *stream)		/* output stream */
+{
+  fprintf(stream,
+	  "DRAM: %s: %d channel(s) x %d rank(s) x %d bank(s), "
+	  "%d byte rows\n",
+	  dram->name, dram->nchannels, dram->nranks, dram->nbanks,
+	  dram->row_size);
+  fprintf(stream,
+	  "DRAM: %s: tRCD %d, tCAS %d, tRP %d, %d queue entries/channel, "
+	  "%d byte bus, %d cycles/transfer\n",
+	  dram->name, dram->t_rcd, dram->t_cas, dram->t_rp, dram->qsize,
+	  dram->bus_width, dram->transfer_lat);
+}
+
+/* register the DRAM stats */
+void
+dram_reg_stats(struct dram_t *dram,	/* DRAM */
+	       struct stat_sdb_t *sdb)	/* stats database */
+{
+  char buf[512], buf1[512], *name = dram->name;
+
+  sprintf(buf, "%s.reads", name);
+  stat_reg_counter(sdb, buf, "total number of block reads",
+		   &dram->reads, 0, NULL);
+  sprintf(buf, "%s.writes", name);
+  stat_reg_counter(sdb, buf, "total number of block writes",
+		   &dram->writes, 0, NULL);
+  sprintf(buf, "%s.accesses", name);
+  sprintf(buf1, "%s.reads + %s.writes", name, name);
+  stat_reg_formula(sdb, buf, "total number of accesses", buf1, "%12.0f");
+  sprintf(buf, "%s.row_hits", name);
+  stat_reg_counter(sdb, buf, "total number of row buffer hits",
+		   &dram->row_hits, 0, NULL);
+  sprintf(buf, "%s.row_misses", name);
+  stat_reg_counter(sdb, buf, "total number of accesses to a closed bank",
+		   &dram->row_misses, 0, NULL);
+  sprintf(buf, "%s.row_conflicts", name);
+  stat_reg_counter(sdb, buf, "total number of row buffer conflicts",
+		   &dram->row_conflicts, 0, NULL);
+  sprintf(buf, "%s.row_hits_first", name);
+  stat_reg_counter(sdb, buf,
+		   "total number of row hits served ahead of older requests",
+		   &dram->row_hits_first, 0, NULL);
+  sprintf(buf, "%s.queue_full", name);
+  stat_reg_counter(sdb, buf,
+		   "total number of requests that found the queue full",
+		   &dram->queue_full, 0, NULL);
+  sprintf(buf, "%s.queue_cycles", name);
+  stat_reg_counter(sdb, buf, "total cycles waiting for a queue entry",
+		   &dram->queue_cycles, 0, NULL);
+  sprintf(buf, "%s.bus_cycles", name);
+  stat_reg_counter(sdb, buf, "total cycles of data transfer",
+		   &dram->bus_cycles, 0, NULL);
+  sprintf(buf, "%s.total_lat", name);
+  stat_reg_counter(sdb, buf, "total latency of all accesses",
+		   &dram->total_lat, 0, NULL);
+
+  sprintf(buf, "%s.row_hit_rate", name);
+  sprintf(buf1, "%s.row_hits / %s.accesses", name, name);
+  stat_reg_formula(sdb, buf, "row buffer hit rate (i.e., hits/accesses)",
+		   buf1, NULL);
+  sprintf(buf, "%s.row_conflict_rate", name);
+  sprintf(buf1, "%s.row_conflicts / %s.accesses", name, name);
+  stat_reg_formula(sdb, buf,
+		   "row buffer conflict rate (i.e., conflicts/accesses)",
+		   buf1, NULL);
+  sprintf(buf, "%s.avg_lat", name);
+  sprintf(buf1, "%s.total_lat / %s.accesses", name, name);
+  stat_reg_formula(sdb, buf, "average access latency in cycles",
+		   buf1, NULL);
+}
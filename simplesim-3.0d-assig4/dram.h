@@ -0,0 +1,193 @@
+/* dram.h - DRAM controller and device timing model interfaces */
+
+/* SimpleScalar(TM) Tool Suite
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ * All Rights Reserved. 
+ * 
+ * THIS IS A LEGAL DOCUMENT, BY USING SIMPLESCALAR,
+ * YOU ARE AGREEING TO THESE TERMS AND CONDITIONS.
+ * 
+ * No portion of this work may be used by any commercial entity, or for any
+ * commercial purpose, without the prior, written permission of SimpleScalar,
+ * LLC (info@simplescalar.com). Nonprofit and noncommercial use is permitted
+ * as described below.
+ * 
+ * 1. SimpleScalar is provided AS IS, with no warranty of any kind, express
+ * or implied. The user of the program accepts full responsibility for the
+ * application of the program and the use of any results.
+ * 
+ * 2. Nonprofit and noncommercial use is encouraged. SimpleScalar may be
+ * downloaded, compiled, executed, copied, and modified solely for nonprofit,
+ * educational, noncommercial research, and noncommercial scholarship
+ * purposes provided that this notice in its entirety accompanies all copies.
+ * Copies of the modified software can be delivered to persons who use it
+ * solely for nonprofit, educational, noncommercial research, and
+ * noncommercial scholarship purposes provided that this notice in its
+ * entirety accompanies all copies.
+ * 
+ * 3. ALL COMMERCIAL USE, AND ALL USE BY FOR PROFIT ENTITIES, IS EXPRESSLY
+ * PROHIBITED WITHOUT A LICENSE FROM SIMPLESCALAR, LLC (info@simplescalar.com).
+ * 
+ * 4. No nonprofit user may place any restrictions on the use of this software,
+ * including as modified by the user, by any other authorized user.
+ * 
+ * 5. Noncommercial and nonprofit users may distribute copies of SimpleScalar
+ * in compiled or executable form as set forth in Section 2, provided that
+ * either: (A) it is accompanied by the corresponding machine-readable source
+ * code, or (B) it is accompanied by a written offer, with no time limit, to
+ * give anyone a machine-readable copy of the corresponding source code in
+ * return for reimbursement of the cost of distribution. This written offer
+ * must permit verbatim duplication by anyone, or (C) it is distributed by
+ * someone who received only the executable form, and is accompanied by a
+ * copy of the written offer of source code.
+ * 
+ * 6. SimpleScalar was developed by Todd M. Austin, Ph.D. The tool suite is
+ * currently maintained by SimpleScalar LLC (info@simplescalar.com). US Mail:
+ * 2395 Timbercrest Court, Ann Arbor, MI 48105.
+ * 
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ */
+
+#ifndef DRAM_H
+#define DRAM_H
+
+#include <stdio.h>
+
+#include "host.h"
+#include "misc.h"
+#include "machine.h"
+#include "memory.h"
+#include "stats.h"
+
+/*
+ * This module models main memory as a DRAM controller in front of one or
+ * more channels, each with its own data bus, request queue and ranks of
+ * banks.  Every bank holds one row open in its row buffer (open-page
+ * policy): an access to the open row takes tCAS, an access to a closed bank
+ * tRCD + tCAS, and an access to another row of an open bank
+ * tRP + tRCD + tCAS, after which the block takes one bus transfer per
+ * BUS_WIDTH bytes on its channel's data bus.
+ *
+ * Physical addresses are mapped, from the least significant bit up, to a
+ * column within a row, a channel, a bank, a rank and a row, so that
+ * consecutive rows go to different channels and banks.
+ *
+ * Like the caches, the model fixes the latency of each request when it is
+ * made, and a later request can never delay one already accepted.  Requests
+ * to different banks proceed in parallel, sharing only their channel's bus.
+ * Scheduling is FR-FCFS as far as that allows: a conflicting request puts
+ * off its precharge while its data would wait for the bus anyway, and a row
+ * hit arriving meanwhile goes ahead of it, provided that it issues its
+ * column access before that precharge.  Each
+ * channel holds at most QSIZE outstanding requests, a request arriving at a
+ * full queue waits for the earliest one to complete.
+ *
+ * All timings are in CPU cycles.
+ */
+
+/* DRAM bank state: the row open in the row buffer as of the latest request
+   scheduled to the bank, and the row it replaced, which stays open until its
+   precharge starts at PREV_UNTIL */
+struct dram_bank_t
+{
+  int row_valid;		/* is a row open (or being opened)? */
+  md_addr_t row;		/* open row */
+  tick_t ready;			/* when the row is ready for column accesses */
+  tick_t last_cas;		/* latest column access to the row */
+  int prev_valid;		/* was another row open before ROW? */
+  md_addr_t prev_row;		/* row open before ROW */
+  tick_t prev_ready;		/* when it was ready for column accesses */
+  tick_t prev_until;		/* when its precharge starts */
+};
+
+/* outstanding request, holding its channel's data bus from DATA_START to
+   FINISH */
+struct dram_req_t
+{
+  tick_t data_start;		/* first cycle of the data transfer */
+  tick_t finish;		/* cycle after the last data transfer */
+};
+
+/* DRAM channel */
+struct dram_channel_t
+{
+  struct dram_req_t *queue;	/* outstanding requests */
+  int nreqs;			/* number of outstanding requests */
+};
+
+/* DRAM definition */
+struct dram_t
+{
+  /* parameters */
+  char *name;			/* DRAM name */
+  int nchannels;		/* number of channels */
+  int nranks;			/* ranks per channel */
+  int nbanks;			/* banks per rank */
+  int row_size;			/* row buffer size in bytes */
+  int t_rcd;			/* activate to column access */
+  int t_cas;			/* column access to data */
+  int t_rp;			/* precharge to activate */
+  int qsize;			/* request queue entries per channel */
+  int bus_width;		/* channel data bus width in bytes */
+  int transfer_lat;		/* cycles per bus transfer */
+
+  /* derived address mapping */
+  int col_shift;		/* log2 of ROW_SIZE */
+  int chan_shift;		/* log2 of NCHANNELS */
+  int bank_shift;		/* log2 of NBANKS */
+  int rank_shift;		/* log2 of NRANKS */
+
+  /* state */
+  struct dram_channel_t *channels;/* NCHANNELS channels */
+  struct dram_bank_t *banks;	/* NCHANNELS * NRANKS * NBANKS banks */
+
+  /* stats */
+  counter_t reads;		/* total number of block reads */
+  counter_t writes;		/* total number of block writes */
+  counter_t row_hits;		/* accesses to the open row */
+  counter_t row_misses;		/* accesses to a closed bank */
+  counter_t row_conflicts;	/* accesses to another row of an open bank */
+  counter_t row_hits_first;	/* row hits served ahead of an older request */
+  counter_t queue_full;		/* requests that found their queue full */
+  counter_t queue_cycles;	/* cycles spent waiting for a queue entry */
+  counter_t total_lat;		/* total latency of all requests */
+  counter_t bus_cycles;		/* cycles of data transfer, all channels */
+};
+
+/* create a DRAM of NCHANNELS channels of NRANKS ranks of NBANKS banks with
+   ROW_SIZE byte rows, all powers of two, the given timings, QSIZE request
+   queue entries per channel, and BUS_WIDTH byte buses that take
+   TRANSFER_LAT cycles per transfer */
+struct dram_t *				/* DRAM */
+dram_create(char *name,			/* name of the DRAM */
+	    int nchannels,		/* number of channels */
+	    int nranks,			/* ranks per channel */
+	    int nbanks,			/* banks per rank */
+	    int row_size,		/* row buffer size in bytes */
+	    int t_rcd,			/* activate to column access */
+	    int t_cas,			/* column access to data */
+	    int t_rp,			/* precharge to activate */
+	    int qsize,			/* request queue entries per channel */
+	    int bus_width,		/* data bus width in bytes */
+	    int transfer_lat);		/* cycles per bus transfer */
+
+/* access NBYTES of DRAM at ADDR at time NOW, returns the latency until the
+   last byte has been transferred */
+unsigned int				/* latency of access in cycles */
+dram_access(struct dram_t *dram,	/* DRAM */
+	    enum mem_cmd cmd,		/* Read or Write */
+	    md_addr_t addr,		/* address of access */
+	    int nbytes,			/* number of bytes to access */
+	    tick_t now);		/* time of access */
+
+/* print the DRAM configuration */
+void
+dram_config(struct dram_t *dram,	/* DRAM */
+	    FILE *stream);		/* output stream */
+
+/* register the DRAM stats */
+void
+dram_reg_stats(struct dram_t *dram,	/* DRAM */
+	       struct stat_sdb_t *sdb);	/* stats database */
+
+#endif /* DRAM_H */
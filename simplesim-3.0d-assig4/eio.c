@@ -51,6 +51,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #ifdef _MSC_VER
 #include <io.h>
 #else /* !_MSC_VER */
@@ -302,6 +303,45 @@ eio_write_chkpt(struct regs_t *regs,		/* regs to dump */
   return eio_trans_icnt;
 }
 
+/* append a SIZE byte blob holding DATA to checkpoint list EXO */
+void
+eio_chkpt_add_blob(struct exo_term_t *exo,	/* checkpoint list */
+		   int size,			/* size of the table in bytes */
+		   void *data)			/* table to save */
+{
+  exo->as_list.head = exo_chain(exo->as_list.head,
+				exo_new(ec_blob, size, data));
+}
+
+/* the integer at the head of checkpoint list *ELT, advances *ELT, WHAT
+   names the checkpointed state for the error message */
+exo_integer_t
+eio_chkpt_integer(struct exo_term_t **elt,	/* checkpoint list position */
+		  char *what)			/* state being restored */
+{
+  exo_integer_t val;
+
+  if (!*elt || (*elt)->ec != ec_integer)
+    fatal("could not read the checkpoint of %s", what);
+  val = (*elt)->as_integer.val;
+  *elt = (*elt)->next;
+  return val;
+}
+
+/* copy the SIZE byte blob at the head of checkpoint list *ELT to DST,
+   advances *ELT, WHAT names the checkpointed state for the error message */
+void
+eio_chkpt_blob(struct exo_term_t **elt,		/* checkpoint list position */
+	       void *dst,			/* restored table */
+	       int size,			/* size of the table in bytes */
+	       char *what)			/* state being restored */
+{
+  if (!*elt || (*elt)->ec != ec_blob || (*elt)->as_blob.size != size)
+    fatal("could not read the checkpoint of %s", what);
+  memcpy(dst, (*elt)->as_blob.data, size);
+  *elt = (*elt)->next;
+}
+
 /* read check point of architected state from stream FD, returns
    EIO transaction count (an EIO file pointer) */
 counter_t
@@ -84,6 +84,30 @@ eio_read_chkpt(struct regs_t *regs,		/* regs to dump */
 		struct mem_t *mem,		/* memory to dump */
 		FILE *fd);			/* stream to read */
 
+/* helpers for simulator components that add their own state to a
+   checkpoint as an EXO list, e.g., the caches and the branch predictor */
+struct exo_term_t;
+
+/* append a SIZE byte blob holding DATA to checkpoint list EXO */
+void
+eio_chkpt_add_blob(struct exo_term_t *exo,	/* checkpoint list */
+		   int size,			/* size of the table in bytes */
+		   void *data);			/* table to save */
+
+/* the integer at the head of checkpoint list *ELT, advances *ELT, WHAT
+   names the checkpointed state for the error message */
+exo_integer_t
+eio_chkpt_integer(struct exo_term_t **elt,	/* checkpoint list position */
+		  char *what);			/* state being restored */
+
+/* copy the SIZE byte blob at the head of checkpoint list *ELT to DST,
+   advances *ELT, WHAT names the checkpointed state for the error message */
+void
+eio_chkpt_blob(struct exo_term_t **elt,		/* checkpoint list position */
+	       void *dst,			/* restored table */
+	       int size,			/* size of the table in bytes */
+	       char *what);			/* state being restored */
+
 /* syscall proxy handler, with EIO tracing support, architect registers
    and memory are assumed to be precise when this function is called,
    register and memory are updated with the results of the sustem call */
@@ -125,6 +125,7 @@ struct stat_sdb_t *sim_sdb;
 char *sim_eio_fname = NULL;
 char *sim_chkpt_fname = NULL;
 FILE *sim_eio_fd = NULL;
+FILE *sim_chkpt_fd = NULL;
 
 /* redirected program/simulator output file names */
 static char *sim_simout = NULL;
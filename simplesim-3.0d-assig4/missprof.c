@@ -0,0 +1,421 @@
+/* missprof.c - cache miss attribution profiler routines */
+
+/* SimpleScalar(TM) Tool Suite
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ * All Rights Reserved. 
+ * 
+ * THIS IS A LEGAL DOCUMENT, BY USING SIMPLESCALAR,
+ * YOU ARE AGREEING TO THESE TERMS AND CONDITIONS.
+ * 
+ * No portion of this work may be used by any commercial entity, or for any
+ * commercial purpose, without the prior, written permission of SimpleScalar,
+ * LLC (info@simplescalar.com). Nonprofit and noncommercial use is permitted
+ * as described below.
+ * 
+ * 1. SimpleScalar is provided AS IS, with no warranty of any kind, express
+ * or implied. The user of the program accepts full responsibility for the
+ * application of the program and the use of any results.
+ * 
+ * 2. Nonprofit and noncommercial use is encouraged. SimpleScalar may be
+ * downloaded, compiled, executed, copied, and modified solely for nonprofit,
+ * educational, noncommercial research, and noncommercial scholarship
+ * purposes provided that this notice in its entirety accompanies all copies.
+ * Copies of the modified software can be delivered to persons who use it
+ * solely for nonprofit, educational, noncommercial research, and
+ * noncommercial scholarship purposes provided that this notice in its
+ * entirety accompanies all copies.
+ * 
+ * 3. ALL COMMERCIAL USE, AND ALL USE BY FOR PROFIT ENTITIES, IS EXPRESSLY
+ * PROHIBITED WITHOUT A LICENSE FROM SIMPLESCALAR, LLC (info@simplescalar.com).
+ * 
+ * 4. No nonprofit user may place any restrictions on the use of this software,
+ * including as modified by the user, by any other authorized user.
+ * 
+ * 5. Noncommercial and nonprofit users may distribute copies of SimpleScalar
+ * in compiled or executable form as set forth in Section 2, provided that
+ * either: (A) it is accompanied by the corresponding machine-readable source
+ * code, or (B) it is accompanied by a written offer, with no time limit, to
+ * give anyone a machine-readable copy of the corresponding source code in
+ * return for reimbursement of the cost of distribution. This written offer
+ * must permit verbatim duplication by anyone, or (C) it is distributed by
+ * someone who received only the executable form, and is accompanied by a
+ * copy of the written offer of source code.
+ * 
+ * 6. SimpleScalar was developed by Todd M. Austin, Ph.D. The tool suite is
+ * currently maintained by SimpleScalar LLC (info@simplescalar.com). US Mail:
+ * 2395 Timbercrest Court, Ann Arbor, MI 48105.
+ * 
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "host.h"
+#include "misc.h"
+#include "machine.h"
+#include "loader.h"
+#include "symbol.h"
+#include "stats.h"
+#include "missprof.h"
+
+/* initial size of the profile hash tables, doubled when 3/4 full */
+#define MP_INIT_SIZE		256
+
+/* key of a free hash table entry */
+#define MP_EMPTY		((md_addr_t)-1)
+
+/* data objects are keyed by segment, below mp_seg_NUM, or by data symbol,
+   the symbol of index I (see symbol.h) being MP_SYM_KEY(I) */
+#define MP_SYM_KEY(I)		((md_addr_t)(mp_seg_NUM + (I)))
+#define MP_KEY_SYM(KEY)		((int)((KEY) - mp_seg_NUM))
+
+/* extent of the stack segment, as in sim-profile */
+#define MP_STACK_SIZE		(16*1024*1024)
+
+/* address segment strings */
+static char *mp_seg_str[mp_seg_NUM] = {
+  "<data segment>",
+  "<heap segment>",
+  "<stack segment>",
+  "<text segment>",
+  "<unknown>",
+};
+
+/* hash table entry of KEY, Fibonacci hashing */
+#define MP_HASH(tab, key)						\
+  ((unsigned int)((word_t)(key) * 2654435761u) >> (tab)->shift)
+
+/* allocate the hash table TAB with SIZE free entries */
+static void
+tab_init(struct missprof_tab_t *tab,	/* hash table */
+	 int size)			/* number of entries, a power of two */
+{
+  int i;
+
+  tab->size = size;
+  tab->shift = 32 - log_base2(size);
+  tab->nents = 0;
+  tab->ents = (struct missprof_ent_t *)
+    calloc(size, sizeof(struct missprof_ent_t));
+  if (!tab->ents)
+    fatal("out of virtual memory");
+  for (i=0; i < size; i++)
+    tab->ents[i].key = MP_EMPTY;
+}
+
+/* entry of KEY in hash table TAB, a zeroed one is added if KEY is not in
+   the table yet */
+static struct missprof_ent_t *
+tab_lookup(struct missprof_tab_t *tab,	/* hash table */
+	   md_addr_t key)		/* PC or data object */
+{
+  struct missprof_ent_t *ent;
+  unsigned int i;
+
+  for (i=MP_HASH(tab, key); ; i=(i+1) & (tab->size-1))
+    {
+      ent = &tab->ents[i];
+      if (ent->key == key)
+	return ent;
+      if (ent->key == MP_EMPTY)
+	break;
+    }
+
+  /* not found, keep the table at most 3/4 full so probes stay short */
+  if (4 * (tab->nents + 1) > 3 * tab->size)
+    {
+      struct missprof_tab_t old = *tab;
+
+      tab_init(tab, 2 * old.size);
+      for (i=0; i < (unsigned int)old.size; i++)
+	{
+	  if (old.ents[i].key != MP_EMPTY)
+	    *tab_lookup(tab, old.ents[i].key) = old.ents[i];
+	}
+      free(old.ents);
+      return tab_lookup(tab, key);
+    }
+
+  ent->key = key;
+  tab->nents++;
+  return ent;
+}
+
+/* add the counts of entry SRC to entry ENT */
+static void
+ent_add(struct missprof_ent_t *ent,	/* profile entry */
+	struct missprof_ent_t *src,	/* entry to add */
+	int nlevels)			/* cache levels followed */
+{
+  int l;
+
+  for (l=0; l < nlevels; l++)
+    ent->misses[l] += src->misses[l];
+  ent->late += src->late;
+}
+
+/* data object holding ADDR */
+static md_addr_t			/* object key */
+bind_obj(struct missprof_t *mp,		/* miss profiler */
+	 md_addr_t addr)		/* data address */
+{
+  int i;
+
+  if (!mp->resolve)
+    return mp_seg_unknown;
+  else if (sym_bind_addr(addr, &i, /* !exact */FALSE, sdb_data))
+    return MP_SYM_KEY(i);
+  else if (ld_data_base <= addr && addr < (ld_data_base + ld_data_size))
+    return mp_seg_data;
+  else if ((ld_data_base + ld_data_size) <= addr && addr < ld_brk_point)
+    return mp_seg_heap;
+  else if ((ld_stack_base - MP_STACK_SIZE) <= addr && addr < ld_stack_base)
+    return mp_seg_stack;
+  else if (ld_text_base <= addr && addr < (ld_text_base + ld_text_size))
+    return mp_seg_text;
+  else
+    return mp_seg_unknown;
+}
+
+/* create a miss profiler following the NLEVELS cache levels named
+   LEVEL_NAMES and reporting the TOPN worst PCs and data objects, data
+   addresses are bound to symbols and segments of the loaded program if
+   RESOLVE, its symbols must then be loaded (sym_loadsyms()) by the time
+   the profile is printed */
+struct missprof_t *			/* miss profiler */
+missprof_create(char *name,		/* name of the profiler */
+		int nlevels,		/* number of cache levels */
+		char **level_names,	/* name of each level */
+		int topn,		/* PCs and objects reported */
+		int resolve)		/* bind addresses to the program? */
+{
+  struct missprof_t *mp;
+  int l;
+
+  /* check all parameters */
+  if (nlevels <= 0 || nlevels > MP_MAX_LEVELS)
+    fatal("miss profiler `%s' follows %d cache levels, at most %d are "
+	  "supported", name, nlevels, MP_MAX_LEVELS);
+  if (topn <= 0)
+    fatal("miss profiler `%s' reports `%d' PCs, must be positive",
+	  name, topn);
+
+  mp = (struct missprof_t *)calloc(1, sizeof(struct missprof_t));
+  if (!mp)
+    fatal("out of virtual memory");
+
+  mp->name = mystrdup(name);
+  mp->nlevels = nlevels;
+  for (l=0; l < nlevels; l++)
+    mp->level_names[l] = mystrdup(level_names[l]);
+  mp->topn = topn;
+  mp->resolve = resolve;
+
+  tab_init(&mp->pcs, MP_INIT_SIZE);
+  tab_init(&mp->objs, MP_INIT_SIZE);
+
+  return mp;
+}
+
+/* account the demand reference by the instruction at PC to ADDR, which
+   missed MISSES[L] times at level L and found LATE prefetches in flight */
+void
+missprof_account(struct missprof_t *mp,	/* miss profiler */
+		 md_addr_t pc,		/* PC of the load or store */
+		 md_addr_t addr,	/* data address referenced */
+		 counter_t *misses,	/* misses at each level */
+		 counter_t late)	/* late prefetches */
+{
+  struct missprof_ent_t ref;
+  int l;
+
+  ref.late = late;
+  for (l=0; l < mp->nlevels; l++)
+    ref.misses[l] = misses[l];
+
+  ent_add(tab_lookup(&mp->pcs, pc), &ref, mp->nlevels);
+  ent_add(tab_lookup(&mp->objs, bind_obj(mp, addr)), &ref, mp->nlevels);
+
+  for (l=0; l < mp->nlevels; l++)
+    mp->misses[l] += misses[l];
+  mp->late += late;
+}
+
+/* add the profile of SRC, with the same levels, to MP */
+void
+missprof_merge(struct missprof_t *mp,	/* miss profiler */
+	       struct missprof_t *src)	/* profiler to add */
+{
+  int i, l;
+
+  if (src->nlevels != mp->nlevels)
+    panic("cannot merge miss profilers of different cache levels");
+
+  for (i=0; i < src->pcs.size; i++)
+    {
+      if (src->pcs.ents[i].key != MP_EMPTY)
+	ent_add(tab_lookup(&mp->pcs, src->pcs.ents[i].key),
+		&src->pcs.ents[i], mp->nlevels);
+    }
+  for (i=0; i < src->objs.size; i++)
+    {
+      if (src->objs.ents[i].key != MP_EMPTY)
+	ent_add(tab_lookup(&mp->objs, src->objs.ents[i].key),
+		&src->objs.ents[i], mp->nlevels);
+    }
+
+  for (l=0; l < mp->nlevels; l++)
+    mp->misses[l] += src->misses[l];
+  mp->late += src->late;
+}
+
+/* print the profiler configuration */
+void
+missprof_config(struct missprof_t *mp,	/* miss profiler */
+		FILE *stream)		/* output stream */
+{
+  int l;
+
+  fprintf(stream, "missprof: %s: top %d PCs and data objects, levels",
+	  mp->name, mp->topn);
+  for (l=0; l < mp->nlevels; l++)
+    fprintf(stream, " %s", mp->level_names[l]);
+  fprintf(stream, ", %s\n",
+	  mp->resolve ? "symbols and segments" : "addresses unresolved");
+}
+
+/* register the profiler stats */
+void
+missprof_reg_stats(struct missprof_t *mp,	/* miss profiler */
+		   struct stat_sdb_t *sdb)	/* stats database */
+{
+  char buf[512], buf1[512];
+  int l;
+
+  for (l=0; l < mp->nlevels; l++)
+    {
+      sprintf(buf, "%s.%s_misses", mp->name, mp->level_names[l]);
+      sprintf(buf1, "demand misses attributed at %s", mp->level_names[l]);
+      stat_reg_counter(sdb, buf, buf1, &mp->misses[l], 0, NULL);
+    }
+  sprintf(buf, "%s.late", mp->name);
+  stat_reg_counter(sdb, buf, "late prefetches attributed",
+		   &mp->late, 0, NULL);
+  sprintf(buf, "%s.pcs", mp->name);
+  stat_reg_int(sdb, buf, "distinct PCs that missed",
+	       &mp->pcs.nents, 0, NULL);
+  sprintf(buf, "%s.objects", mp->name);
+  stat_reg_int(sdb, buf, "distinct data objects that missed",
+	       &mp->objs.nents, 0, NULL);
+}
+
+/* misses of entry ENT at all levels, a miss that goes further down the
+   hierarchy costs more and counts once per level */
+#define ENT_MISSES(ENT)							\
+  ((ENT)->misses[0] + (ENT)->misses[1] + (ENT)->misses[2]		\
+   + (ENT)->misses[3])
+
+/* order entries by decreasing misses, then late prefetches, then key */
+static int
+ent_compare(const void *a, const void *b)
+{
+  struct missprof_ent_t *ea = *(struct missprof_ent_t **)a;
+  struct missprof_ent_t *eb = *(struct missprof_ent_t **)b;
+
+  if (ENT_MISSES(ea) != ENT_MISSES(eb))
+    return ENT_MISSES(ea) > ENT_MISSES(eb) ? -1 : 1;
+  else if (ea->late != eb->late)
+    return ea->late > eb->late ? -1 : 1;
+  else if (ea->key != eb->key)
+    return ea->key < eb->key ? -1 : 1;
+  else
+    return 0;
+}
+
+/* print the top entries of hash table TAB, of PCs if IS_PC, else of data
+   objects */
+static void
+print_tab(struct missprof_t *mp,	/* miss profiler */
+	  struct missprof_tab_t *tab,	/* hash table to print */
+	  int is_pc,			/* PCs, not data objects? */
+	  FILE *stream)			/* output stream */
+{
+  struct missprof_ent_t **sorted;
+  counter_t total = 0, cum = 0;
+  int i, n = 0, l;
+
+  sorted = (struct missprof_ent_t **)
+    calloc(MAX(tab->nents, 1), sizeof(struct missprof_ent_t *));
+  if (!sorted)
+    fatal("out of virtual memory");
+  for (i=0; i < tab->size; i++)
+    {
+      if (tab->ents[i].key != MP_EMPTY)
+	{
+	  sorted[n++] = &tab->ents[i];
+	  total += ENT_MISSES(&tab->ents[i]);
+	}
+    }
+  qsort(sorted, n, sizeof(struct missprof_ent_t *), ent_compare);
+
+  fprintf(stream, "\nmissprof: %s: top %d of %d %s by misses\n",
+	  mp->name, MIN(mp->topn, n), n, is_pc ? "PCs" : "data objects");
+  fprintf(stream, "missprof: %s: %-10s", mp->name, is_pc ? "PC" : "address");
+  for (l=0; l < mp->nlevels; l++)
+    fprintf(stream, " %10s", mp->level_names[l]);
+  fprintf(stream, " %10s %6s  %s\n", "late", "cum%", "symbol");
+
+  for (i=0; i < n && i < mp->topn; i++)
+    {
+      struct missprof_ent_t *ent = sorted[i];
+      struct sym_sym_t *sym;
+
+      cum += ENT_MISSES(ent);
+      if (is_pc)
+	{
+	  sym = sym_bind_addr(ent->key, NULL, /* !exact */FALSE, sdb_text);
+	  myfprintf(stream, "missprof: %s: 0x%08p", mp->name, ent->key);
+	}
+      else if (ent->key >= mp_seg_NUM)
+	{
+	  sym = sym_datasyms[MP_KEY_SYM(ent->key)];
+	  myfprintf(stream, "missprof: %s: 0x%08p", mp->name, sym->addr);
+	}
+      else
+	{
+	  sym = NULL;
+	  fprintf(stream, "missprof: %s: %-10s", mp->name, "-");
+	}
+
+      for (l=0; l < mp->nlevels; l++)
+	fprintf(stream, " %10.0f", (double)ent->misses[l]);
+      fprintf(stream, " %10.0f %6.2f  ", (double)ent->late,
+	      total ? 100.0 * (double)cum / (double)total : 0.0);
+
+      if (!is_pc && ent->key < mp_seg_NUM)
+	fprintf(stream, "%s\n", mp_seg_str[ent->key]);
+      else if (!sym)
+	fprintf(stream, "?\n");
+      else if (is_pc && ent->key != sym->addr)
+	fprintf(stream, "%s+0x%x\n", sym->name,
+		(unsigned int)(ent->key - sym->addr));
+      else if (is_pc)
+	fprintf(stream, "%s\n", sym->name);
+      else
+	fprintf(stream, "%s (%d bytes)\n", sym->name, sym->size);
+    }
+
+  free(sorted);
+}
+
+/* print the top PCs and data objects by misses */
+void
+missprof_print(struct missprof_t *mp,	/* miss profiler */
+	       FILE *stream)		/* output stream */
+{
+  print_tab(mp, &mp->pcs, /* PCs */TRUE, stream);
+  print_tab(mp, &mp->objs, /* data objects */FALSE, stream);
+}
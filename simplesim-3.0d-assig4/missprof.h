@@ -0,0 +1,168 @@
+/* missprof.h - cache miss attribution profiler interfaces */
+
+/* SimpleScalar(TM) Tool Suite
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ * All Rights Reserved. 
+ * 
+ * THIS IS A LEGAL DOCUMENT, BY USING SIMPLESCALAR,
+ * YOU ARE AGREEING TO THESE TERMS AND CONDITIONS.
+ * 
+ * No portion of this work may be used by any commercial entity, or for any
+ * commercial purpose, without the prior, written permission of SimpleScalar,
+ * LLC (info@simplescalar.com). Nonprofit and noncommercial use is permitted
+ * as described below.
+ * 
+ * 1. SimpleScalar is provided AS IS, with no warranty of any kind, express
+ * or implied. The user of the program accepts full responsibility for the
+ * application of the program and the use of any results.
+ * 
+ * 2. Nonprofit and noncommercial use is encouraged. SimpleScalar may be
+ * downloaded, compiled, executed, copied, and modified solely for nonprofit,
+ * educational, noncommercial research, and noncommercial scholarship
+ * purposes provided that this notice in its entirety accompanies all copies.
+ * Copies of the modified software can be delivered to persons who use it
+ * solely for nonprofit, educational, noncommercial research, and
+ * noncommercial scholarship purposes provided that this notice in its
+ * entirety accompanies all copies.
+ * 
+ * 3. ALL COMMERCIAL USE, AND ALL USE BY FOR PROFIT ENTITIES, IS EXPRESSLY
+ * PROHIBITED WITHOUT A LICENSE FROM SIMPLESCALAR, LLC (info@simplescalar.com).
+ * 
+ * 4. No nonprofit user may place any restrictions on the use of this software,
+ * including as modified by the user, by any other authorized user.
+ * 
+ * 5. Noncommercial and nonprofit users may distribute copies of SimpleScalar
+ * in compiled or executable form as set forth in Section 2, provided that
+ * either: (A) it is accompanied by the corresponding machine-readable source
+ * code, or (B) it is accompanied by a written offer, with no time limit, to
+ * give anyone a machine-readable copy of the corresponding source code in
+ * return for reimbursement of the cost of distribution. This written offer
+ * must permit verbatim duplication by anyone, or (C) it is distributed by
+ * someone who received only the executable form, and is accompanied by a
+ * copy of the written offer of source code.
+ * 
+ * 6. SimpleScalar was developed by Todd M. Austin, Ph.D. The tool suite is
+ * currently maintained by SimpleScalar LLC (info@simplescalar.com). US Mail:
+ * 2395 Timbercrest Court, Ann Arbor, MI 48105.
+ * 
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ */
+
+
+#ifndef MISSPROF_H
+#define MISSPROF_H
+
+#include <stdio.h>
+
+#include "host.h"
+#include "misc.h"
+#include "machine.h"
+#include "stats.h"
+
+/*
+ * This module charges cache misses to the instruction and the data that
+ * caused them.  Every demand reference that misses in one or more levels of
+ * a cache hierarchy, or that finds its block's prefetch still in flight (a
+ * late prefetch), is accounted to the PC of the load or store and to the
+ * data object it touched: the program's data symbol holding the address
+ * when one does, else its segment (data, heap, stack or text).
+ *
+ * Both profiles are open-addressed hash tables holding only the PCs and
+ * objects that missed, so their size follows the miss footprint of the
+ * program rather than its text or data size.  After the run, the top N PCs
+ * and objects by misses are reported, PCs resolved to the enclosing text
+ * symbol, along with the share of all misses each one and the ones above
+ * it account for: the loads worth prefetching for.
+ */
+
+/* cache levels a profiler can follow */
+#define MP_MAX_LEVELS		4
+
+/* data objects that are not data symbols */
+enum mp_seg_t {
+  mp_seg_data,			/* data segment */
+  mp_seg_heap,			/* heap segment */
+  mp_seg_stack,			/* stack segment */
+  mp_seg_text,			/* text segment */
+  mp_seg_unknown,		/* unknown, e.g., no program loaded */
+  mp_seg_NUM
+};
+
+/* profile entry of one PC or data object */
+struct missprof_ent_t
+{
+  md_addr_t key;		/* PC, or data object (see missprof.c) */
+  counter_t misses[MP_MAX_LEVELS];/* demand misses at each level */
+  counter_t late;		/* late prefetches */
+};
+
+/* hash table of profile entries */
+struct missprof_tab_t
+{
+  int size;			/* number of entries, a power of two */
+  int shift;			/* 32 - log2(SIZE), for hashing */
+  int nents;			/* entries in use */
+  struct missprof_ent_t *ents;	/* entries, key MP_EMPTY if free */
+};
+
+/* miss attribution profiler definition */
+struct missprof_t
+{
+  /* parameters */
+  char *name;			/* profiler name */
+  int nlevels;			/* cache levels followed */
+  char *level_names[MP_MAX_LEVELS];/* name of each level */
+  int topn;			/* PCs and objects reported */
+  int resolve;			/* program symbols and segments known? */
+
+  /* profiles */
+  struct missprof_tab_t pcs;	/* by PC of the load or store */
+  struct missprof_tab_t objs;	/* by data object */
+
+  /* stats */
+  counter_t misses[MP_MAX_LEVELS];/* demand misses at each level */
+  counter_t late;		/* late prefetches */
+};
+
+/* create a miss profiler following the NLEVELS cache levels named
+   LEVEL_NAMES and reporting the TOPN worst PCs and data objects, data
+   addresses are bound to symbols and segments of the loaded program if
+   RESOLVE, its symbols must then be loaded (sym_loadsyms()) by the time
+   the profile is printed */
+struct missprof_t *			/* miss profiler */
+missprof_create(char *name,		/* name of the profiler */
+		int nlevels,		/* number of cache levels */
+		char **level_names,	/* name of each level */
+		int topn,		/* PCs and objects reported */
+		int resolve);		/* bind addresses to the program? */
+
+/* account the demand reference by the instruction at PC to ADDR, which
+   missed MISSES[L] times at level L and found LATE prefetches in flight */
+void
+missprof_account(struct missprof_t *mp,	/* miss profiler */
+		 md_addr_t pc,		/* PC of the load or store */
+		 md_addr_t addr,	/* data address referenced */
+		 counter_t *misses,	/* misses at each level */
+		 counter_t late);	/* late prefetches */
+
+/* add the profile of SRC, with the same levels, to MP */
+void
+missprof_merge(struct missprof_t *mp,	/* miss profiler */
+	       struct missprof_t *src);	/* profiler to add */
+
+/* print the profiler configuration */
+void
+missprof_config(struct missprof_t *mp,	/* miss profiler */
+		FILE *stream);		/* output stream */
+
+/* register the profiler stats */
+void
+missprof_reg_stats(struct missprof_t *mp,	/* miss profiler */
+		   struct stat_sdb_t *sdb);	/* stats database */
+
+/* print the top PCs and data objects by misses */
+void
+missprof_print(struct missprof_t *mp,	/* miss profiler */
+	       FILE *stream);		/* output stream */
+
+#endif /* MISSPROF_H */
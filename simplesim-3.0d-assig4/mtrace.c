@@ -0,0 +1,342 @@
+/* mtrace.c - memory reference trace routines */
+
+/* SimpleScalar(TM) Tool Suite
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ * All Rights Reserved. 
+ * 
+ * THIS IS A LEGAL DOCUMENT, BY USING SIMPLESCALAR,
+ * YOU ARE AGREEING TO THESE TERMS AND CONDITIONS.
+ * 
+ * No portion of this work may be used by any commercial entity, or for any
+ * commercial purpose, without the prior, written permission of SimpleScalar,
+ * LLC (info@simplescalar.com). Nonprofit and noncommercial use is permitted
+ * as described below.
+ * 
+ * 1. SimpleScalar is provided AS IS, with no warranty of any kind, express
+ * or implied. The user of the program accepts full responsibility for the
+ * application of the program and the use of any results.
+ * 
+ * 2. Nonprofit and noncommercial use is encouraged. SimpleScalar may be
+ * downloaded, compiled, executed, copied, and modified solely for nonprofit,
+ * educational, noncommercial research, and noncommercial scholarship
+ * purposes provided that this notice in its entirety accompanies all copies.
+ * Copies of the modified software can be delivered to persons who use it
+ * solely for nonprofit, educational, noncommercial research, and
+ * noncommercial scholarship purposes provided that this notice in its
+ * entirety accompanies all copies.
+ * 
+ * 3. ALL COMMERCIAL USE, AND ALL USE BY FOR PROFIT ENTITIES, IS EXPRESSLY
+ * PROHIBITED WITHOUT A LICENSE FROM SIMPLESCALAR, LLC (info@simplescalar.com).
+ * 
+ * 4. No nonprofit user may place any restrictions on the use of this software,
+ * including as modified by the user, by any other authorized user.
+ * 
+ * 5. Noncommercial and nonprofit users may distribute copies of SimpleScalar
+ * in compiled or executable form as set forth in Section 2, provided that
+ * either: (A) it is accompanied by the corresponding machine-readable source
+ * code, or (B) it is accompanied by a written offer, with no time limit, to
+ * give anyone a machine-readable copy of the corresponding source code in
+ * return for reimbursement of the cost of distribution. This written offer
+ * must permit verbatim duplication by anyone, or (C) it is distributed by
+ * someone who received only the executable form, and is accompanied by a
+ * copy of the written offer of source code.
+ * 
+ * 6. SimpleScalar was developed by Todd M. Austin, Ph.D. The tool suite is
+ * currently maintained by SimpleScalar LLC (info@simplescalar.com). US Mail:
+ * 2395 Timbercrest Court, Ann Arbor, MI 48105.
+ * 
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "host.h"
+#include "misc.h"
+#include "machine.h"
+#include "stats.h"
+#include "mtrace.h"
+
+/* trace header magic and version */
+#define MTRACE_MAGIC		"SSMTRACE"
+#define MTRACE_VERSION		1
+
+/* I/O buffer size, traces are read and written in blocks of this size */
+#define MTRACE_BUF_SIZE		(1 << 16)
+
+/* zig-zag encode the signed difference held in unsigned DELTA */
+#define ZIGZAG(DELTA)							\
+  (((DELTA) << 1) ^ (0 - ((DELTA) >> (sizeof(md_addr_t) * 8 - 1))))
+
+/* encode VAL at P, returns the number of bytes written */
+static int
+put_varint(unsigned char *p,		/* output buffer */
+	   md_addr_t val)		/* value to encode */
+{
+  int n = 0;
+
+  while (val >= 0x80)
+    {
+      p[n++] = (unsigned char)(val | 0x80);
+      val >>= 7;
+    }
+  p[n++] = (unsigned char)val;
+  return n;
+}
+
+/* decode a varint at P, checking for the END of input, returns the number
+   of bytes read or -1 if the varint is truncated */
+static int
+get_varint(unsigned char *p,		/* input buffer */
+	   unsigned char *end,		/* end of input */
+	   md_addr_t *val)		/* decoded value */
+{
+  md_addr_t v = 0;
+  int n = 0, shift = 0;
+
+  do
+    {
+      if (p + n >= end || shift >= (int)(sizeof(md_addr_t) * 8))
+	return -1;
+      v |= (md_addr_t)(p[n] & 0x7f) << shift;
+      shift += 7;
+    }
+  while (p[n++] & 0x80);
+
+  *val = v;
+  return n;
+}
+
+/* allocate a trace descriptor */
+static struct mtrace_t *
+mtrace_new(char *fname,			/* trace file name */
+	   int writing)			/* non-zero if writing */
+{
+  struct mtrace_t *mt;
+
+  mt = (struct mtrace_t *)calloc(1, sizeof(struct mtrace_t));
+  if (!mt)
+    fatal("out of virtual memory");
+  mt->fname = mystrdup(fname);
+  mt->writing = writing;
+  return mt;
+}
+
+/* write out the buffered part of a trace being written */
+static void
+flush_buf(struct mtrace_t *mt)		/* memory reference trace */
+{
+  if (mt->tail > mt->head
+      && fwrite(mt->buf + mt->head, 1, mt->tail - mt->head, mt->fd)
+         != mt->tail - mt->head)
+    fatal("error writing trace file `%s'", mt->fname);
+  mt->head = mt->tail = 0;
+}
+
+/* refill the buffer of a trace being read, which is then full unless the
+   input is exhausted, and then followed by zero bytes so that decoding a
+   truncated record stops within the buffer */
+static void
+fill_buf(struct mtrace_t *mt)		/* memory reference trace */
+{
+  size_t n;
+
+  if (mt->eof)
+    return;
+
+  /* keep the unconsumed tail */
+  memmove(mt->buf, mt->buf + mt->head, mt->tail - mt->head);
+  mt->tail -= mt->head;
+  mt->head = 0;
+
+  while (mt->tail < mt->buf_size && !mt->eof)
+    {
+      n = fread(mt->buf + mt->tail, 1, mt->buf_size - mt->tail, mt->fd);
+      if (n == 0)
+	{
+	  if (ferror(mt->fd))
+	    fatal("error reading trace file `%s'", mt->fname);
+	  mt->eof = TRUE;
+	}
+      mt->tail += n;
+    }
+  if (mt->eof)
+    memset(mt->buf + mt->tail, 0, MTRACE_MAX_REC);
+}
+
+/* create trace file FNAME for writing, recording TEXT_BASE in its header */
+struct mtrace_t *			/* memory reference trace */
+mtrace_create(char *fname,		/* trace file name */
+	      md_addr_t text_base)	/* program text base */
+{
+  struct mtrace_t *mt = mtrace_new(fname, /* writing */TRUE);
+
+  mt->fd = fopen(fname, "wb");
+  if (!mt->fd)
+    fatal("unable to create trace file `%s'", fname);
+
+  mt->buf_size = MTRACE_BUF_SIZE;
+  mt->buf = (unsigned char *)malloc(mt->buf_size);
+  if (!mt->buf)
+    fatal("out of virtual memory");
+
+  /* header */
+  memcpy(mt->buf, MTRACE_MAGIC, 8);
+  mt->buf[8] = MTRACE_VERSION;
+  mt->buf[9] = sizeof(md_addr_t);
+  mt->tail = 10 + put_varint(mt->buf + 10, text_base);
+  mt->text_base = text_base;
+
+  return mt;
+}
+
+/* open trace file FNAME for reading */
+struct mtrace_t *			/* memory reference trace */
+mtrace_open(char *fname)		/* trace file name */
+{
+  struct mtrace_t *mt = mtrace_new(fname, /* writing */FALSE);
+  int n;
+
+  mt->fd = fopen(fname, "rb");
+  if (!mt->fd)
+    fatal("unable to open trace file `%s'", fname);
+  mt->buf_size = MTRACE_BUF_SIZE;
+  mt->buf = (unsigned char *)malloc(mt->buf_size + MTRACE_MAX_REC);
+  if (!mt->buf)
+    fatal("out of virtual memory");
+  fill_buf(mt);
+
+  /* header */
+  if (mt->tail < 10 || memcmp(mt->buf, MTRACE_MAGIC, 8) != 0)
+    fatal("`%s' is not a memory reference trace", fname);
+  if (mt->buf[8] != MTRACE_VERSION)
+    fatal("trace file `%s' is version %d, expected version %d",
+	  fname, mt->buf[8], MTRACE_VERSION);
+  if (mt->buf[9] != sizeof(md_addr_t))
+    fatal("trace file `%s' has %d byte addresses, expected %d",
+	  fname, mt->buf[9], (int)sizeof(md_addr_t));
+  n = get_varint(mt->buf + 10, mt->buf + mt->tail, &mt->text_base);
+  if (n < 0)
+    fatal("trace file `%s' is truncated", fname);
+  mt->head = 10 + n;
+
+  return mt;
+}
+
+/* append a record to a trace being written */
+void
+mtrace_write(struct mtrace_t *mt,	/* memory reference trace */
+	     enum mtrace_type type,	/* record type */
+	     int sys,			/* non-zero if made by a system call */
+	     md_addr_t pc,		/* PC of the instruction */
+	     md_addr_t addr,		/* address referenced */
+	     int size)			/* size of the reference in bytes */
+{
+  unsigned char *p, *start;
+  md_addr_t next_pc;
+  int code;
+
+  if (mt->tail + MTRACE_MAX_REC > mt->buf_size)
+    flush_buf(mt);
+  start = p = mt->buf + mt->tail;
+
+  /* control byte, the size is encoded in it if a power of two up to 64 */
+  code = (type == mt_syscall) ? 0 : MTRACE_SIZE_VARINT;
+  if (type != mt_syscall && size > 0 && (size & (size-1)) == 0 && size <= 64)
+    code = log_base2(size);
+  *p = (unsigned char)(type | (sys ? MTRACE_SYS : 0)
+		       | (code << MTRACE_SIZE_SHIFT));
+
+  /* PC */
+  next_pc = mt->last_pc + (type == mt_inst ? sizeof(md_inst_t) : 0);
+  if (pc == next_pc)
+    *p++ |= MTRACE_PC_IMPLIED;
+  else
+    {
+      p++;
+      p += put_varint(p, ZIGZAG(pc - mt->last_pc));
+    }
+  mt->last_pc = pc;
+
+  /* address */
+  if (type == mt_read || type == mt_write)
+    {
+      p += put_varint(p, ZIGZAG(addr - mt->last_addr));
+      mt->last_addr = addr;
+    }
+
+  /* size */
+  if (code == MTRACE_SIZE_VARINT)
+    p += put_varint(p, (md_addr_t)size);
+
+  mt->tail += p - start;
+  mt->bytes += p - start;
+  mt->records++;
+}
+
+/* buffer the next batch of records of a trace being read, returns the
+   first record, or NULL at the end of the trace, and sets *END so that
+   every record starting before it is buffered whole */
+unsigned char *				/* first record of the batch */
+mtrace_batch(struct mtrace_t *mt,	/* memory reference trace */
+	     unsigned char **end)	/* end of the batch */
+{
+  if (mt->tail - mt->head < MTRACE_BUF_SIZE / 2)
+    fill_buf(mt);
+  if (mt->head == mt->tail)
+    return NULL;
+
+  /* past the end of the input are zero bytes, which end any varint */
+  if (mt->eof)
+    *end = mt->buf + mt->tail;
+  else
+    *end = mt->buf + mt->tail - (MTRACE_MAX_REC - 1);
+  return mt->buf + mt->head;
+}
+
+/* consume the NRECS records of the current batch decoded up to P */
+void
+mtrace_batch_done(struct mtrace_t *mt,	/* memory reference trace */
+		  unsigned char *p,	/* first record not decoded */
+		  int nrecs)		/* records decoded */
+{
+  if (p > mt->buf + mt->tail)
+    fatal("trace file `%s' is truncated", mt->fname);
+  mt->bytes += (p - mt->buf) - mt->head;
+  mt->records += nrecs;
+  mt->head = p - mt->buf;
+}
+
+/* flush and close a trace */
+void
+mtrace_close(struct mtrace_t *mt)	/* memory reference trace */
+{
+  if (mt->writing)
+    flush_buf(mt);
+  free(mt->buf);
+  if (mt->fd && fclose(mt->fd) != 0)
+    fatal("error closing trace file `%s'", mt->fname);
+  free(mt->fname);
+  free(mt);
+}
+
+/* register the trace stats, named NAME.records etc. */
+void
+mtrace_reg_stats(struct mtrace_t *mt,	/* memory reference trace */
+		 char *name,		/* stat name prefix */
+		 struct stat_sdb_t *sdb)/* stats database */
+{
+  char buf[512], buf1[512];
+
+  sprintf(buf, "%s.records", name);
+  stat_reg_counter(sdb, buf, "total number of trace records",
+		   &mt->records, 0, NULL);
+  sprintf(buf, "%s.bytes", name);
+  stat_reg_counter(sdb, buf, "total number of record bytes",
+		   &mt->bytes, 0, NULL);
+  sprintf(buf, "%s.bytes_per_rec", name);
+  sprintf(buf1, "%s.bytes / %s.records", name, name);
+  stat_reg_formula(sdb, buf, "trace bytes per record", buf1, NULL);
+}
@@ -0,0 +1,237 @@
+/* mtrace.h - memory reference trace interfaces */
+
+/* SimpleScalar(TM) Tool Suite
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ * All Rights Reserved. 
+ * 
+ * THIS IS A LEGAL DOCUMENT, BY USING SIMPLESCALAR,
+ * YOU ARE AGREEING TO THESE TERMS AND CONDITIONS.
+ * 
+ * No portion of this work may be used by any commercial entity, or for any
+ * commercial purpose, without the prior, written permission of SimpleScalar,
+ * LLC (info@simplescalar.com). Nonprofit and noncommercial use is permitted
+ * as described below.
+ * 
+ * 1. SimpleScalar is provided AS IS, with no warranty of any kind, express
+ * or implied. The user of the program accepts full responsibility for the
+ * application of the program and the use of any results.
+ * 
+ * 2. Nonprofit and noncommercial use is encouraged. SimpleScalar may be
+ * downloaded, compiled, executed, copied, and modified solely for nonprofit,
+ * educational, noncommercial research, and noncommercial scholarship
+ * purposes provided that this notice in its entirety accompanies all copies.
+ * Copies of the modified software can be delivered to persons who use it
+ * solely for nonprofit, educational, noncommercial research, and
+ * noncommercial scholarship purposes provided that this notice in its
+ * entirety accompanies all copies.
+ * 
+ * 3. ALL COMMERCIAL USE, AND ALL USE BY FOR PROFIT ENTITIES, IS EXPRESSLY
+ * PROHIBITED WITHOUT A LICENSE FROM SIMPLESCALAR, LLC (info@simplescalar.com).
+ * 
+ * 4. No nonprofit user may place any restrictions on the use of this software,
+ * including as modified by the user, by any other authorized user.
+ * 
+ * 5. Noncommercial and nonprofit users may distribute copies of SimpleScalar
+ * in compiled or executable form as set forth in Section 2, provided that
+ * either: (A) it is accompanied by the corresponding machine-readable source
+ * code, or (B) it is accompanied by a written offer, with no time limit, to
+ * give anyone a machine-readable copy of the corresponding source code in
+ * return for reimbursement of the cost of distribution. This written offer
+ * must permit verbatim duplication by anyone, or (C) it is distributed by
+ * someone who received only the executable form, and is accompanied by a
+ * copy of the written offer of source code.
+ * 
+ * 6. SimpleScalar was developed by Todd M. Austin, Ph.D. The tool suite is
+ * currently maintained by SimpleScalar LLC (info@simplescalar.com). US Mail:
+ * 2395 Timbercrest Court, Ann Arbor, MI 48105.
+ * 
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ */
+
+#ifndef MTRACE_H
+#define MTRACE_H
+
+#include <stdio.h>
+
+#include "host.h"
+#include "misc.h"
+#include "machine.h"
+#include "stats.h"
+
+/*
+ * This module reads and writes compact traces of the memory references of a
+ * program, i.e., every instruction fetch and every load and store with its
+ * PC, address and size, so that cache-only experiments can replay the
+ * reference stream rather than re-execute the program.
+ *
+ * A trace is the 8 byte magic "SSMTRACE", a version byte, the size of
+ * md_addr_t in bytes, and the program text base (as a varint, for
+ * -cache:icompress), followed by one record per reference.  A record is a
+ * control byte:
+ *
+ *    bits 0-1  record type, enum mtrace_type
+ *    bit  2    PC implied: the previous PC plus one instruction for fetches,
+ *              the previous PC for everything else
+ *    bit  3    reference made by a system call on behalf of the program
+ *    bits 4-6  log2 of the size, or 7 if the size follows as a varint
+ *
+ * then, when not implied, the PC as a signed delta from the previous PC,
+ * then for loads and stores the address as a signed delta from the previous
+ * load or store address, then the size if not encoded in the control byte.
+ * Signed deltas are zig-zag encoded and all varints are little-endian base
+ * 128.  Sequential fetches thus take one byte and most data references two
+ * or three.
+ *
+ * A trace is read a batch of records at a time: mtrace_batch() buffers the
+ * next records, which the reader decodes in its own loop with
+ * MTRACE_DECODE(), and mtrace_batch_done() consumes them.  Buffer space is
+ * checked once per batch rather than once per record.
+ */
+
+/* longest varint and longest record, in bytes */
+#define MTRACE_MAX_VARINT	((sizeof(md_addr_t) * 8 + 6) / 7)
+#define MTRACE_MAX_REC		(1 + 3 * MTRACE_MAX_VARINT)
+
+/* control byte fields */
+#define MTRACE_TYPE_MASK	0x03
+#define MTRACE_PC_IMPLIED	0x04
+#define MTRACE_SYS		0x08
+#define MTRACE_SIZE_SHIFT	4
+#define MTRACE_SIZE_MASK	0x07
+#define MTRACE_SIZE_VARINT	7
+
+/* zig-zag decode the signed difference held in unsigned ZZ */
+#define MTRACE_UNZIGZAG(ZZ)						\
+  (((ZZ) >> 1) ^ (0 - ((ZZ) & 1)))
+
+/* record types */
+enum mtrace_type {
+  mt_inst,			/* instruction fetch */
+  mt_read,			/* load */
+  mt_write,			/* store */
+  mt_syscall			/* system call, a flush point for -flush */
+};
+
+/* one decoded trace record */
+struct mtrace_rec_t
+{
+  enum mtrace_type type;	/* record type */
+  int sys;			/* non-zero if made by a system call */
+  md_addr_t pc;			/* PC of the instruction */
+  md_addr_t addr;		/* address referenced, the PC for fetches */
+  int size;			/* size of the reference in bytes */
+};
+
+/* memory reference trace definition */
+struct mtrace_t
+{
+  char *fname;			/* trace file name */
+  FILE *fd;			/* trace file */
+  int writing;			/* non-zero if the trace is being written */
+  md_addr_t text_base;		/* program text base recorded in the header */
+
+  /* delta encoding state */
+  md_addr_t last_pc;		/* PC of the previous record */
+  md_addr_t last_addr;		/* address of the previous load or store */
+
+  /* I/O buffer, BUF[HEAD..TAIL) is unconsumed input or unwritten output,
+     input is followed by MTRACE_MAX_REC zero bytes once exhausted */
+  unsigned char *buf;		/* buffer */
+  size_t buf_size;		/* buffer capacity */
+  size_t head, tail;		/* buffer contents */
+  int eof;			/* non-zero once the input is exhausted */
+
+  /* stats */
+  counter_t records;		/* total number of records */
+  counter_t bytes;		/* total number of record bytes */
+};
+
+/* create trace file FNAME for writing, recording TEXT_BASE in its header */
+struct mtrace_t *			/* memory reference trace */
+mtrace_create(char *fname,		/* trace file name */
+	      md_addr_t text_base);	/* program text base */
+
+/* open trace file FNAME for reading */
+struct mtrace_t *			/* memory reference trace */
+mtrace_open(char *fname);		/* trace file name */
+
+/* append a record to a trace being written */
+void
+mtrace_write(struct mtrace_t *mt,	/* memory reference trace */
+	     enum mtrace_type type,	/* record type */
+	     int sys,			/* non-zero if made by a system call */
+	     md_addr_t pc,		/* PC of the instruction */
+	     md_addr_t addr,		/* address referenced */
+	     int size);			/* size of the reference in bytes */
+
+/* buffer the next batch of records of a trace being read, returns the
+   first record, or NULL at the end of the trace, and sets *END so that
+   every record starting before it is buffered whole */
+unsigned char *				/* first record of the batch */
+mtrace_batch(struct mtrace_t *mt,	/* memory reference trace */
+	     unsigned char **end);	/* end of the batch */
+
+/* consume the NRECS records of the current batch decoded up to P */
+void
+mtrace_batch_done(struct mtrace_t *mt,	/* memory reference trace */
+		  unsigned char *p,	/* first record not decoded */
+		  int nrecs);		/* records decoded */
+
+/* decode a varint at P into md_addr_t VAL, advancing P */
+#define MTRACE_GET_VARINT(P, VAL)					\
+  do {									\
+    int _shift = 0;							\
+    (VAL) = 0;								\
+    do {								\
+      (VAL) |= (md_addr_t)(*(P) & 0x7f) << _shift;			\
+      _shift += 7;							\
+    } while ((*(P)++ & 0x80) && _shift < (int)(sizeof(md_addr_t) * 8));	\
+  } while (0)
+
+/* decode the record of trace MT at P, which must start before the end of
+   the current batch, into struct mtrace_rec_t REC, advancing P */
+#define MTRACE_DECODE(MT, P, REC)					\
+  do {									\
+    unsigned int _ctl = *(P)++;						\
+    md_addr_t _val;							\
+									\
+    (REC).type = (enum mtrace_type)(_ctl & MTRACE_TYPE_MASK);		\
+    (REC).sys = (_ctl & MTRACE_SYS) != 0;				\
+    if (_ctl & MTRACE_PC_IMPLIED)					\
+      (REC).pc = (MT)->last_pc						\
+	+ ((REC).type == mt_inst ? sizeof(md_inst_t) : 0);		\
+    else								\
+      {									\
+	MTRACE_GET_VARINT(P, _val);					\
+	(REC).pc = (MT)->last_pc + MTRACE_UNZIGZAG(_val);		\
+      }									\
+    (MT)->last_pc = (REC).pc;						\
+    if ((REC).type == mt_read || (REC).type == mt_write)		\
+      {									\
+	MTRACE_GET_VARINT(P, _val);					\
+	(REC).addr = (MT)->last_addr =					\
+	  (MT)->last_addr + MTRACE_UNZIGZAG(_val);			\
+      }									\
+    else								\
+      (REC).addr = (REC).pc;						\
+    _ctl = (_ctl >> MTRACE_SIZE_SHIFT) & MTRACE_SIZE_MASK;		\
+    if (_ctl == MTRACE_SIZE_VARINT)					\
+      {									\
+	MTRACE_GET_VARINT(P, _val);					\
+	(REC).size = (int)_val;						\
+      }									\
+    else								\
+      (REC).size = 1 << _ctl;						\
+  } while (0)
+
+/* flush and close a trace */
+void
+mtrace_close(struct mtrace_t *mt);	/* memory reference trace */
+
+/* register the trace stats, named NAME.records etc. */
+void
+mtrace_reg_stats(struct mtrace_t *mt,	/* memory reference trace */
+		 char *name,		/* stat name prefix */
+		 struct stat_sdb_t *sdb);/* stats database */
+
+#endif /* MTRACE_H */
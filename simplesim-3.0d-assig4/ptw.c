@@ -0,0 +1,283 @@
+/* ptw.c - page table walker routines */
+
+/* SimpleScalar(TM) Tool Suite
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ * All Rights Reserved. 
+ * 
+ * THIS IS A LEGAL DOCUMENT, BY USING SIMPLESCALAR,
+ * YOU ARE AGREEING TO THESE TERMS AND CONDITIONS.
+ * 
+ * No portion of this work may be used by any commercial entity, or for any
+ * commercial purpose, without the prior, written permission of SimpleScalar,
+ * LLC (info@simplescalar.com). Nonprofit and noncommercial use is permitted
+ * as described below.
+ * 
+ * 1. SimpleScalar is provided AS IS, with no warranty of any kind, express
+ * or implied. The user of the program accepts full responsibility for the
+ * application of the program and the use of any results.
+ * 
+ * 2. Nonprofit and noncommercial use is encouraged. SimpleScalar may be
+ * downloaded, compiled, executed, copied, and modified solely for nonprofit,
+ * educational, noncommercial research, and noncommercial scholarship
+ * purposes provided that this notice in its entirety accompanies all copies.
+ * Copies of the modified software can be delivered to persons who use it
+ * solely for nonprofit, educational, noncommercial research, and
+ * noncommercial scholarship purposes provided that this notice in its
+ * entirety accompanies all copies.
+ * 
+ * 3. ALL COMMERCIAL USE, AND ALL USE BY FOR PROFIT ENTITIES, IS EXPRESSLY
+ * PROHIBITED WITHOUT A LICENSE FROM SIMPLESCALAR, LLC (info@simplescalar.com).
+ * 
+ * 4. No nonprofit user may place any restrictions on the use of this software,
+ * including as modified by the user, by any other authorized user.
+ * 
+ * 5. Noncommercial and nonprofit users may distribute copies of SimpleScalar
+ * in compiled or executable form as set forth in Section 2, provided that
+ * either: (A) it is accompanied by the corresponding machine-readable source
+ * code, or (B) it is accompanied by a written offer, with no time limit, to
+ * give anyone a machine-readable copy of the corresponding source code in
+ * return for reimbursement of the cost of distribution. This written offer
+ * must permit verbatim duplication by anyone, or (C) it is distributed by
+ * someone who received only the executable form, and is accompanied by a
+ * copy of the written offer of source code.
+ * 
+ * 6. SimpleScalar was developed by Todd M. Austin, Ph.D. The tool suite is
+ * currently maintained by SimpleScalar LLC (info@simplescalar.com). US Mail:
+ * 2395 Timbercrest Court, Ann Arbor, MI 48105.
+ * 
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "host.h"
+#include "misc.h"
+#include "machine.h"
+#include "memory.h"
+#include "stats.h"
+#include "cache.h"
+#include "ptw.h"
+
+/* address of the level L page table entry that translates ADDR */
+#define PTE_ADDR(PTW, L, ADDR)						\
+  ((PTW)->level_base[L]							\
+   + (((ADDR) & (PTW)->va_mask) >> (PTW)->level_shift[L]) * PTW_PTE_SIZE)
+
+/* page walk cache miss handler, the walker loads the entry itself */
+static unsigned int			/* latency of block access */
+pwc_access_fn(enum mem_cmd cmd,		/* access cmd, Read or Write */
+	      md_addr_t baddr,		/* block address to access */
+	      int bsize,		/* size of block to access */
+	      struct cache_blk_t *blk,	/* ptr to block in upper level */
+	      tick_t now,		/* time of access */
+	      md_addr_t pc,		/* PC of the requesting instruction */
+	      int prefetch)		/* non-zero if the access is a prefetch */
+{
+  return 0;
+}
+
+/* create a page table walker for VA_BITS bit virtual addresses and
+   2^PAGE_SHIFT byte pages, whose tables lie from BASE up, with a
+   PWC_NENTRIES entry fully associative LRU page walk cache, or none if
+   zero, that loads page table entries with MEM_FN and maps the huge pages
+   HUGE_FN accepts, if given */
+struct ptw_t *				/* page table walker */
+ptw_create(char *name,			/* name of the walker */
+	   int va_bits,			/* virtual address bits */
+	   int page_shift,		/* log2 of the base page size */
+	   md_addr_t base,		/* address of the page tables */
+	   int pwc_nentries,		/* page walk cache entries */
+	   unsigned int (*mem_fn)(md_addr_t addr, tick_t now),
+	   int (*huge_fn)(md_addr_t base, md_addr_t size))
+{
+  struct ptw_t *ptw;
+  int l, index_bits;
+  md_addr_t addr;
+
+  /* check all walker parameters */
+  if (page_shift < 6)
+    fatal("page size `%d' must be at least 64 bytes", 1 << page_shift);
+  if (va_bits <= page_shift || va_bits > (int)sizeof(md_addr_t) * 8)
+    fatal("virtual address width `%d' must be larger than the page offset "
+	  "and at most %d bits", va_bits, (int)sizeof(md_addr_t) * 8);
+  if (pwc_nentries < 0 || (pwc_nentries & (pwc_nentries-1)) != 0)
+    fatal("page walk cache size `%d' must be zero or a power of two",
+	  pwc_nentries);
+  if (!mem_fn)
+    fatal("must specify a page table entry load function");
+
+  ptw = (struct ptw_t *)calloc(1, sizeof(struct ptw_t));
+  if (!ptw)
+    fatal("out of virtual memory");
+
+  ptw->name = mystrdup(name);
+  ptw->va_bits = va_bits;
+  ptw->page_shift = page_shift;
+  ptw->base = base;
+  ptw->pwc_nentries = pwc_nentries;
+  ptw->mem_fn = mem_fn;
+  ptw->huge_fn = huge_fn;
+
+  /* each level translates as many bits as a page holds entries */
+  index_bits = page_shift - log_base2(PTW_PTE_SIZE);
+  ptw->nlevels = (va_bits - page_shift + index_bits - 1) / index_bits;
+  if (ptw->nlevels > PTW_MAX_LEVELS)
+    fatal("page table of `%d' levels is too deep", ptw->nlevels);
+  if (huge_fn && ptw->nlevels < 2)
+    fatal("huge pages need a page table of at least two levels");
+  ptw->huge_shift = page_shift + index_bits;
+  ptw->va_mask = va_bits < (int)sizeof(md_addr_t) * 8
+    ? ((md_addr_t)1 << va_bits) - 1 : ~(md_addr_t)0;
+
+  /* lay the levels out from the leaves up, each past the previous one */
+  addr = base;
+  for (l = ptw->nlevels - 1; l >= 0; l--)
+    {
+      ptw->level_shift[l] = page_shift + (ptw->nlevels - 1 - l) * index_bits;
+      ptw->level_base[l] = addr;
+      addr += ((md_addr_t)1 << (va_bits - ptw->level_shift[l])) * PTW_PTE_SIZE;
+    }
+
+  if (pwc_nentries)
+    ptw->pwc = cache_create("pwc", /* nsets */1, /* bsize */PTW_PTE_SIZE,
+			    /* balloc */FALSE, /* usize */0, pwc_nentries,
+			    LRU, pwc_access_fn, /* hit latency */1,
+			    /* no prefetcher */0);
+
+  return ptw;
+}
+
+/* return non-zero if ADDR lies in a huge page */
+int					/* non-zero if huge page */
+ptw_huge(struct ptw_t *ptw,		/* page table walker */
+	 md_addr_t addr)		/* virtual address */
+{
+  md_addr_t size = (md_addr_t)1 << ptw->huge_shift;
+
+  return ptw->huge_fn && ptw->huge_fn(addr & ~(size - 1), size);
+}
+
+/* return the address under which TLBs with base page sized entries hold
+   the translation of ADDR, i.e., ADDR for base pages */
+md_addr_t				/* TLB key address */
+ptw_tlb_addr(struct ptw_t *ptw,		/* page table walker */
+	     md_addr_t addr)		/* virtual address */
+{
+  md_addr_t size = (md_addr_t)1 << ptw->huge_shift;
+
+  if (!ptw_huge(ptw, addr))
+    return addr;
+
+  /* the base page of the huge page numbered like the huge page itself */
+  return ((addr & ~(size - 1))
+	  | (((addr >> ptw->huge_shift) << ptw->page_shift) & (size - 1)));
+}
+
+/* walk the page table for ADDR at time NOW, returns the walk latency */
+unsigned int				/* latency of walk in cycles */
+ptw_walk(struct ptw_t *ptw,		/* page table walker */
+	 md_addr_t addr,		/* virtual address to translate */
+	 tick_t now)			/* time of walk */
+{
+  int l, start = 0, leaf = ptw->nlevels - 1;
+  unsigned int lat = 0;
+  md_addr_t pte;
+
+  /* huge pages are mapped one level above the leaves */
+  if (ptw_huge(ptw, addr))
+    {
+      leaf--;
+      ptw->huge_walks++;
+    }
+
+  /* start below the deepest entry the page walk cache holds */
+  if (ptw->pwc)
+    {
+      for (l = leaf - 1; l >= 0; l--)
+	{
+	  pte = PTE_ADDR(ptw, l, addr);
+	  if (cache_probe(ptw->pwc, pte))
+	    {
+	      /* update its replacement state */
+	      cache_access(ptw->pwc, Read, pte, NULL, PTW_PTE_SIZE, now,
+			   NULL, NULL, /* pc */0, /* prefetch */0);
+	      ptw->pwc_hits++;
+	      start = l + 1;
+	      break;
+	    }
+	}
+    }
+
+  /* load the remaining entries, each through the previous one */
+  for (l = start; l <= leaf; l++)
+    {
+      pte = PTE_ADDR(ptw, l, addr);
+      lat += ptw->mem_fn(pte, now + lat);
+      ptw->pte_loads++;
+
+      if (ptw->pwc && l < leaf)
+	cache_access(ptw->pwc, Read, pte, NULL, PTW_PTE_SIZE, now + lat,
+		     NULL, NULL, /* pc */0, /* prefetch */0);
+    }
+
+  ptw->walks++;
+  ptw->walk_cycles += lat;
+
+  return lat;
+}
+
+/* print the page table walker configuration */
+void
+ptw_config(struct ptw_t *ptw,		/* page table walker */
+	   FILE *stream)		/* output stream */
+{
+  fprintf(stream,
+	  "PTW: %s: %d bit addresses, %d level page table of %d byte pages "
+	  "at 0x%08lx\n",
+	  ptw->name, ptw->va_bits, ptw->nlevels, 1 << ptw->page_shift,
+	  (unsigned long)ptw->base);
+  fprintf(stream,
+	  "PTW: %s: %d entry page walk cache, ",
+	  ptw->name, ptw->pwc_nentries);
+  if (ptw->huge_fn)
+    fprintf(stream, "%d byte huge pages\n", 1 << ptw->huge_shift);
+  else
+    fprintf(stream, "no huge pages\n");
+}
+
+/* register the page table walker stats */
+void
+ptw_reg_stats(struct ptw_t *ptw,	/* page table walker */
+	      struct stat_sdb_t *sdb)	/* stats database */
+{
+  char buf[512], buf1[512], *name = ptw->name;
+
+  sprintf(buf, "%s.walks", name);
+  stat_reg_counter(sdb, buf, "total number of page walks",
+		   &ptw->walks, 0, NULL);
+  sprintf(buf, "%s.huge_walks", name);
+  stat_reg_counter(sdb, buf, "total number of walks to huge pages",
+		   &ptw->huge_walks, 0, NULL);
+  sprintf(buf, "%s.pwc_hits", name);
+  stat_reg_counter(sdb, buf, "total number of walks that hit in the PWC",
+		   &ptw->pwc_hits, 0, NULL);
+  sprintf(buf, "%s.pte_loads", name);
+  stat_reg_counter(sdb, buf, "total number of page table entries loaded",
+		   &ptw->pte_loads, 0, NULL);
+  sprintf(buf, "%s.walk_cycles", name);
+  stat_reg_counter(sdb, buf, "total latency of all walks",
+		   &ptw->walk_cycles, 0, NULL);
+
+  sprintf(buf, "%s.pwc_hit_rate", name);
+  sprintf(buf1, "%s.pwc_hits / %s.walks", name, name);
+  stat_reg_formula(sdb, buf, "PWC hit rate (i.e., hits/walks)", buf1, NULL);
+  sprintf(buf, "%s.ptes_per_walk", name);
+  sprintf(buf1, "%s.pte_loads / %s.walks", name, name);
+  stat_reg_formula(sdb, buf, "page table entries loaded per walk",
+		   buf1, NULL);
+  sprintf(buf, "%s.avg_walk_lat", name);
+  sprintf(buf1, "%s.walk_cycles / %s.walks", name, name);
+  stat_reg_formula(sdb, buf, "average walk latency in cycles", buf1, NULL);
+}
@@ -0,0 +1,185 @@
+/* ptw.h - page table walker interfaces */
+
+/* SimpleScalar(TM) Tool Suite
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ * All Rights Reserved. 
+ * 
+ * THIS IS A LEGAL DOCUMENT, BY USING SIMPLESCALAR,
+ * YOU ARE AGREEING TO THESE TERMS AND CONDITIONS.
+ * 
+ * No portion of this work may be used by any commercial entity, or for any
+ * commercial purpose, without the prior, written permission of SimpleScalar,
+ * LLC (info@simplescalar.com). Nonprofit and noncommercial use is permitted
+ * as described below.
+ * 
+ * 1. SimpleScalar is provided AS IS, with no warranty of any kind, express
+ * or implied. The user of the program accepts full responsibility for the
+ * application of the program and the use of any results.
+ * 
+ * 2. Nonprofit and noncommercial use is encouraged. SimpleScalar may be
+ * downloaded, compiled, executed, copied, and modified solely for nonprofit,
+ * educational, noncommercial research, and noncommercial scholarship
+ * purposes provided that this notice in its entirety accompanies all copies.
+ * Copies of the modified software can be delivered to persons who use it
+ * solely for nonprofit, educational, noncommercial research, and
+ * noncommercial scholarship purposes provided that this notice in its
+ * entirety accompanies all copies.
+ * 
+ * 3. ALL COMMERCIAL USE, AND ALL USE BY FOR PROFIT ENTITIES, IS EXPRESSLY
+ * PROHIBITED WITHOUT A LICENSE FROM SIMPLESCALAR, LLC (info@simplescalar.com).
+ * 
+ * 4. No nonprofit user may place any restrictions on the use of this software,
+ * including as modified by the user, by any other authorized user.
+ * 
+ * 5. Noncommercial and nonprofit users may distribute copies of SimpleScalar
+ * in compiled or executable form as set forth in Section 2, provided that
+ * either: (A) it is accompanied by the corresponding machine-readable source
+ * code, or (B) it is accompanied by a written offer, with no time limit, to
+ * give anyone a machine-readable copy of the corresponding source code in
+ * return for reimbursement of the cost of distribution. This written offer
+ * must permit verbatim duplication by anyone, or (C) it is distributed by
+ * someone who received only the executable form, and is accompanied by a
+ * copy of the written offer of source code.
+ * 
+ * 6. SimpleScalar was developed by Todd M. Austin, Ph.D. The tool suite is
+ * currently maintained by SimpleScalar LLC (info@simplescalar.com). US Mail:
+ * 2395 Timbercrest Court, Ann Arbor, MI 48105.
+ * 
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ */
+
+#ifndef PTW_H
+#define PTW_H
+
+#include <stdio.h>
+
+#include "host.h"
+#include "misc.h"
+#include "machine.h"
+#include "memory.h"
+#include "stats.h"
+#include "cache.h"
+
+/*
+ * This module models the hardware page table walker that refills the TLBs.
+ * The page table is a radix tree of page sized tables of 8 byte entries, as
+ * in x86 PAE or x86-64: each level translates (log2(PAGE_SIZE) - 3) more
+ * bits of the virtual address, and the root table is as small as the
+ * address width allows, e.g., with 4 KB pages a 32 bit address space takes
+ * a 4 entry root, then two levels of 512 entries.  An entry one level above
+ * the leaves may map a huge page directly, i.e., 2 MB with 4 KB pages.
+ *
+ * The walker reads one entry per level, each depending on the previous one,
+ * and issues these loads through the memory function given to it, i.e.,
+ * through the data caches, so that page table entries compete with program
+ * data and nearby entries share cache blocks.  The tables of each level lie
+ * linearly at their own address, past the end of the previous level, from
+ * BASE up, as in a self-mapped page table, so choose a BASE the program
+ * does not use.
+ *
+ * A page walk cache holds recently used entries of the levels above the
+ * leaves, keyed by their address, and lets a walk start at the deepest
+ * level whose entry it holds.  Lookups in it take no time.
+ *
+ * TLBs hold huge pages in the entries of their base pages.  A huge page is
+ * kept under the key given by ptw_tlb_addr(), the address of one of its own
+ * base pages, chosen by its huge page number so that huge pages still
+ * spread over the TLB sets.
+ */
+
+/* page table entry size in bytes */
+#define PTW_PTE_SIZE		8
+
+/* maximum number of page table levels */
+#define PTW_MAX_LEVELS		8
+
+/* virtual address width and page table address of the target, the tables
+   lie above the user address space */
+#if defined(TARGET_PISA)
+#define PTW_VA_BITS		32
+#define PTW_BASE		((md_addr_t)0xc0000000)
+#elif defined(TARGET_ALPHA)
+#define PTW_VA_BITS		43
+#define PTW_BASE		(((md_addr_t)1) << 43)
+#else
+#error No ISA target defined...
+#endif
+
+/* page table walker definition */
+struct ptw_t
+{
+  /* parameters */
+  char *name;			/* walker name */
+  int va_bits;			/* virtual address bits translated */
+  int page_shift;		/* log2 of the base page size */
+  int huge_shift;		/* log2 of the huge page size */
+  int nlevels;			/* page table levels */
+  md_addr_t base;		/* address of the page tables */
+  int pwc_nentries;		/* page walk cache entries, zero if none */
+
+  /* memory access function, issues the page table entry load at ADDR at
+     time NOW and returns its latency */
+  unsigned int (*mem_fn)(md_addr_t addr, tick_t now);
+
+  /* huge page function, returns non-zero if the SIZE byte huge page at
+     BASE is mapped as a whole, NULL if huge pages are not used */
+  int (*huge_fn)(md_addr_t base, md_addr_t size);
+
+  /* derived table layout, level 0 is the root */
+  md_addr_t va_mask;		/* mask of the virtual address bits */
+  int level_shift[PTW_MAX_LEVELS];/* address bits mapped by an entry */
+  md_addr_t level_base[PTW_MAX_LEVELS];/* address of each level's tables */
+
+  /* state */
+  struct cache_t *pwc;		/* page walk cache, or NULL */
+
+  /* stats */
+  counter_t walks;		/* total number of page walks */
+  counter_t huge_walks;		/* walks that ended in a huge page */
+  counter_t pwc_hits;		/* walks that skipped a level on a PWC hit */
+  counter_t pte_loads;		/* page table entries loaded */
+  counter_t walk_cycles;	/* total latency of all walks */
+};
+
+/* create a page table walker for VA_BITS bit virtual addresses and
+   2^PAGE_SHIFT byte pages, whose tables lie from BASE up, with a
+   PWC_NENTRIES entry fully associative LRU page walk cache, or none if
+   zero, that loads page table entries with MEM_FN and maps the huge pages
+   HUGE_FN accepts, if given */
+struct ptw_t *				/* page table walker */
+ptw_create(char *name,			/* name of the walker */
+	   int va_bits,			/* virtual address bits */
+	   int page_shift,		/* log2 of the base page size */
+	   md_addr_t base,		/* address of the page tables */
+	   int pwc_nentries,		/* page walk cache entries */
+	   unsigned int (*mem_fn)(md_addr_t addr, tick_t now),
+	   int (*huge_fn)(md_addr_t base, md_addr_t size));
+
+/* return non-zero if ADDR lies in a huge page */
+int					/* non-zero if huge page */
+ptw_huge(struct ptw_t *ptw,		/* page table walker */
+	 md_addr_t addr);		/* virtual address */
+
+/* return the address under which TLBs with base page sized entries hold
+   the translation of ADDR, i.e., ADDR for base pages */
+md_addr_t				/* TLB key address */
+ptw_tlb_addr(struct ptw_t *ptw,		/* page table walker */
+	     md_addr_t addr);		/* virtual address */
+
+/* walk the page table for ADDR at time NOW, returns the walk latency */
+unsigned int				/* latency of walk in cycles */
+ptw_walk(struct ptw_t *ptw,		/* page table walker */
+	 md_addr_t addr,		/* virtual address to translate */
+	 tick_t now);			/* time of walk */
+
+/* print the page table walker configuration */
+void
+ptw_config(struct ptw_t *ptw,		/* page table walker */
+	   FILE *stream);		/* output stream */
+
+/* register the page table walker stats */
+void
+ptw_reg_stats(struct ptw_t *ptw,	/* page table walker */
+	      struct stat_sdb_t *sdb);	/* stats database */
+
+#endif /* PTW_H */
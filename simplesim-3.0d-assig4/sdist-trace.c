@@ -0,0 +1,138 @@
+/* sdist-trace.c - single-pass LRU cache simulation of an address trace */
+
+/* SimpleScalar(TM) Tool Suite
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ * All Rights Reserved. 
+ * 
+ * THIS IS A LEGAL DOCUMENT, BY USING SIMPLESCALAR,
+ * YOU ARE AGREEING TO THESE TERMS AND CONDITIONS.
+ * 
+ * No portion of this work may be used by any commercial entity, or for any
+ * commercial purpose, without the prior, written permission of SimpleScalar,
+ * LLC (info@simplescalar.com). Nonprofit and noncommercial use is permitted
+ * as described below.
+ * 
+ * 1. SimpleScalar is provided AS IS, with no warranty of any kind, express
+ * or implied. The user of the program accepts full responsibility for the
+ * application of the program and the use of any results.
+ * 
+ * 2. Nonprofit and noncommercial use is encouraged. SimpleScalar may be
+ * downloaded, compiled, executed, copied, and modified solely for nonprofit,
+ * educational, noncommercial research, and noncommercial scholarship
+ * purposes provided that this notice in its entirety accompanies all copies.
+ * Copies of the modified software can be delivered to persons who use it
+ * solely for nonprofit, educational, noncommercial research, and
+ * noncommercial scholarship purposes provided that this notice in its
+ * entirety accompanies all copies.
+ * 
+ * 3. ALL COMMERCIAL USE, AND ALL USE BY FOR PROFIT ENTITIES, IS EXPRESSLY
+ * PROHIBITED WITHOUT A LICENSE FROM SIMPLESCALAR, LLC (info@simplescalar.com).
+ * 
+ * 4. No nonprofit user may place any restrictions on the use of this software,
+ * including as modified by the user, by any other authorized user.
+ * 
+ * 5. Noncommercial and nonprofit users may distribute copies of SimpleScalar
+ * in compiled or executable form as set forth in Section 2, provided that
+ * either: (A) it is accompanied by the corresponding machine-readable source
+ * code, or (B) it is accompanied by a written offer, with no time limit, to
+ * give anyone a machine-readable copy of the corresponding source code in
+ * return for reimbursement of the cost of distribution. This written offer
+ * must permit verbatim duplication by anyone, or (C) it is distributed by
+ * someone who received only the executable form, and is accompanied by a
+ * copy of the written offer of source code.
+ * 
+ * 6. SimpleScalar was developed by Todd M. Austin, Ph.D. The tool suite is
+ * currently maintained by SimpleScalar LLC (info@simplescalar.com). US Mail:
+ * 2395 Timbercrest Court, Ann Arbor, MI 48105.
+ * 
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ */
+
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "host.h"
+#include "misc.h"
+#include "machine.h"
+#include "sdist.h"
+
+/*
+ * This program runs the stack distance engine of sdist.c over an address
+ * trace rather than a simulated program, and prints the miss rate of every
+ * LRU cache geometry it covers.  The trace is read from a file, or from
+ * stdin, in din format: one reference per line, a label followed by a hex
+ * address, where label 0 is a data read, 1 a data write and 2 an
+ * instruction fetch; all other labels are ignored.
+ */
+
+static void
+usage(char *prog)
+{
+  fprintf(stderr,
+	  "usage: %s [-refs {inst|data|unified}] [-bsize <bytes>]\n"
+	  "       [-sets <min>:<max>] [-assoc <max>] [<trace>]\n", prog);
+  exit(1);
+}
+
+int
+main(int argc, char **argv)
+{
+  char *refs = "unified", *fname = NULL, line[256];
+  int i, bsize = 32, minsets = 16, maxsets = 4096, maxassoc = 16;
+  struct sdist_t *sd;
+  FILE *fd;
+
+  /* parse the command line */
+  for (i=1; i < argc; i++)
+    {
+      if (!strcmp(argv[i], "-refs") && i+1 < argc)
+	refs = argv[++i];
+      else if (!strcmp(argv[i], "-bsize") && i+1 < argc)
+	bsize = atoi(argv[++i]);
+      else if (!strcmp(argv[i], "-sets") && i+1 < argc)
+	{
+	  if (sscanf(argv[++i], "%d:%d", &minsets, &maxsets) != 2)
+	    usage(argv[0]);
+	}
+      else if (!strcmp(argv[i], "-assoc") && i+1 < argc)
+	maxassoc = atoi(argv[++i]);
+      else if (argv[i][0] == '-' || fname)
+	usage(argv[0]);
+      else
+	fname = argv[i];
+    }
+  if (strcmp(refs, "inst") && strcmp(refs, "data") && strcmp(refs, "unified"))
+    usage(argv[0]);
+  if (minsets <= 0 || (minsets & (minsets-1)) != 0
+      || maxsets <= 0 || (maxsets & (maxsets-1)) != 0)
+    fatal("set counts must be powers of two");
+
+  if (!fname)
+    fd = stdin;
+  else if (!(fd = fopen(fname, "r")))
+    fatal("cannot open trace file `%s'", fname);
+
+  sd = sdist_create(refs, bsize, log_base2(minsets), log_base2(maxsets),
+		    maxassoc);
+  sdist_config(sd, stderr);
+
+  while (fgets(line, sizeof(line), fd))
+    {
+      int label;
+      unsigned long long addr;
+
+      if (sscanf(line, "%d %llx", &label, &addr) != 2)
+	continue;
+      if ((label == 2 && strcmp(refs, "data"))
+	  || ((label == 0 || label == 1) && strcmp(refs, "inst")))
+	sdist_access(sd, (md_addr_t)addr);
+    }
+  if (fd != stdin)
+    fclose(fd);
+
+  sdist_print(sd, stdout);
+  return 0;
+}
@@ -0,0 +1,422 @@
+/* sdist.c - LRU stack distance (single-pass cache simulation) routines */
+
+/* SimpleScalar(TM) Tool Suite
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ * All Rights Reserved. 
+ * 
+ * THIS IS A LEGAL DOCUMENT, BY USING SIMPLESCALAR,
+ * YOU ARE AGREEING TO THESE TERMS AND CONDITIONS.
+ * 
+ * No portion of this work may be used by any commercial entity, or for any
+ * commercial purpose, without the prior, written permission of SimpleScalar,
+ * LLC (info@simplescalar.com). Nonprofit and noncommercial use is permitted
+ * as described below.
+ * 
+ * 1. SimpleScalar is provided AS IS, with no warranty of any kind, express
+ * or implied. The user of the program accepts full responsibility for the
+ * application of the program and the use of any results.
+ * 
+ * 2. Nonprofit and noncommercial use is encouraged. SimpleScalar may be
+ * downloaded, compiled, executed, copied, and modified solely for nonprofit,
+ * educational, noncommercial research, and noncommercial scholarship
+ * purposes provided that this notice in its entirety accompanies all copies.
+ * Copies of the modified software can be delivered to persons who use it
+ * solely for nonprofit, educational, noncommercial research, and
+ * noncommercial scholarship purposes provided that this notice in its
+ * entirety accompanies all copies.
+ * 
+ * 3. ALL COMMERCIAL USE, AND ALL USE BY FOR PROFIT ENTITIES, IS EXPRESSLY
+ * PROHIBITED WITHOUT A LICENSE FROM SIMPLESCALAR, LLC (info@simplescalar.com).
+ * 
+ * 4. No nonprofit user may place any restrictions on the use of this software,
+ * including as modified by the user, by any other authorized user.
+ * 
+ * 5. Noncommercial and nonprofit users may distribute copies of SimpleScalar
+ * in compiled or executable form as set forth in Section 2, provided that
+ * either: (A) it is accompanied by the corresponding machine-readable source
+ * code, or (B) it is accompanied by a written offer, with no time limit, to
+ * give anyone a machine-readable copy of the corresponding source code in
+ * return for reimbursement of the cost of distribution. This written offer
+ * must permit verbatim duplication by anyone, or (C) it is distributed by
+ * someone who received only the executable form, and is accompanied by a
+ * copy of the written offer of source code.
+ * 
+ * 6. SimpleScalar was developed by Todd M. Austin, Ph.D. The tool suite is
+ * currently maintained by SimpleScalar LLC (info@simplescalar.com). US Mail:
+ * 2395 Timbercrest Court, Ann Arbor, MI 48105.
+ * 
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ */
+
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "host.h"
+#include "misc.h"
+#include "machine.h"
+#include "stats.h"
+#include "sdist.h"
+
+/* initial capacities of the fully associative stack, grown as needed */
+#define SDIST_INIT_NODES	(1 << 12)
+#define SDIST_INIT_HSIZE	(1 << 12)
+#define SDIST_INIT_TSIZE	(1 << 14)
+
+/* hash bucket of block address BADDR */
+#define SDIST_HASH(sd, baddr)						\
+  (((baddr) ^ ((baddr) >> 11) ^ ((baddr) >> 23)) & ((sd)->hsize - 1))
+
+/* add VAL at time T of the Fenwick tree of SD */
+static void
+tree_add(struct sdist_t *sd,			/* stack distance engine */
+	 unsigned int t,			/* time */
+	 int val)				/* +1 to mark, -1 to unmark */
+{
+  for (t++; t <= sd->tsize; t += t & -t)
+    sd->tree[t-1] += val;
+}
+
+/* number of marks at times 0 to T, inclusive */
+static unsigned int
+tree_sum(struct sdist_t *sd,			/* stack distance engine */
+	 unsigned int t)			/* time */
+{
+  unsigned int sum = 0;
+
+  for (t++; t > 0; t -= t & -t)
+    sum += sd->tree[t-1];
+  return sum;
+}
+
+/* renumber the last reference of every block to times 0 .. NNODES-1, in
+   order, doubling the tree first if it would be more than half full */
+static void
+compact_time(struct sdist_t *sd)		/* stack distance engine */
+{
+  unsigned int t, newt = 0;
+
+  for (t=0; t < sd->now; t++)
+    {
+      if (sd->owner[t] >= 0)
+	{
+	  sd->owner[newt] = sd->owner[t];
+	  sd->nodes[sd->owner[t]].time = newt;
+	  newt++;
+	}
+    }
+  sd->now = newt;
+
+  if (2 * (unsigned int)sd->nnodes > sd->tsize)
+    {
+      sd->tsize *= 2;
+      sd->owner = (int *)realloc(sd->owner, sd->tsize * sizeof(int));
+      sd->tree = (unsigned int *)
+	realloc(sd->tree, sd->tsize * sizeof(unsigned int));
+      if (!sd->owner || !sd->tree)
+	fatal("out of virtual memory");
+    }
+  for (t=newt; t < sd->tsize; t++)
+    sd->owner[t] = -1;
+
+  /* rebuild the tree in linear time, every time up to NOW is marked */
+  for (t=0; t < sd->tsize; t++)
+    sd->tree[t] = (t < newt);
+  for (t=1; t <= sd->tsize; t++)
+    {
+      unsigned int parent = t + (t & -t);
+
+      if (parent <= sd->tsize)
+	sd->tree[parent-1] += sd->tree[t-1];
+    }
+}
+
+/* double the hash table of the fully associative stack */
+static void
+grow_htab(struct sdist_t *sd)			/* stack distance engine */
+{
+  int i;
+
+  free(sd->htab);
+  sd->hsize *= 2;
+  sd->htab = (int *)malloc(sd->hsize * sizeof(int));
+  if (!sd->htab)
+    fatal("out of virtual memory");
+  for (i=0; i < sd->hsize; i++)
+    sd->htab[i] = -1;
+  for (i=0; i < sd->nnodes; i++)
+    {
+      int bucket = SDIST_HASH(sd, sd->nodes[i].baddr);
+
+      sd->nodes[i].next = sd->htab[bucket];
+      sd->htab[bucket] = i;
+    }
+}
+
+/* reference block BADDR of the fully associative stack */
+static void
+fa_access(struct sdist_t *sd,			/* stack distance engine */
+	  md_addr_t baddr)			/* block address */
+{
+  int i, bucket = SDIST_HASH(sd, baddr);
+
+  /* make room for one more time stamp */
+  if (sd->now == sd->tsize)
+    compact_time(sd);
+
+  for (i=sd->htab[bucket]; i >= 0; i=sd->nodes[i].next)
+    {
+      if (sd->nodes[i].baddr == baddr)
+	break;
+    }
+
+  if (i >= 0)
+    {
+      /* distinct blocks referenced since the last reference to BADDR */
+      unsigned int last = sd->nodes[i].time;
+      unsigned int dist = tree_sum(sd, sd->now - 1) - tree_sum(sd, last);
+      int b = 0;
+
+      while (b < SDIST_FA_BUCKETS-1 && ((qword_t)1 << b) < (qword_t)dist + 1)
+	b++;
+      sd->fa_hist[b]++;
+
+      tree_add(sd, last, -1);
+      sd->owner[last] = -1;
+    }
+  else
+    {
+      /* first reference to BADDR, a cold miss in every cache */
+      if (sd->nnodes == sd->max_nodes)
+	{
+	  sd->max_nodes *= 2;
+	  sd->nodes = (struct sdist_node_t *)
+	    realloc(sd->nodes, sd->max_nodes * sizeof(struct sdist_node_t));
+	  if (!sd->nodes)
+	    fatal("out of virtual memory");
+	}
+      i = sd->nnodes++;
+      sd->nodes[i].baddr = baddr;
+      sd->nodes[i].next = sd->htab[bucket];
+      sd->htab[bucket] = i;
+
+      if (sd->nnodes > 2 * sd->hsize)
+	grow_htab(sd);
+    }
+
+  sd->nodes[i].time = sd->now;
+  sd->owner[sd->now] = i;
+  tree_add(sd, sd->now, +1);
+  sd->now++;
+}
+
+/* create a stack distance engine for blocks of BSIZE bytes and set counts
+   2^MIN_SETS to 2^MAX_SETS, keeping stacks up to MAX_ASSOC deep */
+struct sdist_t *			/* stack distance engine */
+sdist_create(char *name,		/* name of the engine */
+	     int bsize,			/* block size in bytes */
+	     int min_sets,		/* log2 of the smallest set count */
+	     int max_sets,		/* log2 of the largest set count */
+	     int max_assoc)		/* largest associativity of interest */
+{
+  struct sdist_t *sd;
+  int i, l;
+
+  /* check all parameters */
+  if (bsize <= 0 || (bsize & (bsize-1)) != 0)
+    fatal("stack distance block size `%d' must be a power of two", bsize);
+  if (min_sets < 0 || max_sets < min_sets || max_sets > 24)
+    fatal("stack distance set counts 2^%d to 2^%d are out of range",
+	  min_sets, max_sets);
+  if (max_assoc <= 0 || (max_assoc & (max_assoc-1)) != 0)
+    fatal("stack distance associativity `%d' must be a power of two",
+	  max_assoc);
+
+  sd = (struct sdist_t *)calloc(1, sizeof(struct sdist_t));
+  if (!sd)
+    fatal("out of virtual memory");
+
+  sd->name = mystrdup(name);
+  sd->bsize = bsize;
+  sd->bshift = log_base2(bsize);
+  sd->min_sets = min_sets;
+  sd->max_sets = max_sets;
+  sd->max_assoc = max_assoc;
+
+  /* set-associative stacks, all empty */
+  sd->nlevels = max_sets - min_sets + 1;
+  sd->levels = (struct sdist_level_t *)
+    calloc(sd->nlevels, sizeof(struct sdist_level_t));
+  if (!sd->levels)
+    fatal("out of virtual memory");
+  for (l=0; l < sd->nlevels; l++)
+    {
+      struct sdist_level_t *lv = &sd->levels[l];
+
+      lv->nsets = 1 << (min_sets + l);
+      lv->stacks = (md_addr_t *)
+	calloc((size_t)lv->nsets * max_assoc, sizeof(md_addr_t));
+      lv->depth = (int *)calloc(lv->nsets, sizeof(int));
+      lv->hits = (counter_t *)calloc(max_assoc, sizeof(counter_t));
+      if (!lv->stacks || !lv->depth || !lv->hits)
+	fatal("out of virtual memory");
+    }
+
+  /* fully associative stack, empty */
+  sd->max_nodes = SDIST_INIT_NODES;
+  sd->nodes = (struct sdist_node_t *)
+    malloc(sd->max_nodes * sizeof(struct sdist_node_t));
+  sd->hsize = SDIST_INIT_HSIZE;
+  sd->htab = (int *)malloc(sd->hsize * sizeof(int));
+  sd->tsize = SDIST_INIT_TSIZE;
+  sd->tree = (unsigned int *)calloc(sd->tsize, sizeof(unsigned int));
+  sd->owner = (int *)malloc(sd->tsize * sizeof(int));
+  if (!sd->nodes || !sd->htab || !sd->tree || !sd->owner)
+    fatal("out of virtual memory");
+  for (i=0; i < sd->hsize; i++)
+    sd->htab[i] = -1;
+  for (i=0; i < (int)sd->tsize; i++)
+    sd->owner[i] = -1;
+
+  return sd;
+}
+
+/* account a reference to address ADDR */
+void
+sdist_access(struct sdist_t *sd,	/* stack distance engine */
+	     md_addr_t addr)		/* address referenced */
+{
+  md_addr_t baddr = addr >> sd->bshift;
+  int l, d;
+
+  sd->refs++;
+
+  for (l=0; l < sd->nlevels; l++)
+    {
+      struct sdist_level_t *lv = &sd->levels[l];
+      int set = baddr & (lv->nsets - 1);
+      md_addr_t *stack = &lv->stacks[(size_t)set * sd->max_assoc];
+      int depth = lv->depth[set];
+
+      /* find the block, counting hits by depth */
+      for (d=0; d < depth; d++)
+	{
+	  if (stack[d] == baddr)
+	    break;
+	}
+      if (d < depth)
+	lv->hits[d]++;
+      else if (depth < sd->max_assoc)
+	lv->depth[set] = ++depth;
+      else
+	d = depth - 1;		/* the deepest block falls off the stack */
+
+      /* move the block to the top of the stack */
+      for (; d > 0; d--)
+	stack[d] = stack[d-1];
+      stack[0] = baddr;
+    }
+
+  fa_access(sd, baddr);
+}
+
+/* misses of an LRU cache of NSETS sets of ASSOC ways, both powers of two
+   within the range of the engine, or NSETS == 1 and any power of two ASSOC
+   for a fully associative cache */
+counter_t				/* misses, cold misses included */
+sdist_misses(struct sdist_t *sd,	/* stack distance engine */
+	     int nsets,			/* number of sets */
+	     int assoc)			/* associativity */
+{
+  counter_t hits = 0;
+  int i;
+
+  if (nsets == 1)
+    {
+      /* fully associative, 2^B blocks hit buckets 0 to B */
+      for (i=0; i < SDIST_FA_BUCKETS && ((qword_t)1 << i) <= (qword_t)assoc;
+	   i++)
+	hits += sd->fa_hist[i];
+    }
+  else
+    {
+      struct sdist_level_t *lv;
+      int l = log_base2(nsets) - sd->min_sets;
+
+      if (l < 0 || l >= sd->nlevels || assoc > sd->max_assoc)
+	panic("cache geometry is outside of the stack distance engine");
+      lv = &sd->levels[l];
+      for (i=0; i < assoc; i++)
+	hits += lv->hits[i];
+    }
+  return sd->refs - hits;
+}
+
+/* print the engine configuration */
+void
+sdist_config(struct sdist_t *sd,	/* stack distance engine */
+	     FILE *stream)		/* output stream */
+{
+  fprintf(stream,
+	  "sdist: %s: %d byte blocks, %d to %d sets, up to %d ways, LRU\n",
+	  sd->name, sd->bsize, 1 << sd->min_sets, 1 << sd->max_sets,
+	  sd->max_assoc);
+}
+
+/* register the engine stats */
+void
+sdist_reg_stats(struct sdist_t *sd,	/* stack distance engine */
+		struct stat_sdb_t *sdb)	/* stats database */
+{
+  char buf[512];
+
+  sprintf(buf, "%s.refs", sd->name);
+  stat_reg_counter(sdb, buf, "total number of references", &sd->refs, 0, NULL);
+  sprintf(buf, "%s.blocks", sd->name);
+  stat_reg_int(sdb, buf, "total number of distinct blocks referenced",
+	       &sd->nnodes, 0, NULL);
+}
+
+/* print the miss rate of every cache geometry covered by the engine */
+void
+sdist_print(struct sdist_t *sd,		/* stack distance engine */
+	    FILE *stream)		/* output stream */
+{
+  double refs = (double)sd->refs;
+  int l, assoc, b;
+
+  fprintf(stream, "\nsdist: %s: LRU miss rates, %.0f references, "
+	  "%d byte blocks\n", sd->name, refs, sd->bsize);
+  fprintf(stream, "sdist: %s: %8s %6s %10s %12s %10s\n", sd->name,
+	  "sets", "assoc", "size", "misses", "miss_rate");
+  for (l=0; l < sd->nlevels; l++)
+    {
+      int nsets = sd->levels[l].nsets;
+
+      if (nsets == 1)
+	continue;
+      for (assoc=1; assoc <= sd->max_assoc; assoc *= 2)
+	{
+	  counter_t misses = sdist_misses(sd, nsets, assoc);
+
+	  fprintf(stream, "sdist: %s: %8d %6d %10.0f %12.0f %10.4f\n",
+		  sd->name, nsets, assoc,
+		  (double)nsets * assoc * sd->bsize, (double)misses,
+		  refs ? (double)misses / refs : 0.0);
+	}
+    }
+
+  /* fully associative, up to the first size that holds every block */
+  for (b=0; b < SDIST_FA_BUCKETS; b++)
+    {
+      counter_t misses = sdist_misses(sd, 1, 1 << b);
+
+      fprintf(stream, "sdist: %s: %8d %6d %10.0f %12.0f %10.4f\n",
+	      sd->name, 1, 1 << b, (double)((qword_t)1 << b) * sd->bsize,
+	      (double)misses, refs ? (double)misses / refs : 0.0);
+      if (((qword_t)1 << b) >= (qword_t)sd->nnodes)
+	break;
+    }
+}
@@ -0,0 +1,173 @@
+/* sdist.h - LRU stack distance (single-pass cache simulation) interfaces */
+
+/* SimpleScalar(TM) Tool Suite
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ * All Rights Reserved. 
+ * 
+ * THIS IS A LEGAL DOCUMENT, BY USING SIMPLESCALAR,
+ * YOU ARE AGREEING TO THESE TERMS AND CONDITIONS.
+ * 
+ * No portion of this work may be used by any commercial entity, or for any
+ * commercial purpose, without the prior, written permission of SimpleScalar,
+ * LLC (info@simplescalar.com). Nonprofit and noncommercial use is permitted
+ * as described below.
+ * 
+ * 1. SimpleScalar is provided AS IS, with no warranty of any kind, express
+ * or implied. The user of the program accepts full responsibility for the
+ * application of the program and the use of any results.
+ * 
+ * 2. Nonprofit and noncommercial use is encouraged. SimpleScalar may be
+ * downloaded, compiled, executed, copied, and modified solely for nonprofit,
+ * educational, noncommercial research, and noncommercial scholarship
+ * purposes provided that this notice in its entirety accompanies all copies.
+ * Copies of the modified software can be delivered to persons who use it
+ * solely for nonprofit, educational, noncommercial research, and
+ * noncommercial scholarship purposes provided that this notice in its
+ * entirety accompanies all copies.
+ * 
+ * 3. ALL COMMERCIAL USE, AND ALL USE BY FOR PROFIT ENTITIES, IS EXPRESSLY
+ * PROHIBITED WITHOUT A LICENSE FROM SIMPLESCALAR, LLC (info@simplescalar.com).
+ * 
+ * 4. No nonprofit user may place any restrictions on the use of this software,
+ * including as modified by the user, by any other authorized user.
+ * 
+ * 5. Noncommercial and nonprofit users may distribute copies of SimpleScalar
+ * in compiled or executable form as set forth in Section 2, provided that
+ * either: (A) it is accompanied by the corresponding machine-readable source
+ * code, or (B) it is accompanied by a written offer, with no time limit, to
+ * give anyone a machine-readable copy of the corresponding source code in
+ * return for reimbursement of the cost of distribution. This written offer
+ * must permit verbatim duplication by anyone, or (C) it is distributed by
+ * someone who received only the executable form, and is accompanied by a
+ * copy of the written offer of source code.
+ * 
+ * 6. SimpleScalar was developed by Todd M. Austin, Ph.D. The tool suite is
+ * currently maintained by SimpleScalar LLC (info@simplescalar.com). US Mail:
+ * 2395 Timbercrest Court, Ann Arbor, MI 48105.
+ * 
+ * Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+ */
+
+
+#ifndef SDIST_H
+#define SDIST_H
+
+#include <stdio.h>
+
+#include "host.h"
+#include "misc.h"
+#include "machine.h"
+#include "stats.h"
+
+/*
+ * This module simulates a whole family of LRU caches in a single pass over a
+ * reference stream by computing the LRU stack distance of every reference
+ * (Mattson et al., 1970): a reference whose block was last touched D distinct
+ * blocks ago hits in every LRU cache holding more than D blocks of its set.
+ * One run thus yields the miss rate of every associativity and size of a
+ * given block size, rather than one sim-cache run per geometry.
+ *
+ * For each set count 2^MIN_SETS .. 2^MAX_SETS (as log2), every set keeps an
+ * LRU stack bounded at MAX_ASSOC blocks, so a depth histogram per set count
+ * gives the misses of all associativities up to MAX_ASSOC.  A fully
+ * associative stack is kept as well, unbounded, with the Bennett-Kruskal
+ * method: each block remembers the time of its last reference, a Fenwick
+ * tree over time marks the last reference of every block, and the stack
+ * distance of a reference is the number of marks since the block's previous
+ * reference.  Time is renumbered when the tree fills, so the tree stays
+ * proportional to the number of distinct blocks.
+ */
+
+/* fully associative stack distances are histogrammed by powers of two, bucket
+   B counts the distances D with 2^(B-1) < D+1 <= 2^B, i.e., B = ceil(log2(D+1))
+   and the references that hit in a fully associative cache of 2^B blocks but
+   not one of half that size */
+#define SDIST_FA_BUCKETS	40
+
+/* stack of one set count */
+struct sdist_level_t
+{
+  int nsets;			/* number of sets */
+  md_addr_t *stacks;		/* NSETS stacks of MAX_ASSOC block addresses,
+				   most recently used first */
+  int *depth;			/* blocks in each stack */
+  counter_t *hits;		/* HITS[D] references found at depth D */
+};
+
+/* block of the fully associative stack */
+struct sdist_node_t
+{
+  md_addr_t baddr;		/* block address */
+  unsigned int time;		/* time of last reference */
+  int next;			/* next node in hash chain, -1 at the end */
+};
+
+/* stack distance engine definition */
+struct sdist_t
+{
+  /* parameters */
+  char *name;			/* engine name */
+  int bsize;			/* block size in bytes */
+  int bshift;			/* log2 of BSIZE */
+  int min_sets;			/* log2 of the smallest set count */
+  int max_sets;			/* log2 of the largest set count */
+  int max_assoc;		/* deepest stack kept per set */
+
+  /* set-associative stacks, one per set count */
+  int nlevels;			/* number of set counts */
+  struct sdist_level_t *levels;	/* stacks of each set count */
+
+  /* fully associative stack, Bennett-Kruskal */
+  struct sdist_node_t *nodes;	/* one node per distinct block */
+  int nnodes;			/* number of distinct blocks */
+  int max_nodes;		/* allocated size of NODES */
+  int *htab;			/* hash table of NODES, -1 if empty */
+  int hsize;			/* number of hash buckets, a power of two */
+  unsigned int *tree;		/* Fenwick tree of last references by time */
+  int *owner;			/* node last referenced at each time, or -1 */
+  unsigned int tsize;		/* capacity of TREE and OWNER, in time */
+  unsigned int now;		/* time of next reference */
+  counter_t fa_hist[SDIST_FA_BUCKETS];/* histogram of FA stack distances */
+
+  /* stats */
+  counter_t refs;		/* total number of references */
+};
+
+/* create a stack distance engine for blocks of BSIZE bytes and set counts
+   2^MIN_SETS to 2^MAX_SETS, keeping stacks up to MAX_ASSOC deep */
+struct sdist_t *			/* stack distance engine */
+sdist_create(char *name,		/* name of the engine */
+	     int bsize,			/* block size in bytes */
+	     int min_sets,		/* log2 of the smallest set count */
+	     int max_sets,		/* log2 of the largest set count */
+	     int max_assoc);		/* largest associativity of interest */
+
+/* account a reference to address ADDR */
+void
+sdist_access(struct sdist_t *sd,	/* stack distance engine */
+	     md_addr_t addr);		/* address referenced */
+
+/* misses of an LRU cache of NSETS sets of ASSOC ways, both powers of two
+   within the range of the engine, or NSETS == 1 and any power of two ASSOC
+   for a fully associative cache */
+counter_t				/* misses, cold misses included */
+sdist_misses(struct sdist_t *sd,	/* stack distance engine */
+	     int nsets,			/* number of sets */
+	     int assoc);		/* associativity */
+
+/* print the engine configuration */
+void
+sdist_config(struct sdist_t *sd,	/* stack distance engine */
+	     FILE *stream);		/* output stream */
+
+/* register the engine stats */
+void
+sdist_reg_stats(struct sdist_t *sd,	/* stack distance engine */
+		struct stat_sdb_t *sdb);/* stats database */
+
+/* print the miss rate of every cache geometry covered by the engine */
+void
+sdist_print(struct sdist_t *sd,		/* stack distance engine */
+	    FILE *stream);		/* output stream */
+
+#endif /* SDIST_H */
@@ -54,6 +54,9 @@
 #include <string.h>
 #include <math.h>
 #include <assert.h>
+#ifdef SIM_THREADS
+#include <pthread.h>
+#endif /* SIM_THREADS */
 
 #include "host.h"
 #include "misc.h"
@@ -61,7 +64,13 @@
 #include "regs.h"
 #include "memory.h"
 #include "cache.h"
+#include "dram.h"
+#include "ptw.h"
+#include "sdist.h"
+#include "mtrace.h"
+#include "missprof.h"
 #include "loader.h"
+#include "symbol.h"
 #include "syscall.h"
 #include "dlite.h"
 #include "sim.h"
@@ -72,6 +81,21 @@
  * up to two levels of instruction and data cache (with any levels unified),
  * and one level of instruction and data TLBs.  No timing information is
  * generated (hence the distinction, "functional" simulator).
+ *
+ * The memory references of a run can be captured to a trace with -trace:out,
+ * and later replayed with -trace:replay, which drives the caches straight
+ * from the trace and so skips decoding and executing the program.  A replay
+ * may be split across threads by cache set, each thread simulating the sets
+ * of one shard of every cache, as the sets of a cache are independent, with
+ * the trace decoded once and its references handed to the threads.
+ *
+ * Main memory may be modeled as a DRAM (-mem:dram) to gather row buffer
+ * statistics for the miss stream, timed on a notional processor that
+ * executes one instruction per cycle and blocks on every read from memory.
+ *
+ * With -missprof, every data cache miss is charged to the PC of the load or
+ * store and to the data symbol or segment it referenced, and the PCs and
+ * objects with the most misses are reported after the statistics.
  */
 
 /* simulated registers */
@@ -104,16 +128,98 @@ static struct cache_t *itlb = NULL;
 /* data TLB */
 static struct cache_t *dtlb = NULL;
 
+/* second level TLB, shared by instructions and data */
+static struct cache_t *stlb = NULL;
+
+/* page table walker, or NULL */
+static struct ptw_t *ptw = NULL;
+
+/* address under which the TLBs hold the translation of ADDR */
+#define TLB_ADDR(ADDR)		(ptw ? ptw_tlb_addr(ptw, (ADDR)) : (ADDR))
+
+/* single-pass stack distance engines for instruction and data references,
+   the same engine if unified */
+static struct sdist_t *sdist_inst = NULL;
+static struct sdist_t *sdist_data = NULL;
+
+/* memory reference traces being captured and replayed */
+static struct mtrace_t *mtrace_out = NULL;
+static struct mtrace_t *mtrace_in = NULL;
+
+/* DRAM timing model of main memory, or NULL */
+static struct dram_t *mem_dram = NULL;
+
+/* cycles the notional processor has spent blocked on DRAM reads */
+static tick_t mem_dram_stall = 0;
+
+/* DRAM data bus, as sim-outorder's default -mem:width and -mem:lat */
+#define DRAM_BUS_WIDTH		8
+#define DRAM_TRANSFER_LAT	2
+
+#ifdef SIM_THREADS
+/* trace records handed to a replay thread at a time, and the batches of
+   them queued per replay thread */
+#define REPLAY_BATCH		4096
+#define REPLAY_QUEUE		4
+
+/* a batch of trace records for one replay thread */
+struct replay_batch_t
+{
+  int nrecs;				/* records in the batch */
+  struct mtrace_rec_t recs[REPLAY_BATCH];/* the records */
+};
+#endif /* SIM_THREADS */
+
+/* one shard of the caches, holding the sets selected by SHARD_OF(), the
+   TLBs and stack distance engines are not sharded and are simulated by the
+   thread that decodes the trace, shard 0's caches are the ones above */
+struct shard_t
+{
+  int id;				/* shard number */
+  struct cache_t *il1, *il2;		/* instruction caches of the shard */
+  struct cache_t *dl1, *dl2;		/* data caches of the shard */
+  struct missprof_t *mp;		/* miss profile of the shard */
+#ifdef SIM_THREADS
+  /* records of the shard queued for its replay thread, the batches
+     QUEUE[QHEAD..QHEAD+QCOUNT) modulo REPLAY_QUEUE are full and FILL is
+     the one after them being filled by the decoding thread */
+  struct replay_batch_t *queue;		/* ring of batches */
+  struct replay_batch_t *fill;		/* batch being filled, or NULL */
+  int qhead, qcount;			/* full batches */
+  int done;				/* non-zero once the trace is decoded */
+  pthread_mutex_t lock;			/* protects QHEAD, QCOUNT and DONE */
+  pthread_cond_t cond;			/* signals a change to them */
+#endif /* SIM_THREADS */
+};
+
+/* cache shards, one per replay thread */
+static int nshards /* = 1 */;
+static struct shard_t *shards = NULL;
+
+/* shard number of ADDR, taken from set index bits common to all caches */
+static int shard_shift = 0;
+#define SHARD_OF(ADDR)							\
+  (((ADDR) >> shard_shift) & (nshards - 1))
+
+#ifdef SIM_THREADS
+/* shard of the calling replay thread */
+static pthread_key_t shard_key;
+
+/* cache X of the calling thread's shard */
+#define SHARD_CACHE(X)							\
+  (nshards > 1								\
+   ? ((struct shard_t *)pthread_getspecific(shard_key))->X		\
+   : cache_##X)
+#else /* !SIM_THREADS */
+#define SHARD_CACHE(X)		(cache_##X)
+#endif /* SIM_THREADS */
+
 /* text-based stat profiles */
 #define MAX_PCSTAT_VARS 8
 static struct stat_stat_t *pcstat_stats[MAX_PCSTAT_VARS];
 static counter_t pcstat_lastvals[MAX_PCSTAT_VARS];
 static struct stat_stat_t *pcstat_sdists[MAX_PCSTAT_VARS];
 
-md_addr_t get_PC() {	// return the current program counter (PC)
-   return regs.regs_PC;
-}
-
 /* wedge all stat values into a counter_t */
 #define STATVAL(STAT)							\
   ((STAT)->sc == sc_int							\
@@ -124,6 +230,24 @@ md_addr_t get_PC() {	// return the current program counter (PC)
 	 ? *((STAT)->variant.for_counter.var)				\
 	 : (panic("bad stat class"), 0))))
 
+/* access main memory, only timed for the DRAM statistics */
+static void
+dram_mem_access(enum mem_cmd cmd,	/* Read or Write */
+		md_addr_t baddr,		/* block address to access */
+		int bsize)			/* size of block to access */
+{
+  if (mem_dram)
+    {
+      unsigned int lat =
+	dram_access(mem_dram, cmd, baddr, bsize,
+		    /* now */(tick_t)sim_num_insn + mem_dram_stall);
+
+      /* the processor waits for reads, writes are buffered */
+      if (cmd == Read)
+	mem_dram_stall += lat;
+    }
+}
+
 /* l1 data cache l1 block miss handler function */
 static unsigned int			/* latency of block access */
 dl1_access_fn(enum mem_cmd cmd,		/* access cmd, Read or Write */
@@ -131,17 +255,21 @@ dl1_access_fn(enum mem_cmd cmd,		/* access cmd, Read or Write */
 	      int bsize,		/* size of block to access */
 	      struct cache_blk_t *blk,	/* ptr to block in upper level */
 	      tick_t now,		/* time of access */
+	      md_addr_t pc,		/* PC of the requesting instruction */
 	      int prefetch)		/* if 1 the access is a prefetch, if 0 it is a regular cache access */
 {
-  if (cache_dl2)
+  struct cache_t *dl2 = SHARD_CACHE(dl2);
+
+  if (dl2)
     {
       /* access next level of data cache hierarchy */
-      return cache_access(cache_dl2, cmd, baddr, NULL, bsize, 
-			  /* now */now, /* pudata */NULL, /* repl addr */NULL, prefetch);
+      return cache_access(dl2, cmd, baddr, NULL, bsize, 
+			  /* now */now, /* pudata */NULL, /* repl addr */NULL, pc, prefetch);
     }
   else
     {
-      /* access main memory, which is always done in the main simulator loop */
+      /* access main memory */
+      dram_mem_access(cmd, baddr, bsize);
       return /* access latency, ignored */1;
     }
 }
@@ -153,14 +281,25 @@ dl2_access_fn(enum mem_cmd cmd,		/* access cmd, Read or Write */
 	      int bsize,		/* size of block to access */
 	      struct cache_blk_t *blk,	/* ptr to block in upper level */
 	      tick_t now,		/* time of access */
+	      md_addr_t pc,		/* PC of the requesting instruction */
 	      int prefetch)
 	      
 {
-  /* this is a miss to the lowest level, so access main memory, which is
-     always done in the main simulator loop */
+  /* this is a miss to the lowest level, so access main memory */
+  dram_mem_access(cmd, baddr, bsize);
   return /* access latency, ignored */1;
 }
 
+/* compressed l2 data cache block contents function, the simulator keeps
+   no data in its caches, so the contents are read from simulated memory */
+static void
+l2_blk_data(md_addr_t baddr,		/* block address to read */
+	    byte_t *buf,		/* buffer for the block contents */
+	    int bsize)			/* size of block to read */
+{
+  mem_access(mem, Read, baddr, buf, bsize);
+}
+
 /* l1 inst cache l1 block miss handler function */
 static unsigned int			/* latency of block access */
 il1_access_fn(enum mem_cmd cmd,		/* access cmd, Read or Write */
@@ -168,18 +307,22 @@ il1_access_fn(enum mem_cmd cmd,		/* access cmd, Read or Write */
 	      int bsize,		/* size of block to access */
 	      struct cache_blk_t *blk,	/* ptr to block in upper level */
 	      tick_t now,		/* time of access */
+	      md_addr_t pc,		/* PC of the requesting instruction */
 	      int prefetch)		/* if 1 the access is a prefetch, if 0 it is a regular cache access */
 
 {
-  if (cache_il2)
+  struct cache_t *il2 = SHARD_CACHE(il2);
+
+  if (il2)
     {
       /* access next level of inst cache hierarchy */
-      return cache_access(cache_il2, cmd, baddr, NULL, bsize,
-			  /* now */now, /* pudata */NULL, /* repl addr */NULL, prefetch);
+      return cache_access(il2, cmd, baddr, NULL, bsize,
+			  /* now */now, /* pudata */NULL, /* repl addr */NULL, pc, prefetch);
     }
   else
     {
-      /* access main memory, which is always done in the main simulator loop */
+      /* access main memory */
+      dram_mem_access(cmd, baddr, bsize);
       return /* access latency, ignored */1;
     }
 }
@@ -191,13 +334,50 @@ il2_access_fn(enum mem_cmd cmd,		/* access cmd, Read or Write */
 	      int bsize,		/* size of block to access */
 	      struct cache_blk_t *blk,	/* ptr to block in upper level */
 	      tick_t now,		/* time of access */
+	      md_addr_t pc,		/* PC of the requesting instruction */
 	      int prefetch)
 {
-  /* this is a miss to the lowest level, so access main memory, which is
-     always done in the main simulator loop */
+  /* this is a miss to the lowest level, so access main memory */
+  dram_mem_access(cmd, baddr, bsize);
   return /* access latency, ignored */1;
 }
 
+/* page table entry load function, walks go through the data caches */
+static unsigned int			/* latency of PTE load */
+ptw_mem_access(md_addr_t addr,		/* address of the PTE */
+	       tick_t now)		/* time of access */
+{
+  if (cache_dl1)
+    cache_access(cache_dl1, Read, addr, NULL, PTW_PTE_SIZE, 0,
+		 NULL, NULL, /* pc */0, /* prefetch */0);
+  else
+    dram_mem_access(Read, addr, PTW_PTE_SIZE);
+  return /* access latency, ignored */1;
+}
+
+/* huge page function, the text segment and the data segment up to the
+   break are large mappings, backed by huge pages wherever they wholly
+   contain one */
+static int				/* non-zero if a huge page */
+huge_mapped(md_addr_t base,		/* base of the huge page */
+	    md_addr_t size)		/* size of the huge page */
+{
+  return ((base >= ld_text_base && base + size <= ld_text_base + ld_text_size)
+	  || (base >= ld_data_base && base + size <= ld_brk_point));
+}
+
+/* refill a first level TLB, from the second level TLB if there is one,
+   else from the page table */
+static void
+tlb_refill(md_addr_t baddr)		/* TLB address of the page */
+{
+  if (stlb)
+    cache_access(stlb, Read, baddr, NULL, sizeof(md_addr_t), 0,
+		 NULL, NULL, /* pc */0, /* prefetch */0);
+  else if (ptw)
+    ptw_walk(ptw, baddr, 0);
+}
+
 /* inst cache block miss handler function */
 static unsigned int			/* latency of block access */
 itlb_access_fn(enum mem_cmd cmd,	/* access cmd, Read or Write */
@@ -205,6 +385,7 @@ itlb_access_fn(enum mem_cmd cmd,	/* access cmd, Read or Write */
 	       int bsize,		/* size of block to access */
 	       struct cache_blk_t *blk,	/* ptr to block in upper level */
 	       tick_t now,		/* time of access */
+	       md_addr_t pc,		/* PC of the requesting instruction */
 	       int prefetch)
 {
   md_addr_t *phy_page_ptr = (md_addr_t *)blk->user_data;
@@ -215,6 +396,7 @@ itlb_access_fn(enum mem_cmd cmd,	/* access cmd, Read or Write */
   /* fake translation, for now... */
   *phy_page_ptr = 0;
 
+  tlb_refill(baddr);
   return /* access latency, ignored */1;
 }
 
@@ -225,6 +407,29 @@ dtlb_access_fn(enum mem_cmd cmd,	/* access cmd, Read or Write */
 	       int bsize,		/* size of block to access */
 	       struct cache_blk_t *blk,	/* ptr to block in upper level */
 	       tick_t now,		/* time of access */
+	       md_addr_t pc,		/* PC of the requesting instruction */
+	       int prefetch)
+{
+  md_addr_t *phy_page_ptr = (md_addr_t *)blk->user_data;
+
+  /* no real memory access, however, should have user data space attached */
+  assert(phy_page_ptr);
+
+  /* fake translation, for now... */
+  *phy_page_ptr = 0;
+
+  tlb_refill(baddr);
+  return /* access latency, ignored */1;
+}
+
+/* second level TLB block miss handler function */
+static unsigned int			/* latency of block access */
+stlb_access_fn(enum mem_cmd cmd,	/* access cmd, Read or Write */
+	       md_addr_t baddr,		/* block address to access */
+	       int bsize,		/* size of block to access */
+	       struct cache_blk_t *blk,	/* ptr to block in upper level */
+	       tick_t now,		/* time of access */
+	       md_addr_t pc,		/* PC of the requesting instruction */
 	       int prefetch)
 {
   md_addr_t *phy_page_ptr = (md_addr_t *)blk->user_data;
@@ -235,6 +440,8 @@ dtlb_access_fn(enum mem_cmd cmd,	/* access cmd, Read or Write */
   /* fake translation, for now... */
   *phy_page_ptr = 0;
 
+  if (ptw)
+    ptw_walk(ptw, baddr, 0);
   return /* access latency, ignored */1;
 }
 
@@ -245,9 +452,52 @@ static char *cache_il1_opt /* = "none" */;
 static char *cache_il2_opt /* = "none" */;
 static char *itlb_opt /* = "none" */;
 static char *dtlb_opt /* = "none" */;
+static char *stlb_opt /* = "none" */;
+static int tlb_ptw /* = FALSE */;
+static int tlb_pwc_size /* = 16 */;
+static int tlb_huge /* = FALSE */;
 static int flush_on_syscalls /* = FALSE */;
 static int compress_icache_addrs /* = FALSE */;
 
+/* victim caches and inclusion of the l1 caches in the l2 caches */
+static int cache_dl1_victim /* = 0 */;
+static int cache_dl2_victim /* = 0 */;
+static int cache_il1_victim /* = 0 */;
+static char *cache_incl_opt /* = "nine" */;
+
+/* set index functions, i.e., {bits|xor|prime|skew} */
+static char *cache_dl1_index_opt /* = "bits" */;
+static char *cache_dl2_index_opt /* = "bits" */;
+static char *cache_il1_index_opt /* = "bits" */;
+static enum cache_incl cache_incl /* = NINE */;
+
+/* sector sizes, 0 for unsectored blocks, and l2 block compression */
+static int cache_dl1_sect /* = 0 */;
+static int cache_dl2_sect /* = 0 */;
+static int cache_il1_sect /* = 0 */;
+static int cache_dl2_bdi /* = FALSE */;
+
+/* stack distance options */
+static char *sdist_refs_opt /* = "none" */;
+static char *sdist_opt;
+
+/* DRAM config, i.e., {<config>|none} */
+static char *mem_dram_opt /* = "none" */;
+
+/* memory reference trace options */
+static char *trace_out_fname /* = NULL */;
+static int trace_replay /* = FALSE */;
+static int trace_threads /* = 1 */;
+
+/* PCs and data objects reported by the miss profiler, 0 if none */
+static int missprof_topn /* = 0 */;
+
+/* prefetch queue and throttling options */
+static int prefetch_qsize /* = 0 */;
+static int prefetch_bandwidth /* = 1 */;
+static int prefetch_degree /* = 0 */;
+static int prefetch_fdp /* = FALSE */;
+
 /* text-based stat profiles */
 static int pcstat_nelt = 0;
 static char *pcstat_vars[MAX_PCSTAT_VARS];
@@ -292,9 +542,11 @@ sim_reg_options(struct opt_odb_t *odb)	/* options database */
 "    <nsets>  - number of sets in the cache\n"
 "    <bsize>  - block size of the cache\n"
 "    <assoc>  - associativity of the cache\n"
-"    <repl>   - block replacement strategy, 'l'-LRU, 'f'-FIFO, 'r'-random, 'n'-NRU\n"
+"    <repl>   - block replacement strategy, 'l'-LRU, 'f'-FIFO, 'r'-random, 'n'-NRU,\n"
+"               's'-SRRIP, 'd'-DRRIP (set-dueling), 'h'-SHiP (PC signatures)\n"
 "    <pref>   - prefetcher type, 0 - no prefetcher, 1 - next line prefetcher,\n"
 "	       2 - open-ended prefetcher, \n"
+"	       -num - GHB PC/DC prefetcher with num (a power of two) GHB and index table entries\n"
 "	       any other number num - stride prefetcher with num entries in the Reference Prediction Table (RPT)\n"
 "\n"
 "    Examples:   -cache:dl1 dl1:4096:32:1:l:1\n"
@@ -328,12 +580,182 @@ sim_reg_options(struct opt_odb_t *odb)	/* options database */
   opt_reg_string(odb, "-tlb:dtlb",
 		 "data TLB config, i.e., {<config>|none}",
 		 &dtlb_opt, "dtlb:32:4096:4:l:0", /* print */TRUE, NULL);
+  opt_reg_string(odb, "-tlb:stlb",
+		 "second level, unified TLB config, i.e., {<config>|none}",
+		 &stlb_opt, "none", /* print */TRUE, NULL);
+  opt_reg_flag(odb, "-tlb:ptw",
+	       "walk the page table through the data caches on TLB misses",
+	       &tlb_ptw, /* default */FALSE, /* print */TRUE, NULL);
+  opt_reg_int(odb, "-tlb:pwc",
+	      "page walk cache entries (0 for none)",
+	      &tlb_pwc_size, /* default */16, /* print */TRUE, NULL);
+  opt_reg_flag(odb, "-tlb:huge",
+	       "back large mappings with huge pages",
+	       &tlb_huge, /* default */FALSE, /* print */TRUE, NULL);
+  opt_reg_note(odb,
+"  First level TLB misses go to the second level TLB, if any.  With\n"
+"  -tlb:ptw, misses there walk the page table, loading its entries through\n"
+"  the data caches after a lookup in the page walk cache, and all TLBs need\n"
+"  the same page size.  With -tlb:huge, the text segment and the data\n"
+"  segment are backed by huge pages of 512 base pages, i.e., 2 MB with 4 KB\n"
+"  pages, wherever they wholly contain one, and -tlb:huge needs -tlb:ptw.\n"
+"\n"
+"    Example:   -tlb:stlb stlb:128:4096:8:l:0 -tlb:ptw -tlb:huge\n"
+	       );
   opt_reg_flag(odb, "-flush", "flush caches on system calls",
 	       &flush_on_syscalls, /* default */FALSE, /* print */TRUE, NULL);
   opt_reg_flag(odb, "-cache:icompress",
 	       "convert 64-bit inst addresses to 32-bit inst equivalents",
 	       &compress_icache_addrs, /* default */FALSE,
 	       /* print */TRUE, NULL);
+  opt_reg_int(odb, "-cache:dl1victim",
+	      "l1 data cache victim cache entries (0 for none)",
+	      &cache_dl1_victim, /* default */0, /* print */TRUE, NULL);
+  opt_reg_int(odb, "-cache:dl2victim",
+	      "l2 data cache victim cache entries (0 for none)",
+	      &cache_dl2_victim, /* default */0, /* print */TRUE, NULL);
+  opt_reg_int(odb, "-cache:il1victim",
+	      "l1 inst cache victim cache entries (0 for none)",
+	      &cache_il1_victim, /* default */0, /* print */TRUE, NULL);
+  opt_reg_string(odb, "-cache:dl1index",
+		 "l1 data cache set index, i.e., {bits|xor|prime|skew}",
+		 &cache_dl1_index_opt, "bits", /* print */TRUE, NULL);
+  opt_reg_string(odb, "-cache:dl2index",
+		 "l2 data cache set index, i.e., {bits|xor|prime|skew}",
+		 &cache_dl2_index_opt, "bits", /* print */TRUE, NULL);
+  opt_reg_string(odb, "-cache:il1index",
+		 "l1 inst cache set index, i.e., {bits|xor|prime|skew}",
+		 &cache_il1_index_opt, "bits", /* print */TRUE, NULL);
+  opt_reg_int(odb, "-cache:dl1sect",
+	      "l1 data cache sector size in bytes (0 for unsectored blocks)",
+	      &cache_dl1_sect, /* default */0, /* print */TRUE, NULL);
+  opt_reg_int(odb, "-cache:dl2sect",
+	      "l2 data cache sector size in bytes (0 for unsectored blocks)",
+	      &cache_dl2_sect, /* default */0, /* print */TRUE, NULL);
+  opt_reg_int(odb, "-cache:il1sect",
+	      "l1 inst cache sector size in bytes (0 for unsectored blocks)",
+	      &cache_il1_sect, /* default */0, /* print */TRUE, NULL);
+  opt_reg_flag(odb, "-cache:dl2bdi",
+	       "compress the l2 data cache with base-delta-immediate encoding",
+	       &cache_dl2_bdi, /* default */FALSE, /* print */TRUE, NULL);
+  opt_reg_string(odb, "-cache:incl",
+		 "inclusion of the l1 caches in the l2, i.e., {nine|incl|excl}",
+		 &cache_incl_opt, "nine", /* print */TRUE, NULL);
+  opt_reg_note(odb,
+"  The l2 caches hold the blocks of the l1 caches above them as -cache:incl\n"
+"  says: \"nine\" (non-inclusive non-exclusive) manages each level on its\n"
+"  own, \"incl\" invalidates a block in the l1 caches when the l2 gives it\n"
+"  up, and \"excl\" moves a block from the l2 to the l1 on a hit and fills\n"
+"  the l2 with the blocks the l1 caches replace, clean or dirty, which needs\n"
+"  the l1 and l2 caches to have the same block size.  A victim cache\n"
+"  (-cache:dl1victim etc.) holds the last blocks replaced from its cache,\n"
+"  which leave the cache level only when they leave its victim cache.\n"
+"\n"
+"  A cache indexes its sets (-cache:dl1index etc.) by the low block address\n"
+"  bits (\"bits\"), by these XORed with all higher bits (\"xor\"), by the\n"
+"  block address modulo the largest prime number of sets (\"prime\"), or\n"
+"  with a different XOR hash per way (\"skew\", skewed-associative).\n"
+"\n"
+"  A sectored cache (-cache:dl1sect etc.) keeps a valid and a dirty bit per\n"
+"  sector of a block, and fills and writes back only the sectors it needs.\n"
+"  A compressed l2 cache (-cache:dl2bdi) has twice the tags of its data\n"
+"  array and packs the blocks of a set into the data array with base-delta-\n"
+"  immediate (BDI) encoding of their contents in simulated memory.  Both\n"
+"  report their effective capacity and the bytes moved to and from the next\n"
+"  level.\n"
+	       );
+
+  opt_reg_string(odb, "-mem:dram",
+		 "DRAM timing model config, i.e., {<config>|none}",
+		 &mem_dram_opt, "none", /* print */TRUE, NULL);
+  opt_reg_note(odb,
+"  The DRAM config parameter <config> has the following format:\n"
+"\n"
+"    <nchan>:<nrank>:<nbank>:<rowsize>:<tRCD>:<tCAS>:<tRP>:<qsize>\n"
+"\n"
+"    Example:   -mem:dram 1:1:8:2048:14:14:14:16\n"
+"\n"
+"  as in sim-outorder.  Misses to main memory are timed on a processor that\n"
+"  executes one instruction per cycle and waits for every read, giving the\n"
+"  row buffer hit, miss and conflict rates of the miss stream under\n"
+"  open-page FR-FCFS scheduling.\n"
+	       );
+
+  opt_reg_string(odb, "-sdist:refs",
+		 "stack distance references, i.e., {none|inst|data|unified}",
+		 &sdist_refs_opt, "none", /* print */TRUE, NULL);
+  opt_reg_string(odb, "-sdist:config",
+		 "stack distance config, i.e., <bsize>:<minsets>:<maxsets>:<maxassoc>",
+		 &sdist_opt, "32:16:4096:16", /* print */TRUE, NULL);
+  opt_reg_note(odb,
+"  The stack distance engine simulates every LRU cache of one block size in\n"
+"  a single pass: all set counts from <minsets> to <maxsets> and all\n"
+"  associativities up to <maxassoc> (powers of two), and fully associative\n"
+"  caches of any size.  The miss rate of each geometry is printed after the\n"
+"  statistics.  The caches configured with -cache:* are simulated as usual.\n"
+"\n"
+"    Example:   -sdist:refs data -sdist:config 64:64:8192:32\n"
+	       );
+
+  opt_reg_string(odb, "-trace:out",
+		 "capture the memory references to a trace file",
+		 &trace_out_fname, /* default */NULL, /* print */TRUE, NULL);
+  opt_reg_flag(odb, "-trace:replay",
+	       "replay the trace named in place of the program",
+	       &trace_replay, /* default */FALSE, /* print */TRUE, NULL);
+  opt_reg_int(odb, "-trace:threads",
+	      "replay threads, each simulating a shard of the cache sets",
+	      &trace_threads, /* default */1, /* print */TRUE, NULL);
+  opt_reg_note(odb,
+"  A trace holds the PC, address, size and kind of every instruction fetch,\n"
+"  load, store and system call reference, delta encoded in 1-3 bytes each.\n"
+"  A replay gives the same cache statistics as executing the program, for\n"
+"  any cache, TLB, -flush or -sdist options.  It decodes the trace in about\n"
+"  half the time the program takes to execute, the simulation of the caches\n"
+"  themselves costs the same either way.\n"
+"\n"
+"    Example:   sim-cache -trace:out go.mtr go.pisa-big 50 9 2stone9.in\n"
+"               sim-cache -trace:replay -cache:dl1 dl1:512:64:2:l:0 go.mtr\n"
+"\n"
+"  With -trace:threads <n>, a power of two, the sets of every cache are split\n"
+"  into <n> shards by address bits that index the sets of all caches, and\n"
+"  each shard is replayed by its own thread.  The trace is decoded once, by\n"
+"  a thread that also simulates the TLBs and -sdist and hands every shard\n"
+"  its references in batches.  Statistics are merged at the end and match\n"
+"  a serial replay unless a cache uses a prefetcher, a victim cache or the\n"
+"  'r', 'd' or 'h' policy, all of which keep state shared across sets.  The\n"
+"  caches must index their sets by address bits.\n"
+	       );
+
+  opt_reg_int(odb, "-prefetch:queue",
+	      "prefetch queue entries per cache (0 issues prefetches at once)",
+	      &prefetch_qsize, /* default */0, /* print */TRUE, NULL);
+  opt_reg_int(odb, "-prefetch:bw",
+	      "queued prefetches issued per demand access",
+	      &prefetch_bandwidth, /* default */1, /* print */TRUE, NULL);
+  opt_reg_int(odb, "-prefetch:degree",
+	      "prefetch requests per trigger (0 for the prefetcher's default)",
+	      &prefetch_degree, /* default */0, /* print */TRUE, NULL);
+  opt_reg_flag(odb, "-prefetch:fdp",
+	       "throttle prefetch degree and distance with feedback",
+	       &prefetch_fdp, /* default */FALSE, /* print */TRUE, NULL);
+
+  opt_reg_int(odb, "-missprof",
+	      "report the top <n> PCs and data objects by data cache misses",
+	      &missprof_topn, /* default */0, /* print */TRUE, NULL);
+  opt_reg_note(odb,
+"  The miss profiler charges every demand miss in the data caches, and\n"
+"  every demand reference that finds its block's prefetch still queued (a\n"
+"  late prefetch), to the PC of the load or store and to the data symbol,\n"
+"  or else the segment, holding the address.  Misses the l2 takes on\n"
+"  writebacks from the l1 are not demand misses and are not charged.  The\n"
+"  <n> PCs and data objects with the most misses are printed after the\n"
+"  statistics, PCs resolved to their function, with the cumulative share of\n"
+"  all misses.  A replayed trace has no program, so its data objects are not\n"
+"  resolved.\n"
+"\n"
+"    Example:   -missprof 20\n"
+	       );
 
   opt_reg_string_list(odb, "-pcstat",
 		      "profile stat(s) against text addr's (mult uses ok)",
@@ -342,6 +764,90 @@ sim_reg_options(struct opt_odb_t *odb)	/* options database */
 
 }
 
+/* copy of shard 0 cache CP in another shard, in which caches aliased to
+   another level (unified levels) are aliased the same way */
+static struct cache_t *
+shard_clone(struct shard_t *sh,		/* shard being built */
+	    struct cache_t *cp)		/* shard 0 cache */
+{
+  if (!cp)
+    return NULL;
+  else if (cp == cache_dl1 && sh->dl1)
+    return sh->dl1;
+  else if (cp == cache_dl2 && sh->dl2)
+    return sh->dl2;
+  else
+    return cache_clone(cp);
+}
+
+/* link the l1 caches IL1 and DL1 to the l2 caches IL2 and DL2 below them,
+   if the l2 caches enforce inclusion or exclusion */
+static void
+link_levels(struct cache_t *il1, struct cache_t *il2,
+	    struct cache_t *dl1, struct cache_t *dl2)
+{
+  if (cache_incl == NINE)
+    return;
+  if (dl2)
+    cache_set_lower(dl1, dl2, cache_incl);
+  if (il2 && il1 != dl1)
+    cache_set_lower(il1, il2, cache_incl);
+}
+
+/* split the caches into N shards by set, N a power of two */
+static void
+shard_caches(int n)
+{
+  struct cache_t *cps[4];
+  int i, lo = 0, hi = sizeof(md_addr_t) * 8;
+
+  nshards = n;
+  shards = (struct shard_t *)calloc(n, sizeof(struct shard_t));
+  if (!shards)
+    fatal("out of virtual memory");
+
+  /* shard 0 is the global cache hierarchy */
+  shards[0].il1 = cache_il1;
+  shards[0].il2 = cache_il2;
+  shards[0].dl1 = cache_dl1;
+  shards[0].dl2 = cache_dl2;
+  if (n == 1)
+    return;
+
+  /* shard by the lowest address bits that index the sets of every cache,
+     so an access, its misses and their writebacks stay in one shard */
+  cps[0] = cache_il1; cps[1] = cache_il2; cps[2] = cache_dl1;
+  cps[3] = cache_dl2;
+  for (i=0; i < 4; i++)
+    {
+      if (!cps[i])
+	continue;
+      if (cps[i]->index != BitSelect)
+	fatal("cannot shard cache `%s', its sets are hashed", cps[i]->name);
+      lo = MAX(lo, cps[i]->set_shift);
+      hi = MIN(hi, cps[i]->set_shift + log_base2(cps[i]->nsets));
+      if (cps[i]->prefetch_type != 0 || cps[i]->vc_nentries
+	  || cps[i]->policy == Random || cps[i]->policy == DRRIP
+	  || cps[i]->policy == SHiP)
+	warn("cache `%s' keeps state across sets, "
+	     "a sharded replay may not match a serial one", cps[i]->name);
+    }
+  if (hi - lo < log_base2(n))
+    fatal("cannot shard the caches %d ways, their set indices share "
+	  "only %d address bits", n, MAX(hi - lo, 0));
+  shard_shift = lo;
+
+  for (i=1; i < n; i++)
+    {
+      shards[i].id = i;
+      shards[i].dl1 = shard_clone(&shards[i], cache_dl1);
+      shards[i].dl2 = shard_clone(&shards[i], cache_dl2);
+      shards[i].il1 = shard_clone(&shards[i], cache_il1);
+      shards[i].il2 = shard_clone(&shards[i], cache_il2);
+      link_levels(shards[i].il1, shards[i].il2, shards[i].dl1, shards[i].dl2);
+    }
+}
+
 /* check simulator-specific option values */
 void
 sim_check_options(struct opt_odb_t *odb,	/* options database */
@@ -474,6 +980,165 @@ sim_check_options(struct opt_odb_t *odb,	/* options database */
 			  cache_char2policy(c),  dtlb_access_fn,
 			  /* hit latency */1, prefetch_type);
     }
+
+  /* use a second level TLB? */
+  if (!mystricmp(stlb_opt, "none"))
+    stlb = NULL;
+  else
+    {
+      if (sscanf(stlb_opt, "%[^:]:%d:%d:%d:%c:%d",
+		 name, &nsets, &bsize, &assoc, &c, &prefetch_type) != 6)
+	fatal("bad TLB parms: <name>:<nsets>:<page_size>:<assoc>:<repl>:<pref>");
+      stlb = cache_create(name, nsets, bsize, /* balloc */FALSE,
+			  /* usize */sizeof(md_addr_t), assoc,
+			  cache_char2policy(c), stlb_access_fn,
+			  /* hit latency */1, prefetch_type);
+    }
+
+  /* use the stack distance engine? */
+  if (mystricmp(sdist_refs_opt, "none"))
+    {
+      int minsets, maxsets, maxassoc;
+
+      if (sscanf(sdist_opt, "%d:%d:%d:%d",
+		 &bsize, &minsets, &maxsets, &maxassoc) != 4)
+	fatal("bad stack distance parms: "
+	      "<bsize>:<minsets>:<maxsets>:<maxassoc>");
+      if (minsets <= 0 || (minsets & (minsets-1)) != 0
+	  || maxsets <= 0 || (maxsets & (maxsets-1)) != 0)
+	fatal("stack distance set counts must be powers of two");
+
+      if (!mystricmp(sdist_refs_opt, "inst"))
+	sdist_inst = sdist_create("sdist_inst", bsize, log_base2(minsets),
+				  log_base2(maxsets), maxassoc);
+      else if (!mystricmp(sdist_refs_opt, "data"))
+	sdist_data = sdist_create("sdist_data", bsize, log_base2(minsets),
+				  log_base2(maxsets), maxassoc);
+      else if (!mystricmp(sdist_refs_opt, "unified"))
+	sdist_inst = sdist_data =
+	  sdist_create("sdist_unified", bsize, log_base2(minsets),
+		       log_base2(maxsets), maxassoc);
+      else
+	fatal("bad stack distance references `%s'", sdist_refs_opt);
+    }
+
+  if (trace_replay && trace_out_fname)
+    fatal("cannot capture a trace while replaying one");
+  if (trace_replay && pcstat_nelt)
+    fatal("`-pcstat' is not supported when replaying a trace");
+  if (trace_threads < 1 || (trace_threads & (trace_threads-1)) != 0)
+    fatal("replay threads `%d' must be a power of two", trace_threads);
+  if (trace_threads > 1 && !trace_replay)
+    fatal("`-trace:threads' requires `-trace:replay'");
+
+  /* model main memory as a DRAM? */
+  if (mystricmp(mem_dram_opt, "none"))
+    {
+      int nchan, nrank, nbank, row_size, t_rcd, t_cas, t_rp, qsize;
+
+      if (sscanf(mem_dram_opt, "%d:%d:%d:%d:%d:%d:%d:%d",
+		 &nchan, &nrank, &nbank, &row_size,
+		 &t_rcd, &t_cas, &t_rp, &qsize) != 8)
+	fatal("bad DRAM parms: "
+	      "<nchan>:<nrank>:<nbank>:<rowsize>:<tRCD>:<tCAS>:<tRP>:<qsize>");
+      if (trace_threads > 1)
+	fatal("`-mem:dram' is not supported with `-trace:threads'");
+      mem_dram = dram_create("dram", nchan, nrank, nbank, row_size,
+			     t_rcd, t_cas, t_rp, qsize,
+			     DRAM_BUS_WIDTH, DRAM_TRANSFER_LAT);
+    }
+
+  /* walk the page table on TLB misses? */
+  if (tlb_huge && !tlb_ptw)
+    fatal("huge pages (-tlb:huge) need page walks (-tlb:ptw)");
+  if (tlb_huge && trace_replay)
+    fatal("`-tlb:huge' is not supported when replaying a trace");
+  if (tlb_ptw && trace_threads > 1)
+    fatal("`-tlb:ptw' is not supported with `-trace:threads'");
+  if (tlb_ptw && (itlb || dtlb || stlb))
+    {
+      bsize = (dtlb ? dtlb : itlb ? itlb : stlb)->bsize;
+      if ((itlb && itlb->bsize != bsize) || (dtlb && dtlb->bsize != bsize)
+	  || (stlb && stlb->bsize != bsize))
+	fatal("page walks (-tlb:ptw) need the same page size in all TLBs");
+      ptw = ptw_create("ptw", PTW_VA_BITS, log_base2(bsize), PTW_BASE,
+		       tlb_pwc_size, ptw_mem_access,
+		       tlb_huge ? huge_mapped : NULL);
+    }
+
+#ifndef SIM_THREADS
+  if (trace_threads > 1)
+    fatal("this simulator was built without thread support (-DSIM_THREADS)");
+#endif /* !SIM_THREADS */
+
+  /* compressed and sectored blocks */
+  if (cache_dl2_bdi)
+    {
+      if (!cache_dl2)
+	fatal("-cache:dl2bdi needs an l2 data cache");
+      if (trace_replay)
+	fatal("`-cache:dl2bdi' needs the program data, it cannot replay a trace");
+      cache_set_compress(cache_dl2, l2_blk_data);
+    }
+  if (cache_dl1)
+    cache_set_sectors(cache_dl1, cache_dl1_sect);
+  if (cache_dl2)
+    cache_set_sectors(cache_dl2, cache_dl2_sect);
+  if (cache_il1 && cache_il1 != cache_dl1 && cache_il1 != cache_dl2)
+    cache_set_sectors(cache_il1, cache_il1_sect);
+  else if (cache_il1_sect)
+    fatal("a unified l1 inst cache takes the sectors of its data cache");
+
+  /* the prefetch queue and throttle apply to every cache level */
+  if (cache_dl1)
+    cache_set_prefetch(cache_dl1, prefetch_qsize, prefetch_bandwidth,
+		       prefetch_degree, prefetch_fdp);
+  if (cache_dl2)
+    cache_set_prefetch(cache_dl2, prefetch_qsize, prefetch_bandwidth,
+		       prefetch_degree, prefetch_fdp);
+  if (cache_il1 && cache_il1 != cache_dl1 && cache_il1 != cache_dl2)
+    cache_set_prefetch(cache_il1, prefetch_qsize, prefetch_bandwidth,
+		       prefetch_degree, prefetch_fdp);
+  if (cache_il2 && cache_il2 != cache_dl2)
+    cache_set_prefetch(cache_il2, prefetch_qsize, prefetch_bandwidth,
+		       prefetch_degree, prefetch_fdp);
+
+  /* victim caches, and the inclusion of the l1 caches in the l2 caches */
+  if (cache_dl1)
+    cache_set_victim(cache_dl1, cache_dl1_victim);
+  if (cache_dl2)
+    cache_set_victim(cache_dl2, cache_dl2_victim);
+  if (cache_il1 && cache_il1 != cache_dl1 && cache_il1 != cache_dl2)
+    cache_set_victim(cache_il1, cache_il1_victim);
+  else if (cache_il1_victim)
+    fatal("a unified l1 inst cache takes the victim cache of its data cache");
+
+  /* set index functions */
+  if (cache_dl1)
+    cache_set_index(cache_dl1, cache_str2index(cache_dl1_index_opt));
+  if (cache_dl2)
+    cache_set_index(cache_dl2, cache_str2index(cache_dl2_index_opt));
+  if (cache_il1 && cache_il1 != cache_dl1 && cache_il1 != cache_dl2)
+    cache_set_index(cache_il1, cache_str2index(cache_il1_index_opt));
+  else if (cache_str2index(cache_il1_index_opt) != BitSelect)
+    fatal("a unified l1 inst cache takes the set index of its data cache");
+  cache_incl = cache_str2incl(cache_incl_opt);
+  link_levels(cache_il1, cache_il2, cache_dl1, cache_dl2);
+
+  shard_caches(trace_threads);
+
+  /* profile data cache misses, one profile per shard */
+  if (missprof_topn)
+    {
+      char *levels[2] = { "dl1", "dl2" };
+      int i;
+
+      if (!cache_dl1)
+	fatal("the miss profiler (-missprof) needs a data cache");
+      for (i=0; i < nshards; i++)
+	shards[i].mp = missprof_create("missprof_data", cache_dl2 ? 2 : 1, levels,
+				       missprof_topn, !trace_replay);
+    }
 }
 
 /* initialize the simulator */
@@ -510,8 +1175,24 @@ sim_load_prog(char *fname,		/* program to load */
 	      int argc, char **argv,	/* program arguments */
 	      char **envp)		/* program environment */
 {
-  /* load program text and data, set up environment, memory, and regs */
-  ld_load_prog(fname, argc, argv, envp, &regs, mem, TRUE);
+  if (trace_replay)
+    {
+      /* the "program" is a memory reference trace, nothing to load */
+      mtrace_in = mtrace_open(fname);
+      ld_text_base = mtrace_in->text_base;
+    }
+  else
+    {
+      /* load program text and data, set up environment, memory, and regs */
+      ld_load_prog(fname, argc, argv, envp, &regs, mem, TRUE);
+
+      if (trace_out_fname)
+	mtrace_out = mtrace_create(trace_out_fname, ld_text_base);
+
+      /* the miss profiler binds PCs and data addresses to symbols */
+      if (shards[0].mp)
+	sym_loadsyms(ld_prog_fname, /* load locals */TRUE);
+    }
 
   /* initialize the DLite debugger */
   dlite_init(md_reg_obj, dlite_mem_obj, cache_mstate_obj);
@@ -521,7 +1202,16 @@ sim_load_prog(char *fname,		/* program to load */
 void
 sim_aux_config(FILE *stream)		/* output stream */
 {
-  /* nada */
+  if (sdist_inst)
+    sdist_config(sdist_inst, stream);
+  if (sdist_data && sdist_data != sdist_inst)
+    sdist_config(sdist_data, stream);
+  if (mem_dram)
+    dram_config(mem_dram, stream);
+  if (ptw)
+    ptw_config(ptw, stream);
+  if (shards[0].mp)
+    missprof_config(shards[0].mp, stream);
 }
 
 /* register simulator-specific statistics */
@@ -559,6 +1249,22 @@ sim_reg_stats(struct stat_sdb_t *sdb)	/* stats database */
     cache_reg_stats(itlb, sdb);
   if (dtlb)
     cache_reg_stats(dtlb, sdb);
+  if (stlb)
+    cache_reg_stats(stlb, sdb);
+  if (ptw)
+    ptw_reg_stats(ptw, sdb);
+  if (sdist_inst)
+    sdist_reg_stats(sdist_inst, sdb);
+  if (sdist_data && sdist_data != sdist_inst)
+    sdist_reg_stats(sdist_data, sdb);
+  if (mem_dram)
+    dram_reg_stats(mem_dram, sdb);
+  if (shards[0].mp)
+    missprof_reg_stats(shards[0].mp, sdb);
+  if (mtrace_out)
+    mtrace_reg_stats(mtrace_out, "trace_out", sdb);
+  if (mtrace_in)
+    mtrace_reg_stats(mtrace_in, "trace_in", sdb);
 
   for (i=0; i<pcstat_nelt; i++)
     {
@@ -598,14 +1304,21 @@ sim_reg_stats(struct stat_sdb_t *sdb)	/* stats database */
 void
 sim_aux_stats(FILE *stream)		/* output stream */
 {
-  /* nada */
+  if (sdist_inst)
+    sdist_print(sdist_inst, stream);
+  if (sdist_data && sdist_data != sdist_inst)
+    sdist_print(sdist_data, stream);
+  if (shards[0].mp)
+    missprof_print(shards[0].mp, stream);
 }
 
 /* un-initialize the simulator */
 void
 sim_uninit(void)
 {
-  /* nada */
+  if (mtrace_out)
+    mtrace_close(mtrace_out);
+  mtrace_out = NULL;
 }
 
 /*
@@ -662,16 +1375,150 @@ sim_uninit(void)
 #error No ISA target defined...
 #endif
 
+/* fetch the instruction at PC through the instruction TLB and stack
+   distance engine, which are not sharded */
+static void
+inst_ref_unsharded(md_addr_t pc)	/* PC of the instruction */
+{
+  md_addr_t addr = IACOMPRESS(pc);
+
+  if (sdist_inst)
+    sdist_access(sdist_inst, addr);
+  if (itlb)
+    cache_access(itlb, Read, TLB_ADDR(addr),
+		 NULL, ISCOMPRESS(sizeof(md_inst_t)), 0, NULL, NULL, pc, 0);
+}
+
+/* fetch the instruction at PC through the caches of shard SH */
+static void
+inst_ref_shard(struct shard_t *sh,	/* cache shard */
+	       md_addr_t pc)		/* PC of the instruction */
+{
+  if (sh->il1)
+    cache_access(sh->il1, Read, IACOMPRESS(pc),
+		 NULL, ISCOMPRESS(sizeof(md_inst_t)), 0, NULL, NULL, pc, 0);
+}
+
+/* fetch the instruction at PC through the instruction TLB and the caches
+   of shard SH */
+static void
+inst_ref(struct shard_t *sh,		/* cache shard */
+	 md_addr_t pc)			/* PC of the instruction */
+{
+  inst_ref_unsharded(pc);
+  inst_ref_shard(sh, pc);
+}
+
+/* demand misses at each data cache level of shard SH so far, and late
+   prefetches at all levels, for the miss profiler; the l1 fills its blocks
+   with reads from the l2, so only the l2 read misses come from demand
+   references, its write misses come from l1 writebacks */
+static counter_t			/* late prefetches */
+miss_counts(struct shard_t *sh,		/* cache shard */
+	    counter_t *misses)		/* misses at each level */
+{
+  counter_t late = sh->dl1->prefetch_late + sh->dl1->prefetch_squashed;
+
+  misses[0] = sh->dl1->misses;
+  if (sh->dl2)
+    {
+      misses[1] = sh->dl2->read_misses;
+      late += sh->dl2->prefetch_late + sh->dl2->prefetch_squashed;
+    }
+  return late;
+}
+
+/* access NBYTES at ADDR through the data TLB and stack distance engine,
+   which are not sharded */
+static void
+data_ref_unsharded(enum mem_cmd cmd,	/* access cmd, Read or Write */
+		   md_addr_t addr,	/* data address to access */
+		   int nbytes,		/* number of bytes to access */
+		   md_addr_t pc)	/* PC of the instruction */
+{
+  if (sdist_data)
+    sdist_access(sdist_data, addr);
+  if (dtlb)
+    cache_access(dtlb, cmd, TLB_ADDR(addr),
+		 NULL, nbytes, 0, NULL, NULL, pc, 0);
+}
+
+/* access NBYTES at ADDR through the caches of shard SH */
+static void
+data_ref_shard(struct shard_t *sh,	/* cache shard */
+	       enum mem_cmd cmd,	/* access cmd, Read or Write */
+	       md_addr_t addr,		/* data address to access */
+	       int nbytes,		/* number of bytes to access */
+	       md_addr_t pc)		/* PC of the instruction */
+{
+  counter_t before[2], after[2], late = 0;
+
+  if (!sh->dl1)
+    return;
+
+  /* the misses of this reference are the ones it adds to the caches, not
+     counting the ones its writebacks cause */
+  if (sh->mp)
+    late = miss_counts(sh, before);
+  cache_access(sh->dl1, cmd, addr, NULL, nbytes, 0, NULL, NULL, pc, 0);
+  if (sh->mp)
+    {
+      late = miss_counts(sh, after) - late;
+      after[0] -= before[0];
+      after[1] = sh->dl2 ? after[1] - before[1] : 0;
+      if (after[0] || after[1] || late)
+	missprof_account(sh->mp, pc, addr, after, late);
+    }
+}
+
+/* access NBYTES at ADDR through the data TLB and the caches of shard SH */
+static void
+data_ref(struct shard_t *sh,		/* cache shard */
+	 enum mem_cmd cmd,		/* access cmd, Read or Write */
+	 md_addr_t addr,		/* data address to access */
+	 int nbytes,			/* number of bytes to access */
+	 md_addr_t pc)			/* PC of the instruction */
+{
+  data_ref_unsharded(cmd, addr, nbytes, pc);
+  data_ref_shard(sh, cmd, addr, nbytes, pc);
+}
+
+/* flush the data TLBs at a system call, for -flush */
+static void
+syscall_flush_unsharded(void)
+{
+  if (dtlb)
+    cache_flush(dtlb, 0);
+  if (stlb)
+    cache_flush(stlb, 0);
+}
+
+/* flush the data caches of shard SH at a system call, for -flush */
+static void
+syscall_flush_shard(struct shard_t *sh)	/* cache shard */
+{
+  if (sh->dl1)
+    cache_flush(sh->dl1, 0);
+  if (sh->dl2)
+    cache_flush(sh->dl2, 0);
+}
+
+/* flush the data TLB and the data caches of shard SH at a system call, for
+   -flush */
+static void
+syscall_flush(struct shard_t *sh)	/* cache shard */
+{
+  syscall_flush_unsharded();
+  syscall_flush_shard(sh);
+}
+
 /* precise architected memory state accessor macros */
 #define __READ_CACHE(addr, SRC_T)					\
-  ((dtlb								\
-    ? cache_access(dtlb, Read, (addr), NULL,				\
-		   sizeof(SRC_T), 0, NULL, NULL, 0)			\
+  ((mtrace_out								\
+    ? (mtrace_write(mtrace_out, mt_read, /* sys */FALSE, regs.regs_PC,	\
+		    (addr), sizeof(SRC_T)), 0)				\
     : 0),								\
-   (cache_dl1								\
-    ? cache_access(cache_dl1, Read, (addr), NULL,			\
-		   sizeof(SRC_T), 0, NULL, NULL, 0)			\
-    : 0))
+   data_ref(shards, Read, (addr), sizeof(SRC_T), regs.regs_PC))
 
 #define READ_BYTE(SRC, FAULT)						\
   ((FAULT) = md_fault_none, addr = (SRC),				\
@@ -689,14 +1536,11 @@ sim_uninit(void)
 #endif /* HOST_HAS_QWORD */
 
 #define __WRITE_CACHE(addr, DST_T)					\
-  ((dtlb								\
-    ? cache_access(dtlb, Write, (addr), NULL,				\
-		   sizeof(DST_T), 0, NULL, NULL, 0)			\
+  ((mtrace_out								\
+    ? (mtrace_write(mtrace_out, mt_write, /* sys */FALSE, regs.regs_PC,	\
+		    (addr), sizeof(DST_T)), 0)				\
     : 0),								\
-   (cache_dl1								\
-    ? cache_access(cache_dl1, Write, (addr), NULL,			\
-		   sizeof(DST_T), 0,  NULL, NULL, 0)			\
-    : 0))
+   data_ref(shards, Write, (addr), sizeof(DST_T), regs.regs_PC))
 
 #define WRITE_BYTE(SRC, DST, FAULT)					\
   ((FAULT) = md_fault_none, addr = (DST),				\
@@ -721,21 +1565,268 @@ dcache_access_fn(struct mem_t *mem,	/* memory space to access */
 		 void *p,		/* data input/output buffer */
 		 int nbytes)		/* number of bytes to access */
 {
-  if (dtlb)
-    cache_access(dtlb, cmd, addr, NULL, nbytes, 0, NULL, NULL, 0);
-  if (cache_dl1)
-    cache_access(cache_dl1, cmd, addr, NULL, nbytes, 0, NULL, NULL, 0);
+  /* system call references are captured even with -flush, so that a trace
+     replays under either setting */
+  if (mtrace_out)
+    mtrace_write(mtrace_out, cmd == Read ? mt_read : mt_write, /* sys */TRUE,
+		 regs.regs_PC, addr, nbytes);
+  if (!flush_on_syscalls)
+    data_ref(shards, cmd, addr, nbytes, regs.regs_PC);
   return mem_access(mem, cmd, addr, p, nbytes);
 }
 
 /* system call handler macro */
 #define SYSCALL(INST)							\
-  (flush_on_syscalls							\
-   ? ((dtlb ? cache_flush(dtlb, 0) : 0),				\
-      (cache_dl1 ? cache_flush(cache_dl1, 0) : 0),			\
-      (cache_dl2 ? cache_flush(cache_dl2, 0) : 0),			\
-      sys_syscall(&regs, mem_access, mem, INST, TRUE))			\
-   : sys_syscall(&regs, dcache_access_fn, mem, INST, TRUE))
+  ((mtrace_out								\
+    ? (mtrace_write(mtrace_out, mt_syscall, /* sys */TRUE, regs.regs_PC,	\
+		    0, 0), 0)						\
+    : 0),								\
+   (flush_on_syscalls ? (syscall_flush(shards), 0) : 0),		\
+   sys_syscall(&regs, (flush_on_syscalls && !mtrace_out			\
+		       ? mem_access : dcache_access_fn),		\
+	       mem, INST, TRUE))
+
+/* replay trace record REC through the caches of shard SH */
+static void
+replay_ref(struct shard_t *sh,		/* cache shard */
+	   struct mtrace_rec_t *rec)	/* trace record */
+{
+  switch (rec->type)
+    {
+    case mt_inst:
+      inst_ref_shard(sh, rec->pc);
+      break;
+    case mt_read:
+    case mt_write:
+      data_ref_shard(sh, rec->type == mt_read ? Read : Write,
+		     rec->addr, rec->size, rec->pc);
+      break;
+    case mt_syscall:
+      syscall_flush_shard(sh);
+      break;
+    default:
+      panic("bogus trace record type");
+    }
+}
+
+#ifdef SIM_THREADS
+/* hand the batch being filled for shard SH to its replay thread */
+static void
+shard_publish(struct shard_t *sh)	/* cache shard */
+{
+  pthread_mutex_lock(&sh->lock);
+  sh->qcount++;
+  pthread_cond_signal(&sh->cond);
+  pthread_mutex_unlock(&sh->lock);
+  sh->fill = NULL;
+}
+
+/* queue trace record REC for the replay thread of shard SH, waiting for it
+   to free a batch if its queue is full */
+static void
+shard_queue(struct shard_t *sh,		/* cache shard */
+	    struct mtrace_rec_t *rec)	/* trace record */
+{
+  if (!sh->fill)
+    {
+      pthread_mutex_lock(&sh->lock);
+      while (sh->qcount == REPLAY_QUEUE)
+	pthread_cond_wait(&sh->cond, &sh->lock);
+      sh->fill = &sh->queue[(sh->qhead + sh->qcount) % REPLAY_QUEUE];
+      pthread_mutex_unlock(&sh->lock);
+      sh->fill->nrecs = 0;
+    }
+  sh->fill->recs[sh->fill->nrecs++] = *rec;
+  if (sh->fill->nrecs == REPLAY_BATCH)
+    shard_publish(sh);
+}
+
+/* replay thread, replays the batches queued for its shard until the whole
+   trace is decoded */
+static void *
+shard_main(void *arg)			/* cache shard */
+{
+  struct shard_t *sh = (struct shard_t *)arg;
+  struct replay_batch_t *batch;
+  int i;
+
+  if (pthread_setspecific(shard_key, sh) != 0)
+    fatal("cannot set the shard of replay thread %d", sh->id);
+
+  while (TRUE)
+    {
+      pthread_mutex_lock(&sh->lock);
+      while (!sh->qcount && !sh->done)
+	pthread_cond_wait(&sh->cond, &sh->lock);
+      batch = sh->qcount ? &sh->queue[sh->qhead] : NULL;
+      pthread_mutex_unlock(&sh->lock);
+      if (!batch)
+	break;
+
+      for (i=0; i < batch->nrecs; i++)
+	replay_ref(sh, &batch->recs[i]);
+
+      pthread_mutex_lock(&sh->lock);
+      sh->qhead = (sh->qhead + 1) % REPLAY_QUEUE;
+      sh->qcount--;
+      pthread_cond_signal(&sh->cond);
+      pthread_mutex_unlock(&sh->lock);
+    }
+  return NULL;
+}
+#endif /* SIM_THREADS */
+
+/* replay trace record REC through the caches of shard ID, on the shard's
+   replay thread if there is one */
+static void
+shard_ref(int id,			/* shard number */
+	  struct mtrace_rec_t *rec)	/* trace record */
+{
+#ifdef SIM_THREADS
+  if (nshards > 1)
+    {
+      shard_queue(&shards[id], rec);
+      return;
+    }
+#endif /* SIM_THREADS */
+  replay_ref(&shards[id], rec);
+}
+
+/* decode the memory reference trace, simulating the TLBs and stack
+   distance engines and handing every cache reference to the shard that
+   holds its set, the program is not executed */
+static void
+replay_trace(void)
+{
+  struct mtrace_rec_t rec;
+  unsigned char *p, *end;
+  int i, n, counted = FALSE;
+
+  while ((p = mtrace_batch(mtrace_in, &end)) != NULL)
+    {
+      for (n=0; p < end; n++)
+	{
+	  MTRACE_DECODE(mtrace_in, p, rec);
+	  switch (rec.type)
+	    {
+	    case mt_inst:
+	      /* finish early? */
+	      if (max_insts && sim_num_insn >= max_insts)
+		{
+		  mtrace_batch_done(mtrace_in, p, n + 1);
+		  return;
+		}
+	      inst_ref_unsharded(rec.pc);
+	      if (cache_il1)
+		shard_ref(SHARD_OF(IACOMPRESS(rec.pc)), &rec);
+	      sim_num_insn++;
+	      counted = FALSE;
+	      break;
+	    case mt_read:
+	    case mt_write:
+	      if (rec.sys)
+		{
+		  if (flush_on_syscalls)
+		    break;
+		}
+	      else if (!counted)
+		{
+		  /* one load or store may make several references */
+		  sim_num_refs++;
+		  counted = TRUE;
+		}
+	      data_ref_unsharded(rec.type == mt_read ? Read : Write,
+				 rec.addr, rec.size, rec.pc);
+	      if (cache_dl1)
+		shard_ref(SHARD_OF(rec.addr), &rec);
+	      break;
+	    case mt_syscall:
+	      if (flush_on_syscalls)
+		{
+		  syscall_flush_unsharded();
+		  if (cache_dl1)
+		    for (i=0; i < nshards; i++)
+		      shard_ref(i, &rec);
+		}
+	      break;
+	    default:
+	      panic("bogus trace record type");
+	    }
+	}
+      mtrace_batch_done(mtrace_in, p, n);
+    }
+}
+
+/* replay the memory reference trace, one thread per cache shard */
+static void
+sim_replay(void)
+{
+  fprintf(stderr, "sim: ** starting trace-driven simulation w/ caches **\n");
+
+  if (nshards == 1)
+    replay_trace();
+#ifdef SIM_THREADS
+  else
+    {
+      pthread_t *threads;
+      int i;
+
+      threads = (pthread_t *)calloc(nshards, sizeof(pthread_t));
+      if (!threads)
+	fatal("out of virtual memory");
+      if (pthread_key_create(&shard_key, NULL) != 0)
+	fatal("cannot create the replay thread key");
+
+      /* the trace is decoded once, by this thread, which hands the records
+	 of each shard to its replay thread in batches */
+      for (i=0; i < nshards; i++)
+	{
+	  shards[i].queue = (struct replay_batch_t *)
+	    calloc(REPLAY_QUEUE, sizeof(struct replay_batch_t));
+	  if (!shards[i].queue)
+	    fatal("out of virtual memory");
+	  if (pthread_mutex_init(&shards[i].lock, NULL) != 0
+	      || pthread_cond_init(&shards[i].cond, NULL) != 0)
+	    fatal("cannot create the queue of replay thread %d", i);
+	  if (pthread_create(&threads[i], NULL, shard_main, &shards[i]) != 0)
+	    fatal("cannot create replay thread %d", i);
+	}
+      replay_trace();
+      for (i=0; i < nshards; i++)
+	{
+	  if (shards[i].fill)
+	    shard_publish(&shards[i]);
+	  pthread_mutex_lock(&shards[i].lock);
+	  shards[i].done = TRUE;
+	  pthread_cond_signal(&shards[i].cond);
+	  pthread_mutex_unlock(&shards[i].lock);
+	}
+      for (i=0; i < nshards; i++)
+	if (pthread_join(threads[i], NULL) != 0)
+	  fatal("cannot join replay thread %d", i);
+
+      /* the stats of shard 0's caches are the ones registered */
+      for (i=1; i < nshards; i++)
+	{
+	  if (shards[i].il1
+	      && shards[i].il1 != shards[i].dl1
+	      && shards[i].il1 != shards[i].dl2)
+	    cache_merge_stats(cache_il1, shards[i].il1);
+	  if (shards[i].il2 && shards[i].il2 != shards[i].dl2)
+	    cache_merge_stats(cache_il2, shards[i].il2);
+	  if (shards[i].dl1)
+	    cache_merge_stats(cache_dl1, shards[i].dl1);
+	  if (shards[i].dl2)
+	    cache_merge_stats(cache_dl2, shards[i].dl2);
+	  if (shards[i].mp)
+	    missprof_merge(shards[0].mp, shards[i].mp);
+	}
+      for (i=0; i < nshards; i++)
+	free(shards[i].queue);
+      free(threads);
+    }
+#endif /* SIM_THREADS */
+}
 
 /* start simulation, program loaded, processor precise state initialized */
 void
@@ -747,7 +1838,13 @@ sim_main(void)
   enum md_opcode op;
   register int is_write;
   enum md_fault_type fault;
- 
+
+  if (mtrace_in)
+    {
+      sim_replay();
+      return;
+    }
+
   fprintf(stderr, "sim: ** starting functional simulation w/ caches **\n");
 
   /* set up initial default next PC */
@@ -767,12 +1864,10 @@ sim_main(void)
 #endif /* TARGET_ALPHA */
 
       /* get the next instruction to execute */
-      if (itlb)
-	cache_access(itlb, Read, IACOMPRESS(regs.regs_PC),
-		     NULL, ISCOMPRESS(sizeof(md_inst_t)), 0, NULL, NULL, 0);
-      if (cache_il1)
-	cache_access(cache_il1, Read, IACOMPRESS(regs.regs_PC),
-		     NULL, ISCOMPRESS(sizeof(md_inst_t)), 0, NULL, NULL, 0);
+      if (mtrace_out)
+	mtrace_write(mtrace_out, mt_inst, /* sys */FALSE, regs.regs_PC,
+		     regs.regs_PC, sizeof(md_inst_t));
+      inst_ref(shards, regs.regs_PC);
       MD_FETCH_INST(inst, mem, regs.regs_PC);
 
       /* keep an instruction count */
@@ -61,6 +61,8 @@
 #include "regs.h"
 #include "memory.h"
 #include "cache.h"
+#include "dram.h"
+#include "ptw.h"
 #include "loader.h"
 #include "syscall.h"
 #include "bpred.h"
@@ -72,6 +74,7 @@
 #include "ptrace.h"
 #include "dlite.h"
 #include "sim.h"
+#include "eio.h"
 
 /*
  * This file implements a very detailed out-of-order issue superscalar
@@ -97,6 +100,22 @@ static unsigned int max_insts;
 /* number of insts skipped before timing starts */
 static int fastfwd_count;
 
+/* sampled simulation, number of insts measured per sample (0 = no sampling) */
+static int sample_unit;
+
+/* detailed warm-up before each sample (in insts) */
+static int sample_warmup;
+
+/* sampling period, insts from the start of one sample to the next */
+static int sample_period;
+
+/* periodic checkpoints with warm state, <fname format> <interval> */
+static int chkpt_nelt = 0;
+static char *chkpt_opts[2];
+
+/* insts between periodic checkpoints, 0 if none are written */
+static counter_t chkpt_interval = 0;
+
 /* pipeline trace range and output filename */
 static int ptrace_nelt = 0;
 static char *ptrace_opts[2];
@@ -157,30 +176,88 @@ static int RUU_size = 8;
 /* load/store queue (LSQ) size */
 static int LSQ_size = 4;
 
+/* store set predictor SSIT entries, 0 to hold loads behind all stores with
+   unknown addresses */
+static int LSQ_storesets;
+
 /* l1 data cache config, i.e., {<config>|none} */
 static char *cache_dl1_opt;
 
 /* l1 data cache hit latency (in cycles) */
 static int cache_dl1_lat;
 
+/* l1 data cache MSHRs and targets per MSHR, 0 MSHRs for unlimited misses */
+static int cache_dl1_mshr;
+static int cache_dl1_mshr_targets;
+
+/* l1 data cache write buffer entries, 0 for unlimited write buffering */
+static int cache_dl1_wbuf;
+
+/* l1 data cache victim cache entries, 0 for none */
+static int cache_dl1_victim;
+
+/* l1 data cache set index function, i.e., {bits|xor|prime|skew} */
+static char *cache_dl1_index_opt;
+
+/* l1 data cache sector size (in bytes), 0 for unsectored blocks */
+static int cache_dl1_sect;
+
 /* l2 data cache config, i.e., {<config>|none} */
 static char *cache_dl2_opt;
 
 /* l2 data cache hit latency (in cycles) */
 static int cache_dl2_lat;
 
+/* l2 data cache MSHRs and targets per MSHR, 0 MSHRs for unlimited misses */
+static int cache_dl2_mshr;
+static int cache_dl2_mshr_targets;
+
+/* l2 data cache write buffer entries, 0 for unlimited write buffering */
+static int cache_dl2_wbuf;
+
+/* l2 data cache victim cache entries, 0 for none */
+static int cache_dl2_victim;
+
+/* l2 data cache set index function, i.e., {bits|xor|prime|skew} */
+static char *cache_dl2_index_opt;
+
+/* l2 data cache sector size (in bytes), 0 for unsectored blocks */
+static int cache_dl2_sect;
+
+/* compress the l2 data cache blocks with base-delta-immediate encoding */
+static int cache_dl2_bdi;
+
+/* prefetch queue entries and issue bandwidth of each cache, prefetch
+   degree, and FDP throttling of the prefetch degree and distance */
+static int prefetch_qsize;
+static int prefetch_bandwidth;
+static int prefetch_degree;
+static int prefetch_fdp;
+
 /* l1 instruction cache config, i.e., {<config>|dl1|dl2|none} */
 static char *cache_il1_opt;
 
 /* l1 instruction cache hit latency (in cycles) */
 static int cache_il1_lat;
 
+/* l1 instruction cache victim cache entries, 0 for none */
+static int cache_il1_victim;
+
+/* l1 instruction cache set index function, i.e., {bits|xor|prime|skew} */
+static char *cache_il1_index_opt;
+
+/* l1 instruction cache sector size (in bytes), 0 for unsectored blocks */
+static int cache_il1_sect;
+
 /* l2 instruction cache config, i.e., {<config>|dl1|dl2|none} */
 static char *cache_il2_opt;
 
 /* l2 instruction cache hit latency (in cycles) */
 static int cache_il2_lat;
 
+/* inclusion of the l1 caches in the l2 caches, i.e., {nine|incl|excl} */
+static char *cache_incl_opt;
+
 /* flush caches on system calls */
 static int flush_on_syscalls;
 
@@ -195,6 +272,12 @@ static int mem_lat[2] =
 /* memory access bus width (in bytes) */
 static int mem_bus_width;
 
+/* DRAM config, i.e., {<config>|none} */
+static char *mem_dram_opt;
+
+/* DRAM timing model, or NULL for fixed memory latency */
+static struct dram_t *mem_dram = NULL;
+
 /* instruction TLB config, i.e., {<config>|none} */
 static char *itlb_opt;
 
@@ -204,6 +287,21 @@ static char *dtlb_opt;
 /* inst/data TLB miss latency (in cycles) */
 static int tlb_miss_lat;
 
+/* second level TLB config, i.e., {<config>|none} */
+static char *stlb_opt;
+
+/* second level TLB hit latency (in cycles) */
+static int stlb_lat;
+
+/* walk the page table through the data caches on TLB misses? */
+static int tlb_ptw;
+
+/* page walk cache entries */
+static int tlb_pwc_size;
+
+/* back large mappings with huge pages? */
+static int tlb_huge;
+
 /* total number of integer ALU's available */
 static int res_ialu;
 
@@ -338,6 +436,29 @@ static counter_t RUU_fcount;		/* cumulative RUU full count */
 static counter_t LSQ_count;		/* cumulative LSQ occupancy */
 static counter_t LSQ_fcount;		/* cumulative LSQ full count */
 
+/* store set predictor counters */
+static counter_t lsq_ss_waits;		/* loads held by a predicted store */
+static counter_t lsq_ss_violations;	/* loads caught passing a store */
+
+/* sampled simulation counters */
+static counter_t sample_units;		/* sample units measured */
+static counter_t sample_insn;		/* insts in the sample units */
+static counter_t sample_cycles;		/* cycles in the sample units */
+static counter_t sample_warm_insn;	/* insts run by functional warming */
+static counter_t sample_warm_cycles;	/* memory cycles of the warming */
+static double sample_cpi;		/* mean CPI of the sample units */
+static double sample_cpi_sdev;		/* std deviation of the unit CPIs */
+static double sample_cpi_err;		/* 95% confidence half-width */
+
+/* insts executed before the checkpoint the simulation started from */
+static counter_t chkpt_start_insn = 0;
+
+/* time seen by the memory system, functional warming advances it while the
+   pipeline clock stands still, as if each inst waited for its accesses to
+   complete, so no cache, bus or DRAM activity is left pending in the future
+   of the pipeline */
+#define MEM_NOW			(sim_cycle + sample_warm_cycles)
+
 /* total non-speculative bogus addresses seen (debug var) */
 static counter_t sim_invalid_addrs;
 
@@ -385,6 +506,15 @@ static struct cache_t *itlb;
 /* data TLB */
 static struct cache_t *dtlb;
 
+/* second level TLB, shared by instructions and data */
+static struct cache_t *stlb;
+
+/* page table walker, or NULL for the fixed TLB miss latency */
+static struct ptw_t *ptw = NULL;
+
+/* address under which the TLBs hold the translation of ADDR */
+#define TLB_ADDR(ADDR)		(ptw ? ptw_tlb_addr(ptw, (ADDR)) : (ADDR))
+
 /* branch predictor */
 static struct bpred_t *pred;
 
@@ -409,12 +539,18 @@ static struct stat_stat_t *pcstat_sdists[MAX_PCSTAT_VARS];
 
 /* memory access latency, assumed to not cross a page boundary */
 static unsigned int			/* total latency of access */
-mem_access_latency(int blk_sz)		/* block size accessed */
+mem_access_latency(enum mem_cmd cmd,	/* Read or Write */
+		   md_addr_t baddr,	/* block address accessed */
+		   int blk_sz,		/* block size accessed */
+		   tick_t now)		/* time of access */
 {
   int chunks = (blk_sz + (mem_bus_width - 1)) / mem_bus_width;
 
   assert(chunks > 0);
 
+  if (mem_dram)
+    return dram_access(mem_dram, cmd, baddr, blk_sz, now);
+
   return (/* first chunk latency */mem_lat[0] +
 	  (/* remainder chunk latency */mem_lat[1] * (chunks - 1)));
 }
@@ -430,7 +566,9 @@ dl1_access_fn(enum mem_cmd cmd,		/* access cmd, Read or Write */
 	      md_addr_t baddr,		/* block address to access */
 	      int bsize,		/* size of block to access */
 	      struct cache_blk_t *blk,	/* ptr to block in upper level */
-	      tick_t now)		/* time of access */
+	      tick_t now,		/* time of access */
+	      md_addr_t pc,		/* PC of the requesting instruction */
+	      int prefetch)		/* non-zero if the access is a prefetch */
 {
   unsigned int lat;
 
@@ -438,25 +576,24 @@ dl1_access_fn(enum mem_cmd cmd,		/* access cmd, Read or Write */
     {
       /* access next level of data cache hierarchy */
       lat = cache_access(cache_dl2, cmd, baddr, NULL, bsize,
-			 /* now */now, /* pudata */NULL, /* repl addr */NULL);
-      if (cmd == Read)
+			 /* now */now, /* pudata */NULL, /* repl addr */NULL,
+			 pc, prefetch);
+      /* writebacks take as long as the L2 access when dl1 has a write
+	 buffer, which waits for them to drain, otherwise write buffers
+	 are unlimited */
+      if (cmd == Read || cache_dl1->wbuf_nentries)
 	return lat;
       else
-	{
-	  /* FIXME: unlimited write buffers */
-	  return 0;
-	}
+	return 0;
     }
   else
     {
       /* access main memory */
-      if (cmd == Read)
-	return mem_access_latency(bsize);
+      lat = mem_access_latency(cmd, baddr, bsize, now);
+      if (cmd == Read || cache_dl1->wbuf_nentries)
+	return lat;
       else
-	{
-	  /* FIXME: unlimited write buffers */
-	  return 0;
-	}
+	return 0;
     }
 }
 
@@ -466,16 +603,32 @@ dl2_access_fn(enum mem_cmd cmd,		/* access cmd, Read or Write */
 	      md_addr_t baddr,		/* block address to access */
 	      int bsize,		/* size of block to access */
 	      struct cache_blk_t *blk,	/* ptr to block in upper level */
-	      tick_t now)		/* time of access */
+	      tick_t now,		/* time of access */
+	      md_addr_t pc,		/* PC of the requesting instruction */
+	      int prefetch)		/* non-zero if the access is a prefetch */
 {
+  unsigned int lat;
+
   /* this is a miss to the lowest level, so access main memory */
-  if (cmd == Read)
-    return mem_access_latency(bsize);
+  lat = mem_access_latency(cmd, baddr, bsize, now);
+
+  /* writebacks take as long as the memory access when dl2 has a write
+     buffer, which waits for them to drain, otherwise write buffers are
+     unlimited */
+  if (cmd == Read || cache_dl2->wbuf_nentries)
+    return lat;
   else
-    {
-      /* FIXME: unlimited write buffers */
-      return 0;
-    }
+    return 0;
+}
+
+/* compressed l2 data cache block contents function, the simulator keeps
+   no data in its caches, so the contents are read from simulated memory */
+static void
+l2_blk_data(md_addr_t baddr,		/* block address to read */
+	    byte_t *buf,		/* buffer for the block contents */
+	    int bsize)			/* size of block to read */
+{
+  mem_access(mem, Read, baddr, buf, bsize);
 }
 
 /* l1 inst cache l1 block miss handler function */
@@ -484,7 +637,9 @@ il1_access_fn(enum mem_cmd cmd,		/* access cmd, Read or Write */
 	      md_addr_t baddr,		/* block address to access */
 	      int bsize,		/* size of block to access */
 	      struct cache_blk_t *blk,	/* ptr to block in upper level */
-	      tick_t now)		/* time of access */
+	      tick_t now,		/* time of access */
+	      md_addr_t pc,		/* PC of the requesting instruction */
+	      int prefetch)		/* non-zero if the access is a prefetch */
 {
   unsigned int lat;
 
@@ -492,7 +647,8 @@ if (cache_il2)
     {
       /* access next level of inst cache hierarchy */
       lat = cache_access(cache_il2, cmd, baddr, NULL, bsize,
-			 /* now */now, /* pudata */NULL, /* repl addr */NULL);
+			 /* now */now, /* pudata */NULL, /* repl addr */NULL,
+			 pc, prefetch);
       if (cmd == Read)
 	return lat;
       else
@@ -502,7 +658,7 @@ if (cache_il2)
     {
       /* access main memory */
       if (cmd == Read)
-	return mem_access_latency(bsize);
+	return mem_access_latency(cmd, baddr, bsize, now);
       else
 	panic("writes to instruction memory not supported");
     }
@@ -514,11 +670,13 @@ il2_access_fn(enum mem_cmd cmd,		/* access cmd, Read or Write */
 	      md_addr_t baddr,		/* block address to access */
 	      int bsize,		/* size of block to access */
 	      struct cache_blk_t *blk,	/* ptr to block in upper level */
-	      tick_t now)		/* time of access */
+	      tick_t now,		/* time of access */
+	      md_addr_t pc,		/* PC of the requesting instruction */
+	      int prefetch)		/* non-zero if the access is a prefetch */
 {
   /* this is a miss to the lowest level, so access main memory */
   if (cmd == Read)
-    return mem_access_latency(bsize);
+    return mem_access_latency(cmd, baddr, bsize, now);
   else
     panic("writes to instruction memory not supported");
 }
@@ -528,13 +686,53 @@ il2_access_fn(enum mem_cmd cmd,		/* access cmd, Read or Write */
  * TLB miss handlers
  */
 
+/* page table entry load function, walks go through the data caches */
+static unsigned int			/* latency of PTE load */
+ptw_mem_access(md_addr_t addr,		/* address of the PTE */
+	       tick_t now)		/* time of access */
+{
+  if (cache_dl1)
+    return cache_access(cache_dl1, Read, addr, NULL, PTW_PTE_SIZE, now,
+			NULL, NULL, /* pc */0, /* prefetch */0);
+  else
+    return mem_access_latency(Read, addr, PTW_PTE_SIZE, now);
+}
+
+/* huge page function, the text segment and the data segment up to the
+   break are large mappings, backed by huge pages wherever they wholly
+   contain one */
+static int				/* non-zero if a huge page */
+huge_mapped(md_addr_t base,		/* base of the huge page */
+	    md_addr_t size)		/* size of the huge page */
+{
+  return ((base >= ld_text_base && base + size <= ld_text_base + ld_text_size)
+	  || (base >= ld_data_base && base + size <= ld_brk_point));
+}
+
+/* latency to refill a first level TLB, from the second level TLB if
+   there is one, else from the page table */
+static unsigned int			/* latency of refill */
+tlb_refill_latency(md_addr_t baddr,	/* TLB address of the page */
+		   tick_t now)		/* time of access */
+{
+  if (stlb)
+    return cache_access(stlb, Read, baddr, NULL, sizeof(md_addr_t), now,
+			NULL, NULL, /* pc */0, /* prefetch */0);
+  else if (ptw)
+    return ptw_walk(ptw, baddr, now);
+  else
+    return tlb_miss_lat;
+}
+
 /* inst cache block miss handler function */
 static unsigned int			/* latency of block access */
 itlb_access_fn(enum mem_cmd cmd,	/* access cmd, Read or Write */
 	       md_addr_t baddr,		/* block address to access */
 	       int bsize,		/* size of block to access */
 	       struct cache_blk_t *blk,	/* ptr to block in upper level */
-	       tick_t now)		/* time of access */
+	       tick_t now,		/* time of access */
+	       md_addr_t pc,		/* PC of the requesting instruction */
+	       int prefetch)		/* non-zero if the access is a prefetch */
 {
   md_addr_t *phy_page_ptr = (md_addr_t *)blk->user_data;
 
@@ -545,7 +743,7 @@ itlb_access_fn(enum mem_cmd cmd,	/* access cmd, Read or Write */
   *phy_page_ptr = 0;
 
   /* return tlb miss latency */
-  return tlb_miss_lat;
+  return tlb_refill_latency(baddr, now);
 }
 
 /* data cache block miss handler function */
@@ -554,7 +752,9 @@ dtlb_access_fn(enum mem_cmd cmd,	/* access cmd, Read or Write */
 	       md_addr_t baddr,	/* block address to access */
 	       int bsize,		/* size of block to access */
 	       struct cache_blk_t *blk,	/* ptr to block in upper level */
-	       tick_t now)		/* time of access */
+	       tick_t now,		/* time of access */
+	       md_addr_t pc,		/* PC of the requesting instruction */
+	       int prefetch)		/* non-zero if the access is a prefetch */
 {
   md_addr_t *phy_page_ptr = (md_addr_t *)blk->user_data;
 
@@ -565,7 +765,29 @@ dtlb_access_fn(enum mem_cmd cmd,	/* access cmd, Read or Write */
   *phy_page_ptr = 0;
 
   /* return tlb miss latency */
-  return tlb_miss_lat;
+  return tlb_refill_latency(baddr, now);
+}
+
+/* second level TLB block miss handler function */
+static unsigned int			/* latency of block access */
+stlb_access_fn(enum mem_cmd cmd,	/* access cmd, Read or Write */
+	       md_addr_t baddr,		/* block address to access */
+	       int bsize,		/* size of block to access */
+	       struct cache_blk_t *blk,	/* ptr to block in upper level */
+	       tick_t now,		/* time of access */
+	       md_addr_t pc,		/* PC of the requesting instruction */
+	       int prefetch)		/* non-zero if the access is a prefetch */
+{
+  md_addr_t *phy_page_ptr = (md_addr_t *)blk->user_data;
+
+  /* no real memory access, however, should have user data space attached */
+  assert(phy_page_ptr);
+
+  /* fake translation, for now... */
+  *phy_page_ptr = 0;
+
+  /* walk the page table, or return tlb miss latency */
+  return ptw ? ptw_walk(ptw, baddr, now) : tlb_miss_lat;
 }
 
 
@@ -616,6 +838,57 @@ sim_reg_options(struct opt_odb_t *odb)
 "                -ptrace FOOBAR.trc @main:+278\n"
 	       );
 
+  /* sampling options */
+
+  opt_reg_int(odb, "-sample:unit",
+	      "insts measured per sample, sampled simulation if > 0",
+	      &sample_unit, /* default */0,
+	      /* print */TRUE, /* format */NULL);
+
+  opt_reg_int(odb, "-sample:warmup",
+	      "insts of detailed warm-up before each sample",
+	      &sample_warmup, /* default */2000,
+	      /* print */TRUE, /* format */NULL);
+
+  opt_reg_int(odb, "-sample:period",
+	      "insts from the start of one sample to the next",
+	      &sample_period, /* default */1000000,
+	      /* print */TRUE, /* format */NULL);
+
+  opt_reg_note(odb,
+"  Sampled simulation (-sample:unit > 0) measures the CPI of short sample\n"
+"  units spread over the program.  Every -sample:period insts, the pipeline\n"
+"  is warmed up for -sample:warmup insts and the CPI of the next\n"
+"  -sample:unit insts is measured.  Then the pipeline drains and the rest of\n"
+"  the period executes functionally, accessing only the caches and TLBs and\n"
+"  training the branch predictor.  The sample_* stats give the mean CPI of\n"
+"  the units and its 95% confidence interval.  sim_num_insn and -max:inst\n"
+"  count the functionally executed insts as well, while sim_cycle and the\n"
+"  per-inst stats, e.g., sim_CPI, cover the detailed insts and cycles only.\n"
+	       );
+
+  /* checkpoint options */
+
+  opt_reg_string_list(odb, "-chkpt:perdump",
+		      "periodic checkpoint with warm state every n insts: "
+		      "<fname format> <interval>",
+		      chkpt_opts, /* sz */2, &chkpt_nelt, /* default */NULL,
+		      /* !print */FALSE, /* format */NULL, /* !accrue */FALSE);
+
+  opt_reg_note(odb,
+"  While running an EIO trace, -chkpt:perdump executes the program\n"
+"  functionally, warming the caches, TLBs and branch predictor, and every\n"
+"  <interval> insts writes an EIO checkpoint, named by the printf-style\n"
+"  <fname format> and the checkpoint number, that also holds the contents of\n"
+"  the caches and TLBs and the branch predictor state.  A simulation started\n"
+"  from such a checkpoint with -chkpt restores this warm state (the caches,\n"
+"  TLBs and predictor must be configured as when the checkpoint was written),\n"
+"  and runs up to -max:inst, which counts the insts before the checkpoint.\n"
+"  Checkpoints without warm state, e.g., from sim-eio, start cold.  The\n"
+"  regions between checkpoints may be simulated in parallel, see\n"
+"  sim-parallel.pl.\n"
+	       );
+
   /* ifetch options */
 
   opt_reg_int(odb, "-fetch:ifqsize", "instruction fetch queue size (in insts)",
@@ -733,6 +1006,21 @@ sim_reg_options(struct opt_odb_t *odb)
 	      &LSQ_size, /* default */8,
 	      /* print */TRUE, /* format */NULL);
 
+  opt_reg_int(odb, "-lsq:storesets",
+	      "store set predictor SSIT entries (0 to wait for all older STAs)",
+	      &LSQ_storesets, /* default */0,
+	      /* print */TRUE, /* format */NULL);
+
+  opt_reg_note(odb,
+"  Loads wait for every older store with an unknown address (STA) by\n"
+"  default.  With -lsq:storesets <n>, a store set predictor with <n> SSIT\n"
+"  entries lets loads pass these stores, except the last fetched store of\n"
+"  their store set.  A load about to pass a store to its own address is\n"
+"  caught before it issues, as the simulator knows all addresses at\n"
+"  dispatch: it waits for the store, joins its store set and counts as a\n"
+"  violation, but is not replayed.\n"
+	       );
+
   /* cache options */
 
   opt_reg_string(odb, "-cache:dl1",
@@ -743,15 +1031,22 @@ sim_reg_options(struct opt_odb_t *odb)
   opt_reg_note(odb,
 "  The cache config parameter <config> has the following format:\n"
 "\n"
-"    <name>:<nsets>:<bsize>:<assoc>:<repl>\n"
+"    <name>:<nsets>:<bsize>:<assoc>:<repl>[:<pref>]\n"
 "\n"
 "    <name>   - name of the cache being defined\n"
 "    <nsets>  - number of sets in the cache\n"
 "    <bsize>  - block size of the cache\n"
 "    <assoc>  - associativity of the cache\n"
-"    <repl>   - block replacement strategy, 'l'-LRU, 'f'-FIFO, 'r'-random\n"
+"    <repl>   - block replacement strategy, 'l'-LRU, 'f'-FIFO, 'r'-random,\n"
+"               'n'-NRU, 's'-SRRIP, 'd'-DRRIP, 'h'-SHiP\n"
+"    <pref>   - optional prefetcher type, 0 - none (default), 1 - next line,\n"
+"               2 - open-ended (DCPT), -num - GHB PC/DC prefetcher with num\n"
+"               (a power of two) GHB and index table entries, any other\n"
+"               number num - stride prefetcher with num entries in its RPT\n"
+"               (caches only)\n"
 "\n"
 "    Examples:   -cache:dl1 dl1:4096:32:1:l\n"
+"                -cache:dl1 dl1:4096:32:1:l:2\n"
 "                -dtlb dtlb:128:4096:32:r\n"
 	       );
 
@@ -760,6 +1055,36 @@ sim_reg_options(struct opt_odb_t *odb)
 	      &cache_dl1_lat, /* default */1,
 	      /* print */TRUE, /* format */NULL);
 
+  opt_reg_int(odb, "-cache:dl1mshr",
+	      "l1 data cache MSHRs (0 for unlimited outstanding misses)",
+	      &cache_dl1_mshr, /* default */0,
+	      /* print */TRUE, /* format */NULL);
+
+  opt_reg_int(odb, "-cache:dl1mshrtgt",
+	      "l1 data cache accesses that may merge onto one MSHR",
+	      &cache_dl1_mshr_targets, /* default */4,
+	      /* print */TRUE, /* format */NULL);
+
+  opt_reg_int(odb, "-cache:dl1wbuf",
+	      "l1 data cache write buffer entries (0 for unlimited buffering)",
+	      &cache_dl1_wbuf, /* default */0,
+	      /* print */TRUE, /* format */NULL);
+
+  opt_reg_int(odb, "-cache:dl1victim",
+	      "l1 data cache victim cache entries (0 for none)",
+	      &cache_dl1_victim, /* default */0,
+	      /* print */TRUE, /* format */NULL);
+
+  opt_reg_string(odb, "-cache:dl1index",
+		 "l1 data cache set index, i.e., {bits|xor|prime|skew}",
+		 &cache_dl1_index_opt, "bits",
+		 /* print */TRUE, NULL);
+
+  opt_reg_int(odb, "-cache:dl1sect",
+	      "l1 data cache sector size in bytes (0 for unsectored blocks)",
+	      &cache_dl1_sect, /* default */0,
+	      /* print */TRUE, /* format */NULL);
+
   opt_reg_string(odb, "-cache:dl2",
 		 "l2 data cache config, i.e., {<config>|none}",
 		 &cache_dl2_opt, "ul2:1024:64:4:l",
@@ -770,6 +1095,40 @@ sim_reg_options(struct opt_odb_t *odb)
 	      &cache_dl2_lat, /* default */6,
 	      /* print */TRUE, /* format */NULL);
 
+  opt_reg_int(odb, "-cache:dl2mshr",
+	      "l2 data cache MSHRs (0 for unlimited outstanding misses)",
+	      &cache_dl2_mshr, /* default */0,
+	      /* print */TRUE, /* format */NULL);
+
+  opt_reg_int(odb, "-cache:dl2mshrtgt",
+	      "l2 data cache accesses that may merge onto one MSHR",
+	      &cache_dl2_mshr_targets, /* default */4,
+	      /* print */TRUE, /* format */NULL);
+
+  opt_reg_int(odb, "-cache:dl2wbuf",
+	      "l2 data cache write buffer entries (0 for unlimited buffering)",
+	      &cache_dl2_wbuf, /* default */0,
+	      /* print */TRUE, /* format */NULL);
+
+  opt_reg_int(odb, "-cache:dl2victim",
+	      "l2 data cache victim cache entries (0 for none)",
+	      &cache_dl2_victim, /* default */0,
+	      /* print */TRUE, /* format */NULL);
+
+  opt_reg_string(odb, "-cache:dl2index",
+		 "l2 data cache set index, i.e., {bits|xor|prime|skew}",
+		 &cache_dl2_index_opt, "bits",
+		 /* print */TRUE, NULL);
+
+  opt_reg_int(odb, "-cache:dl2sect",
+	      "l2 data cache sector size in bytes (0 for unsectored blocks)",
+	      &cache_dl2_sect, /* default */0,
+	      /* print */TRUE, /* format */NULL);
+
+  opt_reg_flag(odb, "-cache:dl2bdi",
+	       "compress the l2 data cache with base-delta-immediate encoding",
+	       &cache_dl2_bdi, /* default */FALSE, /* print */TRUE, NULL);
+
   opt_reg_string(odb, "-cache:il1",
 		 "l1 inst cache config, i.e., {<config>|dl1|dl2|none}",
 		 &cache_il1_opt, "il1:512:32:1:l",
@@ -794,6 +1153,21 @@ sim_reg_options(struct opt_odb_t *odb)
 	      &cache_il1_lat, /* default */1,
 	      /* print */TRUE, /* format */NULL);
 
+  opt_reg_int(odb, "-cache:il1victim",
+	      "l1 inst cache victim cache entries (0 for none)",
+	      &cache_il1_victim, /* default */0,
+	      /* print */TRUE, /* format */NULL);
+
+  opt_reg_string(odb, "-cache:il1index",
+		 "l1 inst cache set index, i.e., {bits|xor|prime|skew}",
+		 &cache_il1_index_opt, "bits",
+		 /* print */TRUE, NULL);
+
+  opt_reg_int(odb, "-cache:il1sect",
+	      "l1 inst cache sector size in bytes (0 for unsectored blocks)",
+	      &cache_il1_sect, /* default */0,
+	      /* print */TRUE, /* format */NULL);
+
   opt_reg_string(odb, "-cache:il2",
 		 "l2 instruction cache config, i.e., {<config>|dl2|none}",
 		 &cache_il2_opt, "dl2",
@@ -804,6 +1178,35 @@ sim_reg_options(struct opt_odb_t *odb)
 	      &cache_il2_lat, /* default */6,
 	      /* print */TRUE, /* format */NULL);
 
+  opt_reg_string(odb, "-cache:incl",
+		 "inclusion of the l1 caches in the l2, i.e., {nine|incl|excl}",
+		 &cache_incl_opt, "nine",
+		 /* print */TRUE, NULL);
+
+  opt_reg_note(odb,
+"  The l2 caches hold the blocks of the l1 caches above them as -cache:incl\n"
+"  says: \"nine\" (non-inclusive non-exclusive) manages each level on its\n"
+"  own, \"incl\" invalidates a block in the l1 caches when the l2 gives it\n"
+"  up, and \"excl\" moves a block from the l2 to the l1 on a hit and fills\n"
+"  the l2 with the blocks the l1 caches replace, clean or dirty, which needs\n"
+"  the l1 and l2 caches to have the same block size.  A victim cache\n"
+"  (-cache:dl1victim etc.) holds the last blocks replaced from its cache,\n"
+"  which leave the cache level only when they leave its victim cache.\n"
+"\n"
+"  A cache indexes its sets (-cache:dl1index etc.) by the low block address\n"
+"  bits (\"bits\"), by these XORed with all higher bits (\"xor\"), by the\n"
+"  block address modulo the largest prime number of sets (\"prime\"), or\n"
+"  with a different XOR hash per way (\"skew\", skewed-associative).\n"
+"\n"
+"  A sectored cache (-cache:dl1sect etc.) keeps a valid and a dirty bit per\n"
+"  sector of a block, and fills and writes back only the sectors it needs.\n"
+"  A compressed l2 cache (-cache:dl2bdi) has twice the tags of its data\n"
+"  array and packs the blocks of a set into the data array with base-delta-\n"
+"  immediate (BDI) encoding of their contents in simulated memory.  Both\n"
+"  report their effective capacity and the bytes moved to and from the next\n"
+"  level.\n"
+	       );
+
   opt_reg_flag(odb, "-cache:flush", "flush caches on system calls",
 	       &flush_on_syscalls, /* default */FALSE, /* print */TRUE, NULL);
 
@@ -812,6 +1215,26 @@ sim_reg_options(struct opt_odb_t *odb)
 	       &compress_icache_addrs, /* default */FALSE,
 	       /* print */TRUE, NULL);
 
+  opt_reg_int(odb, "-prefetch:queue",
+	      "prefetch queue entries per cache (0 issues prefetches at once)",
+	      &prefetch_qsize, /* default */0,
+	      /* print */TRUE, /* format */NULL);
+
+  opt_reg_int(odb, "-prefetch:bw",
+	      "queued prefetches issued per cycle",
+	      &prefetch_bandwidth, /* default */1,
+	      /* print */TRUE, /* format */NULL);
+
+  opt_reg_int(odb, "-prefetch:degree",
+	      "prefetch requests per trigger (0 for the prefetcher's default)",
+	      &prefetch_degree, /* default */0,
+	      /* print */TRUE, /* format */NULL);
+
+  opt_reg_flag(odb, "-prefetch:fdp",
+	       "throttle prefetch degree and distance with feedback",
+	       &prefetch_fdp, /* default */FALSE,
+	       /* print */TRUE, /* format */NULL);
+
   /* mem options */
   opt_reg_int_list(odb, "-mem:lat",
 		   "memory access latency (<first_chunk> <inter_chunk>)",
@@ -822,6 +1245,33 @@ sim_reg_options(struct opt_odb_t *odb)
 	      &mem_bus_width, /* default */8,
 	      /* print */TRUE, /* format */NULL);
 
+  opt_reg_string(odb, "-mem:dram",
+		 "DRAM timing model config, i.e., {<config>|none}",
+		 &mem_dram_opt, "none", /* print */TRUE, NULL);
+
+  opt_reg_note(odb,
+"  The DRAM config parameter <config> has the following format:\n"
+"\n"
+"    <nchan>:<nrank>:<nbank>:<rowsize>:<tRCD>:<tCAS>:<tRP>:<qsize>\n"
+"\n"
+"    <nchan>   - number of channels, each with its own data bus\n"
+"    <nrank>   - number of ranks per channel\n"
+"    <nbank>   - number of banks per rank\n"
+"    <rowsize> - row buffer size in bytes\n"
+"    <tRCD>    - activate to column access latency (in cycles)\n"
+"    <tCAS>    - column access to first data latency (in cycles)\n"
+"    <tRP>     - precharge latency (in cycles)\n"
+"    <qsize>   - request queue entries per channel\n"
+"\n"
+"    Examples:   -mem:dram 1:1:8:2048:14:14:14:16\n"
+"                -mem:dram 2:2:8:8192:20:20:20:32\n"
+"\n"
+"  With a DRAM config, memory accesses are timed by open-page banks with\n"
+"  FR-FCFS scheduling instead of the fixed -mem:lat first chunk latency;\n"
+"  each -mem:width byte chunk still takes the -mem:lat inter chunk latency\n"
+"  on its channel's data bus.\n"
+		 );
+
   /* TLB options */
 
   opt_reg_string(odb, "-tlb:itlb",
@@ -837,6 +1287,44 @@ sim_reg_options(struct opt_odb_t *odb)
 	      &tlb_miss_lat, /* default */30,
 	      /* print */TRUE, /* format */NULL);
 
+  opt_reg_string(odb, "-tlb:stlb",
+		 "second level, unified TLB config, i.e., {<config>|none}",
+		 &stlb_opt, "none", /* print */TRUE, NULL);
+
+  opt_reg_int(odb, "-tlb:stlblat",
+	      "second level TLB hit latency (in cycles)",
+	      &stlb_lat, /* default */7,
+	      /* print */TRUE, /* format */NULL);
+
+  opt_reg_flag(odb, "-tlb:ptw",
+	       "walk the page table through the data caches on TLB misses",
+	       &tlb_ptw, /* default */FALSE,
+	       /* print */TRUE, /* format */NULL);
+
+  opt_reg_int(odb, "-tlb:pwc",
+	      "page walk cache entries (0 for none)",
+	      &tlb_pwc_size, /* default */16,
+	      /* print */TRUE, /* format */NULL);
+
+  opt_reg_flag(odb, "-tlb:huge",
+	       "back large mappings with huge pages",
+	       &tlb_huge, /* default */FALSE,
+	       /* print */TRUE, /* format */NULL);
+
+  opt_reg_note(odb,
+"  First level TLB misses go to the second level TLB, if any, and misses\n"
+"  there take -tlb:lat cycles, or with -tlb:ptw a walk of the page table,\n"
+"  whose entries are loaded one level at a time through the data caches\n"
+"  after a lookup in the page walk cache of upper level entries.  All TLBs\n"
+"  then need the same page size.  With -tlb:huge, the text segment and the\n"
+"  data segment are backed by huge pages of 512 base pages, i.e., 2 MB with\n"
+"  4 KB pages, wherever they wholly contain one, and -tlb:huge needs\n"
+"  -tlb:ptw.  TLBs hold huge pages in the same entries as base pages.\n"
+"\n"
+"    Examples:   -tlb:stlb stlb:128:4096:8:l -tlb:ptw\n"
+"                -tlb:stlb stlb:128:4096:8:l -tlb:ptw -tlb:huge\n"
+	       );
+
   /* resource configuration */
 
   opt_reg_int(odb, "-res:ialu",
@@ -881,10 +1369,32 @@ sim_check_options(struct opt_odb_t *odb,        /* options database */
 {
   char name[128], c;
   int nsets, bsize, assoc;
+  int prefetch_type;			/* type of the cache's prefetcher */
+  enum cache_incl incl;			/* inclusion of the l1s in the l2s */
 
   if (fastfwd_count < 0 || fastfwd_count >= 2147483647)
     fatal("bad fast forward count: %d", fastfwd_count);
 
+  if (sample_unit < 0)
+    fatal("bad sample unit: %d", sample_unit);
+  if (sample_unit > 0 && sample_warmup < 0)
+    fatal("bad sample warm-up: %d", sample_warmup);
+  if (sample_unit > 0 && sample_period < sample_unit + sample_warmup)
+    fatal("sample period must cover the sample warm-up and unit");
+
+  if (chkpt_nelt != 0)
+    {
+      if (chkpt_nelt != 2)
+	fatal("bad checkpoint args, use: <fname format> <interval>");
+      if (strchr(chkpt_opts[0], '%') == NULL)
+	fatal("periodic checkpoint filename must be printf-style format");
+      if (sscanf(chkpt_opts[1], "%Ld", &chkpt_interval) != 1
+	  || chkpt_interval <= 0)
+	fatal("can't parse periodic checkpoint interval '%s'", chkpt_opts[1]);
+      if (sample_unit > 0)
+	fatal("periodic checkpoints cannot be written by a sampled simulation");
+    }
+
   if (ruu_ifq_size < 1 || (ruu_ifq_size & (ruu_ifq_size - 1)) != 0)
     fatal("inst fetch queue size must be positive > 0 and a power of two");
 
@@ -999,6 +1509,9 @@ sim_check_options(struct opt_odb_t *odb,        /* options database */
   if (LSQ_size < 2 || (LSQ_size & (LSQ_size-1)) != 0)
     fatal("LSQ size must be a positive number > 1 and a power of two");
 
+  if (LSQ_storesets < 0 || (LSQ_storesets & (LSQ_storesets-1)) != 0)
+    fatal("store set SSIT entries must be zero or a power of two");
+
   /* use a level 1 D-cache? */
   if (!mystricmp(cache_dl1_opt, "none"))
     {
@@ -1011,25 +1524,33 @@ sim_check_options(struct opt_odb_t *odb,        /* options database */
     }
   else /* dl1 is defined */
     {
-      if (sscanf(cache_dl1_opt, "%[^:]:%d:%d:%d:%c",
-		 name, &nsets, &bsize, &assoc, &c) != 5)
-	fatal("bad l1 D-cache parms: <name>:<nsets>:<bsize>:<assoc>:<repl>");
+      prefetch_type = 0;
+      if (sscanf(cache_dl1_opt, "%[^:]:%d:%d:%d:%c:%d", name,
+		 &nsets, &bsize, &assoc, &c, &prefetch_type) < 5)
+	fatal("bad l1 D-cache parms: "
+	      "<name>:<nsets>:<bsize>:<assoc>:<repl>[:<pref>]");
       cache_dl1 = cache_create(name, nsets, bsize, /* balloc */FALSE,
 			       /* usize */0, assoc, cache_char2policy(c),
-			       dl1_access_fn, /* hit lat */cache_dl1_lat);
+			       dl1_access_fn, /* hit lat */cache_dl1_lat, prefetch_type);
+      cache_set_mshr(cache_dl1, cache_dl1_mshr, cache_dl1_mshr_targets);
+      cache_set_wbuf(cache_dl1, cache_dl1_wbuf);
 
       /* is the level 2 D-cache defined? */
       if (!mystricmp(cache_dl2_opt, "none"))
 	cache_dl2 = NULL;
       else
 	{
-	  if (sscanf(cache_dl2_opt, "%[^:]:%d:%d:%d:%c",
-		     name, &nsets, &bsize, &assoc, &c) != 5)
+	  prefetch_type = 0;
+	  if (sscanf(cache_dl2_opt, "%[^:]:%d:%d:%d:%c:%d", name,
+		     &nsets, &bsize, &assoc, &c, &prefetch_type) < 5)
 	    fatal("bad l2 D-cache parms: "
-		  "<name>:<nsets>:<bsize>:<assoc>:<repl>");
+		  "<name>:<nsets>:<bsize>:<assoc>:<repl>[:<pref>]");
 	  cache_dl2 = cache_create(name, nsets, bsize, /* balloc */FALSE,
 				   /* usize */0, assoc, cache_char2policy(c),
-				   dl2_access_fn, /* hit lat */cache_dl2_lat);
+				   dl2_access_fn, /* hit lat */cache_dl2_lat,
+				   prefetch_type);
+	  cache_set_mshr(cache_dl2, cache_dl2_mshr, cache_dl2_mshr_targets);
+	  cache_set_wbuf(cache_dl2, cache_dl2_wbuf);
 	}
     }
 
@@ -1067,12 +1588,14 @@ sim_check_options(struct opt_odb_t *odb,        /* options database */
     }
   else /* il1 is defined */
     {
-      if (sscanf(cache_il1_opt, "%[^:]:%d:%d:%d:%c",
-		 name, &nsets, &bsize, &assoc, &c) != 5)
-	fatal("bad l1 I-cache parms: <name>:<nsets>:<bsize>:<assoc>:<repl>");
+      prefetch_type = 0;
+      if (sscanf(cache_il1_opt, "%[^:]:%d:%d:%d:%c:%d", name,
+		 &nsets, &bsize, &assoc, &c, &prefetch_type) < 5)
+	fatal("bad l1 I-cache parms: "
+	      "<name>:<nsets>:<bsize>:<assoc>:<repl>[:<pref>]");
       cache_il1 = cache_create(name, nsets, bsize, /* balloc */FALSE,
 			       /* usize */0, assoc, cache_char2policy(c),
-			       il1_access_fn, /* hit lat */cache_il1_lat);
+			       il1_access_fn, /* hit lat */cache_il1_lat, prefetch_type);
 
       /* is the level 2 D-cache defined? */
       if (!mystricmp(cache_il2_opt, "none"))
@@ -1085,13 +1608,15 @@ sim_check_options(struct opt_odb_t *odb,        /* options database */
 	}
       else
 	{
-	  if (sscanf(cache_il2_opt, "%[^:]:%d:%d:%d:%c",
-		     name, &nsets, &bsize, &assoc, &c) != 5)
+	  prefetch_type = 0;
+	  if (sscanf(cache_il2_opt, "%[^:]:%d:%d:%d:%c:%d", name,
+		     &nsets, &bsize, &assoc, &c, &prefetch_type) < 5)
 	    fatal("bad l2 I-cache parms: "
-		  "<name>:<nsets>:<bsize>:<assoc>:<repl>");
+		  "<name>:<nsets>:<bsize>:<assoc>:<repl>[:<pref>]");
 	  cache_il2 = cache_create(name, nsets, bsize, /* balloc */FALSE,
 				   /* usize */0, assoc, cache_char2policy(c),
-				   il2_access_fn, /* hit lat */cache_il2_lat);
+				   il2_access_fn, /* hit lat */cache_il2_lat,
+				   prefetch_type);
 	}
     }
 
@@ -1106,7 +1631,7 @@ sim_check_options(struct opt_odb_t *odb,        /* options database */
       itlb = cache_create(name, nsets, bsize, /* balloc */FALSE,
 			  /* usize */sizeof(md_addr_t), assoc,
 			  cache_char2policy(c), itlb_access_fn,
-			  /* hit latency */1);
+			  /* hit latency */1, /* no prefetcher */0);
     }
 
   /* use a D-TLB? */
@@ -1120,7 +1645,110 @@ sim_check_options(struct opt_odb_t *odb,        /* options database */
       dtlb = cache_create(name, nsets, bsize, /* balloc */FALSE,
 			  /* usize */sizeof(md_addr_t), assoc,
 			  cache_char2policy(c), dtlb_access_fn,
-			  /* hit latency */1);
+			  /* hit latency */1, /* no prefetcher */0);
+    }
+
+  /* use a second level TLB? */
+  if (!mystricmp(stlb_opt, "none"))
+    stlb = NULL;
+  else
+    {
+      if (sscanf(stlb_opt, "%[^:]:%d:%d:%d:%c",
+		 name, &nsets, &bsize, &assoc, &c) != 5)
+	fatal("bad TLB parms: <name>:<nsets>:<page_size>:<assoc>:<repl>");
+      if (stlb_lat < 1)
+	fatal("second level TLB hit latency must be greater than zero");
+      stlb = cache_create(name, nsets, bsize, /* balloc */FALSE,
+			  /* usize */sizeof(md_addr_t), assoc,
+			  cache_char2policy(c), stlb_access_fn,
+			  /* hit latency */stlb_lat, /* no prefetcher */0);
+    }
+
+  /* walk the page table on TLB misses? */
+  if (tlb_huge && !tlb_ptw)
+    fatal("huge pages (-tlb:huge) need page walks (-tlb:ptw)");
+  if (tlb_ptw && (itlb || dtlb || stlb))
+    {
+      bsize = (dtlb ? dtlb : itlb ? itlb : stlb)->bsize;
+      if ((itlb && itlb->bsize != bsize) || (dtlb && dtlb->bsize != bsize)
+	  || (stlb && stlb->bsize != bsize))
+	fatal("page walks (-tlb:ptw) need the same page size in all TLBs");
+      ptw = ptw_create("ptw", PTW_VA_BITS, log_base2(bsize), PTW_BASE,
+		       tlb_pwc_size, ptw_mem_access,
+		       tlb_huge ? huge_mapped : NULL);
+    }
+
+  /* compressed and sectored blocks */
+  if (cache_dl2_bdi)
+    {
+      if (!cache_dl2)
+	fatal("-cache:dl2bdi needs an l2 data cache");
+      cache_set_compress(cache_dl2, l2_blk_data);
+    }
+  if (cache_dl1)
+    cache_set_sectors(cache_dl1, cache_dl1_sect);
+  if (cache_dl2)
+    cache_set_sectors(cache_dl2, cache_dl2_sect);
+  if (cache_il1 && cache_il1 != cache_dl1 && cache_il1 != cache_dl2)
+    cache_set_sectors(cache_il1, cache_il1_sect);
+  else if (cache_il1_sect)
+    fatal("a unified l1 inst cache takes the sectors of its data cache");
+
+  /* every cache is accessed at the cycle of the pipeline, and drains its
+     prefetch queue each cycle rather than on each demand access */
+  if (cache_dl1)
+    cache_set_timed(cache_dl1);
+  if (cache_dl2)
+    cache_set_timed(cache_dl2);
+  if (cache_il1 && cache_il1 != cache_dl1 && cache_il1 != cache_dl2)
+    cache_set_timed(cache_il1);
+  if (cache_il2 && cache_il2 != cache_dl2)
+    cache_set_timed(cache_il2);
+  if (itlb)
+    cache_set_timed(itlb);
+  if (dtlb)
+    cache_set_timed(dtlb);
+
+  /* the prefetch queue and throttle apply to every cache level */
+  if (cache_dl1)
+    cache_set_prefetch(cache_dl1, prefetch_qsize, prefetch_bandwidth,
+		       prefetch_degree, prefetch_fdp);
+  if (cache_dl2)
+    cache_set_prefetch(cache_dl2, prefetch_qsize, prefetch_bandwidth,
+		       prefetch_degree, prefetch_fdp);
+  if (cache_il1 && cache_il1 != cache_dl1 && cache_il1 != cache_dl2)
+    cache_set_prefetch(cache_il1, prefetch_qsize, prefetch_bandwidth,
+		       prefetch_degree, prefetch_fdp);
+  if (cache_il2 && cache_il2 != cache_dl2)
+    cache_set_prefetch(cache_il2, prefetch_qsize, prefetch_bandwidth,
+		       prefetch_degree, prefetch_fdp);
+
+  /* victim caches, and the inclusion of the l1 caches in the l2 caches */
+  if (cache_dl1)
+    cache_set_victim(cache_dl1, cache_dl1_victim);
+  if (cache_dl2)
+    cache_set_victim(cache_dl2, cache_dl2_victim);
+  if (cache_il1 && cache_il1 != cache_dl1 && cache_il1 != cache_dl2)
+    cache_set_victim(cache_il1, cache_il1_victim);
+  else if (cache_il1_victim)
+    fatal("a unified l1 inst cache takes the victim cache of its data cache");
+
+  /* set index functions */
+  if (cache_dl1)
+    cache_set_index(cache_dl1, cache_str2index(cache_dl1_index_opt));
+  if (cache_dl2)
+    cache_set_index(cache_dl2, cache_str2index(cache_dl2_index_opt));
+  if (cache_il1 && cache_il1 != cache_dl1 && cache_il1 != cache_dl2)
+    cache_set_index(cache_il1, cache_str2index(cache_il1_index_opt));
+  else if (cache_str2index(cache_il1_index_opt) != BitSelect)
+    fatal("a unified l1 inst cache takes the set index of its data cache");
+  incl = cache_str2incl(cache_incl_opt);
+  if (incl != NINE)
+    {
+      if (cache_dl2)
+	cache_set_lower(cache_dl1, cache_dl2, incl);
+      if (cache_il2 && cache_il1 != cache_dl1)
+	cache_set_lower(cache_il1, cache_il2, incl);
     }
 
   if (cache_dl1_lat < 1)
@@ -1144,6 +1772,23 @@ sim_check_options(struct opt_odb_t *odb,        /* options database */
   if (mem_bus_width < 1 || (mem_bus_width & (mem_bus_width-1)) != 0)
     fatal("memory bus width must be positive non-zero and a power of two");
 
+  /* use a DRAM timing model? */
+  if (!mystricmp(mem_dram_opt, "none"))
+    mem_dram = NULL;
+  else
+    {
+      int nchan, nrank, nbank, row_size, t_rcd, t_cas, t_rp, qsize;
+
+      if (sscanf(mem_dram_opt, "%d:%d:%d:%d:%d:%d:%d:%d",
+		 &nchan, &nrank, &nbank, &row_size,
+		 &t_rcd, &t_cas, &t_rp, &qsize) != 8)
+	fatal("bad DRAM parms: "
+	      "<nchan>:<nrank>:<nbank>:<rowsize>:<tRCD>:<tCAS>:<tRP>:<qsize>");
+      mem_dram = dram_create("dram", nchan, nrank, nbank, row_size,
+			     t_rcd, t_cas, t_rp, qsize,
+			     mem_bus_width, /* transfer lat */mem_lat[1]);
+    }
+
   if (tlb_miss_lat < 1)
     fatal("TLB miss latency must be greater than zero");
 
@@ -1182,7 +1827,10 @@ sim_check_options(struct opt_odb_t *odb,        /* options database */
 void
 sim_aux_config(FILE *stream)            /* output stream */
 {
-  /* nada */
+  if (mem_dram)
+    dram_config(mem_dram, stream);
+  if (ptw)
+    ptw_config(ptw, stream);
 }
 
 /* register simulator-specific statistics */
@@ -1190,6 +1838,12 @@ void
 sim_reg_stats(struct stat_sdb_t *sdb)   /* stats database */
 {
   int i;
+  char expr[512];
+  /* sim_num_insn also counts the functionally warmed insts of a sampled
+     simulation, the per-inst performance stats use the detailed insts */
+  char *detail_insn =
+    sample_unit ? "(sim_num_insn - sample_warm_insn)" : "sim_num_insn";
+
   stat_reg_counter(sdb, "sim_num_insn",
 		   "total number of instructions committed",
 		   &sim_num_insn, sim_num_insn, NULL);
@@ -1232,18 +1886,79 @@ sim_reg_stats(struct stat_sdb_t *sdb)   /* stats database */
   stat_reg_counter(sdb, "sim_cycle",
 		   "total simulation time in cycles",
 		   &sim_cycle, /* initial value */0, /* format */NULL);
+  sprintf(expr, "%s / sim_cycle", detail_insn);
   stat_reg_formula(sdb, "sim_IPC",
 		   "instructions per cycle",
-		   "sim_num_insn / sim_cycle", /* format */NULL);
+		   expr, /* format */NULL);
+  sprintf(expr, "sim_cycle / %s", detail_insn);
   stat_reg_formula(sdb, "sim_CPI",
 		   "cycles per instruction",
-		   "sim_cycle / sim_num_insn", /* format */NULL);
+		   expr, /* format */NULL);
   stat_reg_formula(sdb, "sim_exec_BW",
 		   "total instructions (mis-spec + committed) per cycle",
 		   "sim_total_insn / sim_cycle", /* format */NULL);
+  sprintf(expr, "%s / sim_num_branches", detail_insn);
   stat_reg_formula(sdb, "sim_IPB",
 		   "instruction per branch",
-		   "sim_num_insn / sim_num_branches", /* format */NULL);
+		   expr, /* format */NULL);
+
+  /* sampled simulation stats */
+  if (sample_unit)
+    {
+      stat_reg_counter(sdb, "sample_units",
+		       "number of sample units measured",
+		       &sample_units, /* initial value */0, /* format */NULL);
+      stat_reg_counter(sdb, "sample_insn",
+		       "total number of instructions in the sample units",
+		       &sample_insn, /* initial value */0, /* format */NULL);
+      stat_reg_counter(sdb, "sample_cycles",
+		       "total simulation time in cycles of the sample units",
+		       &sample_cycles, /* initial value */0, /* format */NULL);
+      stat_reg_counter(sdb, "sample_warm_insn",
+		       "total number of instructions functionally warmed",
+		       &sample_warm_insn, /* initial value */0,
+		       /* format */NULL);
+      stat_reg_counter(sdb, "sample_warm_cycles",
+		       "total memory system cycles of the functional warming",
+		       &sample_warm_cycles, /* initial value */0,
+		       /* format */NULL);
+      stat_reg_double(sdb, "sample_CPI",
+		      "mean cycles per instruction of the sample units",
+		      &sample_cpi, /* initial value */0.0, /* format */NULL);
+      stat_reg_double(sdb, "sample_CPI_sdev",
+		      "standard deviation of the sample unit CPIs",
+		      &sample_cpi_sdev, /* initial value */0.0,
+		      /* format */NULL);
+      stat_reg_double(sdb, "sample_CPI_err",
+		      "half-width of the 95% confidence interval of sample_CPI",
+		      &sample_cpi_err, /* initial value */0.0,
+		      /* format */NULL);
+      stat_reg_formula(sdb, "sample_CPI_rel_err",
+		       "sample_CPI_err relative to sample_CPI",
+		       "sample_CPI_err / sample_CPI", /* format */NULL);
+      stat_reg_formula(sdb, "sample_IPC",
+		       "instructions per cycle of the sample units",
+		       "sample_insn / sample_cycles", /* format */NULL);
+      stat_reg_formula(sdb, "sample_est_cycle",
+		       "estimated simulation time in cycles of all insts",
+		       "sample_CPI * sim_num_insn", /* format */NULL);
+    }
+
+  /* simulation started from a checkpoint */
+  if (sim_chkpt_fname)
+    {
+      stat_reg_counter(sdb, "chkpt_start_insn",
+		       "instructions executed before the checkpoint",
+		       &chkpt_start_insn, chkpt_start_insn, /* format */NULL);
+      stat_reg_formula(sdb, "chkpt_region_insn",
+		       "instructions committed since the checkpoint",
+		       "sim_num_insn - chkpt_start_insn", /* format */NULL);
+      stat_reg_formula(sdb, "chkpt_region_CPI",
+		       "cycles per instruction since the checkpoint",
+		       sample_unit
+		       ? "sim_cycle / (chkpt_region_insn - sample_warm_insn)"
+		       : "sim_cycle / chkpt_region_insn", /* format */NULL);
+    }
 
   /* occupancy stats */
   stat_reg_counter(sdb, "IFQ_count", "cumulative IFQ occupancy",
@@ -1284,14 +1999,25 @@ sim_reg_stats(struct stat_sdb_t *sdb)   /* stats database */
                    "lsq_occupancy / lsq_rate", /* format */NULL);
   stat_reg_formula(sdb, "lsq_full", "fraction of time (cycle's) LSQ was full",
                    "LSQ_fcount / sim_cycle", /* format */NULL);
+  if (LSQ_storesets)
+    {
+      stat_reg_counter(sdb, "lsq_ss_waits",
+		       "loads held by the store set of a store",
+		       &lsq_ss_waits, /* initial value */0, /* format */NULL);
+      stat_reg_counter(sdb, "lsq_ss_violations",
+		       "loads caught passing a store to their address",
+		       &lsq_ss_violations, /* initial value */0,
+		       /* format */NULL);
+    }
 
   stat_reg_counter(sdb, "sim_slip",
                    "total number of slip cycles",
                    &sim_slip, 0, NULL);
   /* register baseline stats */
+  sprintf(expr, "sim_slip / %s", detail_insn);
   stat_reg_formula(sdb, "avg_sim_slip",
                    "the average slip between issue and retirement",
-                   "sim_slip / sim_num_insn", NULL);
+                   expr, NULL);
 
   /* register predictor stats */
   if (pred)
@@ -1312,6 +2038,12 @@ sim_reg_stats(struct stat_sdb_t *sdb)   /* stats database */
     cache_reg_stats(itlb, sdb);
   if (dtlb)
     cache_reg_stats(dtlb, sdb);
+  if (stlb)
+    cache_reg_stats(stlb, sdb);
+  if (ptw)
+    ptw_reg_stats(ptw, sdb);
+  if (mem_dram)
+    dram_reg_stats(mem_dram, sdb);
 
   /* debug variable(s) */
   stat_reg_counter(sdb, "sim_invalid_addrs",
@@ -1358,8 +2090,10 @@ static void lsq_init(void);
 static void rslink_init(int nlinks);
 static void eventq_init(void);
 static void readyq_init(void);
+static void lsq_mem_init(void);
 static void cv_init(void);
 static void tracer_init(void);
+static void predec_init(void);
 static void fetch_init(void);
 
 /* initialize the simulator */
@@ -1402,6 +2136,73 @@ simoo_mstate_obj(FILE *stream,			/* output stream */
 /* total RS links allocated at program start */
 #define MAX_RS_LINKS                    4096
 
+/* most caches and TLBs saved in a checkpoint */
+#define MAX_CHKPT_CACHES		8
+
+/* collect the caches and TLBs saved in checkpoints into CPS, each cache
+   once even if it is both an instruction and a data cache, returns their
+   number */
+static int
+chkpt_caches(struct cache_t **cps)	/* caches, in checkpoint order */
+{
+  struct cache_t *all[MAX_CHKPT_CACHES];
+  int i, j, n = 0;
+
+  all[0] = cache_il1; all[1] = cache_il2;
+  all[2] = cache_dl1; all[3] = cache_dl2;
+  all[4] = itlb; all[5] = dtlb; all[6] = stlb;
+  all[7] = ptw ? ptw->pwc : NULL;
+
+  for (i=0; i < MAX_CHKPT_CACHES; i++)
+    {
+      if (!all[i])
+	continue;
+      for (j=0; j < n && cps[j] != all[i]; j++)
+	/* nada */;
+      if (j == n)
+	cps[n++] = all[i];
+    }
+  return n;
+}
+
+/* write the warm state of the caches, TLBs and branch predictor to
+   checkpoint stream FD, after the architected state */
+static void
+warm_write_chkpt(FILE *fd)		/* stream to write to */
+{
+  struct cache_t *cps[MAX_CHKPT_CACHES];
+  int i, n = chkpt_caches(cps);
+
+  fprintf(fd, "/* ** warm state: caches, TLBs and branch predictor */\n\n");
+  for (i=0; i < n; i++)
+    cache_write_chkpt(cps[i], fd);
+  if (pred)
+    bpred_write_chkpt(pred, fd);
+}
+
+/* restore the warm state of the caches, TLBs and branch predictor from
+   checkpoint stream FD, they stay cold if the checkpoint has none */
+static void
+warm_read_chkpt(FILE *fd)		/* stream to read */
+{
+  struct cache_t *cps[MAX_CHKPT_CACHES];
+  int i, n = chkpt_caches(cps);
+
+  for (i=0; i < n; i++)
+    if (!cache_read_chkpt(cps[i], fd))
+      break;
+  if (i == n && pred)
+    i += bpred_read_chkpt(pred, fd);
+
+  if (i == 0)
+    fprintf(stderr, "sim: checkpoint has no warm state, starting cold\n");
+  else if (i != n + (pred != NULL))
+    fatal("checkpoint warm state is incomplete");
+  else
+    fprintf(stderr,
+	    "sim: restored warm caches, TLBs and branch predictor state\n");
+}
+
 /* load program into simulated state */
 void
 sim_load_prog(char *fname,		/* program to load */
@@ -1411,6 +2212,18 @@ sim_load_prog(char *fname,		/* program to load */
   /* load program text and data, set up environment, memory, and regs */
   ld_load_prog(fname, argc, argv, envp, &regs, mem, TRUE);
 
+  /* restore the warm state that follows the architected state */
+  if (sim_chkpt_fd)
+    {
+      chkpt_start_insn = sim_num_insn;
+      warm_read_chkpt(sim_chkpt_fd);
+      eio_close(sim_chkpt_fd);
+      sim_chkpt_fd = NULL;
+    }
+
+  if (chkpt_interval && !sim_eio_fd)
+    fatal("checkpoints can only be generated while running an EIO trace");
+
   /* initialize here, so symbols can be loaded */
   if (ptrace_nelt == 2)
     {
@@ -1428,12 +2241,14 @@ sim_load_prog(char *fname,		/* program to load */
   fu_pool = res_create_pool("fu-pool", fu_config, N_ELT(fu_config));
   rslink_init(MAX_RS_LINKS);
   tracer_init();
+  predec_init();
   fetch_init();
   cv_init();
   eventq_init();
   readyq_init();
   ruu_init();
   lsq_init();
+  lsq_mem_init();
 
   /* initialize the DLite debugger */
   dlite_init(simoo_reg_obj, simoo_mem_obj, simoo_mstate_obj);
@@ -1809,22 +2624,144 @@ ruu_release_fu(void)
  * drains this queue
  */
 
-/* pending event queue, sorted from soonest to latest event (in time), NOTE:
-   RS_LINK nodes are used for the event queue list so that it need not be
+/* pending event queue, a timing wheel of EVENTQ_HORIZON buckets, one per
+   cycle, for the events of the next EVENTQ_HORIZON cycles, and a heap
+   ordered by time for the events after these; events of the same cycle are
+   serviced latest queued first, as the sorted event list once did, NOTE:
+   RS_LINK nodes are used for the event queue so that it need not be
    updated during squash events */
-static struct RS_link *event_queue;
+#define EVENTQ_HORIZON			1024	/* a power of two */
+
+/* timing wheel buckets, the events of cycle WHEN are in bucket WHEN modulo
+   EVENTQ_HORIZON, latest queued first */
+static struct RS_link *event_wheel[EVENTQ_HORIZON];
+
+/* first cycle not yet serviced, the wheel holds events before
+   EVENTQ_HORIZON cycles after it */
+static tick_t eventq_base;
+
+/* events in the wheel */
+static int eventq_nwheel;
+
+/* events after the wheel horizon, a heap ordered by time and then by the
+   order in which they were queued */
+struct eventq_far_t {
+  tick_t when;				/* time of the event */
+  counter_t seq;			/* order the event was queued in */
+  struct RS_link *ev;			/* the event */
+};
+static struct eventq_far_t *eventq_far;
+static int eventq_nfar;
+static counter_t eventq_seq;
 
 /* initialize the event queue structures */
 static void
 eventq_init(void)
 {
-  event_queue = NULL;
+  int i;
+
+  for (i=0; i < EVENTQ_HORIZON; i++)
+    event_wheel[i] = NULL;
+  eventq_base = 0;
+  eventq_nwheel = 0;
+
+  /* every event holds an RS link, so this many will always do */
+  eventq_far = calloc(MAX_RS_LINKS, sizeof(struct eventq_far_t));
+  if (!eventq_far)
+    fatal("out of virtual memory");
+  eventq_nfar = 0;
+  eventq_seq = 0;
 }
 
-/* dump the contents of the event queue */
+/* non-zero if far event A comes before far event B */
+#define EVENTQ_FAR_BEFORE(A, B)						\
+  ((A)->when < (B)->when || ((A)->when == (B)->when && (A)->seq < (B)->seq))
+
+/* add event EV at time WHEN to the far event heap */
+static void
+eventq_far_push(struct RS_link *ev, tick_t when)
+{
+  int i, parent;
+  struct eventq_far_t far;
+
+  far.when = when;
+  far.seq = eventq_seq++;
+  far.ev = ev;
+
+  /* sift up */
+  for (i=eventq_nfar++; i > 0; i=parent)
+    {
+      parent = (i - 1) / 2;
+      if (!EVENTQ_FAR_BEFORE(&far, &eventq_far[parent]))
+	break;
+      eventq_far[i] = eventq_far[parent];
+    }
+  eventq_far[i] = far;
+}
+
+/* remove the first event from the far event heap */
+static void
+eventq_far_pop(void)
+{
+  int i, child;
+  struct eventq_far_t last;
+
+  last = eventq_far[--eventq_nfar];
+
+  /* sift down */
+  for (i=0; (child = 2*i + 1) < eventq_nfar; i=child)
+    {
+      if (child + 1 < eventq_nfar
+	  && EVENTQ_FAR_BEFORE(&eventq_far[child+1], &eventq_far[child]))
+	child++;
+      if (!EVENTQ_FAR_BEFORE(&eventq_far[child], &last))
+	break;
+      eventq_far[i] = eventq_far[child];
+    }
+  eventq_far[i] = last;
+}
+
+/* move the far events that are now within the wheel horizon to the wheel,
+   earliest queued first so the latest queued end up first in their bucket,
+   no event for these cycles was queued directly to the wheel yet */
+static void
+eventq_far_refill(void)
+{
+  struct RS_link *ev;
+
+  while (eventq_nfar > 0
+	 && eventq_far[0].when < eventq_base + EVENTQ_HORIZON)
+    {
+      ev = eventq_far[0].ev;
+      ev->next = event_wheel[eventq_far[0].when & (EVENTQ_HORIZON-1)];
+      event_wheel[eventq_far[0].when & (EVENTQ_HORIZON-1)] = ev;
+      eventq_nwheel++;
+      eventq_far_pop();
+    }
+}
+
+/* dump one event of the event queue */
+static void
+eventq_dumpev(FILE *stream,			/* output stream */
+	      struct RS_link *ev)		/* event to dump */
+{
+  /* is event still valid? */
+  if (RSLINK_VALID(ev))
+    {
+      struct RUU_station *rs = RSLINK_RS(ev);
+
+      fprintf(stream, "idx: %2d: @ %.0f\n",
+	      (int)(rs - (rs->in_LSQ ? LSQ : RUU)), (double)ev->x.when);
+      ruu_dumpent(rs, rs - (rs->in_LSQ ? LSQ : RUU),
+		  stream, /* !header */FALSE);
+    }
+}
+
+/* dump the contents of the event queue */
 static void
 eventq_dump(FILE *stream)			/* output stream */
 {
+  int i;
   struct RS_link *ev;
 
   if (!stream)
@@ -1832,28 +2769,24 @@ eventq_dump(FILE *stream)			/* output stream */
 
   fprintf(stream, "** event queue state **\n");
 
-  for (ev = event_queue; ev != NULL; ev = ev->next)
+  /* wheel events in time order, then the far events in heap order */
+  for (i=0; i < EVENTQ_HORIZON; i++)
     {
-      /* is event still valid? */
-      if (RSLINK_VALID(ev))
-	{
-	  struct RUU_station *rs = RSLINK_RS(ev);
-
-	  fprintf(stream, "idx: %2d: @ %.0f\n",
-		  (int)(rs - (rs->in_LSQ ? LSQ : RUU)), (double)ev->x.when);
-	  ruu_dumpent(rs, rs - (rs->in_LSQ ? LSQ : RUU),
-		      stream, /* !header */FALSE);
-	}
+      for (ev = event_wheel[(eventq_base + i) & (EVENTQ_HORIZON-1)];
+	   ev != NULL; ev = ev->next)
+	eventq_dumpev(stream, ev);
     }
+  for (i=0; i < eventq_nfar; i++)
+    eventq_dumpev(stream, eventq_far[i].ev);
 }
 
-/* insert an event for RS into the event queue, event queue is sorted from
+/* insert an event for RS into the event queue, events are serviced from
    earliest to latest event, event and associated side-effects will be
    apparent at the start of cycle WHEN */
 static void
 eventq_queue_event(struct RUU_station *rs, tick_t when)
 {
-  struct RS_link *prev, *ev, *new_ev;
+  struct RS_link *new_ev;
 
   if (rs->completed)
     panic("event completed");
@@ -1865,23 +2798,35 @@ eventq_queue_event(struct RUU_station *rs, tick_t when)
   RSLINK_NEW(new_ev, rs);
   new_ev->x.when = when;
 
-  /* locate insertion point */
-  for (prev=NULL, ev=event_queue;
-       ev && ev->x.when < when;
-       prev=ev, ev=ev->next);
-
-  if (prev)
+  if (when < eventq_base + EVENTQ_HORIZON)
     {
-      /* insert middle or end */
-      new_ev->next = prev->next;
-      prev->next = new_ev;
+      /* insert at beginning of its cycle's bucket */
+      new_ev->next = event_wheel[when & (EVENTQ_HORIZON-1)];
+      event_wheel[when & (EVENTQ_HORIZON-1)] = new_ev;
+      eventq_nwheel++;
     }
   else
+    eventq_far_push(new_ev, when);
+}
+
+/* return the time of the next event, squashed or not, or 0 if there is
+   none */
+static tick_t
+eventq_next_time(void)
+{
+  tick_t when;
+
+  if (eventq_nwheel)
     {
-      /* insert at beginning */
-      new_ev->next = event_queue;
-      event_queue = new_ev;
+      /* the first non-empty bucket of the wheel */
+      for (when = eventq_base; !event_wheel[when & (EVENTQ_HORIZON-1)]; when++)
+	/* nada */;
+      return when;
     }
+  else if (eventq_nfar)
+    return eventq_far[0].when;
+  else
+    return 0;
 }
 
 /* return the next event that has already occurred, returns NULL when no
@@ -1889,13 +2834,32 @@ eventq_queue_event(struct RUU_station *rs, tick_t when)
 static struct RUU_station *
 eventq_next_event(void)
 {
-  struct RS_link *ev;
+  struct RS_link *ev, **bucket;
 
-  if (event_queue && event_queue->x.when <= sim_cycle)
+  while (eventq_base <= sim_cycle)
     {
-      /* unlink and return first event on priority list */
-      ev = event_queue;
-      event_queue = event_queue->next;
+      bucket = &event_wheel[eventq_base & (EVENTQ_HORIZON-1)];
+      if (!*bucket)
+	{
+	  /* no more events this cycle, move on to the next one */
+	  eventq_base++;
+	  if (!eventq_nwheel && eventq_base <= sim_cycle)
+	    {
+	      /* skip the empty wheel to the first far event */
+	      if (!eventq_nfar)
+		eventq_base = sim_cycle + 1;
+	      else if (eventq_far[0].when - (EVENTQ_HORIZON-1) > eventq_base)
+		eventq_base = MIN(eventq_far[0].when - (EVENTQ_HORIZON-1),
+				  sim_cycle + 1);
+	    }
+	  eventq_far_refill();
+	  continue;
+	}
+
+      /* unlink first event of the cycle */
+      ev = *bucket;
+      *bucket = ev->next;
+      eventq_nwheel--;
 
       /* event still valid? */
       if (RSLINK_VALID(ev))
@@ -1908,20 +2872,13 @@ eventq_next_event(void)
 	  /* event is valid, return resv station */
 	  return rs;
 	}
-      else
-	{
-	  /* reclaim event record */
-	  RSLINK_FREE(ev);
 
-	  /* receiving inst was squashed, return next event */
-	  return eventq_next_event();
-	}
-    }
-  else
-    {
-      /* no event or no event is ready */
-      return NULL;
+      /* receiving inst was squashed, reclaim event record */
+      RSLINK_FREE(ev);
     }
+
+  /* no event or no event is ready */
+  return NULL;
 }
 
 
@@ -1930,49 +2887,110 @@ eventq_next_event(void)
  * queue indicates which instruction have all of there *register* dependencies
  * satisfied, instruction will issue when 1) all memory dependencies for
  * the instruction have been satisfied (see lsq_refresh() for details on how
- * this is accomplished) and 2) resources are available; ready queue is fully
- * constructed each cycle before any operation is issued from it -- this
- * ensures that instruction issue priorities are properly observed; NOTE:
- * RS_LINK nodes are used for the event queue list so that it need not be
- * updated during squash events
+ * this is accomplished) and 2) resources are available; the queue is a set
+ * of bitmaps over the RUU and LSQ slots, which are allocated in program
+ * order, so a scan of a bitmap from the head of its queue, wrapping around
+ * at the end, finds the ready instructions oldest first; NOTE: the bits of
+ * squashed instructions are cleared by ruu_recover()
  */
 
-/* the ready instruction queue */
-static struct RS_link *ready_queue;
+/* ready RUU operations of the priority class (long latency operations and
+   branches), the other ready RUU operations, and ready LSQ operations,
+   which are all of the priority class */
+static BITMAP_PTR_TYPE readyq_ruu_prio;
+static BITMAP_PTR_TYPE readyq_ruu;
+static BITMAP_PTR_TYPE readyq_lsq;
+
+/* ready instructions in each bitmap */
+static int readyq_nruu_prio, readyq_nruu, readyq_nlsq;
+
+/* a scan of one ready bitmap, oldest instruction first, over the occupied
+   slots of its queue only */
+struct readyq_scan_t {
+  BITMAP_PTR_TYPE map;			/* bitmap being scanned */
+  int pos;				/* next slot to look at */
+  int end;				/* end of the slots before the wrap */
+  int wrap_end;				/* end of the slots after the wrap */
+  int slot;				/* current ready slot, -1 when done */
+};
 
-/* initialize the event queue structures */
+/* scans of the ready queue in issue order, see readyq_next() */
+static struct readyq_scan_t readyq_scan_prio, readyq_scan_lsq, readyq_scan;
+
+/* initialize the ready queue structures */
 static void
 readyq_init(void)
 {
-  ready_queue = NULL;
+  readyq_ruu_prio = calloc(BITMAP_SIZE(RUU_size), sizeof(BITMAP_ENT_TYPE));
+  readyq_ruu = calloc(BITMAP_SIZE(RUU_size), sizeof(BITMAP_ENT_TYPE));
+  readyq_lsq = calloc(BITMAP_SIZE(LSQ_size), sizeof(BITMAP_ENT_TYPE));
+  if (!readyq_ruu_prio || !readyq_ruu || !readyq_lsq)
+    fatal("out of virtual memory");
 }
 
-/* dump the contents of the ready queue */
-static void
-readyq_dump(FILE *stream)			/* output stream */
-{
-  struct RS_link *link;
+/* non-zero if RS issues in the priority class: memory and long latency
+   operations, and branch instructions */
+#define READYQ_PRIO(RS)							\
+  ((RS)->in_LSQ || (MD_OP_FLAGS((RS)->op) & (F_LONGLAT|F_CTRL)))
 
-  if (!stream)
-    stream = stderr;
-
-  fprintf(stream, "** ready queue state **\n");
+/* ready bitmap, count of ready insts in it, and slot of RS */
+#define READYQ_MAP(RS)							\
+  ((RS)->in_LSQ ? readyq_lsq : READYQ_PRIO(RS) ? readyq_ruu_prio : readyq_ruu)
+#define READYQ_NREADY(RS)						\
+  (*((RS)->in_LSQ ? &readyq_nlsq					\
+     : READYQ_PRIO(RS) ? &readyq_nruu_prio : &readyq_nruu))
+#define READYQ_SLOT(RS)		((int)((RS) - ((RS)->in_LSQ ? LSQ : RUU)))
 
-  for (link = ready_queue; link != NULL; link = link->next)
+/* move scan SCAN to the next ready slot of its queue, in age order */
+static void
+readyq_scan_next(struct readyq_scan_t *scan)
+{
+  scan->slot = BITMAP_NEXT_SET(scan->map, scan->pos, scan->end);
+  if (scan->slot < 0 && scan->wrap_end > 0)
     {
-      /* is entry still valid? */
-      if (RSLINK_VALID(link))
-	{
-	  struct RUU_station *rs = RSLINK_RS(link);
-
-	  ruu_dumpent(rs, rs - (rs->in_LSQ ? LSQ : RUU),
-		      stream, /* header */TRUE);
-	}
+      /* continue with the slots after the wrap */
+      scan->pos = 0;
+      scan->end = scan->wrap_end;
+      scan->wrap_end = 0;
+      scan->slot = BITMAP_NEXT_SET(scan->map, scan->pos, scan->end);
     }
+  if (scan->slot >= 0)
+    scan->pos = scan->slot + 1;
+}
+
+/* start scan SCAN of ready bitmap MAP at the head of its queue */
+static void
+readyq_scan_init(struct readyq_scan_t *scan,	/* scan to start */
+		 BITMAP_PTR_TYPE map,		/* ready bitmap */
+		 int nready,			/* ready insts in bitmap */
+		 int size,			/* slots in queue */
+		 int head,			/* head of queue */
+		 int num)			/* occupied slots in queue */
+{
+  scan->map = map;
+  scan->pos = head;
+  scan->end = MIN(head + num, size);
+  scan->wrap_end = head + num - scan->end;
+  if (nready)
+    readyq_scan_next(scan);
+  else
+    scan->slot = -1;
+}
+
+/* start a walk of the ready queue in issue order */
+static void
+readyq_start(void)
+{
+  readyq_scan_init(&readyq_scan_prio, readyq_ruu_prio, readyq_nruu_prio,
+		   RUU_size, RUU_head, RUU_num);
+  readyq_scan_init(&readyq_scan_lsq, readyq_lsq, readyq_nlsq,
+		   LSQ_size, LSQ_head, LSQ_num);
+  readyq_scan_init(&readyq_scan, readyq_ruu, readyq_nruu,
+		   RUU_size, RUU_head, RUU_num);
 }
 
-/* insert ready node into the ready list using ready instruction scheduling
-   policy; currently the following scheduling policy is enforced:
+/* return the next ready instruction of the walk started by readyq_start(),
+   or NULL at the end of the ready queue; the scheduling policy is:
 
      memory and long latency operands, and branch instructions first
 
@@ -1983,48 +3001,398 @@ readyq_dump(FILE *stream)			/* output stream */
   this policy works well because branches pass through the machine quicker
   which works to reduce branch misprediction latencies, and very long latency
   instructions (such loads and multiplies) get priority since they are very
-  likely on the program's critical path */
+  likely on the program's critical path; both classes issue oldest first */
+static struct RUU_station *
+readyq_next(void)
+{
+  struct RUU_station *rs;
+
+  if (readyq_scan_prio.slot >= 0
+      && (readyq_scan_lsq.slot < 0
+	  || (RUU[readyq_scan_prio.slot].seq
+	      < LSQ[readyq_scan_lsq.slot].seq)))
+    {
+      rs = &RUU[readyq_scan_prio.slot];
+      readyq_scan_next(&readyq_scan_prio);
+    }
+  else if (readyq_scan_lsq.slot >= 0)
+    {
+      rs = &LSQ[readyq_scan_lsq.slot];
+      readyq_scan_next(&readyq_scan_lsq);
+    }
+  else if (readyq_scan.slot >= 0)
+    {
+      rs = &RUU[readyq_scan.slot];
+      readyq_scan_next(&readyq_scan);
+    }
+  else
+    rs = NULL;
+
+  return rs;
+}
+
+/* dump the contents of the ready queue */
 static void
-readyq_enqueue(struct RUU_station *rs)		/* RS to enqueue */
+readyq_dump(FILE *stream)			/* output stream */
 {
-  struct RS_link *prev, *node, *new_node;
+  struct RUU_station *rs;
+
+  if (!stream)
+    stream = stderr;
+
+  fprintf(stream, "** ready queue state **\n");
 
+  for (readyq_start(); (rs = readyq_next()) != NULL; )
+    ruu_dumpent(rs, READYQ_SLOT(rs), stream, /* header */TRUE);
+}
+
+/* insert ready instruction RS into the ready queue, see readyq_next() for
+   the order in which it will issue */
+static void
+readyq_enqueue(struct RUU_station *rs)		/* RS to enqueue */
+{
   /* node is now queued */
   if (rs->queued)
     panic("node is already queued");
   rs->queued = TRUE;
 
-  /* get a free ready list node */
-  RSLINK_NEW(new_node, rs);
-  new_node->x.seq = rs->seq;
+  (void)BITMAP_SET(READYQ_MAP(rs), 0, READYQ_SLOT(rs));
+  READYQ_NREADY(rs)++;
+}
 
-  /* locate insertion point */
-  if (rs->in_LSQ || MD_OP_FLAGS(rs->op) & (F_LONGLAT|F_CTRL))
+/* remove instruction RS from the ready queue, when it issues or squashes */
+static void
+readyq_dequeue(struct RUU_station *rs)		/* RS to dequeue */
+{
+  if (!rs->queued)
+    panic("node is not queued");
+  rs->queued = FALSE;
+
+  (void)BITMAP_CLEAR(READYQ_MAP(rs), 0, READYQ_SLOT(rs));
+  READYQ_NREADY(rs)--;
+}
+
+
+/*
+ * the memory dependence tracking implementation follows, it finds the loads
+ * whose memory dependencies are satisfied for lsq_refresh() without a scan
+ * of the LSQ; a load may issue when 1) no older store has an unknown address
+ * (STA), the oldest such store is the STA barrier, or with the store set
+ * predictor, when the last fetched store of its store set has issued, and
+ * 2) the youngest older store to its address has its data (STD); loads are
+ * only checked again when something they wait for changes: their address
+ * operand, the STA barrier, or the issue of the store they wait for
+ */
+
+/* age of LSQ slot INDEX, i.e., its distance from the LSQ head */
+#define LSQ_AGE(INDEX)		(((INDEX) - LSQ_head) & (LSQ_size - 1))
+
+/* non-zero if RS is a load or a store */
+#define LSQ_IS_LOAD(RS)							\
+  ((MD_OP_FLAGS((RS)->op) & (F_MEM|F_LOAD)) == (F_MEM|F_LOAD))
+#define LSQ_IS_STORE(RS)						\
+  ((MD_OP_FLAGS((RS)->op) & (F_MEM|F_STORE)) == (F_MEM|F_STORE))
+
+/* stores by address, a hash table of doubly linked lists of LSQ slots in
+   program order, -1 terminated */
+static int *lsq_stab_head, *lsq_stab_tail;
+static int *lsq_stab_prev, *lsq_stab_next;
+#define LSQ_STAB_HASH(ADDR)	(((ADDR) >> 2) & (LSQ_size - 1))
+
+/* stores with unknown addresses, the oldest of which is the STA barrier,
+   -1 for none; the barrier is found again at the next lsq_refresh() when
+   the set changes */
+static BITMAP_PTR_TYPE lsq_sta_unknown;
+static int lsq_nsta_unknown;
+static int lsq_barrier;
+static int lsq_sta_changed;
+
+/* loads to check at the next lsq_refresh() */
+static BITMAP_PTR_TYPE lsq_wake;
+static int lsq_nwake;
+
+/* loads waiting for the store in each LSQ slot to issue */
+static struct RS_link **lsq_waiters;
+
+/* store set predictor, the store set ID table (SSIT) maps load and store PCs
+   to store sets, -1 for none, and the last fetched store table (LFST) holds
+   the last store of each set dispatched, store sets are named by the SSIT
+   entry they were created with; the SSIT is cleared every LSQ_SS_CLEAR
+   cycles to forget stale dependencies */
+static int *lsq_ssit;
+static struct RS_link *lsq_lfst;
+#define LSQ_SSIT_INDEX(PC)						\
+  (((PC) / sizeof(md_inst_t)) & (LSQ_storesets - 1))
+#define LSQ_SS_CLEAR			1000000
+static tick_t lsq_ss_cleared;
+
+/* store each load in an LSQ slot is predicted to depend on */
+static struct RS_link *lsq_ss_dep;
+
+/* initialize the memory dependence tracking structures */
+static void
+lsq_mem_init(void)
+{
+  int i;
+
+  lsq_stab_head = calloc(LSQ_size, sizeof(int));
+  lsq_stab_tail = calloc(LSQ_size, sizeof(int));
+  lsq_stab_prev = calloc(LSQ_size, sizeof(int));
+  lsq_stab_next = calloc(LSQ_size, sizeof(int));
+  lsq_sta_unknown = calloc(BITMAP_SIZE(LSQ_size), sizeof(BITMAP_ENT_TYPE));
+  lsq_wake = calloc(BITMAP_SIZE(LSQ_size), sizeof(BITMAP_ENT_TYPE));
+  lsq_waiters = calloc(LSQ_size, sizeof(struct RS_link *));
+  lsq_ss_dep = calloc(LSQ_size, sizeof(struct RS_link));
+  if (!lsq_stab_head || !lsq_stab_tail || !lsq_stab_prev || !lsq_stab_next
+      || !lsq_sta_unknown || !lsq_wake || !lsq_waiters || !lsq_ss_dep)
+    fatal("out of virtual memory");
+  for (i=0; i < LSQ_size; i++)
     {
-      /* insert loads/stores and long latency ops at the head of the queue */
-      prev = NULL;
-      node = ready_queue;
+      lsq_stab_head[i] = lsq_stab_tail[i] = -1;
+      lsq_ss_dep[i] = RSLINK_NULL;
     }
-  else
+  lsq_nsta_unknown = 0;
+  lsq_barrier = -1;
+  lsq_sta_changed = FALSE;
+  lsq_nwake = 0;
+
+  if (LSQ_storesets)
     {
-      /* otherwise insert in program order (earliest seq first) */
-      for (prev=NULL, node=ready_queue;
-	   node && node->x.seq < rs->seq;
-	   prev=node, node=node->next);
+      lsq_ssit = calloc(LSQ_storesets, sizeof(int));
+      lsq_lfst = calloc(LSQ_storesets, sizeof(struct RS_link));
+      if (!lsq_ssit || !lsq_lfst)
+	fatal("out of virtual memory");
+      for (i=0; i < LSQ_storesets; i++)
+	{
+	  lsq_ssit[i] = -1;
+	  lsq_lfst[i] = RSLINK_NULL;
+	}
+      lsq_ss_cleared = 0;
+    }
+}
+
+/* check the load in LSQ slot INDEX at the next lsq_refresh() */
+static void
+lsq_wakeup(int index)
+{
+  if (!BITMAP_SET_P(lsq_wake, 0, index))
+    {
+      (void)BITMAP_SET(lsq_wake, 0, index);
+      lsq_nwake++;
+    }
+}
+
+/* wake the loads waiting for store RS to issue */
+static void
+lsq_wakeup_waiters(struct RUU_station *rs)
+{
+  struct RS_link *link, *link_next;
+  int index = rs - LSQ;
+
+  for (link=lsq_waiters[index]; link; link=link_next)
+    {
+      link_next = link->next;
+      if (RSLINK_VALID(link))
+	lsq_wakeup(RSLINK_RS(link) - LSQ);
+      RSLINK_FREE(link);
+    }
+  lsq_waiters[index] = NULL;
+}
+
+/* note that the store in LSQ slot INDEX no longer has an unknown address */
+static void
+lsq_sta_known(int index)
+{
+  if (BITMAP_SET_P(lsq_sta_unknown, 0, index))
+    {
+      (void)BITMAP_CLEAR(lsq_sta_unknown, 0, index);
+      lsq_nsta_unknown--;
+      lsq_sta_changed = TRUE;
     }
+}
+
+/* record newly dispatched load or store RS, in the LSQ tail slot */
+static void
+lsq_mem_dispatch(struct RUU_station *rs)
+{
+  int index = rs - LSQ, bucket, ssid;
+
+  if (LSQ_IS_STORE(rs))
+    {
+      /* add it to the youngest end of its hash chain */
+      bucket = LSQ_STAB_HASH(rs->addr);
+      lsq_stab_prev[index] = lsq_stab_tail[bucket];
+      lsq_stab_next[index] = -1;
+      if (lsq_stab_tail[bucket] >= 0)
+	lsq_stab_next[lsq_stab_tail[bucket]] = index;
+      else
+	lsq_stab_head[bucket] = index;
+      lsq_stab_tail[bucket] = index;
+
+      if (!STORE_ADDR_READY(rs))
+	{
+	  (void)BITMAP_SET(lsq_sta_unknown, 0, index);
+	  lsq_nsta_unknown++;
+	  lsq_sta_changed = TRUE;
+	}
+
+      /* it is now the last fetched store of its store set */
+      if (LSQ_storesets
+	  && (ssid = lsq_ssit[LSQ_SSIT_INDEX(rs->PC)]) >= 0)
+	RSLINK_INIT(lsq_lfst[ssid], rs);
+    }
+  else if (LSQ_IS_LOAD(rs))
+    {
+      /* predict its dependence on the last fetched store of its set */
+      lsq_ss_dep[index] = RSLINK_NULL;
+      if (LSQ_storesets
+	  && (ssid = lsq_ssit[LSQ_SSIT_INDEX(rs->PC)]) >= 0
+	  && !RSLINK_IS_NULL(&lsq_lfst[ssid])
+	  && RSLINK_VALID(&lsq_lfst[ssid]))
+	lsq_ss_dep[index] = lsq_lfst[ssid];
+
+      lsq_wakeup(index);
+    }
+}
+
+/* input operand OPNUM of load or store RS is now ready */
+static void
+lsq_mem_operand(struct RUU_station *rs, int opnum)
+{
+  if (LSQ_IS_STORE(rs))
+    {
+      if (opnum == STORE_ADDR_INDEX)
+	lsq_sta_known(rs - LSQ);
+      if (OPERANDS_READY(rs))
+	lsq_wakeup_waiters(rs);
+    }
+  else if (LSQ_IS_LOAD(rs) && OPERANDS_READY(rs))
+    lsq_wakeup(rs - LSQ);
+}
+
+/* forget the load or store RS in LSQ slot INDEX, which commits or is
+   squashed, it is at the oldest or youngest end of its hash chain */
+static void
+lsq_mem_remove(struct RUU_station *rs)
+{
+  int index = rs - LSQ, bucket;
+
+  if (LSQ_IS_STORE(rs))
+    {
+      bucket = LSQ_STAB_HASH(rs->addr);
+      if (lsq_stab_prev[index] >= 0)
+	lsq_stab_next[lsq_stab_prev[index]] = lsq_stab_next[index];
+      else
+	lsq_stab_head[bucket] = lsq_stab_next[index];
+      if (lsq_stab_next[index] >= 0)
+	lsq_stab_prev[lsq_stab_next[index]] = lsq_stab_prev[index];
+      else
+	lsq_stab_tail[bucket] = lsq_stab_prev[index];
+
+      lsq_sta_known(index);
+      RSLINK_FREE_LIST(lsq_waiters[index]);
+      lsq_waiters[index] = NULL;
+    }
+
+  if (BITMAP_SET_P(lsq_wake, 0, index))
+    {
+      (void)BITMAP_CLEAR(lsq_wake, 0, index);
+      lsq_nwake--;
+    }
+}
+
+/* return the youngest store older than load LD to the address of LD, or
+   NULL if there is none */
+static struct RUU_station *
+lsq_last_store(struct RUU_station *ld)
+{
+  int index;
+
+  for (index = lsq_stab_tail[LSQ_STAB_HASH(ld->addr)];
+       index >= 0;
+       index = lsq_stab_prev[index])
+    {
+      if (LSQ[index].seq < ld->seq && LSQ[index].addr == ld->addr)
+	return &LSQ[index];
+    }
+  return NULL;
+}
+
+/* make load LD wait for store ST to issue */
+static void
+lsq_wait(struct RUU_station *ld, struct RUU_station *st)
+{
+  struct RS_link *link;
 
-  if (prev)
+  RSLINK_NEW(link, ld);
+  link->next = lsq_waiters[st - LSQ];
+  lsq_waiters[st - LSQ] = link;
+}
+
+/* put the loads PC and store PC in the same store set */
+static void
+lsq_ss_train(md_addr_t ld_pc, md_addr_t st_pc)
+{
+  int *ld_ssid = &lsq_ssit[LSQ_SSIT_INDEX(ld_pc)];
+  int *st_ssid = &lsq_ssit[LSQ_SSIT_INDEX(st_pc)];
+
+  if (*ld_ssid < 0 && *st_ssid < 0)
+    *ld_ssid = *st_ssid = LSQ_SSIT_INDEX(st_pc);
+  else if (*st_ssid < 0)
+    *st_ssid = *ld_ssid;
+  else if (*ld_ssid < 0)
+    *ld_ssid = *st_ssid;
+  else
+    *ld_ssid = *st_ssid = MIN(*ld_ssid, *st_ssid);
+}
+
+/* check the load in LSQ slot INDEX, and put it on the ready queue if its
+   memory dependencies are satisfied, otherwise it waits for what holds it */
+static void
+lsq_check_load(int index)
+{
+  struct RUU_station *ld = &LSQ[index], *st;
+  struct RS_link *dep;
+
+  if (!LSQ_IS_LOAD(ld) || ld->queued || ld->issued || ld->completed
+      || !OPERANDS_READY(ld))
+    return;
+
+  if (!LSQ_storesets)
     {
-      /* insert middle or end */
-      new_node->next = prev->next;
-      prev->next = new_node;
+      /* held by the STA barrier until it moves past the load */
+      if (lsq_barrier >= 0 && LSQ_AGE(index) > LSQ_AGE(lsq_barrier))
+	return;
     }
   else
     {
-      /* insert at beginning */
-      new_node->next = ready_queue;
-      ready_queue = new_node;
+      /* held by the last fetched store of its store set */
+      dep = &lsq_ss_dep[index];
+      if (!RSLINK_IS_NULL(dep) && RSLINK_VALID(dep)
+	  && !OPERANDS_READY(RSLINK_RS(dep)))
+	{
+	  lsq_ss_waits++;
+	  lsq_wait(ld, RSLINK_RS(dep));
+	  return;
+	}
+    }
+
+  /* the youngest older store to the load address must have its data */
+  st = lsq_last_store(ld);
+  if (st && !OPERANDS_READY(st))
+    {
+      if (!STORE_ADDR_READY(st))
+	{
+	  /* the load passed an unknown address store it depends on */
+	  lsq_ss_violations++;
+	  lsq_ss_train(ld->PC, st->PC);
+	}
+      lsq_wait(ld, st);
+      return;
     }
+
+  /* no STA or STD unknown conflicts, put load on ready queue */
+  readyq_enqueue(ld);
 }
 
 
@@ -2187,7 +3555,8 @@ ruu_commit(void)
 		      /* commit store value to D-cache */
 		      lat =
 			cache_access(cache_dl1, Write, (LSQ[LSQ_head].addr&~3),
-				     NULL, 4, sim_cycle, NULL, NULL);
+				     NULL, 4, MEM_NOW, NULL, NULL,
+				     LSQ[LSQ_head].PC, /* prefetch */0);
 		      if (lat > cache_dl1_lat)
 			events |= PEV_CACHEMISS;
 		    }
@@ -2197,8 +3566,10 @@ ruu_commit(void)
 		    {
 		      /* access the D-TLB */
 		      lat =
-			cache_access(dtlb, Read, (LSQ[LSQ_head].addr & ~3),
-				     NULL, 4, sim_cycle, NULL, NULL);
+			cache_access(dtlb, Read,
+				     TLB_ADDR(LSQ[LSQ_head].addr & ~3),
+				     NULL, 4, MEM_NOW, NULL, NULL,
+				     LSQ[LSQ_head].PC, /* prefetch */0);
 		      if (lat > 1)
 			events |= PEV_TLBMISS;
 		    }
@@ -2211,6 +3582,7 @@ ruu_commit(void)
 	    }
 
 	  /* invalidate load/store operation instance */
+	  lsq_mem_remove(&LSQ[LSQ_head]);
 	  LSQ[LSQ_head].tag++;
           sim_slip += (sim_cycle - LSQ[LSQ_head].slip);
    
@@ -2320,8 +3692,12 @@ ruu_recover(int branch_index)			/* index of mis-pred branch */
 	      LSQ[LSQ_index].odep_list[i] = NULL;
 	    }
       
-	  /* squash this LSQ entry */
+	  /* squash this LSQ entry, and drop it from the ready queue and the
+	     memory dependence tracking */
+	  lsq_mem_remove(&LSQ[LSQ_index]);
 	  LSQ[LSQ_index].tag++;
+	  if (LSQ[LSQ_index].queued)
+	    readyq_dequeue(&LSQ[LSQ_index]);
 
 	  /* indicate in pipetrace that this instruction was squashed */
 	  ptrace_endinst(LSQ[LSQ_index].ptrace_seq);
@@ -2340,8 +3716,10 @@ ruu_recover(int branch_index)			/* index of mis-pred branch */
 	  RUU[RUU_index].odep_list[i] = NULL;
 	}
       
-      /* squash this RUU entry */
+      /* squash this RUU entry, and drop it from the ready queue */
       RUU[RUU_index].tag++;
+      if (RUU[RUU_index].queued)
+	readyq_dequeue(&RUU[RUU_index]);
 
       /* indicate in pipetrace that this instruction was squashed */
       ptrace_endinst(RUU[RUU_index].ptrace_seq);
@@ -2356,6 +3734,10 @@ ruu_recover(int branch_index)			/* index of mis-pred branch */
   RUU_tail = RUU_prev_tail;
   LSQ_tail = LSQ_prev_tail;
 
+  /* a squashed STA barrier held no surviving load */
+  if (lsq_barrier >= 0 && LSQ_AGE(lsq_barrier) >= LSQ_num)
+    lsq_barrier = -1;
+
   /* revert create vector back to last precise create vector state, NOTE:
      this is accomplished by resetting all the copied-on-write bits in the
      USE_SPEC_CV bit vector */
@@ -2485,6 +3867,11 @@ ruu_writeback(void)
 		      /* input is now ready */
 		      olink->rs->idep_ready[olink->x.opnum] = TRUE;
 
+		      /* wake the loads waiting for a load or store address
+			 or store data */
+		      if (olink->rs->in_LSQ)
+			lsq_mem_operand(olink->rs, olink->x.opnum);
+
 		      /* are all the register operands of target ready? */
 		      if (OPERANDS_READY(olink->rs))
 			{
@@ -2522,75 +3909,57 @@ ruu_writeback(void)
  */
 
 /* this function locates ready instructions whose memory dependencies have
-   been satisfied, this is accomplished by walking the LSQ for loads, looking
-   for blocking memory dependency condition (e.g., earlier store with an
-   unknown address) */
-#define MAX_STD_UNKNOWNS		64
+   been satisfied, the loads to check were woken when something they waited
+   for changed (see lsq_mem_dispatch() and friends), this function moves the
+   STA barrier, waking the loads it passes, and then checks the woken loads */
 static void
 lsq_refresh(void)
 {
-  int i, j, index, n_std_unknowns;
-  md_addr_t std_unknowns[MAX_STD_UNKNOWNS];
-
-  /* scan entire queue for ready loads: scan from oldest instruction
-     (head) until we reach the tail or an unresolved store, after which no
-     other instruction will become ready */
-  for (i=0, index=LSQ_head, n_std_unknowns=0;
-       i < LSQ_num;
-       i++, index=(index + 1) % LSQ_size)
+  int index, age, end, old_barrier;
+  struct readyq_scan_t scan;
+
+  if (lsq_sta_changed)
     {
-      /* terminate search for ready loads after first unresolved store,
-	 as no later load could be resolved in its presence */
-      if (/* store? */
-	  (MD_OP_FLAGS(LSQ[index].op) & (F_MEM|F_STORE)) == (F_MEM|F_STORE))
+      lsq_sta_changed = FALSE;
+
+      /* find the oldest store with an unknown address */
+      old_barrier = lsq_barrier;
+      readyq_scan_init(&scan, lsq_sta_unknown, lsq_nsta_unknown,
+		       LSQ_size, LSQ_head, LSQ_num);
+      lsq_barrier = scan.slot;
+
+      /* wake the loads the barrier passed */
+      if (old_barrier >= 0 && old_barrier != lsq_barrier)
 	{
-	  if (!STORE_ADDR_READY(&LSQ[index]))
+	  end = lsq_barrier >= 0 ? LSQ_AGE(lsq_barrier) : LSQ_num;
+	  for (age = LSQ_AGE(old_barrier) + 1; age < end; age++)
 	    {
-	      /* FIXME: a later STD + STD known could hide the STA unknown */
-	      /* sta unknown, blocks all later loads, stop search */
-	      break;
-	    }
-	  else if (!OPERANDS_READY(&LSQ[index]))
-	    {
-	      /* sta known, but std unknown, may block a later store, record
-		 this address for later referral, we use an array here because
-		 for most simulations the number of entries to search will be
-		 very small */
-	      if (n_std_unknowns == MAX_STD_UNKNOWNS)
-		fatal("STD unknown array overflow, increase MAX_STD_UNKNOWNS");
-	      std_unknowns[n_std_unknowns++] = LSQ[index].addr;
-	    }
-	  else /* STORE_ADDR_READY() && OPERANDS_READY() */
-	    {
-	      /* a later STD known hides an earlier STD unknown */
-	      for (j=0; j<n_std_unknowns; j++)
-		{
-		  if (std_unknowns[j] == /* STA/STD known */LSQ[index].addr)
-		    std_unknowns[j] = /* bogus addr */0;
-		}
+	      index = (LSQ_head + age) & (LSQ_size - 1);
+	      if (LSQ_IS_LOAD(&LSQ[index]))
+		lsq_wakeup(index);
 	    }
 	}
+    }
 
-      if (/* load? */
-	  ((MD_OP_FLAGS(LSQ[index].op) & (F_MEM|F_LOAD)) == (F_MEM|F_LOAD))
-	  && /* queued? */!LSQ[index].queued
-	  && /* waiting? */!LSQ[index].issued
-	  && /* completed? */!LSQ[index].completed
-	  && /* regs ready? */OPERANDS_READY(&LSQ[index]))
+  /* forget stale store sets now and then */
+  if (LSQ_storesets && sim_cycle - lsq_ss_cleared >= LSQ_SS_CLEAR)
+    {
+      for (index=0; index < LSQ_storesets; index++)
+	lsq_ssit[index] = -1;
+      lsq_ss_cleared = sim_cycle;
+    }
+
+  /* check the woken loads */
+  if (lsq_nwake)
+    {
+      for (readyq_scan_init(&scan, lsq_wake, lsq_nwake,
+			    LSQ_size, LSQ_head, LSQ_num);
+	   scan.slot >= 0;
+	   readyq_scan_next(&scan))
 	{
-	  /* no STA unknown conflict (because we got to this check), check for
-	     a STD unknown conflict */
-	  for (j=0; j<n_std_unknowns; j++)
-	    {
-	      /* found a relevant STD unknown? */
-	      if (std_unknowns[j] == LSQ[index].addr)
-		break;
-	    }
-	  if (j == n_std_unknowns)
-	    {
-	      /* no STA or STD unknown conflicts, put load on ready queue */
-	      readyq_enqueue(&LSQ[index]);
-	    }
+	  (void)BITMAP_CLEAR(lsq_wake, 0, scan.slot);
+	  lsq_nwake--;
+	  lsq_check_load(scan.slot);
 	}
     }
 }
@@ -2611,236 +3980,184 @@ static void
 ruu_issue(void)
 {
   int i, load_lat, tlb_lat, n_issued;
-  struct RS_link *node, *next_node;
+  struct RUU_station *rs;
   struct res_template *fu;
 
-  /* FIXME: could be a little more efficient when scanning the ready queue */
-
-  /* copy and then blow away the ready list, NOTE: the ready list is
-     always totally reclaimed each cycle, and instructions that are not
-     issue are explicitly reinserted into the ready instruction queue,
-     this management strategy ensures that the ready instruction queue
-     is always properly sorted */
-  node = ready_queue;
-  ready_queue = NULL;
-
   /* visit all ready instructions (i.e., insts whose register input
      dependencies have been satisfied, stop issue when no more instructions
-     are available or issue bandwidth is exhausted */
+     are available or issue bandwidth is exhausted, instructions that do
+     not issue simply stay in the ready queue */
+  readyq_start();
   for (n_issued=0;
-       node && n_issued < ruu_issue_width;
-       node = next_node)
+       n_issued < ruu_issue_width && (rs = readyq_next()) != NULL;
+       /* nada */)
     {
-      next_node = node->next;
+      /* issue operation, both reg and mem deps have been satisfied */
+      if (!OPERANDS_READY(rs) || !rs->queued
+	  || rs->issued || rs->completed)
+	panic("issued inst !ready, issued, or completed");
 
-      /* still valid? */
-      if (RSLINK_VALID(node))
+      if (rs->in_LSQ
+	  && ((MD_OP_FLAGS(rs->op) & (F_MEM|F_STORE)) == (F_MEM|F_STORE)))
 	{
-	  struct RUU_station *rs = RSLINK_RS(node);
-
-	  /* issue operation, both reg and mem deps have been satisfied */
-	  if (!OPERANDS_READY(rs) || !rs->queued
-	      || rs->issued || rs->completed)
-	    panic("issued inst !ready, issued, or completed");
-
-	  /* node is now un-queued */
-	  rs->queued = FALSE;
-
-	  if (rs->in_LSQ
-	      && ((MD_OP_FLAGS(rs->op) & (F_MEM|F_STORE)) == (F_MEM|F_STORE)))
-	    {
-	      /* stores complete in effectively zero time, result is
-		 written into the load/store queue, the actual store into
-		 the memory system occurs when the instruction is retired
-		 (see ruu_commit()) */
-	      rs->issued = TRUE;
-	      rs->completed = TRUE;
-	      if (rs->onames[0] || rs->onames[1])
-		panic("store creates result");
-
-	      if (rs->recover_inst)
-		panic("mis-predicted store");
-
-	      /* entered execute stage, indicate in pipe trace */
-	      ptrace_newstage(rs->ptrace_seq, PST_WRITEBACK, 0);
-
-	      /* one more inst issued */
-	      n_issued++;
-	    }
-	  else
+	  /* stores complete in effectively zero time, result is
+	     written into the load/store queue, the actual store into
+	     the memory system occurs when the instruction is retired
+	     (see ruu_commit()) */
+	  readyq_dequeue(rs);
+	  rs->issued = TRUE;
+	  rs->completed = TRUE;
+	  if (rs->onames[0] || rs->onames[1])
+	    panic("store creates result");
+
+	  if (rs->recover_inst)
+	    panic("mis-predicted store");
+
+	  /* entered execute stage, indicate in pipe trace */
+	  ptrace_newstage(rs->ptrace_seq, PST_WRITEBACK, 0);
+
+	  /* one more inst issued */
+	  n_issued++;
+	}
+      else
+	{
+	  /* issue the instruction to a functional unit */
+	  if (MD_OP_FUCLASS(rs->op) != NA)
 	    {
-	      /* issue the instruction to a functional unit */
-	      if (MD_OP_FUCLASS(rs->op) != NA)
+	      fu = res_get(fu_pool, MD_OP_FUCLASS(rs->op));
+	      if (fu)
 		{
-		  fu = res_get(fu_pool, MD_OP_FUCLASS(rs->op));
-		  if (fu)
+		  /* got one! issue inst to functional unit */
+		  readyq_dequeue(rs);
+		  rs->issued = TRUE;
+		  /* reserve the functional unit */
+		  if (fu->master->busy)
+		    panic("functional unit already in use");
+
+		  /* schedule functional unit release event */
+		  fu->master->busy = fu->issuelat;
+
+		  /* schedule a result writeback event */
+		  if (rs->in_LSQ
+		      && ((MD_OP_FLAGS(rs->op) & (F_MEM|F_LOAD))
+			  == (F_MEM|F_LOAD)))
 		    {
-		      /* got one! issue inst to functional unit */
-		      rs->issued = TRUE;
-		      /* reserve the functional unit */
-		      if (fu->master->busy)
-			panic("functional unit already in use");
-
-		      /* schedule functional unit release event */
-		      fu->master->busy = fu->issuelat;
-
-		      /* schedule a result writeback event */
-		      if (rs->in_LSQ
-			  && ((MD_OP_FLAGS(rs->op) & (F_MEM|F_LOAD))
-			      == (F_MEM|F_LOAD)))
+		      int events = 0;
+
+		      /* for loads, determine cache access latency:
+			 first scan LSQ to see if a store forward is
+			 possible, if not, access the data cache */
+		      load_lat = 0;
+		      i = (rs - LSQ);
+		      if (i != LSQ_head)
 			{
-			  int events = 0;
-
-			  /* for loads, determine cache access latency:
-			     first scan LSQ to see if a store forward is
-			     possible, if not, access the data cache */
-			  load_lat = 0;
-			  i = (rs - LSQ);
-			  if (i != LSQ_head)
+			  for (;;)
 			    {
-			      for (;;)
+			      /* go to next earlier LSQ entry */
+			      i = (i + (LSQ_size-1)) % LSQ_size;
+
+			      /* FIXME: not dealing with partials! */
+			      if ((MD_OP_FLAGS(LSQ[i].op) & F_STORE)
+				  && (LSQ[i].addr == rs->addr))
 				{
-				  /* go to next earlier LSQ entry */
-				  i = (i + (LSQ_size-1)) % LSQ_size;
-
-				  /* FIXME: not dealing with partials! */
-				  if ((MD_OP_FLAGS(LSQ[i].op) & F_STORE)
-				      && (LSQ[i].addr == rs->addr))
-				    {
-				      /* hit in the LSQ */
-				      load_lat = 1;
-				      break;
-				    }
-
-				  /* scan finished? */
-				  if (i == LSQ_head)
-				    break;
+				  /* hit in the LSQ */
+				  load_lat = 1;
+				  break;
 				}
+
+			      /* scan finished? */
+			      if (i == LSQ_head)
+				break;
 			    }
+			}
 
-			  /* was the value store forwared from the LSQ? */
-			  if (!load_lat)
-			    {
-			      int valid_addr = MD_VALID_ADDR(rs->addr);
+		      /* was the value store forwared from the LSQ? */
+		      if (!load_lat)
+			{
+			  int valid_addr = MD_VALID_ADDR(rs->addr);
 
-			      if (!spec_mode && !valid_addr)
-				sim_invalid_addrs++;
+			  if (!spec_mode && !valid_addr)
+			    sim_invalid_addrs++;
 
-			      /* no! go to the data cache if addr is valid */
-			      if (cache_dl1 && valid_addr)
-				{
-				  /* access the cache if non-faulting */
-				  load_lat =
-				    cache_access(cache_dl1, Read,
-						 (rs->addr & ~3), NULL, 4,
-						 sim_cycle, NULL, NULL);
-				  if (load_lat > cache_dl1_lat)
-				    events |= PEV_CACHEMISS;
-				}
-			      else
-				{
-				  /* no caches defined, just use op latency */
-				  load_lat = fu->oplat;
-				}
+			  /* no! go to the data cache if addr is valid */
+			  if (cache_dl1 && valid_addr)
+			    {
+			      /* access the cache if non-faulting */
+			      load_lat =
+				cache_access(cache_dl1, Read,
+					     (rs->addr & ~3), NULL, 4,
+					     MEM_NOW, NULL, NULL,
+					     rs->PC, /* prefetch */0);
+			      if (load_lat > cache_dl1_lat)
+				events |= PEV_CACHEMISS;
 			    }
-
-			  /* all loads and stores must to access D-TLB */
-			  if (dtlb && MD_VALID_ADDR(rs->addr))
+			  else
 			    {
-			      /* access the D-DLB, NOTE: this code will
-				 initiate speculative TLB misses */
-			      tlb_lat =
-				cache_access(dtlb, Read, (rs->addr & ~3),
-					     NULL, 4, sim_cycle, NULL, NULL);
-			      if (tlb_lat > 1)
-				events |= PEV_TLBMISS;
-
-			      /* D-cache/D-TLB accesses occur in parallel */
-			      load_lat = MAX(tlb_lat, load_lat);
+			      /* no caches defined, just use op latency */
+			      load_lat = fu->oplat;
 			    }
-
-			  /* use computed cache access latency */
-			  eventq_queue_event(rs, sim_cycle + load_lat);
-
-			  /* entered execute stage, indicate in pipe trace */
-			  ptrace_newstage(rs->ptrace_seq, PST_EXECUTE,
-					  ((rs->ea_comp ? PEV_AGEN : 0)
-					   | events));
 			}
-		      else /* !load && !store */
-			{
-			  /* use deterministic functional unit latency */
-			  eventq_queue_event(rs, sim_cycle + fu->oplat);
 
-			  /* entered execute stage, indicate in pipe trace */
-			  ptrace_newstage(rs->ptrace_seq, PST_EXECUTE, 
-					  rs->ea_comp ? PEV_AGEN : 0);
+		      /* all loads and stores must to access D-TLB */
+		      if (dtlb && MD_VALID_ADDR(rs->addr))
+			{
+			  /* access the D-DLB, NOTE: this code will
+			     initiate speculative TLB misses */
+			  tlb_lat =
+			    cache_access(dtlb, Read,
+					 TLB_ADDR(rs->addr & ~3),
+					 NULL, 4, MEM_NOW, NULL, NULL,
+					 rs->PC, /* prefetch */0);
+			  if (tlb_lat > 1)
+			    events |= PEV_TLBMISS;
+
+			  /* D-cache/D-TLB accesses occur in parallel */
+			  load_lat = MAX(tlb_lat, load_lat);
 			}
 
-		      /* one more inst issued */
-		      n_issued++;
+		      /* use computed cache access latency */
+		      eventq_queue_event(rs, sim_cycle + load_lat);
+
+		      /* entered execute stage, indicate in pipe trace */
+		      ptrace_newstage(rs->ptrace_seq, PST_EXECUTE,
+				      ((rs->ea_comp ? PEV_AGEN : 0)
+				       | events));
 		    }
-		  else /* no functional unit */
+		  else /* !load && !store */
 		    {
-		      /* insufficient functional unit resources, put operation
-			 back onto the ready list, we'll try to issue it
-			 again next cycle */
-		      readyq_enqueue(rs);
-		    }
-		}
-	      else /* does not require a functional unit! */
-		{
-		  /* FIXME: need better solution for these */
-		  /* the instruction does not need a functional unit */
-		  rs->issued = TRUE;
-
-		  /* schedule a result event */
-		  eventq_queue_event(rs, sim_cycle + 1);
+		      /* use deterministic functional unit latency */
+		      eventq_queue_event(rs, sim_cycle + fu->oplat);
 
-		  /* entered execute stage, indicate in pipe trace */
-		  ptrace_newstage(rs->ptrace_seq, PST_EXECUTE,
-				  rs->ea_comp ? PEV_AGEN : 0);
+		      /* entered execute stage, indicate in pipe trace */
+		      ptrace_newstage(rs->ptrace_seq, PST_EXECUTE, 
+				      rs->ea_comp ? PEV_AGEN : 0);
+		    }
 
 		  /* one more inst issued */
 		  n_issued++;
 		}
-	    } /* !store */
-
-	}
-      /* else, RUU entry was squashed */
-
-      /* reclaim ready list entry, NOTE: this is done whether or not the
-         instruction issued, since the instruction was once again reinserted
-         into the ready queue if it did not issue, this ensures that the ready
-         queue is always properly sorted */
-      RSLINK_FREE(node);
-    }
-
-  /* put any instruction not issued back into the ready queue, go through
-     normal channels to ensure instruction stay ordered correctly */
-  for (; node; node = next_node)
-    {
-      next_node = node->next;
-
-      /* still valid? */
-      if (RSLINK_VALID(node))
-        {
-	  struct RUU_station *rs = RSLINK_RS(node);
+	      /* else, insufficient functional unit resources, leave the
+		 operation on the ready list, we'll try to issue it
+		 again next cycle */
+	    }
+	  else /* does not require a functional unit! */
+	    {
+	      /* FIXME: need better solution for these */
+	      /* the instruction does not need a functional unit */
+	      readyq_dequeue(rs);
+	      rs->issued = TRUE;
 
-          /* node is now un-queued */
-          rs->queued = FALSE;
+	      /* schedule a result event */
+	      eventq_queue_event(rs, sim_cycle + 1);
 
-	  /* not issued, put operation back onto the ready list, we'll try to
-	     issue it again next cycle */
-          readyq_enqueue(rs);
-        }
-      /* else, RUU entry was squashed */
+	      /* entered execute stage, indicate in pipe trace */
+	      ptrace_newstage(rs->ptrace_seq, PST_EXECUTE,
+			      rs->ea_comp ? PEV_AGEN : 0);
 
-      /* reclaim ready list entry, NOTE: this is done whether or not the
-         instruction issued, since the instruction was once again reinserted
-         into the ready queue if it did not issue, this ensures that the ready
-         queue is always properly sorted */
-      RSLINK_FREE(node);
+	      /* one more inst issued */
+	      n_issued++;
+	    }
+	} /* !store */
     }
 }
 
@@ -2937,9 +4254,34 @@ static md_addr_t recover_PC;
 static md_addr_t fetch_regs_PC;
 static md_addr_t fetch_pred_PC;
 
+/* predecoded instruction, the program text is decoded once at load time so
+   fetch, dispatch and fast-forward skip the memory read and opcode decode */
+struct predec_t {
+  md_inst_t IR;				/* instruction bits */
+  enum md_opcode op;			/* decoded opcode, NOP if bogus */
+  unsigned int flags;			/* opcode flags, MD_OP_FLAGS(op) */
+  int out1, out2, in1, in2, in3;	/* output/input register names */
+  int bogus;				/* bogus or linking opcode? */
+};
+
+/* predecoded program text, one entry per inst from ld_text_base */
+static struct predec_t *predec_text = NULL;
+
+/* predecoded NOP, sent down the pipeline for bogus fetch addresses */
+static struct predec_t predec_nop;
+
+/* non-zero if PC is an aligned address within the predecoded text */
+#define PREDEC_VALID(PC)						\
+  (ld_text_base <= (PC) && (PC) < (ld_text_base+ld_text_size)		\
+   && !((PC) & (sizeof(md_inst_t)-1)))
+
+/* predecoded inst at PC, PC must be PREDEC_VALID() */
+#define PREDEC_INST(PC)							\
+  (&predec_text[((PC) - ld_text_base) / sizeof(md_inst_t)])
+
 /* IFETCH -> DISPATCH instruction queue definition */
 struct fetch_rec {
-  md_inst_t IR;				/* inst register */
+  struct predec_t *pd;			/* predecoded inst register */
   md_addr_t regs_PC, pred_PC;		/* current PC, predicted next PC */
   struct bpred_update_t dir_update;	/* bpred direction update info */
   int stack_recover_idx;		/* branch predictor RSB index */
@@ -2949,6 +4291,9 @@ static struct fetch_rec *fetch_data;	/* IFETCH -> DISPATCH inst queue */
 static int fetch_num;			/* num entries in IF -> DIS queue */
 static int fetch_tail, fetch_head;	/* head and tail pointers of queue */
 
+/* non-zero while fetch and dispatch are stopped to drain the pipeline */
+static int ruu_draining = FALSE;
+
 /* recover instruction trace generator state to precise state state immediately
    before the first mis-predicted branch; this is accomplished by resetting
    all register value copied-on-write bitmasks are reset, and the speculative
@@ -3389,6 +4734,92 @@ ruu_install_odep(struct RUU_station *rs,	/* creating RUU station */
 #endif
 
 
+/*
+ * predecoded program text
+ */
+
+/* predecode INST into PD, bogus and linking opcodes are marked bogus and
+   converted to NOPs */
+static void
+predec_inst(struct predec_t *pd,		/* predecoded inst to fill */
+	    md_inst_t inst)			/* instruction bits */
+{
+  enum md_opcode op;
+
+  pd->IR = inst;
+  pd->bogus = FALSE;
+  MD_SET_OPCODE(op, inst);
+  switch (op)
+    {
+#define DEFINST(OP,MSK,NAME,OPFORM,RES,CLASS,O1,O2,I1,I2,I3)		\
+    case OP:								\
+      pd->out1 = O1; pd->out2 = O2;					\
+      pd->in1 = I1; pd->in2 = I2; pd->in3 = I3;				\
+      break;
+#define DEFLINK(OP,MSK,NAME,MASK,SHIFT)					\
+    case OP:								\
+      op = MD_NOP_OP;							\
+      pd->bogus = TRUE;							\
+      pd->out1 = NA; pd->out2 = NA;					\
+      pd->in1 = NA; pd->in2 = NA; pd->in3 = NA;				\
+      break;
+#define CONNECT(OP)
+#include "machine.def"
+    default:
+      op = MD_NOP_OP;
+      pd->bogus = TRUE;
+      pd->out1 = NA; pd->out2 = NA;
+      pd->in1 = NA; pd->in2 = NA; pd->in3 = NA;
+    }
+  pd->op = op;
+  pd->flags = MD_OP_FLAGS(op);
+}
+
+/* predecode the whole program text, NOTE: the text is assumed not to be
+   written after the program is loaded, i.e., no self-modifying code */
+static void
+predec_init(void)
+{
+  md_addr_t PC;
+  md_inst_t inst;
+
+  predec_text =
+    (struct predec_t *)calloc(ld_text_size / sizeof(md_inst_t),
+			      sizeof(struct predec_t));
+  if (!predec_text)
+    fatal("out of virtual memory");
+
+  for (PC = ld_text_base;
+       PC + sizeof(md_inst_t) <= ld_text_base + ld_text_size;
+       PC += sizeof(md_inst_t))
+    {
+      MD_FETCH_INST(inst, mem, PC);
+      predec_inst(&predec_text[(PC - ld_text_base) / sizeof(md_inst_t)],
+		  inst);
+    }
+
+  /* bogus fetch addresses send this NOP down the pipeline */
+  predec_inst(&predec_nop, MD_NOP_INST);
+}
+
+/* get the predecoded inst at PC, insts outside of the program text (which
+   are only executed in a pinch) are decoded into a scratch entry that is
+   valid until the next call */
+static struct predec_t *
+predec_lookup(md_addr_t PC)
+{
+  static struct predec_t scratch;
+  md_inst_t inst;
+
+  if (PREDEC_VALID(PC))
+    return PREDEC_INST(PC);
+
+  MD_FETCH_INST(inst, mem, PC);
+  predec_inst(&scratch, inst);
+  return &scratch;
+}
+
+
 /*
  * configure the execution engine
  */
@@ -3702,6 +5133,7 @@ ruu_dispatch(void)
 {
   int i;
   int n_dispatched;			/* total insts dispatched */
+  struct predec_t *pd;			/* predecoded instruction */
   md_inst_t inst;			/* actual instruction bits */
   enum md_opcode op;			/* decoded opcode enum */
   int out1, out2, in1, in2, in3;	/* output/input register names */
@@ -3733,7 +5165,9 @@ ruu_dispatch(void)
 	 /* insts still available from fetch unit? */
 	 && fetch_num != 0
 	 /* on an acceptable trace path */
-	 && (ruu_include_spec || !spec_mode))
+	 && (ruu_include_spec || !spec_mode)
+	 /* and not draining the pipeline */
+	 && !ruu_draining)
     {
       /* if issuing in-order, block until last op issues if inorder issue */
       if (ruu_inorder_issue
@@ -3745,21 +5179,24 @@ ruu_dispatch(void)
 	}
 
       /* get the next instruction from the IFETCH -> DISPATCH queue */
-      inst = fetch_data[fetch_head].IR;
+      pd = fetch_data[fetch_head].pd;
       regs.regs_PC = fetch_data[fetch_head].regs_PC;
       pred_PC = fetch_data[fetch_head].pred_PC;
       dir_update_ptr = &(fetch_data[fetch_head].dir_update);
       stack_recover_idx = fetch_data[fetch_head].stack_recover_idx;
       pseq = fetch_data[fetch_head].ptrace_seq;
 
-      /* decode the inst */
-      MD_SET_OPCODE(op, inst);
+      /* the inst is predecoded, including its output/input dependencies */
+      inst = pd->IR;
+      op = pd->op;
+      out1 = pd->out1; out2 = pd->out2;
+      in1 = pd->in1; in2 = pd->in2; in3 = pd->in3;
 
       /* compute default next PC */
       regs.regs_NPC = regs.regs_PC + sizeof(md_inst_t);
 
       /* drain RUU for TRAPs and system calls */
-      if (MD_OP_FLAGS(op) & F_TRAP)
+      if (pd->flags & F_TRAP)
 	{
 	  if (RUU_num != 0)
 	    break;
@@ -3788,26 +5225,17 @@ ruu_dispatch(void)
       /* set default fault - none */
       fault = md_fault_none;
 
-      /* more decoding and execution */
+      /* execution, bogus insts were converted to NOPs by predec_inst() */
       switch (op)
 	{
 #define DEFINST(OP,MSK,NAME,OPFORM,RES,CLASS,O1,O2,I1,I2,I3)		\
 	case OP:							\
-	  /* compute output/input dependencies to out1-2 and in1-3 */	\
-	  out1 = O1; out2 = O2;						\
-	  in1 = I1; in2 = I2; in3 = I3;					\
 	  /* execute the instruction */					\
 	  SYMCAT(OP,_IMPL);						\
 	  break;
 #define DEFLINK(OP,MSK,NAME,MASK,SHIFT)					\
 	case OP:							\
-	  /* could speculatively decode a bogus inst, convert to NOP */	\
-	  op = MD_NOP_OP;						\
-	  /* compute output/input dependencies to out1-2 and in1-3 */	\
-	  out1 = NA; out2 = NA;						\
-	  in1 = NA; in2 = NA; in3 = NA;					\
-	  /* no EXPR */							\
-	  break;
+	  panic("attempted to execute a linking opcode");
 #define CONNECT(OP)	/* nada... */
 	  /* the following macro wraps the instruction fault declaration macro
 	     with a test to see if the trace generator is in non-speculative
@@ -3823,12 +5251,7 @@ ruu_dispatch(void)
 	  }
 #include "machine.def"
 	default:
-	  /* can speculatively decode a bogus inst, convert to a NOP */
-	  op = MD_NOP_OP;
-	  /* compute output/input dependencies to out1-2 and in1-3 */	\
-	  out1 = NA; out2 = NA;
-	  in1 = NA; in2 = NA; in3 = NA;
-	  /* no EXPR */
+	  panic("attempted to execute a bogus opcode");
 	}
       /* operation sets next PC */
 
@@ -3848,13 +5271,13 @@ ruu_dispatch(void)
 	      fault, regs.regs_PC);
 
       /* update memory access stats */
-      if (MD_OP_FLAGS(op) & F_MEM)
+      if (pd->flags & F_MEM)
 	{
 	  sim_total_refs++;
 	  if (!spec_mode)
 	    sim_num_refs++;
 
-	  if (MD_OP_FLAGS(op) & F_STORE)
+	  if (pd->flags & F_STORE)
 	    is_write = TRUE;
 	  else
 	    {
@@ -3868,7 +5291,7 @@ ruu_dispatch(void)
       br_pred_taken = (pred_PC != (regs.regs_PC + sizeof(md_inst_t)));
 
       if ((pred_PC != regs.regs_NPC && pred_perfect)
-	  || ((MD_OP_FLAGS(op) & (F_CTRL|F_DIRJMP)) == (F_CTRL|F_DIRJMP)
+	  || ((pd->flags & (F_CTRL|F_DIRJMP)) == (F_CTRL|F_DIRJMP)
 	      && target_PC != pred_PC && br_pred_taken))
 	{
 	  /* Either 1) we're simulating perfect prediction and are in a
@@ -3932,7 +5355,7 @@ ruu_dispatch(void)
 	  rs->ptrace_seq = pseq;
 
 	  /* split ld/st's into two operations: eff addr comp + mem access */
-	  if (MD_OP_FLAGS(op) & F_MEM)
+	  if (pd->flags & F_MEM)
 	    {
 	      /* convert RUU operation from ld/st to an add (eff addr comp) */
 	      rs->op = MD_AGEN_OP;
@@ -3984,6 +5407,9 @@ ruu_dispatch(void)
 	      ruu_install_odep(lsq, /* odep_list[] index */0, out1);
 	      ruu_install_odep(lsq, /* odep_list[] index */1, out2);
 
+	      /* track its memory dependencies */
+	      lsq_mem_dispatch(lsq);
+
 	      /* install operation in the RUU and LSQ */
 	      n_dispatched++;
 	      RUU_tail = (RUU_tail + 1) % RUU_size;
@@ -4000,7 +5426,7 @@ ruu_dispatch(void)
 	      RSLINK_INIT(last_op, lsq);
 
 	      /* issue stores only, loads are issued by lsq_refresh() */
-	      if (((MD_OP_FLAGS(op) & (F_MEM|F_STORE)) == (F_MEM|F_STORE))
+	      if (((pd->flags & (F_MEM|F_STORE)) == (F_MEM|F_STORE))
 		  && OPERANDS_READY(lsq))
 		{
 		  /* panic("store immediately ready"); */
@@ -4008,7 +5434,7 @@ ruu_dispatch(void)
 		  readyq_enqueue(lsq);
 		}
 	    }
-	  else /* !(MD_OP_FLAGS(op) & F_MEM) */
+	  else /* !(pd->flags & F_MEM) */
 	    {
 	      /* link onto producing operation */
 	      ruu_link_idep(rs, /* idep_ready[] index */0, in1);
@@ -4047,7 +5473,7 @@ ruu_dispatch(void)
 
       /* one more instruction executed, speculative or otherwise */
       sim_total_insn++;
-      if (MD_OP_FLAGS(op) & F_CTRL)
+      if (pd->flags & F_CTRL)
 	sim_total_branches++;
 
       if (!spec_mode)
@@ -4059,7 +5485,7 @@ ruu_dispatch(void)
 
 	  /* if this is a branching instruction update BTB, i.e., only
 	     non-speculative state is committed into the BTB */
-	  if (MD_OP_FLAGS(op) & F_CTRL)
+	  if (pd->flags & F_CTRL)
 	    {
 	      sim_num_branches++;
 	      if (pred && bpred_spec_update == spec_ID)
@@ -4183,7 +5609,8 @@ fetch_dump(FILE *stream)			/* output stream */
   while (num)
     {
       fprintf(stream, "idx: %2d: inst: `", head);
-      md_print_insn(fetch_data[head].IR, fetch_data[head].regs_PC, stream);
+      md_print_insn(fetch_data[head].pd->IR, fetch_data[head].regs_PC,
+		    stream);
       fprintf(stream, "'\n");
       myfprintf(stream, "         regs_PC: 0x%08p, pred_PC: 0x%08p\n",
 		fetch_data[head].regs_PC, fetch_data[head].pred_PC);
@@ -4201,6 +5628,7 @@ static void
 ruu_fetch(void)
 {
   int i, lat, tlb_lat, done = FALSE;
+  struct predec_t *pd;
   md_inst_t inst;
   int stack_recover_idx;
   int branch_cnt;
@@ -4211,19 +5639,19 @@ ruu_fetch(void)
        /* fetch until IFETCH -> DISPATCH queue fills */
        && fetch_num < ruu_ifq_size
        /* and no IFETCH blocking condition encountered */
-       && !done;
+       && !done
+       /* and not draining the pipeline */
+       && !ruu_draining;
        i++)
     {
       /* fetch an instruction at the next predicted fetch address */
       fetch_regs_PC = fetch_pred_PC;
 
       /* is this a bogus text address? (can happen on mis-spec path) */
-      if (ld_text_base <= fetch_regs_PC
-	  && fetch_regs_PC < (ld_text_base+ld_text_size)
-	  && !(fetch_regs_PC & (sizeof(md_inst_t)-1)))
+      if (PREDEC_VALID(fetch_regs_PC))
 	{
-	  /* read instruction from memory */
-	  MD_FETCH_INST(inst, mem, fetch_regs_PC);
+	  /* read predecoded instruction */
+	  pd = PREDEC_INST(fetch_regs_PC);
 
 	  /* address is within program text, read instruction from memory */
 	  lat = cache_il1_lat;
@@ -4232,8 +5660,8 @@ ruu_fetch(void)
 	      /* access the I-cache */
 	      lat =
 		cache_access(cache_il1, Read, IACOMPRESS(fetch_regs_PC),
-			     NULL, ISCOMPRESS(sizeof(md_inst_t)), sim_cycle,
-			     NULL, NULL);
+			     NULL, ISCOMPRESS(sizeof(md_inst_t)), MEM_NOW,
+			     NULL, NULL, fetch_regs_PC, /* prefetch */0);
 	      if (lat > cache_il1_lat)
 		last_inst_missed = TRUE;
 	    }
@@ -4243,9 +5671,9 @@ ruu_fetch(void)
 	      /* access the I-TLB, NOTE: this code will initiate
 		 speculative TLB misses */
 	      tlb_lat =
-		cache_access(itlb, Read, IACOMPRESS(fetch_regs_PC),
-			     NULL, ISCOMPRESS(sizeof(md_inst_t)), sim_cycle,
-			     NULL, NULL);
+		cache_access(itlb, Read, TLB_ADDR(IACOMPRESS(fetch_regs_PC)),
+			     NULL, ISCOMPRESS(sizeof(md_inst_t)), MEM_NOW,
+			     NULL, NULL, fetch_regs_PC, /* prefetch */0);
 	      if (tlb_lat > 1)
 		last_inst_tmissed = TRUE;
 
@@ -4265,23 +5693,21 @@ ruu_fetch(void)
       else
 	{
 	  /* fetch PC is bogus, send a NOP down the pipeline */
-	  inst = MD_NOP_INST;
+	  pd = &predec_nop;
 	}
+      inst = pd->IR;
 
       /* have a valid inst, here */
 
       /* possibly use the BTB target */
       if (pred)
 	{
-	  enum md_opcode op;
+	  enum md_opcode op = pd->op;
 
-	  /* pre-decode instruction, used for bpred stats recording */
-	  MD_SET_OPCODE(op, inst);
-	  
 	  /* get the next predicted fetch address; only use branch predictor
 	     result for branches (assumes pre-decode bits); NOTE: returned
 	     value may be 1 if bpred can only predict a direction */
-	  if (MD_OP_FLAGS(op) & F_CTRL)
+	  if (pd->flags & F_CTRL)
 	    fetch_pred_PC =
 	      bpred_lookup(pred,
 			   /* branch address */fetch_regs_PC,
@@ -4316,7 +5742,7 @@ ruu_fetch(void)
 	}
 
       /* commit this instruction to the IFETCH -> DISPATCH queue */
-      fetch_data[fetch_tail].IR = inst;
+      fetch_data[fetch_tail].pd = pd;
       fetch_data[fetch_tail].regs_PC = fetch_regs_PC;
       fetch_data[fetch_tail].pred_PC = fetch_pred_PC;
       fetch_data[fetch_tail].stack_recover_idx = stack_recover_idx;
@@ -4421,102 +5847,462 @@ simoo_mstate_obj(FILE *stream,			/* output stream */
 }
 
 
-/* start simulation, program loaded, processor precise state initialized */
-void
-sim_main(void)
+/*
+ * idle cycle skipping, when the machine waits on long latency operations
+ * and no pipeline stage can make progress, sim_main() jumps to the next
+ * cycle in which one can
+ */
+
+/* non-zero if ruu_dispatch() cannot dispatch anything until a writeback */
+static int
+ruu_dispatch_blocked(void)
 {
-  /* ignore any floating point exceptions, they may occur on mis-speculated
-     execution paths */
-  signal(SIGFPE, SIG_IGN);
+  if (RUU_num >= RUU_size || LSQ_num >= LSQ_size || fetch_num == 0
+      || (!ruu_include_spec && spec_mode) || ruu_draining)
+    return TRUE;
 
-  /* set up program entry state */
-  regs.regs_PC = ld_prog_entry;
-  regs.regs_NPC = regs.regs_PC + sizeof(md_inst_t);
+  /* in-order issue waits for the last op to be ready */
+  if (ruu_inorder_issue
+      && (last_op.rs && RSLINK_VALID(&last_op)
+	  && !OPERANDS_READY(last_op.rs)))
+    return TRUE;
 
-  /* check for DLite debugger entry condition */
-  if (dlite_check_break(regs.regs_PC, /* no access */0, /* addr */0, 0, 0))
-    dlite_main(regs.regs_PC, regs.regs_PC + sizeof(md_inst_t),
-	       sim_cycle, &regs, mem);
+  /* system calls wait for the RUU to drain */
+  if ((fetch_data[fetch_head].pd->flags & F_TRAP) && RUU_num != 0)
+    return TRUE;
 
-  /* fast forward simulator loop, performs functional simulation for
-     FASTFWD_COUNT insts, then turns on performance (timing) simulation */
-  if (fastfwd_count > 0)
+  return FALSE;
+}
+
+/* skip the cycles starting at SIM_CYCLE in which nothing can commit, issue,
+   dispatch or fetch, up to the next event or the end of a fetch stall;
+   these cycles would only count down the functional unit and fetch stall
+   timers and add to the occupancy stats, which is done here in one step,
+   so the simulation results are unchanged */
+static void
+ruu_skip_idle(void)
+{
+  int i;
+  tick_t until;
+  counter_t n;
+
+  /* pipetraces and the debugger see every cycle */
+  if (ptrace_outfd != NULL || dlite_check || dlite_active)
+    return;
+
+  /* nothing to issue, and no loads to check */
+  if (readyq_nruu_prio || readyq_nruu || readyq_nlsq
+      || lsq_nwake || lsq_sta_changed)
+    return;
+
+  /* nothing to commit */
+  if (RUU_num > 0 && RUU[RUU_head].completed
+      && (!RUU[RUU_head].ea_comp || LSQ[LSQ_head].completed))
+    return;
+
+  /* nothing to dispatch */
+  if (!ruu_dispatch_blocked())
+    return;
+
+  /* wait for the next event, and for fetch unless the IFQ is full or the
+     pipeline is draining */
+  until = eventq_next_time();
+  if (fetch_num < ruu_ifq_size && !ruu_draining)
     {
-      int icount;
-      md_inst_t inst;			/* actual instruction bits */
-      enum md_opcode op;		/* decoded opcode enum */
-      md_addr_t target_PC;		/* actual next/target PC address */
-      md_addr_t addr;			/* effective address, if load/store */
-      int is_write;			/* store? */
-      byte_t temp_byte = 0;		/* temp variable for spec mem access */
-      half_t temp_half = 0;		/* " ditto " */
-      word_t temp_word = 0;		/* " ditto " */
+      if (!ruu_fetch_issue_delay)
+	return;
+      if (!until || sim_cycle + ruu_fetch_issue_delay < until)
+	until = sim_cycle + ruu_fetch_issue_delay;
+    }
+  if (LSQ_storesets && lsq_ss_cleared + LSQ_SS_CLEAR < until)
+    until = lsq_ss_cleared + LSQ_SS_CLEAR;
+  if (until <= sim_cycle)
+    return;
+  n = until - sim_cycle;
+
+  /* count down the timers */
+  for (i=0; i<fu_pool->num_resources; i++)
+    fu_pool->resources[i].busy = MAX(fu_pool->resources[i].busy - (int)n, 0);
+  ruu_fetch_issue_delay = (ruu_fetch_issue_delay > n
+			   ? ruu_fetch_issue_delay - n : 0);
+
+  /* update buffer occupancy stats */
+  IFQ_count += n * fetch_num;
+  IFQ_fcount += ((fetch_num == ruu_ifq_size) ? n : 0);
+  RUU_count += n * RUU_num;
+  RUU_fcount += ((RUU_num == RUU_size) ? n : 0);
+  LSQ_count += n * LSQ_num;
+  LSQ_fcount += ((LSQ_num == LSQ_size) ? n : 0);
+
+  sim_cycle = until;
+}
+
+/* give the prefetch queues of the caches their turn to issue, once per cycle
+   up to MEM_NOW, which also covers the cycles skipped by ruu_skip_idle() and
+   the memory time advanced by functional warming */
+static void
+prefetch_tick(void)
+{
+  if (!prefetch_qsize)
+    return;
+
+  if (cache_dl1)
+    cache_prefetch_tick(cache_dl1, MEM_NOW);
+  if (cache_dl2)
+    cache_prefetch_tick(cache_dl2, MEM_NOW);
+  if (cache_il1 && cache_il1 != cache_dl1 && cache_il1 != cache_dl2)
+    cache_prefetch_tick(cache_il1, MEM_NOW);
+  if (cache_il2 && cache_il2 != cache_dl2)
+    cache_prefetch_tick(cache_il2, MEM_NOW);
+}
+
+
+/*
+ * sampled simulation, each sampling period runs a detailed warm-up and a
+ * measured sample unit, then drains the pipeline and executes the rest of
+ * the period functionally, keeping the caches, TLBs and branch predictor
+ * warm for the next sample
+ */
+
+/* execute COUNT insts starting at regs.regs_PC with no timing; if WARM is
+   set, the insts also access the I-cache, D-cache and TLBs and train the
+   branch predictor with their actual outcome, and count as executed and
+   warmed insts, keeping the inst count of EIO traces in step */
+static void
+fastfwd_exec(counter_t count,			/* insts to execute */
+	     int warm)				/* warm the caches and bpred? */
+{
+  counter_t icount;
+  int lat;				/* latency of a warming access */
+  struct predec_t *pd;			/* predecoded instruction */
+  md_inst_t inst;			/* actual instruction bits */
+  enum md_opcode op;			/* decoded opcode enum */
+  md_addr_t target_PC;			/* actual next/target PC address */
+  md_addr_t addr;			/* effective address, if load/store */
+  int is_write;				/* store? */
+  byte_t temp_byte = 0;			/* temp variable for spec mem access */
+  half_t temp_half = 0;			/* " ditto " */
+  word_t temp_word = 0;			/* " ditto " */
 #ifdef HOST_HAS_QWORD
-      qword_t temp_qword = 0;		/* " ditto " */
+  qword_t temp_qword = 0;		/* " ditto " */
 #endif /* HOST_HAS_QWORD */
-      enum md_fault_type fault;
-
-      fprintf(stderr, "sim: ** fast forwarding %d insts **\n", fastfwd_count);
+  enum md_fault_type fault;
+  md_addr_t bpred_PC;			/* predicted next PC */
+  struct bpred_update_t dir_update;	/* bpred direction update info */
+  int stack_recover_idx;		/* bpred retstack recovery index */
 
-      for (icount=0; icount < fastfwd_count; icount++)
-	{
-	  /* maintain $r0 semantics */
-	  regs.regs_R[MD_REG_ZERO] = 0;
+  for (icount=0; icount < count; icount++)
+    {
+      /* maintain $r0 semantics */
+      regs.regs_R[MD_REG_ZERO] = 0;
 #ifdef TARGET_ALPHA
-	  regs.regs_F.d[MD_REG_ZERO] = 0.0;
+      regs.regs_F.d[MD_REG_ZERO] = 0.0;
 #endif /* TARGET_ALPHA */
 
-	  /* get the next instruction to execute */
-	  MD_FETCH_INST(inst, mem, regs.regs_PC);
+      /* get the next instruction to execute, it is predecoded */
+      pd = predec_lookup(regs.regs_PC);
+      inst = pd->IR;
+      op = pd->op;
 
-	  /* set default reference address */
-	  addr = 0; is_write = FALSE;
+      /* functional execution never runs a bogus inst as a NOP, decode it
+	 again so it reaches the panic below */
+      if (pd->bogus)
+	MD_SET_OPCODE(op, inst);
+
+      /* warm the I-cache and I-TLB, accessed in parallel */
+      if (warm)
+	{
+	  lat = 1;
+	  if (cache_il1)
+	    lat = cache_access(cache_il1, Read, IACOMPRESS(regs.regs_PC),
+			       NULL, ISCOMPRESS(sizeof(md_inst_t)), MEM_NOW,
+			       NULL, NULL, regs.regs_PC, /* prefetch */0);
+	  if (itlb)
+	    lat = MAX(lat,
+		      cache_access(itlb, Read,
+				   TLB_ADDR(IACOMPRESS(regs.regs_PC)),
+				   NULL, ISCOMPRESS(sizeof(md_inst_t)), MEM_NOW,
+				   NULL, NULL, regs.regs_PC, /* prefetch */0));
+	  sim_num_insn++;
+	  sample_warm_insn++;
+	  sample_warm_cycles += MAX(lat, 1);
+	}
 
-	  /* set default fault - none */
-	  fault = md_fault_none;
+      /* set default reference address */
+      addr = 0; is_write = FALSE;
 
-	  /* decode the instruction */
-	  MD_SET_OPCODE(op, inst);
+      /* set default fault - none */
+      fault = md_fault_none;
 
-	  /* execute the instruction */
-	  switch (op)
-	    {
+      /* execute the instruction */
+      switch (op)
+	{
 #define DEFINST(OP,MSK,NAME,OPFORM,RES,FLAGS,O1,O2,I1,I2,I3)		\
-	    case OP:							\
-	      SYMCAT(OP,_IMPL);						\
-	      break;
+	case OP:							\
+	  SYMCAT(OP,_IMPL);						\
+	  break;
 #define DEFLINK(OP,MSK,NAME,MASK,SHIFT)					\
-	    case OP:							\
-	      panic("attempted to execute a linking opcode");
+	case OP:							\
+	  panic("attempted to execute a linking opcode");
 #define CONNECT(OP)
 #undef DECLARE_FAULT
 #define DECLARE_FAULT(FAULT)						\
-	      { fault = (FAULT); break; }
+	  { fault = (FAULT); break; }
 #include "machine.def"
-	    default:
-	      panic("attempted to execute a bogus opcode");
-	    }
+	default:
+	  panic("attempted to execute a bogus opcode");
+	}
+
+      if (fault != md_fault_none)
+	fatal("fault (%d) detected @ 0x%08p", fault, regs.regs_PC);
 
-	  if (fault != md_fault_none)
-	    fatal("fault (%d) detected @ 0x%08p", fault, regs.regs_PC);
+      /* update memory access stats */
+      if (pd->flags & F_MEM)
+	{
+	  if (pd->flags & F_STORE)
+	    is_write = TRUE;
 
-	  /* update memory access stats */
-	  if (MD_OP_FLAGS(op) & F_MEM)
+	  /* warm the D-cache and D-TLB, accessed in parallel */
+	  if (warm && MD_VALID_ADDR(addr))
 	    {
-	      if (MD_OP_FLAGS(op) & F_STORE)
-		is_write = TRUE;
+	      lat = 0;
+	      if (cache_dl1)
+		lat = cache_access(cache_dl1, is_write ? Write : Read,
+				   (addr & ~3), NULL, 4, MEM_NOW, NULL, NULL,
+				   regs.regs_PC, /* prefetch */0);
+	      if (dtlb)
+		lat = MAX(lat,
+			  cache_access(dtlb, Read, TLB_ADDR(addr & ~3),
+				       NULL, 4, MEM_NOW, NULL, NULL,
+				       regs.regs_PC, /* prefetch */0));
+	      sample_warm_cycles += lat;
 	    }
+	}
+
+      /* issue the prefetches queued while the memory time advanced */
+      if (warm)
+	prefetch_tick();
+
+      /* train the branch predictor with the actual branch outcome */
+      if (warm && pred && (pd->flags & F_CTRL))
+	{
+	  bpred_PC =
+	    bpred_lookup(pred,
+			 /* branch address */regs.regs_PC,
+			 /* target address *//* FIXME: not computed */0,
+			 /* opcode */op,
+			 /* call? */MD_IS_CALL(op),
+			 /* return? */MD_IS_RETURN(op),
+			 /* updt */&dir_update,
+			 /* RSB index */&stack_recover_idx);
+	  if (!bpred_PC)
+	    bpred_PC = regs.regs_PC + sizeof(md_inst_t);
+	  bpred_update(pred,
+		       /* branch address */regs.regs_PC,
+		       /* actual target address */regs.regs_NPC,
+		       /* taken? */regs.regs_NPC != (regs.regs_PC +
+						   sizeof(md_inst_t)),
+		       /* pred taken? */bpred_PC != (regs.regs_PC +
+						    sizeof(md_inst_t)),
+		       /* correct pred? */bpred_PC == regs.regs_NPC,
+		       /* opcode */op,
+		       /* predictor update ptr */&dir_update);
+	}
+
+      /* check for DLite debugger entry condition */
+      if (dlite_check_break(regs.regs_NPC,
+			    is_write ? ACCESS_WRITE : ACCESS_READ,
+			    addr, sim_num_insn, sim_num_insn))
+	dlite_main(regs.regs_PC, regs.regs_NPC, sim_num_insn, &regs, mem);
+
+      /* go to the next instruction */
+      regs.regs_PC = regs.regs_NPC;
+      regs.regs_NPC += sizeof(md_inst_t);
+    }
+}
+
+/* sampled simulation phases */
+enum sample_phase_t {
+  sample_warming,			/* detailed warm-up before a unit */
+  sample_measuring,			/* measuring a sample unit */
+  sample_draining			/* draining the pipeline */
+};
+
+/* current phase of the sampled simulation */
+static enum sample_phase_t sample_phase = sample_warming;
+
+/* inst count and cycle at the start of the current phase */
+static counter_t sample_phase_insn = 0;
+static tick_t sample_phase_cycle = 0;
+
+/* inst count at the start of the sampling period */
+static counter_t sample_period_insn = 0;
+
+/* sum and sum of squares of the sample unit CPIs */
+static double sample_cpi_sum = 0.0;
+static double sample_cpi_sumsq = 0.0;
+
+/* record the CPI of the sample unit that just ended */
+static void
+sample_record(void)
+{
+  counter_t n = sim_num_insn - sample_phase_insn;
+  tick_t cycles = sim_cycle - sample_phase_cycle;
+  double cpi = (double)cycles / (double)n, var;
+
+  sample_units++;
+  sample_insn += n;
+  sample_cycles += cycles;
+  sample_cpi_sum += cpi;
+  sample_cpi_sumsq += cpi * cpi;
+
+  /* mean and normal 95% confidence interval of the unit CPIs */
+  sample_cpi = sample_cpi_sum / (double)sample_units;
+  if (sample_units > 1)
+    {
+      var = ((sample_cpi_sumsq - sample_cpi_sum * sample_cpi)
+	     / (double)(sample_units - 1));
+      sample_cpi_sdev = var > 0.0 ? sqrt(var) : 0.0;
+      sample_cpi_err = 1.96 * sample_cpi_sdev / sqrt((double)sample_units);
+    }
+}
+
+/* advance the sampled simulation at the end of a cycle: start measuring
+   after the detailed warm-up, stop fetch and dispatch after the unit, and
+   once the pipeline is empty, execute the rest of the period functionally
+   and restart the pipeline at the next inst */
+static void
+sample_step(void)
+{
+  counter_t done, n;
+
+  switch (sample_phase)
+    {
+    case sample_warming:
+      if (sim_num_insn - sample_phase_insn < sample_warmup)
+	break;
+      sample_phase = sample_measuring;
+      sample_phase_insn = sim_num_insn;
+      sample_phase_cycle = sim_cycle;
+      break;
+
+    case sample_measuring:
+      if (sim_num_insn - sample_phase_insn < sample_unit)
+	break;
+      sample_record();
+
+      /* mis-predicted branches still recover, so the pipeline drains to
+	 the precise state after the last dispatched inst */
+      sample_phase = sample_draining;
+      ruu_draining = TRUE;
+      break;
+
+    case sample_draining:
+      if (RUU_num != 0)
+	break;
+      if (spec_mode)
+	panic("drained and speculative");
+      ruu_draining = FALSE;
+
+      /* continue with the oldest inst not dispatched */
+      regs.regs_PC = fetch_num ? fetch_data[fetch_head].regs_PC : fetch_pred_PC;
+      regs.regs_NPC = regs.regs_PC + sizeof(md_inst_t);
 
-	  /* check for DLite debugger entry condition */
-	  if (dlite_check_break(regs.regs_NPC,
-				is_write ? ACCESS_WRITE : ACCESS_READ,
-				addr, sim_num_insn, sim_num_insn))
-	    dlite_main(regs.regs_PC, regs.regs_NPC, sim_num_insn, &regs, mem);
+      /* execute the rest of the period functionally */
+      done = sim_num_insn - sample_period_insn;
+      if (done < sample_period)
+	{
+	  n = sample_period - done;
+	  if (max_insts && sim_num_insn + n > max_insts)
+	    n = MAX((counter_t)max_insts - sim_num_insn, 0);
+	  fastfwd_exec(n, /* warm */TRUE);
+	}
+
+      /* restart the pipeline with an empty IFQ */
+      fetch_num = 0;
+      fetch_tail = fetch_head = 0;
+      ruu_fetch_issue_delay = 0;
+      fetch_regs_PC = regs.regs_PC - sizeof(md_inst_t);
+      fetch_pred_PC = regs.regs_PC;
+      regs.regs_PC = regs.regs_PC - sizeof(md_inst_t);
+
+      sample_phase = sample_warming;
+      sample_phase_insn = sim_num_insn;
+      sample_phase_cycle = sim_cycle;
+      sample_period_insn = sim_num_insn;
+      break;
+
+    default:
+      panic("bogus sample phase");
+    }
+}
 
-	  /* go to the next instruction */
-	  regs.regs_PC = regs.regs_NPC;
-	  regs.regs_NPC += sizeof(md_inst_t);
+
+/* execute the program functionally, warming the caches, TLBs and branch
+   predictor, and write a checkpoint with the warm state every
+   CHKPT_INTERVAL insts, until -max:inst or the program exits */
+static void
+chkpt_perdump(void)
+{
+  char fname[256];
+  FILE *fd;
+  counter_t n;
+
+  for (;;)
+    {
+      n = chkpt_interval - sim_num_insn % chkpt_interval;
+      if (max_insts && sim_num_insn + n > max_insts)
+	{
+	  fastfwd_exec(MAX((counter_t)max_insts - sim_num_insn, 0),
+		       /* warm */TRUE);
+	  return;
 	}
+      fastfwd_exec(n, /* warm */TRUE);
+
+      /* checkpoint N is written at inst N * CHKPT_INTERVAL */
+      sprintf(fname, chkpt_opts[0], (int)(sim_num_insn / chkpt_interval));
+      fd = eio_create(fname);
+      myfprintf(stderr, "sim: writing checkpoint file `%s' @ inst %n...\n",
+		fname, sim_num_insn);
+      eio_write_chkpt(&regs, mem, fd);
+      warm_write_chkpt(fd);
+      eio_close(fd);
+    }
+}
+
+
+/* start simulation, program loaded, processor precise state initialized */
+void
+sim_main(void)
+{
+  /* ignore any floating point exceptions, they may occur on mis-speculated
+     execution paths */
+  signal(SIGFPE, SIG_IGN);
+
+  /* set up program entry state */
+  regs.regs_PC = ld_prog_entry;
+  regs.regs_NPC = regs.regs_PC + sizeof(md_inst_t);
+
+  /* check for DLite debugger entry condition */
+  if (dlite_check_break(regs.regs_PC, /* no access */0, /* addr */0, 0, 0))
+    dlite_main(regs.regs_PC, regs.regs_PC + sizeof(md_inst_t),
+	       sim_cycle, &regs, mem);
+
+  /* fast forward simulator loop, performs functional simulation for
+     FASTFWD_COUNT insts, then turns on performance (timing) simulation */
+  if (fastfwd_count > 0)
+    {
+      fprintf(stderr, "sim: ** fast forwarding %d insts **\n", fastfwd_count);
+      fastfwd_exec(fastfwd_count, /* !warm */FALSE);
+    }
+
+  /* write checkpoints instead of simulating the pipeline */
+  if (chkpt_interval)
+    {
+      myfprintf(stderr, "sim: ** writing checkpoints every %n insts **\n",
+		chkpt_interval);
+      chkpt_perdump();
+      return;
     }
 
   fprintf(stderr, "sim: ** starting performance simulation **\n");
@@ -4544,6 +6330,9 @@ sim_main(void)
       /* indicate new cycle in pipetrace */
       ptrace_newcycle(sim_cycle);
 
+      /* queued prefetches issue ahead of this cycle's demand accesses */
+      prefetch_tick();
+
       /* commit entries from RUU/LSQ to architected register file */
       ruu_commit();
 
@@ -4599,8 +6388,15 @@ sim_main(void)
       /* go to next cycle */
       sim_cycle++;
 
+      /* advance the sampled simulation */
+      if (sample_unit)
+	sample_step();
+
       /* finish early? */
       if (max_insts && sim_num_insn >= max_insts)
 	return;
+
+      /* skip ahead over idle cycles */
+      ruu_skip_idle();
     }
 }
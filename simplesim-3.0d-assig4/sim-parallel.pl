@@ -0,0 +1,251 @@
+#!/local/bin/perl
+
+#
+# sim-parallel - simulate the regions between checkpoints in parallel
+#
+
+# SimpleScalar(TM) Tool Suite
+# Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+# All Rights Reserved. 
+#
+# THIS IS A LEGAL DOCUMENT, BY USING SIMPLESCALAR,
+# YOU ARE AGREEING TO THESE TERMS AND CONDITIONS.
+#
+# No portion of this work may be used by any commercial entity, or for any
+# commercial purpose, without the prior, written permission of SimpleScalar,
+# LLC (info@simplescalar.com). Nonprofit and noncommercial use is permitted
+# as described below.
+#
+# 1. SimpleScalar is provided AS IS, with no warranty of any kind, express
+# or implied. The user of the program accepts full responsibility for the
+# application of the program and the use of any results.
+#
+# 2. Nonprofit and noncommercial use is encouraged. SimpleScalar may be
+# downloaded, compiled, executed, copied, and modified solely for nonprofit,
+# educational, noncommercial research, and noncommercial scholarship
+# purposes provided that this notice in its entirety accompanies all copies.
+# Copies of the modified software can be delivered to persons who use it
+# solely for nonprofit, educational, noncommercial research, and
+# noncommercial scholarship purposes provided that this notice in its
+# entirety accompanies all copies.
+#
+# 3. ALL COMMERCIAL USE, AND ALL USE BY FOR PROFIT ENTITIES, IS EXPRESSLY
+# PROHIBITED WITHOUT A LICENSE FROM SIMPLESCALAR, LLC (info@simplescalar.com).
+#
+# 4. No nonprofit user may place any restrictions on the use of this software,
+# including as modified by the user, by any other authorized user.
+#
+# 5. Noncommercial and nonprofit users may distribute copies of SimpleScalar
+# in compiled or executable form as set forth in Section 2, provided that
+# either: (A) it is accompanied by the corresponding machine-readable source
+# code, or (B) it is accompanied by a written offer, with no time limit, to
+# give anyone a machine-readable copy of the corresponding source code in
+# return for reimbursement of the cost of distribution. This written offer
+# must permit verbatim duplication by anyone, or (C) it is distributed by
+# someone who received only the executable form, and is accompanied by a
+# copy of the written offer of source code.
+#
+# 6. SimpleScalar was developed by Todd M. Austin, Ph.D. The tool suite is
+# currently maintained by SimpleScalar LLC (info@simplescalar.com). US Mail:
+# 2395 Timbercrest Court, Ann Arbor, MI 48105.
+#
+# Copyright (C) 1994-2003 by Todd M. Austin, Ph.D. and SimpleScalar, LLC.
+#
+
+
+#
+# config parms
+#
+$jobs = `getconf _NPROCESSORS_ONLN` + 0;
+$jobs = 1 if ($jobs < 1);
+$out_dir = ".";
+
+#
+# parse commands
+#
+while (@ARGV && $ARGV[0] =~ /^-[jd]$/)
+  {
+    $opt = shift(@ARGV);
+    if ($opt eq "-j")
+      {
+	$jobs = shift(@ARGV);
+      }
+    else
+      {
+	$out_dir = shift(@ARGV);
+      }
+  }
+if (@ARGV < 4 || $jobs < 1)
+  {
+     print STDERR
+"Usage: sim-parallel [-j <jobs>] [-d <dir>] <chkpt_format> <interval>\n".
+"                    <simulator> [<simulator_options>] <eio_trace>\n".
+"\n".
+"         Simulates the regions of an EIO trace between the checkpoints\n".
+"         written every <interval> insts by \"sim-outorder -chkpt:perdump\",\n".
+"         <jobs> simulations at a time (default: one per processor), and\n".
+"         merges their stats.  The region before the first checkpoint\n".
+"         starts at the beginning of the trace, the others start from the\n".
+"         checkpoints named by the printf-style <chkpt_format>, numbered\n".
+"         from 1, with their warm caches, TLBs and branch predictor, and\n".
+"         each region ends at the next checkpoint.  The simulator output\n".
+"         of region N is written to <dir>/region.N.out (default dir: .),\n".
+"         and the merged stats to the standard output: the sums of the\n".
+"         counters, with sim_num_insn counting the insts of the regions,\n".
+"         and the CPI, IPC, cache miss rates and branch prediction rates\n".
+"         recomputed from them.  The simulator options must not include\n".
+"         -max:inst, -chkpt or -redir:sim.\n".
+"\n".
+"         Example usage:\n".
+"\n".
+"           sim-eio -trace go.eio go.pisa-big 50 9 2stone9.in\n".
+"           sim-outorder -chkpt:perdump go.%d.chk 50000000 go.eio\n".
+"           sim-parallel -j 8 go.%d.chk 50000000 sim-outorder go.eio\n".
+"\n";
+     exit -1;
+  }
+
+($chkpt_fmt, $interval, @sim_cmd) = @ARGV;
+$eio_trace = pop(@sim_cmd);
+
+#
+# build the region list, region 0 starts at the beginning of the trace
+#
+for ($n=1; -e sprintf($chkpt_fmt, $n); $n++)
+  {
+    # nada
+  }
+@region_args = ();
+for ($i=0; $i < $n; $i++)
+  {
+    @args = ();
+    if ($i != 0)
+      {
+	@args = ("-chkpt", sprintf($chkpt_fmt, $i));
+      }
+    # the last region runs to the end of the program
+    if ($i != $n-1)
+      {
+	@args = (@args, "-max:inst", ($i+1) * $interval);
+      }
+    $region_args[$i] = join(' ', @args);
+  }
+
+#
+# run the regions, at most $jobs at a time
+#
+$start_time = time;
+$running = 0;
+$failed = 0;
+for ($i=0; $i < $n; $i++)
+  {
+    if ($running == $jobs)
+      {
+	wait;
+	$failed++ if ($? != 0);
+	$running--;
+      }
+
+    $pid = fork;
+    die "Cannot fork region $i\n" if (!defined($pid));
+    if ($pid == 0)
+      {
+	# program output of the region is discarded
+	open(STDOUT, ">/dev/null");
+	exec(@sim_cmd, split(' ', $region_args[$i]),
+	     "-redir:sim", "$out_dir/region.$i.out", $eio_trace)
+	    || die "Cannot run simulator: $sim_cmd[0]\n";
+      }
+    print STDERR "sim-parallel: region $i started: $region_args[$i]\n";
+    $running++;
+  }
+while ($running > 0)
+  {
+    wait;
+    $failed++ if ($? != 0);
+    $running--;
+  }
+$elapsed_time = time - $start_time;
+die "sim-parallel: $failed region(s) failed, see $out_dir/region.*.out\n"
+    if ($failed);
+
+#
+# merge the stats, counters are summed
+#
+@stat_names = ();
+for ($i=0; $i < $n; $i++)
+  {
+    open(SIM_OUTPUT, "$out_dir/region.$i.out")
+	|| die "Cannot open simulator output file: $out_dir/region.$i.out\n";
+    %region = ();
+    while (<SIM_OUTPUT>)
+      {
+	# counters, options are skipped
+	if (/^([^-\s]\S*)\s+(\d+) # (.*)$/)
+	  {
+	    $region{$1} = $2;
+	    if (!defined($stat_desc{$1}))
+	      {
+		@stat_names = (@stat_names, $1);
+		$stat_desc{$1} = $3;
+	      }
+	  }
+      }
+    close(SIM_OUTPUT);
+
+    # a region started from a checkpoint counts the insts before it
+    if (defined($region{"chkpt_start_insn"}))
+      {
+	$region{"sim_num_insn"} -= $region{"chkpt_start_insn"};
+      }
+    foreach $stat (keys %region)
+      {
+	$stat_sum{$stat} += $region{$stat};
+      }
+  }
+
+print "sim-parallel: ** merged statistics of $n regions **\n";
+foreach $stat (@stat_names)
+  {
+    # skip the loader and memory config, and the checkpoint start
+    next if ($stat =~ /^(ld_|mem\.|chkpt_)/);
+    printf "%-22s %15s # %s\n", $stat, $stat_sum{$stat}, $stat_desc{$stat};
+  }
+printf "%-22s %15d # %s\n", "sim_regions", $n,
+    "number of regions simulated";
+printf "%-22s %15d # %s\n", "parallel_elapsed_time", $elapsed_time,
+    "total time to simulate all regions in seconds";
+
+#
+# recompute the rates from the merged counters
+#
+sub print_rate
+  {
+    local($name, $num, $den, $desc) = @_;
+
+    if (defined($stat_sum{$num}) && $stat_sum{$den} > 0)
+      {
+	printf "%-22s %15.4f # %s\n",
+	    $name, $stat_sum{$num} / $stat_sum{$den}, $desc;
+      }
+  }
+
+&print_rate("sim_IPC", "sim_num_insn", "sim_cycle",
+	    "instructions per cycle");
+&print_rate("sim_CPI", "sim_cycle", "sim_num_insn",
+	    "cycles per instruction");
+foreach $stat (@stat_names)
+  {
+    if ($stat =~ /^(.+)\.misses$/ && defined($stat_sum{"$1.accesses"}))
+      {
+	&print_rate("$1.miss_rate", $stat, "$1.accesses",
+		    "miss rate (i.e., misses/ref)");
+      }
+    if ($stat =~ /^(.+)\.dir_hits$/ && defined($stat_sum{"$1.updates"}))
+      {
+	&print_rate("$1.bpred_dir_rate", $stat, "$1.updates",
+		    "branch direction-prediction rate (i.e., all-hits/updates)");
+      }
+  }
+
+exit 0;
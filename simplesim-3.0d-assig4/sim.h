@@ -93,6 +93,10 @@ extern char *sim_eio_fname;
 extern char *sim_chkpt_fname;
 extern FILE *sim_eio_fd;
 
+/* checkpoint stream restored from, left open after the architected state
+   so that simulators may read the state they added to the checkpoint */
+extern FILE *sim_chkpt_fd;
+
 /* redirected program/simulator output file names */
 extern FILE *sim_progfd;
 
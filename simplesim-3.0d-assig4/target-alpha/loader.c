@@ -184,8 +184,6 @@ ld_load_prog(char *fname,		/* program to load */
 	{
 	  counter_t restore_icnt;
 
-	  FILE *chkpt_fd;
-
 	  fprintf(stderr, "sim: loading checkpoint file: %s\n",
 		  sim_chkpt_fname);
 
@@ -193,11 +191,11 @@ ld_load_prog(char *fname,		/* program to load */
 	    fatal("file `%s' does not appear to be a checkpoint file",
 		  sim_chkpt_fname);
 
-	  /* open the checkpoint file */
-	  chkpt_fd = eio_open(sim_chkpt_fname);
+	  /* open the checkpoint file, it stays open for the simulator */
+	  sim_chkpt_fd = eio_open(sim_chkpt_fname);
 
 	  /* load the state image */
-	  restore_icnt = eio_read_chkpt(regs, mem, chkpt_fd);
+	  restore_icnt = eio_read_chkpt(regs, mem, sim_chkpt_fd);
 
 	  /* fast forward the baseline EIO trace to checkpoint location */
 	  myfprintf(stderr, "sim: fast forwarding to instruction %n\n",